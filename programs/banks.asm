@@ -0,0 +1,107 @@
+; Bank-Switched Table for SimpleCPU16
+; ===================================
+; Keeps a 32768-entry table, half the address space, in banks behind
+; the bank window at 0xC000: entry i lives in bank i / 4096 at offset
+; i % 4096. Run with --banks 8; with no bank store the bank count reads
+; as 0 and the program stops after printing it.
+;
+; Fills entry i with i * 3 one entry at a time (switching banks on
+; every access), sums the table a bank at a time (switching once per
+; bank), and reads two entries back in reverse order. Prints 8, the
+; sum mod 65536 (16384), entry 30000 (90000 mod 65536 = 24464) and
+; entry 5000 (15000).
+;
+; Calling convention as in factorial.asm: arguments in R0-R1, result
+; in R0; R2-R5 are scratch.
+
+.EQU INT_OUT, 0xF801
+.EQU BANK, 0xF830
+.EQU BANK_COUNT, 0xF831
+.EQU WINDOW, 0xC000
+.EQU WINDOW_WORDS, 0x1000
+.EQU BANK_BITS, 12
+.EQU TABLE_BANKS, 8
+.EQU ENTRIES, 0x8000
+
+.ORG 0x0000
+
+main:
+    LD R0, [BANK_COUNT]
+    ST [INT_OUT], R0          ; 8
+    LDI R1, 0
+    CMP R0, R1
+    BEQ main_done             ; No bank store
+
+    LDI R0, 0                 ; R0 = index
+    LDI R1, 0                 ; R1 = index * 3
+fill:
+    CALL put
+    ADDI R1, 3
+    INC R0
+    LDI R2, ENTRIES
+    CMP R0, R2
+    BNE fill
+
+    CALL sum
+    ST [INT_OUT], R0          ; 16384
+
+    LDI R0, 30000
+    CALL get
+    ST [INT_OUT], R0          ; 24464
+    LDI R0, 5000
+    CALL get
+    ST [INT_OUT], R0          ; 15000
+main_done:
+    HALT
+
+; ====================
+; PUT
+; ====================
+; R0 = index, R1 = value
+put:
+    MOV R2, R0
+    LDI R3, BANK_BITS
+    SHR R2, R3
+    ST [BANK], R2             ; Showing bank index / 4096
+    MOV R2, R0
+    LDI R3, WINDOW_WORDS - 1
+    AND R2, R3
+    ST [R2+WINDOW], R1
+    RET
+
+; ====================
+; GET
+; ====================
+; R0 = index
+; Returns: R0 = value
+get:
+    MOV R2, R0
+    LDI R3, BANK_BITS
+    SHR R2, R3
+    ST [BANK], R2
+    LDI R3, WINDOW_WORDS - 1
+    AND R0, R3
+    LD R0, [R0+WINDOW]
+    RET
+
+; ====================
+; SUM
+; ====================
+; Returns: R0 = sum of all entries (mod 65536)
+sum:
+    LDI R0, 0
+    LDI R1, 0                 ; R1 = bank
+sum_bank:
+    ST [BANK], R1
+    LDI R2, WINDOW            ; R2 walks the window
+    LDI R4, WINDOW + WINDOW_WORDS
+sum_word:
+    LD R3, [R2]+
+    ADD R0, R3
+    CMP R2, R4
+    BNE sum_word
+    INC R1
+    LDI R3, TABLE_BANKS
+    CMP R1, R3
+    BNE sum_bank
+    RET
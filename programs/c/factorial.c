@@ -0,0 +1,18 @@
+// Recursive Factorial in C for SimpleCPU16
+// ========================================
+// The C counterpart of programs/factorial.asm: compile with cc16,
+// assemble and run. Prints "Result: 120".
+
+int factorial(int n) {
+    if (n <= 1) return 1;
+    return n * factorial(n - 1);
+}
+
+int main(void) {
+    putstr("Computing factorial of 5...");
+    int result = factorial(5);
+    putstr("Result: ");
+    putint(result);
+    putchar('\n');
+    return 0;
+}
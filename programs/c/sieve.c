@@ -0,0 +1,40 @@
+// Sieve of Eratosthenes in C for SimpleCPU16
+// ==========================================
+// Prints the primes below 200, then their count and sum.
+// Exercises global arrays, nested loops and pointer parameters.
+
+int composite[200];
+
+// Marks every multiple of p from p*p up (p*p below limit is checked
+// as p <= limit / p, which cannot overflow 16-bit int)
+void strike(int* table, int p, int limit) {
+    if (p > limit / p) return;
+    for (int m = p * p; m < limit; m += p) table[m] = 1;
+}
+
+int sieve(int limit) {
+    int count = 0;
+    for (int p = 2; p < limit; p++) {
+        if (composite[p]) continue;
+        count++;
+        if (p <= limit / p) strike(composite, p, limit);
+    }
+    return count;
+}
+
+int main(void) {
+    int count = sieve(200);
+    unsigned sum = 0;
+    for (int p = 2; p < 200; p++) {
+        if (!composite[p]) {
+            putint(p);
+            sum += p;
+        }
+    }
+    putstr("Primes: ");
+    putint(count);
+    putstr("Sum: ");
+    putint(sum);
+    putchar('\n');
+    return 0;
+}
@@ -11,7 +11,7 @@
 ;
 ; MEMORY LAYOUT:
 ; 0x0000 - 0x00XX : Code section (main, factorial function)
-; 0xDFE0 - 0xDFFF : Data section (strings, constants)
+; 0xD000 - 0xD01F : Data section (strings, constants)
 ; 0xE000          : Stack starts here (grows downward)
 
 .ORG 0x0000
@@ -63,9 +63,8 @@ main:
 
 factorial:
     ; --- PROLOGUE: Save registers we'll use ---
-    PUSH R1                   ; Save R1
-    PUSH R2                   ; Save R2
-    ; Stack now: [ret_addr][R1][R2] <- SP
+    PUSHM R1, R2              ; Save R2 then R1 in one instruction
+    ; Stack now: [ret_addr][R2][R1] <- SP
 
     ; --- CHECK BASE CASE: if (n <= 1) return 1 ---
     LDI R1, 1                 ; R1 = 1 for comparison
@@ -94,14 +93,13 @@ base_case:
 
 factorial_return:
     ; --- EPILOGUE: Restore registers and return ---
-    POP R2                    ; Restore R2
-    POP R1                    ; Restore R1
+    POPM R1, R2               ; Restore R1 then R2
     RET                       ; Return to caller
 
 ; ====================
 ; DATA SECTION
 ; ====================
-.ORG 0xDFE0
+.ORG 0xD000
 
 msg_computing:
     .STRING "Computing factorial of 5..."
@@ -0,0 +1,31 @@
+; Linked Factorial: factorial function
+; ====================================
+; Exported with .global so main.asm can call it. The local labels below
+; are relocated to wherever the linker places this object.
+;
+; Arguments:  R0 = n
+; Returns:    R0 = n!
+
+.global factorial
+
+factorial:
+    PUSH R1
+    PUSH R2
+
+    LDI R1, 1
+    CMP R0, R1
+    BLE base_case             ; n <= 1: return 1
+
+    MOV R2, R0                ; R2 = n
+    DEC R0
+    CALL factorial            ; R0 = factorial(n - 1)
+    MUL R0, R2                ; R0 = n * factorial(n - 1)
+    JMP factorial_return
+
+base_case:
+    LDI R0, 1
+
+factorial_return:
+    POP R2
+    POP R1
+    RET
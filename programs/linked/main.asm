@@ -0,0 +1,32 @@
+; Linked Factorial: main program
+; ==============================
+; Same output as factorial.asm, built from two objects:
+;   asmbuild main.asm factorial.asm -o linked.bin
+; main.asm is linked first, so it starts at address 0. factorial is
+; defined in factorial.asm and resolved by the linker.
+
+.extern factorial
+
+main:
+    LDI R0, msg_computing
+    ST [0xF802], R0           ; Print "Computing factorial..."
+
+    LDI R0, 5                 ; Argument: n = 5
+    CALL factorial            ; Imported: patched at link time
+    MOV R1, R0                ; R1 = result (120)
+
+    LDI R0, msg_result
+    ST [0xF802], R0           ; Print "Result: "
+    MOV R0, R1
+    ST [0xF801], R0           ; Print integer result
+    LDI R0, 10
+    ST [0xF800], R0           ; Print newline
+
+    HALT
+
+; Data follows the code; the linker relocates these addresses
+msg_computing:
+    .STRING "Computing factorial of 5..."
+
+msg_result:
+    .STRING "Result: "
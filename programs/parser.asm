@@ -0,0 +1,158 @@
+; Command Parser for SimpleCPU16 (fuzzing target)
+; ================================================
+; Reads one-letter commands with decimal arguments from the character
+; input device until end of input and prints a result for each:
+;
+;   A<n>,<m>   prints n + m
+;   R<n>       recurses n levels and prints n
+;   W<n>       counts up to n and prints the count
+;   J<i>       runs handler i (0-3), which prints a letter
+;
+; It has deliberate bugs for `make fuzz` to find: R has no depth limit
+; (runaway stack), W never finishes for n = 0 (cycle budget), and J
+; does not check i against the size of its table (wild jump).
+;
+; Calling convention as in factorial.asm: argument and result in R0.
+
+.EQU CHAR_OUT, 0xF800
+.EQU INT_OUT, 0xF801
+.EQU CHAR_IN, 0xF820
+.EQU END_OF_INPUT, 0xFFFF
+
+.ORG 0x0000
+
+main:
+    LD R0, [CHAR_IN]
+next_command:
+    LDI R1, END_OF_INPUT
+    CMP R0, R1
+    BEQ done
+    LDI R1, 'A'
+    CMP R0, R1
+    BEQ cmd_add
+    LDI R1, 'R'
+    CMP R0, R1
+    BEQ cmd_recurse
+    LDI R1, 'W'
+    CMP R0, R1
+    BEQ cmd_wait
+    LDI R1, 'J'
+    CMP R0, R1
+    BEQ cmd_jump
+    LDI R1, 10
+    CMP R0, R1
+    BEQ main                  ; Blank line
+    LDI R1, '?'               ; Unknown command
+    ST [CHAR_OUT], R1
+    JMP main
+
+done:
+    HALT
+
+; A<n>,<m>: sum of two numbers
+cmd_add:
+    CALL read_number
+    LDI R2, ','
+    CMP R1, R2
+    BNE syntax_error
+    MOV R4, R0
+    CALL read_number
+    ADD R0, R4
+    ST [INT_OUT], R0
+    MOV R0, R1                ; Character after the number
+    JMP next_command
+
+; R<n>: recursion n levels deep
+cmd_recurse:
+    CALL read_number
+    MOV R4, R0
+    CALL recurse
+    ST [INT_OUT], R4
+    MOV R0, R1
+    JMP next_command
+
+; W<n>: counting loop that only stops when the counter equals n
+cmd_wait:
+    CALL read_number
+    LDI R2, 0
+wait_loop:
+    INC R2
+    CMP R2, R0
+    BNE wait_loop
+    ST [INT_OUT], R2
+    MOV R0, R1
+    JMP next_command
+
+; J<i>: dispatch through handler_table (i is not range checked)
+cmd_jump:
+    CALL read_number
+    LDI R2, handler_table
+    ADD R2, R0
+    LD R2, [R2]
+    MOV R0, R1
+    PUSH R2
+    RET                       ; Jump to handler_table[i]
+
+handler_0:
+    LDI R2, 'a'
+    JMP handler_done
+handler_1:
+    LDI R2, 'b'
+    JMP handler_done
+handler_2:
+    LDI R2, 'c'
+    JMP handler_done
+handler_3:
+    LDI R2, 'd'
+handler_done:
+    ST [CHAR_OUT], R2
+    JMP next_command
+
+syntax_error:
+    LDI R2, '!'
+    ST [CHAR_OUT], R2
+    MOV R0, R1
+    JMP next_command
+
+; ====================
+; READ_NUMBER
+; ====================
+; Reads decimal digits from the input device
+; Returns: R0 = value (modulo 65536), R1 = first character after the digits
+read_number:
+    PUSH R2
+    LDI R0, 0
+read_digit:
+    LD R1, [CHAR_IN]
+    LDI R2, '0'
+    CMP R1, R2
+    BLT read_done             ; Also end of input (0xFFFF is negative)
+    LDI R2, '9'
+    CMP R1, R2
+    BGT read_done
+    SUBI R1, '0'
+    LDI R2, 10
+    MUL R0, R2
+    ADD R0, R1
+    JMP read_digit
+read_done:
+    POP R2
+    RET
+
+; ====================
+; RECURSE
+; ====================
+; Calls itself R0 times, keeping two words per level on the stack
+recurse:
+    PUSH R0
+    LDI R2, 0
+    CMP R0, R2
+    BEQ recurse_done
+    DEC R0
+    CALL recurse
+recurse_done:
+    POP R0
+    RET
+
+handler_table:
+    .WORD handler_0, handler_1, handler_2, handler_3
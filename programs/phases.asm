@@ -0,0 +1,108 @@
+; Program Phases for SimpleCPU16
+; ==============================
+; A workload for the sampled simulator: rounds of three phases that
+; behave differently under the timing model, so intervals cluster by
+; phase and the clusters differ in CPI.
+;
+;   scan    Sums a 4096-word table front to back twice. Sequential:
+;           one cache miss per line, well-predicted loop branches.
+;   stride  Walks the table 512 words at a time. Every address maps to
+;           the same cache set of the default 64-set, 8-word-line cache,
+;           so all eight conflict and nearly every load misses.
+;   random  Steps a linear congruential generator and branches on one
+;           of its bits: about half the branches are mispredicted.
+;
+; A fill pass first writes i * 7 to entry i. Prints the total of all
+; phases mod 65536 at the end.
+;
+; Registers: R0 = running total; R1-R5 are scratch, except that R5
+; holds the generator state through the random phase.
+
+.EQU INT_OUT, 0xF801
+.EQU TABLE, 0x4000
+.EQU TABLE_WORDS, 0x1000
+.EQU STRIDE, 512
+.EQU STRIDE_PASSES, 600
+.EQU RANDOM_STEPS, 3000
+.EQU ROUNDS, 5
+
+.ORG 0x0000
+
+main:
+    LDI R0, 0
+    LDI R1, 0
+    LDI R2, TABLE
+    LDI R4, TABLE + TABLE_WORDS
+fill:
+    ST [R2]+, R1
+    ADDI R1, 7
+    CMP R2, R4
+    BNE fill
+
+    LDI R5, 1                 ; Generator seed
+    LDI R1, ROUNDS
+round:
+    PUSH R1
+    CALL scan
+    CALL scan
+    CALL stride
+    CALL random
+    POP R1
+    DEC R1
+    BNE round
+
+    ST [INT_OUT], R0
+    HALT
+
+; ====================
+; SCAN
+; ====================
+; Adds every table entry to R0
+scan:
+    LDI R2, TABLE
+    LDI R4, TABLE + TABLE_WORDS
+scan_word:
+    LD R3, [R2]+
+    ADD R0, R3
+    CMP R2, R4
+    BNE scan_word
+    RET
+
+; ====================
+; STRIDE
+; ====================
+; Adds every STRIDE-th table entry to R0, STRIDE_PASSES times
+stride:
+    LDI R1, STRIDE_PASSES
+    LDI R4, TABLE + TABLE_WORDS
+stride_pass:
+    LDI R2, TABLE
+stride_word:
+    LD R3, [R2]
+    ADD R0, R3
+    ADDI R2, STRIDE
+    CMP R2, R4
+    BNE stride_word
+    DEC R1
+    BNE stride_pass
+    RET
+
+; ====================
+; RANDOM
+; ====================
+; Counts into R0 the steps whose generator state (R5) has bit 14 set
+random:
+    LDI R1, RANDOM_STEPS
+    LDI R4, 0x4000
+random_step:
+    LDI R3, 25173
+    MUL R5, R3
+    ADDI R5, 13849
+    MOV R3, R5
+    AND R3, R4
+    BEQ random_skip
+    INC R0
+random_skip:
+    DEC R1
+    BNE random_step
+    RET
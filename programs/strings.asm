@@ -0,0 +1,119 @@
+; Packed String Routines for SimpleCPU16
+; ======================================
+; Works on .STRING data (two characters per word, low byte first) a
+; word at a time with the packed-byte instructions, instead of
+; splitting every word with shifts and masks:
+;
+;   strlen  counts characters with BFZ (find zero byte)
+;   strchr  finds a character with BCMPEQ against a broadcast pattern
+;   streq   compares whole words, stopping at the word holding the end
+;
+; Prints the length of greeting, the index of 'W' in it, whether it
+; equals copy and other, and the string itself.
+;
+; Calling convention as in factorial.asm: arguments in R0-R1, result
+; in R0; R2-R5 are scratch.
+
+.EQU CHAR_OUT, 0xF800
+.EQU INT_OUT, 0xF801
+.EQU STR_OUT, 0xF802
+
+.ORG 0x0000
+
+main:
+    LDI R0, greeting
+    CALL strlen
+    ST [INT_OUT], R0          ; 13
+
+    LDI R0, greeting
+    LDI R1, 'W'
+    CALL strchr
+    ST [INT_OUT], R0          ; 7
+
+    LDI R0, greeting
+    LDI R1, copy
+    CALL streq
+    ST [INT_OUT], R0          ; 1
+
+    LDI R0, greeting
+    LDI R1, other
+    CALL streq
+    ST [INT_OUT], R0          ; 0
+
+    LDI R0, greeting
+    ST [STR_OUT], R0
+    LDI R0, 10
+    ST [CHAR_OUT], R0
+    HALT
+
+; ====================
+; STRLEN
+; ====================
+; R0 = address of a packed string
+; Returns: R0 = number of characters
+strlen:
+    LDI R2, 0                 ; Characters in the words before this one
+strlen_word:
+    LD R1, [R0]+
+    BFZ R3, R1                ; R3 = characters before a zero byte
+    ADD R2, R3
+    LDI R4, 2
+    CMP R3, R4
+    BEQ strlen_word           ; Both bytes were characters
+    MOV R0, R2
+    RET
+
+; ====================
+; STRCHR
+; ====================
+; R0 = address of a packed string, R1 = character (not zero)
+; Returns: R0 = index of its first occurrence, or 0xFFFF
+strchr:
+    MOV R5, R0                ; Start, to turn the address into an index
+    MOV R2, R1                ; Broadcasting the character to both bytes
+    BSWAP R2
+    OR R1, R2
+strchr_word:
+    LD R2, [R0]+
+    MOV R3, R2
+    BCMPEQ R3, R1
+    BNE strchr_found          ; Some byte matched
+    BFZ R3, R2
+    BCC strchr_word           ; No zero byte: keep going
+    LDI R0, 0xFFFF
+    RET
+strchr_found:
+    DEC R0                    ; Index = 2 * word + byte
+    SUB R0, R5
+    ADD R0, R0
+    LDI R2, 0x00FF
+    AND R3, R2
+    BNE strchr_done           ; Low byte matched first
+    INC R0
+strchr_done:
+    RET
+
+; ====================
+; STREQ
+; ====================
+; R0, R1 = addresses of two packed strings
+; Returns: R0 = 1 if they are equal, 0 if not
+streq:
+    LD R2, [R0]+
+    LD R3, [R1]+
+    CMP R2, R3
+    BNE streq_differ
+    BFZ R4, R2
+    BCC streq                 ; Equal words without the end: keep going
+    LDI R0, 1
+    RET
+streq_differ:
+    LDI R0, 0
+    RET
+
+greeting:
+    .STRING "Hello, World!"
+copy:
+    .STRING "Hello, World!"
+other:
+    .STRING "Hello, Worlds"
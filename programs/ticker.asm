@@ -0,0 +1,37 @@
+; Timer-Paced Ticker for SimpleCPU16
+; ==================================
+; Prints a tick count every 5000 cycles, 20 times, by polling the
+; timer device between ticks. The 100000 cycles this takes cross the
+; 16-bit wrap of the timer, so the wait compares against the deadline
+; with a signed difference (CMP then BLT) rather than an unsigned one.
+;
+; Nearly every cycle is spent in the three-instruction wait loop, which
+; the fastforward engine skips instead of running.
+
+.EQU INT_OUT, 0xF801
+.EQU CHAR_OUT, 0xF800
+.EQU TIMER, 0xF810
+.EQU PERIOD, 5000
+.EQU TICKS, 20
+
+.ORG 0x0000
+
+main:
+    LD R1, [TIMER]            ; R1 = next deadline
+    LDI R2, 0                 ; R2 = ticks so far
+    LDI R3, TICKS
+    LDI R4, ' '
+tick:
+    ADDI R1, PERIOD
+wait:
+    LD R0, [TIMER]
+    CMP R0, R1
+    BLT wait                  ; Until timer - deadline >= 0
+    INC R2
+    ST [INT_OUT], R2
+    ST [CHAR_OUT], R4
+    CMP R2, R3
+    BNE tick
+    LDI R4, 10
+    ST [CHAR_OUT], R4
+    HALT
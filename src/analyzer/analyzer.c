@@ -0,0 +1,1370 @@
+#include "analyzer.h"
+#include "../emulator/isa.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#define AN_ADDRESSES 0x10001        // Every address plus one past the end
+#define AN_NO_DEPTH INT_MIN
+#define AN_NONE UINT32_MAX
+#define AN_VALUE_SEARCH 32          // Blocks walked back looking for a constant
+
+// Per-address decode marks
+enum { CODE_NONE, CODE_START, CODE_EXT };
+
+// How a basic block ends
+typedef enum {
+    END_FALL,                   // Runs into the next block
+    END_BRANCH,                 // succ[0] taken, succ[1] fall-through
+    END_JUMP,
+    END_CALL,                   // Continues at succ[0] once the callee returns
+    END_RET,
+    END_HALT,
+    END_FAULT                   // No valid instruction here
+} BlockEnd;
+
+// Worst-case cost; every field is maximized on its own
+typedef struct {
+    uint64_t insns;
+    uint64_t cycles;
+    uint64_t calls;             // Calls back into the function's own recursive cycle
+} Cost;
+
+typedef struct {
+    uint32_t start;
+    uint32_t end;               // Address after the last instruction
+    uint8_t kind;               // BlockEnd
+    uint8_t writes;             // Registers written (bit per register)
+    bool sp_lost;               // SP written in a way that cannot be tracked
+    bool reported;              // Fault already reported
+    int succ[2];
+    int succ_count;
+    int callee;                 // Function called (END_CALL)
+    int delta;                  // Net words pushed
+    int peak;                   // Most words pushed at any point, relative to entry
+    int low;                    // Most words popped at any point, relative to entry
+    Cost cost;
+} Block;
+
+typedef struct {
+    uint16_t entry;
+    const char* name;
+    char fallback[16];          // Name when no label marks the entry
+    int* blocks;                // Global block ids reachable without calls; [0] is the entry
+    int block_count;
+    int* callees;               // Distinct
+    int callee_count;
+    int scc;                    // Call-graph component
+    int index;                  // Tarjan bookkeeping
+    int lowlink;
+    bool on_stack;
+    uint8_t clobbers;           // Registers a call to it may change
+    // On its own, with calls into its own component costing nothing
+    bool own_stack_ok;
+    uint64_t own_stack;         // Deepest point
+    uint64_t call_depth;        // Deepest call into its own component (return address included)
+    bool own_time_ok;
+    Cost own_time;
+    // Final bounds
+    bool stack_ok;
+    uint64_t stack;
+    bool time_ok;
+    Cost time;
+} Function;
+
+typedef struct {
+    const uint16_t* image;
+    uint32_t size;
+    const AnalyzerOptions* options;
+    FILE* out;
+    bool ok;                    // Cleared by malformed code and missing bounds
+    uint8_t* code;              // CODE_* per address
+    uint8_t* leader;            // Block starts
+    int* block_at;              // Block starting at an address, or -1
+    int* func_at;               // Function entered at an address, or -1
+    Block* blocks;
+    int block_count;
+    int block_capacity;
+    Function* funcs;
+    int func_count;
+    int func_capacity;
+    int* local;                 // Global block id -> index in the function being analyzed
+    int* tarjan;                // Tarjan's stack of functions
+    int tarjan_top;
+    int tarjan_index;
+    int* order;                 // Functions by component, callees first
+    int order_count;
+    int scc_count;
+} Analyzer;
+
+// A natural loop of the function being analyzed
+typedef struct {
+    int header;                 // Local block index
+    uint8_t* body;              // Membership per local block
+    int size;
+    int* latches;               // Sources of the back edges
+    int latch_count;
+    int parent;                 // Enclosing loop, or -1
+    bool terminates;            // Contains a RET, HALT or fault
+    uint32_t bound;             // Header executions per entry (0 = unknown)
+    Cost total;                 // Worst case for one entry
+} Loop;
+
+// Control-flow graph of one function in local block indices
+typedef struct {
+    Analyzer* an;
+    Function* func;
+    int n;
+    int* pred_first;            // preds[pred_first[x] .. pred_first[x + 1])
+    int* preds;
+    int* rpo;                   // Blocks in reverse postorder
+    int* rpo_index;
+    int* idom;
+    int* retreat_from;          // Edges to a block still on the DFS stack
+    int* retreat_to;
+    int retreat_count;
+    bool irreducible;
+    Loop* loops;                // Innermost (smallest) first
+    int loop_count;
+    int* innermost;             // Innermost loop of each block, or -1
+    Cost* cost;                 // Block cost, callee included
+    Cost* dist;                 // Scratch for longest paths
+    uint8_t* reached;
+} FuncGraph;
+
+// ============================================================
+// Costs (saturating)
+// ============================================================
+
+static uint64_t an_add(uint64_t a, uint64_t b) {
+    return a > UINT64_MAX - b ? UINT64_MAX : a + b;
+}
+
+static uint64_t an_mul(uint64_t a, uint64_t b) {
+    return (a != 0 && b > UINT64_MAX / a) ? UINT64_MAX : a * b;
+}
+
+static Cost an_cost_add(Cost a, Cost b) {
+    Cost sum = { an_add(a.insns, b.insns), an_add(a.cycles, b.cycles), an_add(a.calls, b.calls) };
+    return sum;
+}
+
+static Cost an_cost_scale(Cost a, uint64_t factor) {
+    Cost product = { an_mul(a.insns, factor), an_mul(a.cycles, factor), an_mul(a.calls, factor) };
+    return product;
+}
+
+static Cost an_cost_max(Cost a, Cost b) {
+    Cost max = { a.insns > b.insns ? a.insns : b.insns,
+                 a.cycles > b.cycles ? a.cycles : b.cycles,
+                 a.calls > b.calls ? a.calls : b.calls };
+    return max;
+}
+
+// Cycles taken by one instruction (the emulator retires one per cycle)
+static uint64_t an_cycles(const InsnInfo* insn) {
+    (void)insn;
+    return 1;
+}
+
+// ============================================================
+// Decoding
+// ============================================================
+
+// Finding the first label at an address (NULL if none)
+static const char* an_label(const Analyzer* an, uint32_t address) {
+    for (int i = 0; i < an->options->label_count; i++) {
+        if (an->options->labels[i].address == address) return an->options->labels[i].name;
+    }
+    return NULL;
+}
+
+// Decoding a whole instruction inside the image (NULL if invalid or cut off)
+static const InsnInfo* an_insn(const Analyzer* an, uint32_t address) {
+    if (address >= an->size) return NULL;
+    const InsnInfo* insn = isa_decode(an->image[address]);
+    if (!insn || address + insn->length > an->size) return NULL;
+    return insn;
+}
+
+static uint16_t an_ext(const Analyzer* an, uint32_t address) {
+    return address + 1 < an->size ? an->image[address + 1] : 0;
+}
+
+// Step an auto-increment or auto-decrement access applies to its
+// address register (0 for other instructions)
+static int an_auto_step(const InsnInfo* insn) {
+    if (insn->opcode == OP_LOAD) return insn->sub == LOAD_POSTINC ? 1 : insn->sub == LOAD_PREDEC ? -1 : 0;
+    if (insn->opcode == OP_STORE) return insn->sub == STORE_POSTINC ? 1 : insn->sub == STORE_PREDEC ? -1 : 0;
+    return 0;
+}
+
+// Registers an instruction writes, as a mask (SP only when named)
+static uint8_t an_dests(const InsnInfo* insn, uint16_t word, uint16_t ext) {
+    uint8_t rd = (uint8_t)(1 << ((word >> 9) & 0x7));
+    uint8_t rs = (uint8_t)(1 << ((word >> 6) & 0x7));
+    switch (insn->opcode) {
+        case OP_LOAD:
+            return an_auto_step(insn) ? rd | rs : rd;
+        case OP_STORE:
+            return an_auto_step(insn) ? rd : 0;
+        case OP_MOVE: case OP_ARITH: case OP_LOGIC: case OP_SHIFT: case OP_SPEC:
+            return rd;
+        case OP_STACK:
+            if (insn->sub == STACK_POPM) return (uint8_t)(ext & STACK_MASK_REGS);
+            return insn->sub == STACK_POP ? rd : 0;
+        default:
+            return 0;
+    }
+}
+
+static bool an_sets_flags(const InsnInfo* insn) {
+    return insn->opcode == OP_ARITH || insn->opcode == OP_LOGIC ||
+           insn->opcode == OP_SHIFT || insn->opcode == OP_CMP || insn->opcode == OP_SPEC;
+}
+
+static int an_add_function(Analyzer* an, uint16_t entry) {
+    if (an->func_at[entry] >= 0) return an->func_at[entry];
+    if (an->func_count == an->func_capacity) {
+        an->func_capacity = an->func_capacity ? an->func_capacity * 2 : 16;
+        an->funcs = (Function*)realloc(an->funcs, an->func_capacity * sizeof(Function));
+    }
+    Function* func = &an->funcs[an->func_count];
+    memset(func, 0, sizeof(Function));
+    func->entry = entry;
+    func->name = an_label(an, entry);
+    if (!func->name) {
+        snprintf(func->fallback, sizeof(func->fallback), entry == an->options->entry ? "start" : "sub_%04X", entry);
+        func->name = func->fallback;
+    }
+    func->index = -1;
+    an->func_at[entry] = an->func_count;
+    return an->func_count++;
+}
+
+static void an_mark_leader(Analyzer* an, uint32_t address, uint32_t* work, int* top) {
+    if (an->leader[address]) return;
+    an->leader[address] = 1;
+    work[(*top)++] = address;
+}
+
+// Following every path from the entry point and each CALL target, marking
+// instruction words and block leaders
+static void an_discover(Analyzer* an) {
+    uint32_t* work = (uint32_t*)malloc(AN_ADDRESSES * sizeof(uint32_t));
+    int top = 0;
+    an_mark_leader(an, an->options->entry, work, &top);
+    an_add_function(an, an->options->entry);
+
+    while (top > 0) {
+        uint32_t address = work[--top];
+        while (true) {
+            // Joining code decoded already, or a fault (reported per block)
+            const InsnInfo* insn = an_insn(an, address);
+            if (an->code[address] != CODE_NONE || !insn) {
+                an_mark_leader(an, address, work, &top);
+                break;
+            }
+            an->code[address] = CODE_START;
+            for (int i = 1; i < insn->length; i++) {
+                if (an->code[address + i] == CODE_START) {
+                    fprintf(stderr, "Error: Instruction at 0x%04X overlaps the one at 0x%04X\n",
+                            address, address + i);
+                    an->ok = false;
+                }
+                an->code[address + i] = CODE_EXT;
+            }
+
+            uint16_t target = an_ext(an, address);
+            uint32_t next = address + insn->length;
+            if (insn->opcode == OP_BRANCH || insn->opcode == OP_CALL) {
+                an_mark_leader(an, target, work, &top);
+                an_mark_leader(an, next, work, &top);
+                if (insn->opcode == OP_CALL) an_add_function(an, target);
+            } else if (insn->opcode == OP_JUMP) {
+                an_mark_leader(an, target, work, &top);
+                break;
+            } else if (insn->opcode == OP_RET || insn->opcode == OP_HALT) {
+                break;
+            }
+            address = next;
+        }
+    }
+    free(work);
+}
+
+// Tracking the words pushed by one instruction
+static void an_stack_effect(Block* block, const InsnInfo* insn, uint16_t word, uint16_t ext, int* depth) {
+    uint8_t dests = an_dests(insn, word, ext);
+    if (insn->opcode == OP_STACK) {
+        int words = insn->length > 1 ? __builtin_popcount(ext & STACK_MASK_REGS) : 1;
+        bool push = insn->sub == STACK_PUSH || insn->sub == STACK_PUSHM;
+        *depth += push ? words : -words;
+        if (dests & (1 << REG_SP)) block->sp_lost = true;
+    } else if (dests & (1 << REG_SP)) {
+        // [SP]+ pops a word and -[SP] pushes one, unless SP is also loaded
+        bool sp_loaded = insn->opcode == OP_LOAD && ((word >> 9) & 0x7) == REG_SP;
+        if (insn->opcode == OP_ARITH && insn->sub == ARITH_INC) *depth -= 1;
+        else if (insn->opcode == OP_ARITH && insn->sub == ARITH_DEC) *depth += 1;
+        else if (insn->opcode == OP_ARITH && insn->sub == ARITH_ADDI) *depth -= (int16_t)ext;
+        else if (insn->opcode == OP_ARITH && insn->sub == ARITH_SUBI) *depth += (int16_t)ext;
+        else if (an_auto_step(insn) && !sp_loaded) *depth -= an_auto_step(insn);
+        else block->sp_lost = true;
+    }
+    block->writes |= dests;
+    if (*depth > block->peak) block->peak = *depth;
+    if (*depth < block->low) block->low = *depth;
+}
+
+// Cutting the decoded code into basic blocks
+static void an_build_blocks(Analyzer* an) {
+    for (uint32_t address = 0; address < AN_ADDRESSES; address++) {
+        if (!an->leader[address]) continue;
+        if (an->block_count == an->block_capacity) {
+            an->block_capacity = an->block_capacity ? an->block_capacity * 2 : 64;
+            an->blocks = (Block*)realloc(an->blocks, an->block_capacity * sizeof(Block));
+        }
+        an->block_at[address] = an->block_count;
+        Block* block = &an->blocks[an->block_count++];
+        memset(block, 0, sizeof(Block));
+        block->start = address;
+        block->callee = -1;
+
+        uint32_t pc = address;
+        if (an->code[pc] != CODE_START) {
+            block->kind = END_FAULT;
+            block->end = pc;
+            continue;
+        }
+
+        int depth = 0;
+        while (true) {
+            const InsnInfo* insn = isa_decode(an->image[pc]);
+            uint16_t ext = an_ext(an, pc);
+            block->cost.insns++;
+            block->cost.cycles += an_cycles(insn);
+            an_stack_effect(block, insn, an->image[pc], ext, &depth);
+            pc += insn->length;
+
+            bool ends = true;
+            switch (insn->opcode) {
+                case OP_BRANCH:
+                    block->kind = END_BRANCH;
+                    block->succ[block->succ_count++] = ext;
+                    block->succ[block->succ_count++] = (int)pc;
+                    break;
+                case OP_JUMP:
+                    block->kind = END_JUMP;
+                    block->succ[block->succ_count++] = ext;
+                    break;
+                case OP_CALL:
+                    block->kind = END_CALL;
+                    block->callee = an->func_at[ext];
+                    block->succ[block->succ_count++] = (int)pc;
+                    break;
+                case OP_RET:  block->kind = END_RET; break;
+                case OP_HALT: block->kind = END_HALT; break;
+                default:
+                    ends = an->leader[pc];
+                    if (ends) {
+                        block->kind = END_FALL;
+                        block->succ[block->succ_count++] = (int)pc;
+                    }
+                    break;
+            }
+            if (ends) break;
+        }
+        block->end = pc;
+        block->delta = depth;
+    }
+
+    // Successor addresses to block ids (every target is a leader)
+    for (int i = 0; i < an->block_count; i++) {
+        for (int s = 0; s < an->blocks[i].succ_count; s++) {
+            an->blocks[i].succ[s] = an->block_at[an->blocks[i].succ[s]];
+        }
+    }
+}
+
+static void an_report_fault(Analyzer* an, Block* block) {
+    if (block->reported) return;
+    block->reported = true;
+    an->ok = false;
+    if (block->start < an->size && an->code[block->start] == CODE_EXT) {
+        fprintf(stderr, "Error: Jump into the middle of an instruction at 0x%04X\n", block->start);
+    } else if (block->start < an->size && !isa_decode(an->image[block->start])) {
+        fprintf(stderr, "Error: Invalid instruction 0x%04X at 0x%04X\n",
+                an->image[block->start], block->start);
+    } else {
+        fprintf(stderr, "Error: Execution runs past the end of the image at 0x%04X\n", block->start);
+    }
+}
+
+// Collecting the blocks a function reaches without entering callees
+static void an_collect(Analyzer* an, int index, int* seen, int* callee_seen) {
+    Function* func = &an->funcs[index];
+    func->blocks = (int*)malloc(an->block_count * sizeof(int));
+    func->callees = (int*)malloc(an->func_count * sizeof(int));
+    int entry = an->block_at[func->entry];
+    func->blocks[func->block_count++] = entry;
+    seen[entry] = index;
+
+    for (int i = 0; i < func->block_count; i++) {
+        Block* block = &an->blocks[func->blocks[i]];
+        if (block->kind == END_FAULT) an_report_fault(an, block);
+        if (block->kind == END_CALL && callee_seen[block->callee] != index) {
+            callee_seen[block->callee] = index;
+            func->callees[func->callee_count++] = block->callee;
+        }
+        for (int s = 0; s < block->succ_count; s++) {
+            if (seen[block->succ[s]] != index) {
+                seen[block->succ[s]] = index;
+                func->blocks[func->block_count++] = block->succ[s];
+            }
+        }
+    }
+}
+
+// ============================================================
+// Call graph
+// ============================================================
+
+// Registers saved by a prologue of PUSHes (or PUSHMs) and restored by
+// POPs (or POPMs) right before every RET
+static uint8_t an_preserved(const Analyzer* an, const Function* func) {
+    const Block* entry = &an->blocks[func->blocks[0]];
+    uint8_t preserved = 0;
+    for (uint32_t pc = entry->start; pc < entry->end; pc += isa_length(an->image[pc])) {
+        const InsnInfo* insn = isa_decode(an->image[pc]);
+        if (insn->opcode != OP_STACK || (insn->sub != STACK_PUSH && insn->sub != STACK_PUSHM)) break;
+        if (insn->sub == STACK_PUSHM) preserved |= (uint8_t)(an_ext(an, pc) & STACK_MASK_REGS);
+        else preserved |= (uint8_t)(1 << ((an->image[pc] >> 6) & 0x7));
+    }
+    for (int i = 0; i < func->block_count; i++) {
+        const Block* block = &an->blocks[func->blocks[i]];
+        if (block->kind != END_RET) continue;
+        uint8_t popped = 0;
+        for (uint32_t pc = block->start; pc < block->end; pc += isa_length(an->image[pc])) {
+            const InsnInfo* insn = isa_decode(an->image[pc]);
+            if (insn->opcode == OP_STACK && insn->sub == STACK_POP) {
+                popped |= (uint8_t)(1 << ((an->image[pc] >> 9) & 0x7));
+            } else if (insn->opcode == OP_STACK && insn->sub == STACK_POPM) {
+                popped |= (uint8_t)(an_ext(an, pc) & STACK_MASK_REGS);
+            } else if (insn->opcode != OP_RET) {
+                popped = 0;
+            }
+        }
+        preserved &= popped;
+    }
+    return preserved;
+}
+
+// Registers each call may change, to a fixed point over the call graph
+static void an_compute_clobbers(Analyzer* an) {
+    uint8_t* writes = (uint8_t*)calloc(an->func_count, 1);
+    uint8_t* preserved = (uint8_t*)calloc(an->func_count, 1);
+    for (int f = 0; f < an->func_count; f++) {
+        Function* func = &an->funcs[f];
+        for (int i = 0; i < func->block_count; i++) writes[f] |= an->blocks[func->blocks[i]].writes;
+        preserved[f] = an_preserved(an, func) | (1 << REG_SP);
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int f = 0; f < an->func_count; f++) {
+            Function* func = &an->funcs[f];
+            uint8_t clobbers = writes[f];
+            for (int c = 0; c < func->callee_count; c++) clobbers |= an->funcs[func->callees[c]].clobbers;
+            clobbers &= (uint8_t)~preserved[f];
+            if (clobbers != func->clobbers) {
+                func->clobbers = clobbers;
+                changed = true;
+            }
+        }
+    }
+    free(writes);
+    free(preserved);
+}
+
+// Tarjan's algorithm: components come out callees first
+static void an_tarjan(Analyzer* an, int index) {
+    Function* func = &an->funcs[index];
+    func->index = func->lowlink = an->tarjan_index++;
+    an->tarjan[an->tarjan_top++] = index;
+    func->on_stack = true;
+
+    for (int c = 0; c < func->callee_count; c++) {
+        Function* callee = &an->funcs[func->callees[c]];
+        if (callee->index < 0) {
+            an_tarjan(an, func->callees[c]);
+            if (callee->lowlink < func->lowlink) func->lowlink = callee->lowlink;
+        } else if (callee->on_stack && callee->index < func->lowlink) {
+            func->lowlink = callee->index;
+        }
+    }
+
+    if (func->lowlink == func->index) {
+        int member;
+        do {
+            member = an->tarjan[--an->tarjan_top];
+            an->funcs[member].on_stack = false;
+            an->funcs[member].scc = an->scc_count;
+            an->order[an->order_count++] = member;
+        } while (member != index);
+        an->scc_count++;
+    }
+}
+
+// ============================================================
+// Per-function graph: dominators and natural loops
+// ============================================================
+
+static int an_succ(const FuncGraph* g, int x, int s) {
+    return g->an->local[g->an->blocks[g->func->blocks[x]].succ[s]];
+}
+
+static const Block* an_block(const FuncGraph* g, int x) {
+    return &g->an->blocks[g->func->blocks[x]];
+}
+
+static bool an_dominates(const FuncGraph* g, int a, int b) {
+    while (b != a && b != 0) b = g->idom[b];
+    return b == a;
+}
+
+static int an_intersect(const FuncGraph* g, int a, int b) {
+    while (a != b) {
+        while (g->rpo_index[a] > g->rpo_index[b]) a = g->idom[a];
+        while (g->rpo_index[b] > g->rpo_index[a]) b = g->idom[b];
+    }
+    return a;
+}
+
+// Ordering blocks, computing dominators (Cooper, Harvey and Kennedy)
+// and noting edges that close cycles
+static void an_graph_order(FuncGraph* g) {
+    int n = g->n;
+    int* stack = (int*)malloc(n * sizeof(int));
+    int* next = (int*)calloc(n, sizeof(int));
+    uint8_t* state = (uint8_t*)calloc(n, 1);     // 0 new, 1 on stack, 2 done
+    int top = 0, post = n;
+
+    stack[top++] = 0;
+    state[0] = 1;
+    while (top > 0) {
+        int x = stack[top - 1];
+        if (next[x] < an_block(g, x)->succ_count) {
+            int y = an_succ(g, x, next[x]++);
+            if (state[y] == 0) {
+                state[y] = 1;
+                stack[top++] = y;
+            } else if (state[y] == 1) {
+                g->retreat_from[g->retreat_count] = x;
+                g->retreat_to[g->retreat_count++] = y;
+            }
+        } else {
+            state[x] = 2;
+            g->rpo[--post] = x;
+            top--;
+        }
+    }
+    for (int i = 0; i < n; i++) g->rpo_index[g->rpo[i]] = i;
+
+    for (int i = 0; i < n; i++) g->idom[i] = -1;
+    g->idom[0] = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 1; i < n; i++) {
+            int x = g->rpo[i];
+            int dom = -1;
+            for (int p = g->pred_first[x]; p < g->pred_first[x + 1]; p++) {
+                int pred = g->preds[p];
+                if (g->idom[pred] < 0) continue;
+                dom = dom < 0 ? pred : an_intersect(g, pred, dom);
+            }
+            if (dom != g->idom[x]) {
+                g->idom[x] = dom;
+                changed = true;
+            }
+        }
+    }
+    free(stack);
+    free(next);
+    free(state);
+}
+
+static int an_loop_by_size(const void* a, const void* b) {
+    return ((const Loop*)a)->size - ((const Loop*)b)->size;
+}
+
+// Finding natural loops: one per header, covering all its back edges
+static void an_graph_loops(FuncGraph* g) {
+    int n = g->n;
+    int* work = (int*)malloc(n * sizeof(int));
+    g->loops = (Loop*)calloc(g->retreat_count ? g->retreat_count : 1, sizeof(Loop));
+
+    for (int e = 0; e < g->retreat_count; e++) {
+        int latch = g->retreat_from[e], header = g->retreat_to[e];
+        if (!an_dominates(g, header, latch)) {
+            g->irreducible = true;
+            continue;
+        }
+        Loop* loop = NULL;
+        for (int i = 0; i < g->loop_count; i++) {
+            if (g->loops[i].header == header) loop = &g->loops[i];
+        }
+        if (!loop) {
+            loop = &g->loops[g->loop_count++];
+            loop->header = header;
+            loop->body = (uint8_t*)calloc(n, 1);
+            loop->latches = (int*)malloc(n * sizeof(int));
+            loop->body[header] = 1;
+            loop->size = 1;
+        }
+        loop->latches[loop->latch_count++] = latch;
+
+        // Everything that reaches the latch without passing the header
+        int top = 0;
+        if (!loop->body[latch]) {
+            loop->body[latch] = 1;
+            loop->size++;
+            work[top++] = latch;
+        }
+        while (top > 0) {
+            int x = work[--top];
+            for (int p = g->pred_first[x]; p < g->pred_first[x + 1]; p++) {
+                int pred = g->preds[p];
+                if (!loop->body[pred]) {
+                    loop->body[pred] = 1;
+                    loop->size++;
+                    work[top++] = pred;
+                }
+            }
+        }
+    }
+    free(work);
+
+    qsort(g->loops, g->loop_count, sizeof(Loop), an_loop_by_size);
+    for (int x = 0; x < n; x++) g->innermost[x] = -1;
+    for (int i = 0; i < g->loop_count; i++) {
+        Loop* loop = &g->loops[i];
+        loop->parent = -1;
+        for (int j = i + 1; j < g->loop_count && loop->parent < 0; j++) {
+            if (g->loops[j].body[loop->header]) loop->parent = j;
+        }
+        for (int x = 0; x < n; x++) {
+            if (!loop->body[x]) continue;
+            if (g->innermost[x] < 0) g->innermost[x] = i;
+            int kind = an_block(g, x)->kind;
+            if (kind == END_RET || kind == END_HALT || kind == END_FAULT) loop->terminates = true;
+        }
+    }
+}
+
+static void an_graph_init(FuncGraph* g, Analyzer* an, Function* func) {
+    memset(g, 0, sizeof(FuncGraph));
+    g->an = an;
+    g->func = func;
+    int n = g->n = func->block_count;
+    for (int x = 0; x < n; x++) an->local[func->blocks[x]] = x;
+
+    g->pred_first = (int*)calloc(n + 1, sizeof(int));
+    g->preds = (int*)malloc((2 * n + 1) * sizeof(int));
+    for (int x = 0; x < n; x++) {
+        for (int s = 0; s < an_block(g, x)->succ_count; s++) g->pred_first[an_succ(g, x, s) + 1]++;
+    }
+    for (int x = 0; x < n; x++) g->pred_first[x + 1] += g->pred_first[x];
+    int* fill = (int*)malloc(n * sizeof(int));
+    memcpy(fill, g->pred_first, n * sizeof(int));
+    for (int x = 0; x < n; x++) {
+        for (int s = 0; s < an_block(g, x)->succ_count; s++) g->preds[fill[an_succ(g, x, s)]++] = x;
+    }
+    free(fill);
+
+    g->rpo = (int*)malloc(n * sizeof(int));
+    g->rpo_index = (int*)malloc(n * sizeof(int));
+    g->idom = (int*)malloc(n * sizeof(int));
+    g->retreat_from = (int*)malloc(2 * n * sizeof(int));
+    g->retreat_to = (int*)malloc(2 * n * sizeof(int));
+    g->innermost = (int*)malloc(n * sizeof(int));
+    g->cost = (Cost*)calloc(n, sizeof(Cost));
+    g->dist = (Cost*)calloc(n, sizeof(Cost));
+    g->reached = (uint8_t*)calloc(n, 1);
+    an_graph_order(g);
+    an_graph_loops(g);
+}
+
+static void an_graph_free(FuncGraph* g) {
+    for (int i = 0; i < g->loop_count; i++) {
+        free(g->loops[i].body);
+        free(g->loops[i].latches);
+    }
+    free(g->loops);
+    free(g->pred_first);
+    free(g->preds);
+    free(g->rpo);
+    free(g->rpo_index);
+    free(g->idom);
+    free(g->retreat_from);
+    free(g->retreat_to);
+    free(g->innermost);
+    free(g->cost);
+    free(g->dist);
+    free(g->reached);
+}
+
+// ============================================================
+// Reporting
+// ============================================================
+
+static void an_note(Analyzer* an, const Function* func, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    fprintf(an->out, "  %s: ", func->name);
+    vfprintf(an->out, format, args);
+    fputc('\n', an->out);
+    va_end(args);
+}
+
+// Formatting a loop header as "0x0012 (label)" and an annotation key
+static void an_loop_name(const FuncGraph* g, const Loop* loop, char* name, size_t size, char* key, size_t key_size) {
+    uint32_t address = an_block(g, loop->header)->start;
+    const char* label = an_label(g->an, address);
+    if (label) {
+        snprintf(name, size, "0x%04X (%s)", address, label);
+        snprintf(key, key_size, "%s", label);
+    } else {
+        snprintf(name, size, "0x%04X", address);
+        snprintf(key, key_size, "0x%04X", address);
+    }
+}
+
+// ============================================================
+// Stack depth
+// ============================================================
+
+// Deepest stack of one function, calls into its own component excluded
+static void an_function_stack(FuncGraph* g) {
+    Analyzer* an = g->an;
+    Function* func = g->func;
+    int* depth = (int*)malloc(g->n * sizeof(int));
+    int* work = (int*)malloc(g->n * sizeof(int));
+    for (int x = 0; x < g->n; x++) depth[x] = AN_NO_DEPTH;
+    int top = 0;
+    depth[0] = 0;
+    work[top++] = 0;
+
+    bool ok = true;
+    uint64_t peak = 0, call_depth = 0;
+    while (top > 0) {
+        int x = work[--top];
+        const Block* block = an_block(g, x);
+        int in = depth[x], out = in + block->delta;
+        if (block->kind == END_FAULT) ok = false;
+        if (block->sp_lost) {
+            an_note(an, func, "SP written in the block at 0x%04X; stack depth unknown", block->start);
+            ok = false;
+            continue;
+        }
+        if (in + block->low < 0) {
+            fprintf(stderr, "Error: %s pops more than it pushed in the block at 0x%04X\n",
+                    func->name, block->start);
+            an->ok = ok = false;
+            continue;
+        }
+        if ((uint64_t)(in + block->peak) > peak) peak = in + block->peak;
+
+        if (block->kind == END_CALL) {
+            const Function* callee = &an->funcs[block->callee];
+            uint64_t site = (uint64_t)out + 1;      // Return address
+            if (callee->scc == func->scc) {
+                if (site > call_depth) call_depth = site;
+            } else if (!callee->stack_ok) {
+                ok = false;
+            } else if (site + callee->stack > peak) {
+                peak = site + callee->stack;
+            }
+        } else if (block->kind == END_RET && out != 0) {
+            fprintf(stderr, "Error: %s returns with %d word(s) still pushed (block at 0x%04X)\n",
+                    func->name, out, block->start);
+            an->ok = ok = false;
+        }
+
+        for (int s = 0; s < block->succ_count; s++) {
+            int y = an_succ(g, x, s);
+            if (depth[y] == AN_NO_DEPTH) {
+                depth[y] = out;
+                work[top++] = y;
+            } else if (depth[y] != out) {
+                fprintf(stderr, "Error: Stack depth in %s differs at 0x%04X (%d vs %d words)\n",
+                        func->name, an_block(g, y)->start, depth[y], out);
+                an->ok = ok = false;
+            }
+        }
+    }
+    free(depth);
+    free(work);
+    func->own_stack_ok = ok;
+    func->own_stack = peak;
+    func->call_depth = call_depth;
+}
+
+// ============================================================
+// Counted loops
+// ============================================================
+
+static bool an_dominates_latches(const FuncGraph* g, const Loop* loop, int x) {
+    for (int i = 0; i < loop->latch_count; i++) {
+        if (!an_dominates(g, x, loop->latches[i])) return false;
+    }
+    return true;
+}
+
+// Last instruction in a block before address that writes reg (AN_NONE if none)
+static uint32_t an_last_write(const Analyzer* an, const Block* block, uint32_t before, int reg) {
+    uint32_t last = AN_NONE;
+    for (uint32_t pc = block->start; pc < before; pc += isa_length(an->image[pc])) {
+        if (an_dests(isa_decode(an->image[pc]), an->image[pc], an_ext(an, pc)) & (1 << reg)) last = pc;
+    }
+    return last;
+}
+
+// Checking that nothing in the loop (calls included) changes reg
+static bool an_loop_invariant(const FuncGraph* g, const Loop* loop, int reg) {
+    for (int x = 0; x < g->n; x++) {
+        if (!loop->body[x]) continue;
+        const Block* block = an_block(g, x);
+        if (block->writes & (1 << reg)) return false;
+        if (block->kind == END_CALL && (g->an->funcs[block->callee].clobbers & (1 << reg))) return false;
+    }
+    return true;
+}
+
+// Constant value of reg just before address in block x, following LDI
+// and MOV back through blocks with a single predecessor
+static bool an_value_before(const FuncGraph* g, int x, uint32_t before, int reg, uint16_t* value) {
+    const Analyzer* an = g->an;
+    for (int step = 0; step < AN_VALUE_SEARCH; step++) {
+        const Block* block = an_block(g, x);
+        uint32_t pc;
+        while ((pc = an_last_write(an, block, before, reg)) != AN_NONE) {
+            const InsnInfo* insn = isa_decode(an->image[pc]);
+            if (insn->opcode == OP_LOAD && insn->sub == LOAD_IMM) {
+                *value = an_ext(an, pc);
+                return true;
+            }
+            if (insn->opcode != OP_MOVE) return false;
+            reg = (an->image[pc] >> 6) & 0x7;
+            before = pc;
+        }
+        if (x == 0 || g->pred_first[x + 1] - g->pred_first[x] != 1) return false;
+        x = g->preds[g->pred_first[x]];
+        block = an_block(g, x);
+        if (block->kind == END_CALL && (an->funcs[block->callee].clobbers & (1 << reg))) return false;
+        before = block->end;
+    }
+    return false;
+}
+
+// Constant value of reg on entry to the loop (from its only outside predecessor)
+static bool an_entry_value(const FuncGraph* g, const Loop* loop, int reg, uint16_t* value) {
+    int outside = -1;
+    for (int p = g->pred_first[loop->header]; p < g->pred_first[loop->header + 1]; p++) {
+        int pred = g->preds[p];
+        if (loop->body[pred]) continue;
+        if (outside >= 0 && outside != pred) return false;
+        outside = pred;
+    }
+    if (outside < 0) return false;
+    const Block* block = an_block(g, outside);
+    if (block->kind == END_CALL && (g->an->funcs[block->callee].clobbers & (1 << reg))) return false;
+    return an_value_before(g, outside, block->end, reg, value);
+}
+
+static bool an_condition(uint8_t sub, bool z, bool n, bool c) {
+    switch (sub) {
+        case BRANCH_EQ: return z;
+        case BRANCH_NE: return !z;
+        case BRANCH_GT: return !n && !z;
+        case BRANCH_LT: return n;
+        case BRANCH_GE: return !n;
+        case BRANCH_LE: return n || z;
+        case BRANCH_CS: return c;
+        default:        return !c;
+    }
+}
+
+// Header executions of a loop whose exit test in block x compares a
+// register stepped once per iteration with a constant (0 if not such a
+// loop or it does not finish within ANALYZER_LOOP_LIMIT)
+static uint32_t an_counted_exit(const FuncGraph* g, const Loop* loop, int x) {
+    const Analyzer* an = g->an;
+    const Block* block = an_block(g, x);
+    bool taken_stays = loop->body[an_succ(g, x, 0)];
+
+    // The branch and the last flag setter before it
+    uint32_t branch = AN_NONE, setter = AN_NONE;
+    for (uint32_t pc = block->start; pc < block->end; pc += isa_length(an->image[pc])) {
+        const InsnInfo* insn = isa_decode(an->image[pc]);
+        if (insn->opcode == OP_BRANCH) branch = pc;
+        else if (an_sets_flags(insn)) setter = pc;
+    }
+    if (setter == AN_NONE) return 0;
+    uint8_t condition = isa_decode(an->image[branch])->sub;
+    const InsnInfo* test = isa_decode(an->image[setter]);
+    int rd = (an->image[setter] >> 9) & 0x7, rs = (an->image[setter] >> 6) & 0x7;
+    bool compare = test->opcode == OP_CMP;
+    if (!compare && !(test->opcode == OP_ARITH &&
+                      (test->sub == ARITH_INC || test->sub == ARITH_DEC ||
+                       test->sub == ARITH_ADDI || test->sub == ARITH_SUBI))) {
+        return 0;
+    }
+
+    int candidates[2] = { rd, rs };
+    for (int c = 0; c < (compare ? 2 : 1); c++) {
+        int reg = candidates[c];
+        if (reg == REG_SP || (compare && rd == rs)) continue;
+
+        // Exactly one update of the register in the loop, once per iteration
+        uint32_t update = AN_NONE;
+        int update_block = -1, writes = 0;
+        for (int y = 0; y < g->n; y++) {
+            if (!loop->body[y]) continue;
+            const Block* other = an_block(g, y);
+            if (other->kind == END_CALL && (an->funcs[other->callee].clobbers & (1 << reg))) writes += 2;
+            if (!(other->writes & (1 << reg))) continue;
+            for (uint32_t pc = other->start; pc < other->end; pc += isa_length(an->image[pc])) {
+                if (an_dests(isa_decode(an->image[pc]), an->image[pc], an_ext(an, pc)) & (1 << reg)) {
+                    update = pc;
+                    update_block = y;
+                    writes++;
+                }
+            }
+        }
+        if (writes != 1) continue;
+        const InsnInfo* step = isa_decode(an->image[update]);
+        if (step->opcode != OP_ARITH || (step->sub != ARITH_INC && step->sub != ARITH_DEC &&
+                                         step->sub != ARITH_ADDI && step->sub != ARITH_SUBI)) continue;
+        if (g->innermost[update_block] != g->innermost[x]) continue;
+        if (!an_dominates_latches(g, loop, update_block)) continue;
+        if (!compare && update != setter) continue;
+        if (!compare && (step->sub == ARITH_INC || step->sub == ARITH_DEC) &&
+            (condition == BRANCH_CS || condition == BRANCH_CC)) continue;
+        uint16_t amount = step->sub == ARITH_INC || step->sub == ARITH_DEC ? 1 : an_ext(an, update);
+        bool subtract = step->sub == ARITH_DEC || step->sub == ARITH_SUBI;
+
+        // Whether the update comes before the test within an iteration
+        bool update_first;
+        if (update_block == x) update_first = true;
+        else if (an_dominates(g, update_block, x)) update_first = true;
+        else if (an_dominates(g, x, update_block)) update_first = false;
+        else continue;
+
+        uint16_t limit = 0, value;
+        if (compare) {
+            int other = reg == rd ? rs : rd;
+            uint32_t write = an_last_write(an, block, setter, other);
+            if (write != AN_NONE) {
+                if (!an_value_before(g, x, setter, other, &limit)) continue;
+            } else if (!an_loop_invariant(g, loop, other) || !an_entry_value(g, loop, other, &limit)) {
+                continue;
+            }
+        }
+        if (!an_entry_value(g, loop, reg, &value)) continue;
+
+        // Running the test on 16-bit values with the CPU's flag rules
+        for (uint32_t count = 1; count <= ANALYZER_LOOP_LIMIT; count++) {
+            uint16_t before = value;
+            if (update_first) value = subtract ? (uint16_t)(value - amount) : (uint16_t)(value + amount);
+            uint16_t a, b, result;
+            bool carry;
+            if (compare) {
+                a = reg == rd ? value : limit;
+                b = reg == rd ? limit : value;
+                result = (uint16_t)(a - b);
+                carry = a < b;
+            } else {
+                result = value;
+                carry = subtract ? before < amount : (uint32_t)before + amount > 0xFFFF;
+            }
+            bool taken = an_condition(condition, result == 0, (result & 0x8000) != 0, carry);
+            if (taken != taken_stays) return count;
+            if (!update_first) value = subtract ? (uint16_t)(value - amount) : (uint16_t)(value + amount);
+        }
+    }
+    return 0;
+}
+
+// Tightest automatic bound over the loop's exit tests (0 if none)
+static uint32_t an_counted_loop(const FuncGraph* g, int index) {
+    const Loop* loop = &g->loops[index];
+    uint32_t best = 0;
+    for (int x = 0; x < g->n; x++) {
+        if (!loop->body[x] || g->innermost[x] != index || an_block(g, x)->kind != END_BRANCH) continue;
+        if (loop->body[an_succ(g, x, 0)] == loop->body[an_succ(g, x, 1)]) continue;
+        if (!an_dominates_latches(g, loop, x)) continue;
+        uint32_t count = an_counted_exit(g, loop, x);
+        if (count && (!best || count < best)) best = count;
+    }
+    return best;
+}
+
+// Annotated bound for a loop: the innermost loop holding the address
+static uint32_t an_annotated_loop(const FuncGraph* g, int index) {
+    const AnalyzerOptions* options = g->an->options;
+    for (int i = 0; i < options->loop_count; i++) {
+        uint32_t address = options->loops[i].address;
+        for (int x = 0; x < g->n; x++) {
+            const Block* block = an_block(g, x);
+            if (address >= block->start && address < block->end && g->innermost[x] == index) {
+                return options->loops[i].count;
+            }
+        }
+    }
+    return 0;
+}
+
+// ============================================================
+// Worst-case time
+// ============================================================
+
+// Loop directly inside region (-1 = whole function) holding block x, or -1
+static int an_child_loop(const FuncGraph* g, int x, int region) {
+    int loop = g->innermost[x];
+    if (loop == region) return -1;
+    while (g->loops[loop].parent != region) loop = g->loops[loop].parent;
+    return loop;
+}
+
+static bool an_in_region(const FuncGraph* g, int x, int region) {
+    return region < 0 || g->loops[region].body[x];
+}
+
+// Relaxing an edge from node `from` to block y
+static void an_relax(FuncGraph* g, int region, int from, int y, Cost* iter, Cost* exit) {
+    if (region >= 0 && y == g->loops[region].header) {
+        *iter = an_cost_max(*iter, g->dist[from]);
+        return;
+    }
+    if (!an_in_region(g, y, region)) {
+        *exit = an_cost_max(*exit, g->dist[from]);
+        return;
+    }
+    int child = an_child_loop(g, y, region);
+    int node = child < 0 ? y : g->loops[child].header;
+    Cost cost = an_cost_add(g->dist[from], child < 0 ? g->cost[node] : g->loops[child].total);
+    g->dist[node] = g->reached[node] ? an_cost_max(g->dist[node], cost) : cost;
+    g->reached[node] = 1;
+}
+
+// Longest paths through a loop body (or the whole function when region
+// is -1) with inner loops collapsed to their worst case: iter from the
+// header around to a back edge, exit from the header out of the region
+static bool an_region(FuncGraph* g, int region, Cost* iter, Cost* exit) {
+    Cost zero = { 0, 0, 0 };
+    *iter = *exit = zero;
+    bool exits = false;
+    memset(g->reached, 0, g->n);
+    int entry = region < 0 ? 0 : g->loops[region].header;
+    g->dist[entry] = g->cost[entry];
+    g->reached[entry] = 1;
+
+    for (int i = 0; i < g->n; i++) {
+        int x = g->rpo[i];
+        if (!g->reached[x]) continue;
+        int child = an_child_loop(g, x, region);
+        if (child < 0) {
+            const Block* block = an_block(g, x);
+            for (int s = 0; s < block->succ_count; s++) {
+                int y = an_succ(g, x, s);
+                if (!an_in_region(g, y, region)) exits = true;
+                an_relax(g, region, x, y, iter, exit);
+            }
+            if (block->kind == END_RET || block->kind == END_HALT || block->kind == END_FAULT) {
+                *exit = an_cost_max(*exit, g->dist[x]);
+                exits = true;
+            }
+        } else {
+            const Loop* inner = &g->loops[child];
+            for (int z = 0; z < g->n; z++) {
+                if (!inner->body[z]) continue;
+                for (int s = 0; s < an_block(g, z)->succ_count; s++) {
+                    int y = an_succ(g, z, s);
+                    if (inner->body[y]) continue;
+                    if (!an_in_region(g, y, region)) exits = true;
+                    an_relax(g, region, x, y, iter, exit);
+                }
+            }
+            if (inner->terminates) {
+                *exit = an_cost_max(*exit, g->dist[x]);
+                exits = true;
+            }
+        }
+    }
+    return exits;
+}
+
+// Worst-case instructions and cycles of one function, calls into its
+// own component counted in .calls instead
+static void an_function_time(FuncGraph* g) {
+    Analyzer* an = g->an;
+    Function* func = g->func;
+    bool ok = true;
+    if (g->irreducible) {
+        an_note(an, func, "irreducible control flow; no cycle bound");
+        func->own_time_ok = false;
+        return;
+    }
+
+    for (int x = 0; x < g->n; x++) {
+        const Block* block = an_block(g, x);
+        g->cost[x] = block->cost;
+        if (block->kind == END_FAULT) ok = false;
+        if (block->kind != END_CALL) continue;
+        const Function* callee = &an->funcs[block->callee];
+        if (callee->scc == func->scc) g->cost[x].calls++;
+        else if (!callee->time_ok) ok = false;
+        else g->cost[x] = an_cost_add(g->cost[x], callee->time);
+    }
+
+    for (int i = 0; i < g->loop_count; i++) {
+        Loop* loop = &g->loops[i];
+        char name[64], key[48];
+        an_loop_name(g, loop, name, sizeof(name), key, sizeof(key));
+        const char* how = "annotated";
+        loop->bound = an_annotated_loop(g, i);
+        if (!loop->bound) {
+            loop->bound = an_counted_loop(g, i);
+            how = "counted";
+        }
+        if (!loop->bound) {
+            an_note(an, func, "loop at %s has no bound; annotate it with --bound %s=N", name, key);
+            ok = false;
+            continue;
+        }
+
+        Cost iter, exit;
+        if (!an_region(g, i, &iter, &exit)) {
+            an_note(an, func, "loop at %s never exits", name);
+            ok = false;
+            continue;
+        }
+        loop->total = an_cost_add(an_cost_scale(iter, loop->bound - 1), exit);
+        an_note(an, func, "loop at %s runs its header at most %u time(s) per entry (%s)",
+                name, loop->bound, how);
+    }
+
+    Cost iter, exit;
+    an_region(g, -1, &iter, &exit);
+    func->own_time_ok = ok;
+    func->own_time = exit;
+}
+
+// ============================================================
+// Components (recursion)
+// ============================================================
+
+// Activations in a call tree of the given depth with up to calls children each
+static uint64_t an_activations(uint64_t calls, uint32_t depth) {
+    if (calls <= 1) return depth;
+    uint64_t total = 0, level = 1;
+    for (uint32_t i = 0; i < depth; i++) {
+        total = an_add(total, level);
+        level = an_mul(level, calls);
+    }
+    return total;
+}
+
+static void an_component(Analyzer* an, const int* members, int count) {
+    for (int m = 0; m < count; m++) {
+        FuncGraph g;
+        an_graph_init(&g, an, &an->funcs[members[m]]);
+        an_function_stack(&g);
+        an_function_time(&g);
+        an_graph_free(&g);
+    }
+
+    Function* first = &an->funcs[members[0]];
+    bool recursive = count > 1;
+    for (int c = 0; c < first->callee_count; c++) {
+        if (first->callees[c] == members[0]) recursive = true;
+    }
+    if (!recursive) {
+        first->stack_ok = first->own_stack_ok;
+        first->stack = first->own_stack;
+        first->time_ok = first->own_time_ok;
+        first->time = first->own_time;
+        return;
+    }
+
+    // Naming the cycle and finding its annotation
+    char cycle[256] = "";
+    uint32_t depth = 0;
+    for (int m = 0; m < count; m++) {
+        const Function* func = &an->funcs[members[m]];
+        size_t used = strlen(cycle);
+        snprintf(cycle + used, sizeof(cycle) - used, "%s%s", m ? ", " : "", func->name);
+        for (int r = 0; r < an->options->recursion_count; r++) {
+            if (an->options->recursion[r].entry == func->entry) depth = an->options->recursion[r].depth;
+        }
+    }
+
+    bool stack_ok = depth > 0, time_ok = depth > 0;
+    uint64_t own_stack = 0, call_depth = 0;
+    Cost own_time = { 0, 0, 0 };
+    for (int m = 0; m < count; m++) {
+        const Function* func = &an->funcs[members[m]];
+        stack_ok = stack_ok && func->own_stack_ok;
+        time_ok = time_ok && func->own_time_ok;
+        if (func->own_stack > own_stack) own_stack = func->own_stack;
+        if (func->call_depth > call_depth) call_depth = func->call_depth;
+        own_time = an_cost_max(own_time, func->own_time);
+    }
+
+    if (!depth) {
+        an_note(an, first, "recursive (cycle: %s); bound its depth with --recursion %s=N", cycle, first->name);
+    } else {
+        uint64_t activations = an_activations(own_time.calls, depth);
+        an_note(an, first, "recursive (cycle: %s), at most %u nested and %llu total activation(s) (annotated)",
+                cycle, depth, (unsigned long long)activations);
+        own_stack = an_add(an_mul(call_depth, depth - 1), own_stack);
+        own_time = an_cost_scale(own_time, activations);
+    }
+    own_time.calls = 0;
+    for (int m = 0; m < count; m++) {
+        Function* func = &an->funcs[members[m]];
+        func->stack_ok = stack_ok;
+        func->stack = own_stack;
+        func->time_ok = time_ok;
+        func->time = own_time;
+    }
+}
+
+// ============================================================
+// Driver
+// ============================================================
+
+static int an_by_entry(const void* a, const void* b) {
+    return (int)(*(const Function* const*)a)->entry - (int)(*(const Function* const*)b)->entry;
+}
+
+static void an_print_bound(FILE* out, bool ok, uint64_t value, int width) {
+    if (!ok) fprintf(out, " %*s", width, "-");
+    else if (value == UINT64_MAX) fprintf(out, " %*s", width, "overflow");
+    else fprintf(out, " %*llu", width, (unsigned long long)value);
+}
+
+static void an_report(Analyzer* an) {
+    FILE* out = an->out;
+    Function** sorted = (Function**)malloc(an->func_count * sizeof(Function*));
+    int width = 8;
+    for (int f = 0; f < an->func_count; f++) {
+        sorted[f] = &an->funcs[f];
+        int length = (int)strlen(an->funcs[f].name);
+        if (length > width) width = length;
+    }
+    qsort(sorted, an->func_count, sizeof(Function*), an_by_entry);
+
+    fprintf(out, "\n%-*s  Entry   Stack  Instructions        Cycles\n", width, "Function");
+    for (int f = 0; f < an->func_count; f++) {
+        const Function* func = sorted[f];
+        fprintf(out, "%-*s  0x%04X", width, func->name, func->entry);
+        an_print_bound(out, func->stack_ok, func->stack, 7);
+        an_print_bound(out, func->time_ok, func->time.insns, 13);
+        an_print_bound(out, func->time_ok, func->time.cycles, 13);
+        fputc('\n', out);
+    }
+    free(sorted);
+
+    // Whole program: everything runs below the entry's stack pointer
+    const Function* entry = &an->funcs[0];
+    fprintf(out, "\n");
+    if (!entry->stack_ok) {
+        fprintf(out, "Stack: no bound\n");
+    } else if (entry->stack > STACK_START) {
+        fprintf(out, "Stack: at most %llu words; wraps below address 0\n", (unsigned long long)entry->stack);
+    } else {
+        uint32_t low = STACK_START - (uint32_t)entry->stack;
+        fprintf(out, "Stack: at most %llu words, down to 0x%04X\n", (unsigned long long)entry->stack, low);
+        if (low < an->size) {
+            fprintf(out, "Warning: the stack can reach the loaded image (which ends at 0x%04X)\n", an->size);
+        }
+    }
+    if (entry->time_ok) {
+        fprintf(out, "Time: at most %llu instructions, %llu cycles\n",
+                (unsigned long long)entry->time.insns, (unsigned long long)entry->time.cycles);
+        if (an->options->cycle_budget && entry->time.cycles > an->options->cycle_budget) {
+            fprintf(out, "Warning: worst case exceeds the cycle budget of %llu\n",
+                    (unsigned long long)an->options->cycle_budget);
+        }
+    } else {
+        fprintf(out, "Time: no bound\n");
+    }
+    if (!entry->stack_ok || !entry->time_ok) an->ok = false;
+}
+
+bool analyze_image(const uint16_t* image, uint32_t size, const AnalyzerOptions* options, FILE* out) {
+    Analyzer an;
+    memset(&an, 0, sizeof(an));
+    an.image = image;
+    an.size = size > 0x10000 ? 0x10000 : size;
+    an.options = options;
+    an.out = out;
+    an.ok = true;
+    an.code = (uint8_t*)calloc(AN_ADDRESSES, 1);
+    an.leader = (uint8_t*)calloc(AN_ADDRESSES, 1);
+    an.block_at = (int*)malloc(AN_ADDRESSES * sizeof(int));
+    an.func_at = (int*)malloc(AN_ADDRESSES * sizeof(int));
+    for (uint32_t i = 0; i < AN_ADDRESSES; i++) an.block_at[i] = an.func_at[i] = -1;
+
+    // Recovering blocks, functions and the call graph
+    an_discover(&an);
+    an_build_blocks(&an);
+    int* seen = (int*)malloc(an.block_count * sizeof(int));
+    int* callee_seen = (int*)malloc(an.func_count * sizeof(int));
+    for (int i = 0; i < an.block_count; i++) seen[i] = -1;
+    for (int i = 0; i < an.func_count; i++) callee_seen[i] = -1;
+    for (int f = 0; f < an.func_count; f++) an_collect(&an, f, seen, callee_seen);
+    free(seen);
+    free(callee_seen);
+    an_compute_clobbers(&an);
+
+    uint64_t insns = 0;
+    for (int i = 0; i < an.block_count; i++) insns += an.blocks[i].cost.insns;
+    fprintf(out, "Code: %d function(s), %d block(s), %llu instruction(s)\n\n",
+            an.func_count, an.block_count, (unsigned long long)insns);
+
+    // Components callees first, so every call sees its callee's bounds
+    an.local = (int*)malloc(an.block_count * sizeof(int));
+    an.tarjan = (int*)malloc(an.func_count * sizeof(int));
+    an.order = (int*)malloc(an.func_count * sizeof(int));
+    for (int f = 0; f < an.func_count; f++) {
+        if (an.funcs[f].index < 0) an_tarjan(&an, f);
+    }
+    for (int start = 0; start < an.order_count;) {
+        int end = start;
+        while (end < an.order_count && an.funcs[an.order[end]].scc == an.funcs[an.order[start]].scc) end++;
+        an_component(&an, an.order + start, end - start);
+        start = end;
+    }
+
+    an_report(&an);
+
+    for (int f = 0; f < an.func_count; f++) {
+        free(an.funcs[f].blocks);
+        free(an.funcs[f].callees);
+    }
+    free(an.funcs);
+    free(an.blocks);
+    free(an.code);
+    free(an.leader);
+    free(an.block_at);
+    free(an.func_at);
+    free(an.local);
+    free(an.tarjan);
+    free(an.order);
+    return an.ok;
+}
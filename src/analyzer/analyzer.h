@@ -0,0 +1,52 @@
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Static analyzer: recovers the control-flow graph of a flat image by
+// recursive-descent decoding from the entry point and every CALL target, and
+// bounds, per function, the stack words used below its entry SP (CALL
+// return addresses included) and the instructions and cycles executed
+// until it returns or halts. Nothing is executed.
+//
+// Loops must be bounded. A counted loop (one register stepped once per
+// iteration by INC/DEC/ADDI/SUBI from a constant and compared with a
+// constant) is bounded automatically; other loops take a LoopBound.
+// Recursion always takes a RecursionBound: the analyzer flags it rather
+// than guessing how deep it goes.
+
+#define ANALYZER_LOOP_LIMIT 65536   // Iterations simulated for a counted loop
+
+typedef struct {
+    const char* name;
+    uint16_t address;
+} AnalyzerLabel;
+
+typedef struct {
+    uint16_t address;           // Any address inside the loop (innermost loop wins)
+    uint32_t count;             // Times the loop header may run per entry to the loop
+} LoopBound;
+
+typedef struct {
+    uint16_t entry;             // Entry of any function on the recursive cycle
+    uint32_t depth;             // Activations of the cycle that may be live at once
+} RecursionBound;
+
+typedef struct {
+    uint16_t entry;             // Where execution starts
+    const AnalyzerLabel* labels;    // Names for functions and loops (may be NULL)
+    int label_count;
+    const LoopBound* loops;
+    int loop_count;
+    const RecursionBound* recursion;
+    int recursion_count;
+    uint64_t cycle_budget;      // Warn when the worst case exceeds it (0 = none)
+} AnalyzerOptions;
+
+// Analyzing an image loaded at address 0, writing the report to out.
+// Returns false if the code is malformed or any bound is missing.
+bool analyze_image(const uint16_t* image, uint32_t size, const AnalyzerOptions* options, FILE* out);
+
+#endif // ANALYZER_H
@@ -0,0 +1,173 @@
+#include "analyzer.h"
+#include "../assembler/assembler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void print_usage(const char* program_name) {
+    printf("SimpleCPU16 Static Analyzer\n");
+    printf("Usage: %s <program.bin|program.asm> [options]\n", program_name);
+    printf("Assembly sources are assembled in memory; they and executables with a symbol\n");
+    printf("table name functions and loops by label.\n");
+    printf("Options:\n");
+    printf("  --bound <label|addr>=N      The loop holding this address runs its header at most N times per entry\n");
+    printf("  --recursion <label|addr>=N  At most N activations of this function's recursive cycle at once\n");
+    printf("  --budget <cycles>           Warn above this many cycles (default %d, 0 = off)\n",
+           CPU_DEFAULT_CYCLE_LIMIT);
+    printf("  --help                      Show this help message\n");
+}
+
+// Loading an executable (or assembling a source in memory) as a flat
+// image, keeping its code labels
+static uint16_t* analyzer_load(const char* filename, bool source_file, uint32_t* size, uint32_t* words,
+                               uint16_t* entry, AnalyzerLabel** labels, int* label_count) {
+    Executable exe;
+    if (source_file) {
+        AsmSource source;
+        if (!asm_load_source(&source, filename)) return NULL;
+
+        FILE* quiet = fopen("/dev/null", "w");
+        Assembler asm_state;
+        asm_init(&asm_state);
+        asm_state.info = quiet ? quiet : stderr;
+        bool ok = asm_assemble_source(&asm_state, source.data, source.size);
+        asm_close_source(&source);
+        if (quiet) fclose(quiet);
+        if (ok) asm_build_executable(&asm_state, filename, &exe);
+        asm_free(&asm_state);
+        if (!ok) return NULL;
+    } else if (!exe_read(filename, &exe)) {
+        return NULL;
+    }
+
+    *size = exe_extent(&exe);
+    *words = 0;
+    for (uint32_t i = 0; i < exe.segment_count; i++) *words += exe.segments[i].size;
+    *entry = exe.entry;
+    uint16_t* image = (uint16_t*)malloc((*size ? *size : 1) * sizeof(uint16_t));
+    exe_flatten(&exe, image);
+
+    // Names are taken over: the table goes away with the executable
+    *labels = (AnalyzerLabel*)malloc((exe.symbol_count + 1) * sizeof(AnalyzerLabel));
+    *label_count = 0;
+    for (uint32_t i = 0; i < exe.symbol_count; i++) {
+        ExeSymbol* symbol = &exe.symbols[i];
+        if (symbol->flags & EXE_SYM_CONSTANT) continue;
+        AnalyzerLabel* label = &(*labels)[(*label_count)++];
+        label->name = symbol->name;
+        label->address = symbol->value;
+        symbol->name = NULL;
+    }
+    exe_free(&exe);
+    return image;
+}
+
+// Parsing "name=N" where name is a label or an address
+static bool analyzer_parse_bound(const char* arg, const AnalyzerLabel* labels, int label_count,
+                                 uint16_t* address, uint32_t* count) {
+    const char* equals = strrchr(arg, '=');
+    char* end;
+    if (!equals || equals == arg) {
+        fprintf(stderr, "Error: Expected <label|addr>=N, got '%s'\n", arg);
+        return false;
+    }
+    unsigned long value = strtoul(equals + 1, &end, 0);
+    if (*end != '\0' || equals[1] == '\0' || value == 0 || value > UINT32_MAX) {
+        fprintf(stderr, "Error: Invalid count in '%s' (must be at least 1)\n", arg);
+        return false;
+    }
+    *count = (uint32_t)value;
+
+    size_t length = (size_t)(equals - arg);
+    for (int i = 0; i < label_count; i++) {
+        if (strlen(labels[i].name) == length && strncmp(labels[i].name, arg, length) == 0) {
+            *address = labels[i].address;
+            return true;
+        }
+    }
+    unsigned long parsed = strtoul(arg, &end, 0);
+    if (end != equals || parsed > 0xFFFF) {
+        fprintf(stderr, "Error: Unknown label or address in '%s'\n", arg);
+        return false;
+    }
+    *address = (uint16_t)parsed;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    const char* input_file = NULL;
+    const char** bound_args = (const char**)calloc(argc, sizeof(char*));
+    const char** recursion_args = (const char**)calloc(argc, sizeof(char*));
+    int bound_count = 0, recursion_count = 0;
+    uint64_t budget = CPU_DEFAULT_CYCLE_LIMIT;
+
+    // Parsing command-line arguments
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bound") == 0 && i + 1 < argc) {
+            bound_args[bound_count++] = argv[++i];
+        } else if (strcmp(argv[i], "--recursion") == 0 && i + 1 < argc) {
+            recursion_args[recursion_count++] = argv[++i];
+        } else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+            budget = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            free(bound_args);
+            free(recursion_args);
+            return 0;
+        } else {
+            input_file = argv[i];
+        }
+    }
+
+    if (!input_file) {
+        fprintf(stderr, "Error: No input file specified\n");
+        print_usage(argv[0]);
+        free(bound_args);
+        free(recursion_args);
+        return 1;
+    }
+
+    AnalyzerLabel* labels = NULL;
+    int label_count = 0;
+    uint32_t size = 0;
+    uint32_t words = 0;
+    uint16_t entry = 0;
+    size_t name_length = strlen(input_file);
+    bool source = name_length > 4 && strcmp(input_file + name_length - 4, ".asm") == 0;
+    uint16_t* image = analyzer_load(input_file, source, &size, &words, &entry, &labels, &label_count);
+
+    LoopBound* loops = (LoopBound*)calloc(bound_count + 1, sizeof(LoopBound));
+    RecursionBound* recursion = (RecursionBound*)calloc(recursion_count + 1, sizeof(RecursionBound));
+    bool ok = image != NULL;
+    for (int i = 0; i < bound_count && ok; i++) {
+        ok = analyzer_parse_bound(bound_args[i], labels, label_count, &loops[i].address, &loops[i].count);
+    }
+    for (int i = 0; i < recursion_count && ok; i++) {
+        ok = analyzer_parse_bound(recursion_args[i], labels, label_count,
+                                  &recursion[i].entry, &recursion[i].depth);
+    }
+
+    if (ok) {
+        printf("SimpleCPU16 Static Analyzer v1.0\n");
+        printf("================================\n\n");
+        printf("Input: %s (%u words", input_file, words);
+        if (words != size) printf(", image spans 0x0000-0x%04X", size - 1);
+        printf(")\n");
+        if (entry != 0) printf("Entry: 0x%04X\n", entry);
+
+        AnalyzerOptions options = { entry, labels, label_count, loops, bound_count,
+                                    recursion, recursion_count, budget };
+        ok = analyze_image(image, size, &options, stdout);
+        printf(ok ? "\nAnalysis complete: all bounds found\n"
+                  : "\nAnalysis incomplete: see the notes above\n");
+    }
+
+    for (int i = 0; i < label_count; i++) free((char*)labels[i].name);
+    free(labels);
+    free(image);
+    free(loops);
+    free(recursion);
+    free(bound_args);
+    free(recursion_args);
+    return ok ? 0 : 1;
+}
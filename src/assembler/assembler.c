@@ -1,17 +1,64 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "assembler.h"
+#include "object.h"
+#include "peephole.h"
+#include "expr.h"
 #include "../emulator/cpu.h"
+#include "../emulator/isa.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 // Initializing assembler state
 void asm_init(Assembler* asm_state) {
+    symtab_init(&asm_state->symbols);
     asm_state->label_count = 0;
+    asm_state->fixups = NULL;
+    asm_state->fixup_count = 0;
+    asm_state->fixup_capacity = 0;
+    asm_state->relocatable = false;
+    asm_state->raw = false;
+    asm_state->strip = false;
+    asm_state->relocs = NULL;
+    asm_state->reloc_count = 0;
+    asm_state->reloc_capacity = 0;
+    asm_state->optimize = false;
+    asm_state->items = NULL;
+    asm_state->item_count = 0;
+    asm_state->item_capacity = 0;
+    asm_state->source = NULL;
+    asm_state->source_bytes = 0;
+    asm_state->line = 0;
+    asm_state->line_start = 0;
+    asm_state->token_capacity = 16;
+    asm_state->tokens = (Token*)malloc(asm_state->token_capacity * sizeof(Token));
+    macro_init(&asm_state->macros);
+    asm_state->expansion_count = 0;
+    asm_state->expanding = 0;
+    asm_state->info = stdout;
     asm_state->current_address = 0;
     asm_state->output_capacity = 1024;
     asm_state->output_size = 0;
+    asm_state->output_end = 0;
+    asm_state->overflowed = false;
     asm_state->output = (uint16_t*)malloc(asm_state->output_capacity * sizeof(uint16_t));
+    asm_state->runs = NULL;
+    asm_state->run_count = 0;
+    asm_state->run_capacity = 0;
+    asm_state->run_start = 0;
+    asm_state->lines = NULL;
+    asm_state->line_count = 0;
+    asm_state->line_capacity = 0;
+    asm_state->has_entry = false;
 }
 
 // Freeing assembler resources
@@ -20,552 +67,1471 @@ void asm_free(Assembler* asm_state) {
         free(asm_state->output);
         asm_state->output = NULL;
     }
+    free(asm_state->fixups);
+    asm_state->fixups = NULL;
+    free(asm_state->relocs);
+    asm_state->relocs = NULL;
+    free(asm_state->items);
+    asm_state->items = NULL;
+    free(asm_state->runs);
+    asm_state->runs = NULL;
+    free(asm_state->lines);
+    asm_state->lines = NULL;
+    free(asm_state->tokens);
+    asm_state->tokens = NULL;
+    macro_free(&asm_state->macros);
+    symtab_free(&asm_state->symbols);
 }
 
-// Adding label to symbol table
-void asm_add_label(Assembler* asm_state, const char* name, uint16_t address) {
-    if (asm_state->label_count >= MAX_LABELS) {
-        fprintf(stderr, "Error: Too many labels\n");
-        return;
+// Reporting an error at a token's line and column
+static void asm_error(const Assembler* asm_state, const Token* at, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "Error: ");
+    vfprintf(stderr, format, args);
+    if (at) {
+        fprintf(stderr, " (line %d, column %d)\n", asm_state->line,
+                (int)(at->offset - asm_state->line_start) + 1);
+    } else {
+        fprintf(stderr, " (line %d)\n", asm_state->line);
+    }
+    va_end(args);
+}
+
+static const char* asm_token_text(const Assembler* asm_state, const Token* token) {
+    return asm_state->source + token->offset;
+}
+
+// Comparing a token with a word, ignoring case
+static bool asm_token_is(const Assembler* asm_state, const Token* token, const char* word) {
+    return strncasecmp(asm_token_text(asm_state, token), word, token->length) == 0 &&
+           word[token->length] == '\0';
+}
+
+// Adding label to symbol table (false if already defined)
+bool asm_add_label(Assembler* asm_state, const char* name, size_t length, uint16_t address) {
+    Symbol* symbol = symtab_intern(&asm_state->symbols, name, length);
+    if (symbol->defined) {
+        fprintf(stderr, "Error: Duplicate label '%.*s' (first defined at 0x%04X, line %d)\n",
+                (int)length, name, symbol->address, asm_state->line);
+        return false;
     }
-    
-    strncpy(asm_state->labels[asm_state->label_count].name, name, 63);
-    asm_state->labels[asm_state->label_count].name[63] = '\0';
-    asm_state->labels[asm_state->label_count].address = address;
+
+    symbol->address = address;
+    symbol->defined = true;
     asm_state->label_count++;
+    return true;
 }
 
 // Finding label address
 int asm_find_label(Assembler* asm_state, const char* name) {
-    for (int i = 0; i < asm_state->label_count; i++) {
-        if (strcmp(asm_state->labels[i].name, name) == 0) {
-            return asm_state->labels[i].address;
-        }
+    const Symbol* symbol = symtab_lookup(&asm_state->symbols, name, strlen(name));
+    return symbol && symbol->defined ? symbol->address : -1;
+}
+
+// Growing output buffer to hold at least size words
+static void asm_reserve(Assembler* asm_state, int size) {
+    if (size <= asm_state->output_capacity) return;
+    while (asm_state->output_capacity < size) {
+        asm_state->output_capacity *= 2;
     }
-    return -1;
+    asm_state->output = (uint16_t*)realloc(asm_state->output,
+                                            asm_state->output_capacity * sizeof(uint16_t));
 }
 
-// Emitting word to output
+// Emitting word to output. Words past the end of memory are dropped;
+// the first one is reported and fails the assembly
 void asm_emit_word(Assembler* asm_state, uint16_t word) {
-    if (asm_state->output_size >= asm_state->output_capacity) {
-        asm_state->output_capacity *= 2;
-        asm_state->output = (uint16_t*)realloc(asm_state->output, 
-                                                asm_state->output_capacity * sizeof(uint16_t));
+    if (asm_state->output_size >= MEM_SIZE) {
+        if (!asm_state->overflowed) {
+            asm_error(asm_state, NULL, "Output runs past the end of memory at 0x%04X", MEM_SIZE - 1);
+            asm_state->overflowed = true;
+        }
+        return;
     }
-    
+    asm_reserve(asm_state, asm_state->output_size + 1);
     asm_state->output[asm_state->output_size++] = word;
     asm_state->current_address++;
+    if (asm_state->output_size > asm_state->output_end) {
+        asm_state->output_end = asm_state->output_size;
+    }
 }
 
-// Parsing register name
-int asm_parse_register(const char* str) {
-    if (str[0] != 'R' && str[0] != 'r') {
-        if (strcasecmp(str, "SP") == 0) return REG_SP;
-        return -1;
+// Parsing register name (R0-R7 or SP)
+int asm_parse_register(const char* str, size_t length) {
+    if (length == 2 && strncasecmp(str, "SP", 2) == 0) return REG_SP;
+    if (length < 2 || (str[0] != 'R' && str[0] != 'r')) return -1;
+
+    // Digits only after 'R' (so "RET", "READ" etc. are not registers)
+    int reg_num = 0;
+    for (size_t i = 1; i < length; i++) {
+        if (!isdigit((unsigned char)str[i])) return -1;
+        reg_num = reg_num * 10 + (str[i] - '0');
+        if (reg_num >= NUM_REGISTERS) return -1;
     }
+    return reg_num;
+}
 
-    // Check that character after 'R' is a digit
-    if (!isdigit(str[1])) {
-        return -1;  // Not a valid register (e.g., "RET", "READ", etc.)
+// Parsing numeric value (decimal, hex, or char)
+int asm_parse_number(const char* str, size_t length) {
+    if (length == 3 && str[0] == '\'' && str[2] == '\'') {
+        return (int)str[1];
     }
 
-    int reg_num = atoi(str + 1);
-    if (reg_num >= 0 && reg_num < NUM_REGISTERS) {
-        return reg_num;
+    size_t i = 0;
+    bool negative = false;
+    if (i < length && (str[i] == '-' || str[i] == '+')) {
+        negative = str[i] == '-';
+        i++;
     }
 
-    return -1;
+    int value = 0;
+    if (i + 1 < length && str[i] == '0' && (str[i + 1] == 'b' || str[i + 1] == 'B')) {
+        for (i += 2; i < length && (str[i] == '0' || str[i] == '1'); i++) {
+            value = value * 2 + (str[i] - '0');
+        }
+    } else if (i + 1 < length && str[i] == '0' && (str[i + 1] == 'x' || str[i + 1] == 'X')) {
+        for (i += 2; i < length && isxdigit((unsigned char)str[i]); i++) {
+            int c = tolower((unsigned char)str[i]);
+            value = value * 16 + (isdigit(c) ? c - '0' : c - 'a' + 10);
+        }
+    } else {
+        for (; i < length && isdigit((unsigned char)str[i]); i++) {
+            value = value * 10 + (str[i] - '0');
+        }
+    }
+    return negative ? -value : value;
 }
 
-// Parsing numeric value (decimal, hex, or char)
-int asm_parse_number(const char* str) {
-    if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
-        return (int)strtol(str + 2, NULL, 16);
-    } else if (str[0] == '\'') {
-        if (str[2] == '\'') {
-            return (int)str[1];
-        }
+// Checking for a plain number: optional sign, then decimal, 0x hex or 0b binary
+static bool asm_is_number(const char* str, size_t length) {
+    size_t i = (length > 0 && (str[0] == '-' || str[0] == '+')) ? 1 : 0;
+    int base = 10;
+    if (i + 1 < length && str[i] == '0' && (str[i + 1] == 'x' || str[i + 1] == 'X')) {
+        base = 16;
+        i += 2;
+    } else if (i + 1 < length && str[i] == '0' && (str[i + 1] == 'b' || str[i + 1] == 'B')) {
+        base = 2;
+        i += 2;
+    }
+    if (i == length) return false;
+    for (; i < length; i++) {
+        char c = str[i];
+        bool ok = base == 16 ? isxdigit((unsigned char)c) : base == 2 ? (c == '0' || c == '1')
+                                                                      : isdigit((unsigned char)c);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// Appending a token slot, growing the line's token array as needed
+static Token* asm_new_token(Assembler* asm_state, int count) {
+    if (count == asm_state->token_capacity) {
+        asm_state->token_capacity *= 2;
+        asm_state->tokens = (Token*)realloc(asm_state->tokens, asm_state->token_capacity * sizeof(Token));
     }
-    return atoi(str);
+    Token* token = &asm_state->tokens[count];
+    token->num_value = 0;
+    return token;
 }
 
-// Tokenizing assembly line
-int asm_tokenize(const char* line, Token tokens[], int max_tokens) {
+// Tokenizing source[start, end) into asm_state->tokens (-1 on error)
+int asm_tokenize(Assembler* asm_state, size_t start, size_t end) {
+    const char* src = asm_state->source;
     int token_count = 0;
-    char buffer[MAX_LINE_LENGTH];
-    strncpy(buffer, line, MAX_LINE_LENGTH - 1);
-    buffer[MAX_LINE_LENGTH - 1] = '\0';
-    
-    // Removing comments
-    char* comment = strchr(buffer, ';');
-    if (comment) *comment = '\0';
-    
-    // Removing trailing whitespace
-    int len = strlen(buffer);
-    while (len > 0 && isspace(buffer[len-1])) {
-        buffer[--len] = '\0';
-    }
-    
-    if (len == 0) return 0;
-    
-    char* ptr = buffer;
-    while (*ptr && token_count < max_tokens) {
-        // Skipping whitespace
-        while (*ptr && isspace(*ptr)) ptr++;
-        if (!*ptr) break;
-        
-        // Checking for string literal
-        if (*ptr == '"') {
-            ptr++;
-            char* start = ptr;
-            while (*ptr && *ptr != '"') ptr++;
-            int str_len = ptr - start;
-            strncpy(tokens[token_count].value, start, str_len);
-            tokens[token_count].value[str_len] = '\0';
-            tokens[token_count].type = TOKEN_STRING;
-            token_count++;
-            if (*ptr == '"') ptr++;
+    size_t pos = start;
+
+    while (pos < end) {
+        char c = src[pos];
+
+        // Skipping whitespace; a comment ends the line
+        if (isspace((unsigned char)c)) {
+            pos++;
             continue;
         }
-        
-        // Checking for special characters
-        if (*ptr == ',') {
-            tokens[token_count].type = TOKEN_COMMA;
-            tokens[token_count].value[0] = ',';
-            tokens[token_count].value[1] = '\0';
+        if (c == ';') break;
+
+        Token* token = asm_new_token(asm_state, token_count);
+        token->offset = (uint32_t)pos;
+
+        // Checking for string literal
+        if (c == '"') {
+            size_t close = pos + 1;
+            while (close < end && src[close] != '"') close++;
+            if (close >= end) {
+                asm_error(asm_state, token, "Unterminated string");
+                return -1;
+            }
+            token->type = TOKEN_STRING;
+            token->offset = (uint32_t)(pos + 1);
+            token->length = (uint32_t)(close - pos - 1);
+            pos = close + 1;
             token_count++;
-            ptr++;
             continue;
         }
-        
-        if (*ptr == '[') {
-            tokens[token_count].type = TOKEN_LBRACKET;
-            tokens[token_count].value[0] = '[';
-            tokens[token_count].value[1] = '\0';
+
+        // Checking for character literal
+        if (c == '\'') {
+            if (pos + 2 >= end || src[pos + 2] != '\'') {
+                asm_error(asm_state, token, "Invalid character literal");
+                return -1;
+            }
+            token->type = TOKEN_IMMEDIATE;
+            token->length = 3;
+            token->num_value = (unsigned char)src[pos + 1];
+            pos += 3;
             token_count++;
-            ptr++;
             continue;
         }
-        
-        if (*ptr == ']') {
-            tokens[token_count].type = TOKEN_RBRACKET;
-            tokens[token_count].value[0] = ']';
-            tokens[token_count].value[1] = '\0';
+
+        // Checking for special characters
+        if (c == ',' || c == '[' || c == ']') {
+            token->type = c == ',' ? TOKEN_COMMA : c == '[' ? TOKEN_LBRACKET : TOKEN_RBRACKET;
+            token->length = 1;
+            pos++;
             token_count++;
-            ptr++;
             continue;
         }
-        
+
         // Reading word token
-        char* start = ptr;
-        while (*ptr && !isspace(*ptr) && *ptr != ',' && *ptr != '[' && *ptr != ']' && *ptr != ';') {
-            ptr++;
-        }
-        
-        int word_len = ptr - start;
-        if (word_len == 0) continue;
-        
-        strncpy(tokens[token_count].value, start, word_len);
-        tokens[token_count].value[word_len] = '\0';
-        
+        size_t word_start = pos;
+        while (pos < end && !isspace((unsigned char)src[pos]) && src[pos] != ',' &&
+               src[pos] != '[' && src[pos] != ']' && src[pos] != ';') {
+            pos++;
+        }
+        const char* word = src + word_start;
+        size_t word_len = pos - word_start;
+        token->length = (uint32_t)word_len;
+
         // Determining token type
-        if (tokens[token_count].value[word_len-1] == ':') {
-            tokens[token_count].value[word_len-1] = '\0';
-            tokens[token_count].type = TOKEN_LABEL;
-        } else if (tokens[token_count].value[0] == '.') {
-            tokens[token_count].type = TOKEN_DIRECTIVE;
-        } else if (asm_parse_register(tokens[token_count].value) >= 0) {
-            tokens[token_count].type = TOKEN_REGISTER;
-            tokens[token_count].num_value = asm_parse_register(tokens[token_count].value);
-        } else if (isdigit(tokens[token_count].value[0]) || 
-                   tokens[token_count].value[0] == '\'' ||
-                   tokens[token_count].value[0] == '-') {
-            tokens[token_count].type = TOKEN_IMMEDIATE;
-            tokens[token_count].num_value = asm_parse_number(tokens[token_count].value);
+        int reg;
+        if (word[word_len - 1] == ':') {
+            token->type = TOKEN_LABEL;
+            token->length--;
+        } else if (word[0] == '.') {
+            token->type = TOKEN_DIRECTIVE;
+        } else if ((reg = asm_parse_register(word, word_len)) >= 0) {
+            token->type = TOKEN_REGISTER;
+            token->num_value = reg;
+        } else if (asm_is_number(word, word_len)) {
+            token->type = TOKEN_IMMEDIATE;
+            token->num_value = asm_parse_number(word, word_len);
+        } else if (expr_is_identifier(word, word_len)) {
+            token->type = TOKEN_INSTRUCTION;
         } else {
-            tokens[token_count].type = TOKEN_INSTRUCTION;
+            token->type = TOKEN_EXPRESSION;
         }
-        
         token_count++;
     }
-    
+
     return token_count;
 }
 
-// Encoding instruction
-uint16_t asm_encode_instruction(const char* mnemonic, Token operands[], int operand_count, Assembler* asm_state) {
-    // Suppress unused parameter warnings
-    (void)operand_count;
-    (void)asm_state;
-
-    uint8_t rd = 0, rs = 0;
-    
-    // NOP
-    if (strcasecmp(mnemonic, "NOP") == 0) {
-        return (OP_NOP << 12);
-    }
-    
-    // HALT
-    else if (strcasecmp(mnemonic, "HALT") == 0) {
-        return (OP_HALT << 12);
-    }
-    
-    // MOV Rd, Rs
-    else if (strcasecmp(mnemonic, "MOV") == 0) {
-        rd = operands[0].num_value;
-        rs = operands[2].num_value;  // Skip comma
-        return (OP_MOVE << 12) | (rd << 9) | (rs << 6);
-    }
-    
-    // LDI Rd, immediate
-    else if (strcasecmp(mnemonic, "LDI") == 0) {
-        rd = operands[0].num_value;
-        // Emitting immediate value after instruction
-        return (OP_LOAD << 12) | (rd << 9) | LOAD_IMM;
-    }
-    
-    // LD Rd, [address] or LD Rd, [Rs]
-    else if (strcasecmp(mnemonic, "LD") == 0) {
-        rd = operands[0].num_value;
-        // Checking if indirect [Rs] or direct [address]
-        // Token layout: LD R1, [ R5 ] -> operands[3] is the register/address inside brackets
-        if (operands[3].type == TOKEN_REGISTER) {
-            rs = operands[3].num_value;
-            return (OP_LOAD << 12) | (rd << 9) | (rs << 6) | LOAD_IND;
-        } else {
-            return (OP_LOAD << 12) | (rd << 9) | LOAD_DIR;
+// Recording a reference to symbol at the current output word
+static void asm_add_reference(Assembler* asm_state, Fixup** list, int* count, int* capacity,
+                              const Symbol* symbol, int column) {
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 256;
+        *list = (Fixup*)realloc(*list, *capacity * sizeof(Fixup));
+    }
+    Fixup* fixup = &(*list)[(*count)++];
+    fixup->symbol = symbol->id;
+    fixup->offset = asm_state->output_size;
+    fixup->line = asm_state->line;
+    fixup->column = column;
+}
+
+// Emitting a value word: numbers directly, labels resolved now or
+// patched once defined (forward reference)
+static void asm_emit_value(Assembler* asm_state, bool symbolic, uint32_t value, int column) {
+    if (!symbolic) {
+        asm_emit_word(asm_state, (uint16_t)value);
+        return;
+    }
+
+    const Symbol* symbol = symtab_at(&asm_state->symbols, value);
+    if (!symbol->defined) {
+        asm_add_reference(asm_state, &asm_state->fixups, &asm_state->fixup_count,
+                          &asm_state->fixup_capacity, symbol, column);
+    }
+    if (asm_state->relocatable) {
+        asm_add_reference(asm_state, &asm_state->relocs, &asm_state->reloc_count,
+                          &asm_state->reloc_capacity, symbol, column);
+    }
+    asm_emit_word(asm_state, symbol->address);
+}
+
+// Closing the range written since the last .ORG
+static void asm_close_run(Assembler* asm_state) {
+    if (asm_state->output_size > asm_state->run_start) {
+        if (asm_state->run_count == asm_state->run_capacity) {
+            asm_state->run_capacity = asm_state->run_capacity ? asm_state->run_capacity * 2 : 16;
+            asm_state->runs = (AsmRun*)realloc(asm_state->runs, asm_state->run_capacity * sizeof(AsmRun));
+        }
+        AsmRun* run = &asm_state->runs[asm_state->run_count++];
+        run->start = asm_state->run_start;
+        run->end = asm_state->output_size;
+    }
+}
+
+// Moving the output position to addr (.ORG). Only never-written words
+// are zero-filled, so moving back and forth keeps earlier code.
+static void asm_org(Assembler* asm_state, uint16_t addr) {
+    asm_close_run(asm_state);
+    asm_reserve(asm_state, addr);
+    if (asm_state->output_end < addr) {
+        memset(&asm_state->output[asm_state->output_end], 0,
+               (addr - asm_state->output_end) * sizeof(uint16_t));
+        asm_state->output_end = addr;
+    }
+    asm_state->output_size = addr;
+    asm_state->current_address = addr;
+    asm_state->run_start = addr;
+}
+
+// Recording the source line of an instruction (once per line)
+static void asm_add_line(Assembler* asm_state, int line) {
+    if (asm_state->line_count > 0 && asm_state->lines[asm_state->line_count - 1].line == (uint32_t)line) {
+        return;
+    }
+    if (asm_state->line_count == asm_state->line_capacity) {
+        asm_state->line_capacity = asm_state->line_capacity ? asm_state->line_capacity * 2 : 256;
+        asm_state->lines = (ExeLine*)realloc(asm_state->lines, asm_state->line_capacity * sizeof(ExeLine));
+    }
+    ExeLine* entry = &asm_state->lines[asm_state->line_count++];
+    entry->address = asm_state->current_address;
+    entry->line = (uint32_t)line;
+}
+
+// Emitting one output item at the current address
+static bool asm_emit_item(Assembler* asm_state, const AsmItem* item) {
+    switch (item->kind) {
+        case ITEM_LABEL: {
+            const Symbol* symbol = symtab_at(&asm_state->symbols, item->value);
+            return asm_add_label(asm_state, symbol->name, symbol->length, asm_state->current_address);
         }
+        case ITEM_INSN:
+            asm_add_line(asm_state, item->line);
+            asm_emit_word(asm_state, isa_encode(item->insn, item->rd, item->rs));
+            if (item->insn->length > 1) {
+                asm_emit_value(asm_state, item->symbolic, item->value, item->column);
+            }
+            break;
+        case ITEM_WORD:
+            asm_emit_value(asm_state, item->symbolic, item->value, item->column);
+            break;
+        case ITEM_ORG:
+            asm_org(asm_state, (uint16_t)item->value);
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+// Emitting an item now, or buffering it for the peephole pass
+static bool asm_put(Assembler* asm_state, const AsmItem* item) {
+    if (!asm_state->optimize) {
+        return asm_emit_item(asm_state, item);
+    }
+    if (asm_state->item_count == asm_state->item_capacity) {
+        asm_state->item_capacity = asm_state->item_capacity ? asm_state->item_capacity * 2 : 1024;
+        asm_state->items = (AsmItem*)realloc(asm_state->items, asm_state->item_capacity * sizeof(AsmItem));
     }
-    
-    // ST [address], Rs or ST [Rd], Rs
-    else if (strcasecmp(mnemonic, "ST") == 0) {
-        if (operands[1].type == TOKEN_REGISTER) {
-            rd = operands[1].num_value;
-            rs = operands[4].num_value;  // After comma
-            return (OP_STORE << 12) | (rd << 9) | (rs << 6) | STORE_IND;
+    asm_state->items[asm_state->item_count++] = *item;
+    return true;
+}
+
+// Starting an item at the current line
+static void asm_item_init(const Assembler* asm_state, AsmItem* item, AsmItemKind kind) {
+    memset(item, 0, sizeof(AsmItem));
+    item->kind = kind;
+    item->line = asm_state->line;
+}
+
+// Resolving an identifier in an expression: constants, and labels
+// already placed at a fixed address
+static bool asm_lookup_constant(void* context, const char* name, size_t length, int32_t* value) {
+    const Assembler* asm_state = (const Assembler*)context;
+    const Symbol* symbol = symtab_lookup(&asm_state->symbols, name, length);
+    if (!symbol || !symbol->defined || (!symbol->constant && asm_state->relocatable)) return false;
+    *value = symbol->address;
+    return true;
+}
+
+// Evaluating an expression token
+static bool asm_eval(Assembler* asm_state, const Token* token, int32_t* value) {
+    const char* text = asm_token_text(asm_state, token);
+    ExprError error;
+    if (expr_eval(text, token->length, asm_lookup_constant, asm_state, value, &error)) {
+        return true;
+    }
+
+    Token at = *token;
+    at.offset += (uint32_t)error.position;
+    const char* name = text + error.position;
+    const Symbol* symbol = symtab_lookup(&asm_state->symbols, name, error.length);
+    if (symbol && symbol->defined && asm_state->relocatable) {
+        asm_error(asm_state, &at, "Label '%.*s' in an expression cannot be relocated", (int)error.length, name);
+    } else if (error.message[0] == 'U' && error.message[1] == 'n' && error.message[2] == 'd') {
+        asm_error(asm_state, &at, "Undefined symbol '%.*s' in expression%s", (int)error.length, name,
+                  asm_state->optimize ? " (labels cannot be used in expressions with -O)" : "");
+    } else {
+        asm_error(asm_state, &at, "%s in '%.*s'", error.message, (int)token->length, text);
+    }
+    return false;
+}
+
+// Reading an operand token as a number or a symbol id
+static bool asm_item_value(Assembler* asm_state, AsmItem* item, const Token* token) {
+    item->column = (int)(token->offset - asm_state->line_start) + 1;
+    item->symbolic = false;
+    if (token->type == TOKEN_IMMEDIATE || token->type == TOKEN_REGISTER) {
+        item->value = (uint16_t)token->num_value;
+    } else if (token->type == TOKEN_EXPRESSION) {
+        int32_t value;
+        if (!asm_eval(asm_state, token, &value)) return false;
+        item->value = (uint16_t)value;
+    } else {
+        const Symbol* symbol = symtab_intern(&asm_state->symbols, asm_token_text(asm_state, token), token->length);
+        if (symbol->constant && symbol->defined) {
+            item->value = symbol->address;
         } else {
-            rs = operands[4].num_value;  // Register after comma
-            return (OP_STORE << 12) | (rs << 6) | STORE_DIR;
-        }
-    }
-    
-    // Arithmetic instructions
-    else if (strcasecmp(mnemonic, "ADD") == 0) {
-        rd = operands[0].num_value;
-        rs = operands[2].num_value;
-        return (OP_ARITH << 12) | (rd << 9) | (rs << 6) | ARITH_ADD;
-    }
-    else if (strcasecmp(mnemonic, "SUB") == 0) {
-        rd = operands[0].num_value;
-        rs = operands[2].num_value;
-        return (OP_ARITH << 12) | (rd << 9) | (rs << 6) | ARITH_SUB;
-    }
-    else if (strcasecmp(mnemonic, "MUL") == 0) {
-        rd = operands[0].num_value;
-        rs = operands[2].num_value;
-        return (OP_ARITH << 12) | (rd << 9) | (rs << 6) | ARITH_MUL;
-    }
-    else if (strcasecmp(mnemonic, "DIV") == 0) {
-        rd = operands[0].num_value;
-        rs = operands[2].num_value;
-        return (OP_ARITH << 12) | (rd << 9) | (rs << 6) | ARITH_DIV;
-    }
-    else if (strcasecmp(mnemonic, "INC") == 0) {
-        rd = operands[0].num_value;
-        return (OP_ARITH << 12) | (rd << 9) | ARITH_INC;
-    }
-    else if (strcasecmp(mnemonic, "DEC") == 0) {
-        rd = operands[0].num_value;
-        return (OP_ARITH << 12) | (rd << 9) | ARITH_DEC;
-    }
-    else if (strcasecmp(mnemonic, "ADDI") == 0) {
-        rd = operands[0].num_value;
-        return (OP_ARITH << 12) | (rd << 9) | ARITH_ADDI;
-    }
-    else if (strcasecmp(mnemonic, "SUBI") == 0) {
-        rd = operands[0].num_value;
-        return (OP_ARITH << 12) | (rd << 9) | ARITH_SUBI;
-    }
-    
-    // Logical instructions
-    else if (strcasecmp(mnemonic, "AND") == 0) {
-        rd = operands[0].num_value;
-        rs = operands[2].num_value;
-        return (OP_LOGIC << 12) | (rd << 9) | (rs << 6) | LOGIC_AND;
-    }
-    else if (strcasecmp(mnemonic, "OR") == 0) {
-        rd = operands[0].num_value;
-        rs = operands[2].num_value;
-        return (OP_LOGIC << 12) | (rd << 9) | (rs << 6) | LOGIC_OR;
-    }
-    else if (strcasecmp(mnemonic, "XOR") == 0) {
-        rd = operands[0].num_value;
-        rs = operands[2].num_value;
-        return (OP_LOGIC << 12) | (rd << 9) | (rs << 6) | LOGIC_XOR;
-    }
-    else if (strcasecmp(mnemonic, "NOT") == 0) {
-        rd = operands[0].num_value;
-        return (OP_LOGIC << 12) | (rd << 9) | LOGIC_NOT;
-    }
-    
-    // Shift instructions
-    else if (strcasecmp(mnemonic, "SHL") == 0) {
-        rd = operands[0].num_value;
-        rs = operands[2].num_value;
-        return (OP_SHIFT << 12) | (rd << 9) | (rs << 6) | SHIFT_LEFT;
-    }
-    else if (strcasecmp(mnemonic, "SHR") == 0) {
-        rd = operands[0].num_value;
-        rs = operands[2].num_value;
-        return (OP_SHIFT << 12) | (rd << 9) | (rs << 6) | SHIFT_RIGHT;
-    }
-    else if (strcasecmp(mnemonic, "SAR") == 0) {
-        rd = operands[0].num_value;
-        rs = operands[2].num_value;
-        return (OP_SHIFT << 12) | (rd << 9) | (rs << 6) | SHIFT_ARITH;
-    }
-    
-    // Compare
-    else if (strcasecmp(mnemonic, "CMP") == 0) {
-        rd = operands[0].num_value;
-        rs = operands[2].num_value;
-        return (OP_CMP << 12) | (rd << 9) | (rs << 6);
-    }
-    
-    // Stack operations
-    else if (strcasecmp(mnemonic, "PUSH") == 0) {
-        rs = operands[0].num_value;
-        return (OP_STACK << 12) | (rs << 6) | STACK_PUSH;
-    }
-    else if (strcasecmp(mnemonic, "POP") == 0) {
-        rd = operands[0].num_value;
-        return (OP_STACK << 12) | (rd << 9) | STACK_POP;
-    }
-    
-    // Branches
-    else if (strcasecmp(mnemonic, "BEQ") == 0) {
-        return (OP_BRANCH << 12) | BRANCH_EQ;
-    }
-    else if (strcasecmp(mnemonic, "BNE") == 0) {
-        return (OP_BRANCH << 12) | BRANCH_NE;
-    }
-    else if (strcasecmp(mnemonic, "BGT") == 0) {
-        return (OP_BRANCH << 12) | BRANCH_GT;
-    }
-    else if (strcasecmp(mnemonic, "BLT") == 0) {
-        return (OP_BRANCH << 12) | BRANCH_LT;
-    }
-    else if (strcasecmp(mnemonic, "BGE") == 0) {
-        return (OP_BRANCH << 12) | BRANCH_GE;
-    }
-    else if (strcasecmp(mnemonic, "BLE") == 0) {
-        return (OP_BRANCH << 12) | BRANCH_LE;
-    }
-    else if (strcasecmp(mnemonic, "BCS") == 0) {
-        return (OP_BRANCH << 12) | BRANCH_CS;
-    }
-    else if (strcasecmp(mnemonic, "BCC") == 0) {
-        return (OP_BRANCH << 12) | BRANCH_CC;
-    }
-    
-    // Jump
-    else if (strcasecmp(mnemonic, "JMP") == 0) {
-        return (OP_JUMP << 12);
-    }
-    
-    // Call and Return
-    else if (strcasecmp(mnemonic, "CALL") == 0) {
-        return (OP_CALL << 12);
-    }
-    else if (strcasecmp(mnemonic, "RET") == 0) {
-        return (OP_RET << 12);
-    }
-    
-    fprintf(stderr, "Unknown instruction: %s\n", mnemonic);
+            item->symbolic = true;
+            item->value = symbol->id;
+        }
+    }
+    return true;
+}
+
+// Emitting buffered items after the peephole pass (returns number of errors)
+static int asm_emit_items(Assembler* asm_state) {
+    int errors = 0;
+    for (int i = 0; i < asm_state->item_count; i++) {
+        const AsmItem* item = &asm_state->items[i];
+        asm_state->line = item->line;
+        if (item->kind == ITEM_DELETED && item->symbolic) {
+            // Still reporting undefined labels in removed code (nothing to patch)
+            const Symbol* symbol = symtab_at(&asm_state->symbols, item->value);
+            if (!symbol->defined) {
+                asm_add_reference(asm_state, &asm_state->fixups, &asm_state->fixup_count,
+                                  &asm_state->fixup_capacity, symbol, item->column);
+                asm_state->fixups[asm_state->fixup_count - 1].offset = INT_MAX;
+            }
+            continue;
+        }
+        if (!asm_emit_item(asm_state, item)) errors++;
+    }
+    return errors;
+}
+
+// Patching forward references (returns number of undefined labels).
+// Imported labels stay zero in an object; the linker fills them in.
+static int asm_resolve_fixups(Assembler* asm_state) {
+    int errors = 0;
+    for (int i = 0; i < asm_state->fixup_count; i++) {
+        const Fixup* fixup = &asm_state->fixups[i];
+        const Symbol* symbol = symtab_at(&asm_state->symbols, fixup->symbol);
+        if (!symbol->defined) {
+            if (symbol->imported && asm_state->relocatable) continue;
+            fprintf(stderr, "Error: Undefined label '%s' (line %d, column %d)%s\n",
+                    symbol->name, fixup->line, fixup->column,
+                    symbol->imported ? "; .extern labels need -c and the linker" : "");
+            errors++;
+            continue;
+        }
+        if (fixup->offset < asm_state->output_end) {
+            asm_state->output[fixup->offset] = symbol->address;
+        }
+    }
+    return errors;
+}
+
+// Resolving a .ENTRY label (returns number of errors)
+static int asm_resolve_entry(Assembler* asm_state) {
+    if (!asm_state->has_entry || !asm_state->entry.symbolic) return 0;
+    const Symbol* symbol = symtab_at(&asm_state->symbols, asm_state->entry.value);
+    if (!symbol->defined) {
+        fprintf(stderr, "Error: Undefined .ENTRY label '%s' (line %d, column %d)\n",
+                symbol->name, asm_state->entry.line, asm_state->entry.column);
+        return 1;
+    }
+    asm_state->entry.value = symbol->address;
+    asm_state->entry.symbolic = false;
     return 0;
 }
 
-// Assembling single line
-bool asm_assemble_line(Assembler* asm_state, const char* line, int pass) {
-    Token tokens[MAX_TOKENS];
-    int token_count = asm_tokenize(line, tokens, MAX_TOKENS);
+// Checking .global and .extern declarations (returns number of errors)
+static int asm_check_linkage(Assembler* asm_state) {
+    int errors = 0;
+    for (uint32_t id = 0; id < asm_state->symbols.count; id++) {
+        const Symbol* symbol = symtab_at(&asm_state->symbols, id);
+        if (symbol->exported && !symbol->defined) {
+            fprintf(stderr, "Error: Label '%s' is declared .global but never defined\n", symbol->name);
+            errors++;
+        }
+        if (symbol->exported && symbol->constant) {
+            fprintf(stderr, "Error: Constant '%s' cannot be declared .global\n", symbol->name);
+            errors++;
+        }
+        if (symbol->imported && symbol->defined) {
+            fprintf(stderr, "Error: Label '%s' is declared .extern but defined here\n", symbol->name);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+// Folding the run of value tokens at i (an expression written with
+// spaces) into one token; returns the index after the run
+static int asm_value_run(const Token tokens[], int i, int token_count, Token* out) {
+    int end = i;
+    while (end < token_count && (tokens[end].type == TOKEN_IMMEDIATE || tokens[end].type == TOKEN_INSTRUCTION ||
+                                 tokens[end].type == TOKEN_EXPRESSION)) {
+        end++;
+    }
+    if (end == i) return i;
+    *out = tokens[i];
+    if (end - i > 1) {
+        out->type = TOKEN_EXPRESSION;
+        out->length = tokens[end - 1].offset + tokens[end - 1].length - tokens[i].offset;
+    }
+    return end;
+}
+
+// Recognizing [Rn+offset] or [Rn-offset] between tokens first and last
+// (inclusive): the offset becomes one token, a plain number or label
+// when it is one so labels stay relocatable
+static bool asm_parse_offset(const Assembler* asm_state, const Token tokens[], int first, int last,
+                             Operand* operand) {
+    const char* src = asm_state->source;
+    size_t pos = tokens[first].offset;
+    size_t end = tokens[last].offset + tokens[last].length;
+    size_t name = pos;
+    while (pos < end && isalnum((unsigned char)src[pos])) pos++;
+    int base = asm_parse_register(src + name, pos - name);
+    if (base < 0) return false;
+    while (pos < end && isspace((unsigned char)src[pos])) pos++;
+    if (pos >= end || (src[pos] != '+' && src[pos] != '-')) return false;
+    if (src[pos] == '+') pos++;
+    while (pos < end && isspace((unsigned char)src[pos])) pos++;
+    if (pos >= end) return false;
+
+    Token* token = &operand->token;
+    token->offset = (uint32_t)pos;
+    token->length = (uint32_t)(end - pos);
+    token->num_value = 0;
+    if (asm_is_number(src + pos, end - pos)) {
+        token->type = TOKEN_IMMEDIATE;
+        token->num_value = asm_parse_number(src + pos, end - pos);
+    } else if (expr_is_identifier(src + pos, end - pos)) {
+        token->type = TOKEN_INSTRUCTION;
+    } else {
+        token->type = TOKEN_EXPRESSION;
+    }
+    operand->kind = OPERAND_MEM_OFF;
+    operand->base = base;
+    return true;
+}
+
+// Checking for a lone + or - token (the step of [R1]+ and -[R1])
+static bool asm_is_step(const Assembler* asm_state, const Token tokens[], int i, int token_count, char sign) {
+    return i < token_count && tokens[i].type == TOKEN_EXPRESSION && tokens[i].length == 1 &&
+           asm_state->source[tokens[i].offset] == sign;
+}
+
+static bool asm_is_mem_reg(const Token tokens[], int i, int token_count) {
+    return i + 2 < token_count && tokens[i].type == TOKEN_LBRACKET && tokens[i + 1].type == TOKEN_REGISTER &&
+           tokens[i + 2].type == TOKEN_RBRACKET;
+}
+
+// Grouping operand tokens into operands (commas dropped, [..] folded)
+static int asm_parse_operands(const Assembler* asm_state, const Token tokens[], int token_count,
+                              Operand operands[], int max_operands) {
+    int count = 0;
+    for (int i = 0; i < token_count; i++) {
+        if (tokens[i].type == TOKEN_COMMA) continue;
+        if (count == max_operands) return -1;
+        Operand* operand = &operands[count++];
+        if (asm_is_step(asm_state, tokens, i, token_count, '-') && asm_is_mem_reg(tokens, i + 1, token_count)) {
+            operand->token = tokens[i + 2];
+            operand->kind = OPERAND_MEM_DEC;
+            i += 3;
+            continue;
+        }
+        if (tokens[i].type == TOKEN_LBRACKET) {
+            if (asm_is_mem_reg(tokens, i, token_count)) {
+                operand->token = tokens[i + 1];
+                operand->kind = OPERAND_MEM_REG;
+                i += 2;
+                if (asm_is_step(asm_state, tokens, i + 1, token_count, '+')) {
+                    operand->kind = OPERAND_MEM_INC;
+                    i++;
+                }
+                continue;
+            }
+            int close = i + 1;
+            while (close < token_count && tokens[close].type != TOKEN_RBRACKET) close++;
+            if (close < token_count && close > i + 1 && asm_parse_offset(asm_state, tokens, i + 1, close - 1, operand)) {
+                i = close;
+                continue;
+            }
+            int end = asm_value_run(tokens, i + 1, token_count, &operand->token);
+            if (end == i + 1 || end >= token_count || tokens[end].type != TOKEN_RBRACKET) return -1;
+            operand->kind = OPERAND_MEM;
+            i = end;
+        } else if (tokens[i].type == TOKEN_REGISTER) {
+            operand->token = tokens[i];
+            operand->kind = OPERAND_REG;
+        } else {
+            int end = asm_value_run(tokens, i, token_count, &operand->token);
+            if (end == i) return -1;
+            operand->kind = OPERAND_VALUE;
+            i = end - 1;
+        }
+    }
+    return count;
+}
+
+// Checking operands against an operand shape
+static bool asm_shape_matches(OperandShape shape, const Operand operands[], int count) {
+    static const struct {
+        int count;
+        OperandKind kinds[2];
+    } layouts[] = {
+        [SHAPE_NONE]   = { 0, { 0, 0 } },
+        [SHAPE_RD]     = { 1, { OPERAND_REG, 0 } },
+        [SHAPE_RS]     = { 1, { OPERAND_REG, 0 } },
+        [SHAPE_RD_RS]  = { 2, { OPERAND_REG, OPERAND_REG } },
+        [SHAPE_RD_IMM] = { 2, { OPERAND_REG, OPERAND_VALUE } },
+        [SHAPE_RD_MEM] = { 2, { OPERAND_REG, OPERAND_MEM } },
+        [SHAPE_RD_IND] = { 2, { OPERAND_REG, OPERAND_MEM_REG } },
+        [SHAPE_MEM_RS] = { 2, { OPERAND_MEM, OPERAND_REG } },
+        [SHAPE_IND_RS] = { 2, { OPERAND_MEM_REG, OPERAND_REG } },
+        [SHAPE_RD_OFF] = { 2, { OPERAND_REG, OPERAND_MEM_OFF } },
+        [SHAPE_OFF_RS] = { 2, { OPERAND_MEM_OFF, OPERAND_REG } },
+        [SHAPE_RD_INC] = { 2, { OPERAND_REG, OPERAND_MEM_INC } },
+        [SHAPE_RD_DEC] = { 2, { OPERAND_REG, OPERAND_MEM_DEC } },
+        [SHAPE_INC_RS] = { 2, { OPERAND_MEM_INC, OPERAND_REG } },
+        [SHAPE_DEC_RS] = { 2, { OPERAND_MEM_DEC, OPERAND_REG } },
+        [SHAPE_TARGET] = { 1, { OPERAND_VALUE, 0 } },
+        [SHAPE_REGLIST] = { -1, { 0, 0 } },        // Parsed by asm_assemble_reglist
+    };
+    if (layouts[shape].count != count) return false;
+    for (int i = 0; i < count; i++) {
+        if (layouts[shape].kinds[i] != operands[i].kind) return false;
+    }
+    return true;
+}
+
+// Assembling PUSHM/POPM: registers and Ra-Rb ranges, comma-separated,
+// into the mask in the extension word
+static bool asm_assemble_reglist(Assembler* asm_state, const Token* mnemonic, const InsnInfo* insn,
+                                 const Token tokens[], int token_count) {
+    uint16_t mask = 0;
+    for (int i = 0; i < token_count; i++) {
+        const Token* token = &tokens[i];
+        if (token->type == TOKEN_COMMA) continue;
+        int first = -1, last = -1;
+        if (token->type == TOKEN_REGISTER) {
+            first = last = token->num_value;
+        } else if (token->type == TOKEN_EXPRESSION) {
+            const char* text = asm_token_text(asm_state, token);
+            const char* dash = memchr(text, '-', token->length);
+            if (dash) {
+                first = asm_parse_register(text, (size_t)(dash - text));
+                last = asm_parse_register(dash + 1, token->length - (size_t)(dash - text) - 1);
+            }
+        }
+        if (first < 0 || last < 0 || first > last) {
+            asm_error(asm_state, token, "Expected a register or range like R4-R6 in %s's list", insn->name);
+            return false;
+        }
+        if (last == REG_SP) {
+            asm_error(asm_state, token, "SP cannot be in a %s register list", insn->name);
+            return false;
+        }
+        for (int r = first; r <= last; r++) {
+            if (mask & (1 << r)) {
+                asm_error(asm_state, token, "R%d listed twice", r);
+                return false;
+            }
+            mask |= (uint16_t)(1 << r);
+        }
+    }
+    if (mask == 0) {
+        asm_error(asm_state, mnemonic, "%s needs at least one register", insn->name);
+        return false;
+    }
+
+    AsmItem item;
+    asm_item_init(asm_state, &item, ITEM_INSN);
+    item.insn = insn;
+    item.value = mask;
+    item.column = (int)(mnemonic->offset - asm_state->line_start) + 1;
+    return asm_put(asm_state, &item);
+}
+
+// Assembling one instruction from the table row matching its operands
+bool asm_assemble_instruction(Assembler* asm_state, const Token* mnemonic, Token tokens[], int token_count) {
+    const InsnInfo* insn = isa_lookup(asm_token_text(asm_state, mnemonic), mnemonic->length);
+    if (!insn) {
+        asm_error(asm_state, mnemonic, "Unknown instruction '%.*s'", (int)mnemonic->length,
+                  asm_token_text(asm_state, mnemonic));
+        return false;
+    }
+
+    if (insn->shape == SHAPE_REGLIST) {
+        return asm_assemble_reglist(asm_state, mnemonic, insn, tokens, token_count);
+    }
+
+    Operand operands[MAX_OPERANDS];
+    int count = asm_parse_operands(asm_state, tokens, token_count, operands, MAX_OPERANDS);
+
+    // Trying each addressing form of the mnemonic (rows are adjacent)
+    const InsnInfo* end = isa_table + ISA_COUNT;
+    while (count < 0 || !asm_shape_matches(insn->shape, operands, count)) {
+        if (count < 0 || insn + 1 == end || strcmp(insn[1].name, insn->name) != 0) {
+            asm_error(asm_state, mnemonic, "Invalid operands for %s", insn->name);
+            return false;
+        }
+        insn++;
+    }
+
+    AsmItem item;
+    asm_item_init(asm_state, &item, ITEM_INSN);
+    item.insn = insn;
+    int rd = 0, rs = 0;
+    const Token* extension = NULL;
+    switch (insn->shape) {
+        case SHAPE_RD:     rd = operands[0].token.num_value; break;
+        case SHAPE_RS:     rs = operands[0].token.num_value; break;
+        case SHAPE_RD_RS:
+        case SHAPE_RD_IND:
+        case SHAPE_RD_INC:
+        case SHAPE_RD_DEC: rd = operands[0].token.num_value; rs = operands[1].token.num_value; break;
+        case SHAPE_RD_IMM:
+        case SHAPE_RD_MEM: rd = operands[0].token.num_value; extension = &operands[1].token; break;
+        case SHAPE_MEM_RS: rs = operands[1].token.num_value; extension = &operands[0].token; break;
+        case SHAPE_IND_RS:
+        case SHAPE_INC_RS:
+        case SHAPE_DEC_RS: rd = operands[0].token.num_value; rs = operands[1].token.num_value; break;
+        case SHAPE_RD_OFF: rd = operands[0].token.num_value; rs = operands[1].base; extension = &operands[1].token; break;
+        case SHAPE_OFF_RS: rd = operands[0].base; rs = operands[1].token.num_value; extension = &operands[0].token; break;
+        case SHAPE_TARGET: extension = &operands[0].token; break;
+        default: break;
+    }
+
+    item.rd = (uint8_t)rd;
+    item.rs = (uint8_t)rs;
+    if (extension && !asm_item_value(asm_state, &item, extension)) {
+        return false;
+    }
+    return asm_put(asm_state, &item);
+}
+
+// Evaluating all of a directive's arguments as one expression
+static bool asm_eval_args(Assembler* asm_state, const Token* directive, const Token args[], int arg_count,
+                          int32_t* value) {
+    if (arg_count < 1) {
+        asm_error(asm_state, directive, "%.*s needs a value", (int)directive->length,
+                  asm_token_text(asm_state, directive));
+        return false;
+    }
+    Token expression = args[0];
+    expression.type = TOKEN_EXPRESSION;
+    expression.length = args[arg_count - 1].offset + args[arg_count - 1].length - args[0].offset;
+    return asm_eval(asm_state, &expression, value);
+}
 
+// Assembling a directive
+static bool asm_assemble_directive(Assembler* asm_state, const Token* directive, Token args[], int arg_count) {
+    if (asm_token_is(asm_state, directive, ".ORG")) {
+        int32_t address;
+        if (!asm_eval_args(asm_state, directive, args, arg_count, &address)) {
+            return false;
+        }
+        AsmItem item;
+        asm_item_init(asm_state, &item, ITEM_ORG);
+        item.value = (uint16_t)address;
+        asm_put(asm_state, &item);
+    }
+    else if (asm_token_is(asm_state, directive, ".WORD")) {
+        for (int i = 0; i < arg_count; i++) {
+            if (args[i].type == TOKEN_COMMA) continue;
+            Token value = args[i];
+            int end = asm_value_run(args, i, arg_count, &value);
+            if (end == i && args[i].type != TOKEN_REGISTER) {
+                asm_error(asm_state, &args[i], "Invalid .WORD value");
+                return false;
+            }
+            if (end > i) i = end - 1;
+            AsmItem item;
+            asm_item_init(asm_state, &item, ITEM_WORD);
+            if (!asm_item_value(asm_state, &item, &value)) {
+                return false;
+            }
+            asm_put(asm_state, &item);
+        }
+    }
+    else if (asm_token_is(asm_state, directive, ".EQU")) {
+        if (arg_count < 2 || args[0].type != TOKEN_INSTRUCTION) {
+            asm_error(asm_state, directive, "Expected .EQU name, value");
+            return false;
+        }
+        int first = args[1].type == TOKEN_COMMA ? 2 : 1;
+        int32_t value;
+        if (!asm_eval_args(asm_state, directive, &args[first], arg_count - first, &value)) {
+            return false;
+        }
+        Symbol* symbol = symtab_intern(&asm_state->symbols, asm_token_text(asm_state, &args[0]), args[0].length);
+        if (symbol->defined) {
+            asm_error(asm_state, &args[0], "Duplicate symbol '%.*s'", (int)args[0].length,
+                      asm_token_text(asm_state, &args[0]));
+            return false;
+        }
+        symbol->address = (uint16_t)value;
+        symbol->constant = true;
+        symbol->defined = true;
+    }
+    else if (asm_token_is(asm_state, directive, ".STRING") || asm_token_is(asm_state, directive, ".ASCIIZ")) {
+        if (arg_count < 1 || args[0].type != TOKEN_STRING) {
+            asm_error(asm_state, directive, "Expected a string literal");
+            return false;
+        }
+        const char* str = asm_token_text(asm_state, &args[0]);
+        uint32_t len = args[0].length;
+        // Pack two characters per word (low byte, high byte)
+        AsmItem item;
+        asm_item_init(asm_state, &item, ITEM_WORD);
+        for (uint32_t i = 0; i < len; i += 2) {
+            item.value = (str[i] & 0xFF);
+            if (i + 1 < len) {
+                item.value |= ((uint16_t)(str[i + 1] & 0xFF)) << 8;
+            }
+            asm_put(asm_state, &item);
+        }
+        item.value = 0;  // Null terminator
+        asm_put(asm_state, &item);
+    }
+    else if (asm_token_is(asm_state, directive, ".GLOBAL") || asm_token_is(asm_state, directive, ".EXTERN")) {
+        bool global = asm_token_is(asm_state, directive, ".GLOBAL");
+        int names = 0;
+        for (int i = 0; i < arg_count; i++) {
+            if (args[i].type == TOKEN_COMMA) continue;
+            if (args[i].type != TOKEN_INSTRUCTION) {
+                asm_error(asm_state, &args[i], "Expected a label name");
+                return false;
+            }
+            Symbol* symbol = symtab_intern(&asm_state->symbols, asm_token_text(asm_state, &args[i]),
+                                           args[i].length);
+            if (global) {
+                symbol->exported = true;
+            } else {
+                symbol->imported = true;
+            }
+            names++;
+        }
+        if (names == 0) {
+            asm_error(asm_state, directive, "Expected a label name");
+            return false;
+        }
+    }
+    else if (asm_token_is(asm_state, directive, ".ENTRY")) {
+        if (asm_state->relocatable) {
+            asm_error(asm_state, directive, ".ENTRY is not allowed in an object (the linker starts at 0)");
+            return false;
+        }
+        if (asm_state->has_entry) {
+            asm_error(asm_state, directive, "Duplicate .ENTRY");
+            return false;
+        }
+        asm_item_init(asm_state, &asm_state->entry, ITEM_WORD);
+        if (arg_count == 1 && args[0].type == TOKEN_INSTRUCTION) {
+            if (!asm_item_value(asm_state, &asm_state->entry, &args[0])) return false;
+        } else {
+            int32_t address;
+            if (!asm_eval_args(asm_state, directive, args, arg_count, &address)) return false;
+            asm_state->entry.value = (uint16_t)address;
+        }
+        asm_state->has_entry = true;
+    }
+    else if (asm_token_is(asm_state, directive, ".ENDM") || asm_token_is(asm_state, directive, ".ENDR")) {
+        asm_error(asm_state, directive, "%.*s without a matching %s", (int)directive->length,
+                  asm_token_text(asm_state, directive),
+                  asm_token_is(asm_state, directive, ".ENDM") ? ".MACRO" : ".REPT");
+        return false;
+    }
+    else {
+        asm_error(asm_state, directive, "Unknown directive '%.*s'", (int)directive->length,
+                  asm_token_text(asm_state, directive));
+        return false;
+    }
+    return true;
+}
+
+// Assembling source[start, end) as one line (code is emitted immediately)
+bool asm_assemble_line(Assembler* asm_state, size_t start, size_t end) {
+    asm_state->line_start = start;
+    int token_count = asm_tokenize(asm_state, start, end);
+    if (token_count < 0) return false;
     if (token_count == 0) return true;
-    
+
+    Token* tokens = asm_state->tokens;
     int token_idx = 0;
-    
+
     // Processing label if present
     if (tokens[token_idx].type == TOKEN_LABEL) {
-        if (pass == 1) {
-            asm_add_label(asm_state, tokens[token_idx].value, asm_state->current_address);
+        AsmItem item;
+        asm_item_init(asm_state, &item, ITEM_LABEL);
+        item.value = symtab_intern(&asm_state->symbols, asm_token_text(asm_state, &tokens[token_idx]),
+                                   tokens[token_idx].length)->id;
+        if (!asm_put(asm_state, &item)) {
+            return false;
         }
         token_idx++;
         if (token_idx >= token_count) return true;
     }
-    
+
     // Processing directive
     if (tokens[token_idx].type == TOKEN_DIRECTIVE) {
-        if (strcasecmp(tokens[token_idx].value, ".ORG") == 0) {
-            uint16_t org_addr = asm_parse_number(tokens[token_idx + 1].value);
-            asm_state->current_address = org_addr;
-            if (pass == 2) {
-                asm_state->output_size = org_addr;
-            }
+        return asm_assemble_directive(asm_state, &tokens[token_idx], &tokens[token_idx + 1],
+                                      token_count - token_idx - 1);
+    }
+
+    // Processing instruction
+    if (tokens[token_idx].type == TOKEN_INSTRUCTION) {
+        return asm_assemble_instruction(asm_state, &tokens[token_idx], &tokens[token_idx + 1],
+                                        token_count - token_idx - 1);
+    }
+
+    asm_error(asm_state, &tokens[token_idx], "Expected an instruction or directive");
+    return false;
+}
+
+// Reading one word of a line (no tokens are stored)
+static size_t asm_line_word(const char* src, size_t* pos, size_t end) {
+    while (*pos < end && isspace((unsigned char)src[*pos])) (*pos)++;
+    size_t start = *pos;
+    while (*pos < end && !isspace((unsigned char)src[*pos]) && src[*pos] != ',' && src[*pos] != ';' &&
+           src[*pos] != '[' && src[*pos] != ']' && src[*pos] != '"') {
+        (*pos)++;
+    }
+    return *pos - start;
+}
+
+// Finding the first word of a line after an optional label; *label_end
+// is the end of the label (start if none). Returns the word's length.
+static size_t asm_line_head(const char* src, size_t start, size_t end, size_t* word, size_t* label_end) {
+    size_t pos = start;
+    size_t length = asm_line_word(src, &pos, end);
+    *label_end = start;
+    if (length > 0 && src[pos - 1] == ':') {
+        *label_end = pos;
+        length = asm_line_word(src, &pos, end);
+    }
+    *word = pos - length;
+    return length;
+}
+
+static bool asm_head_is(const char* src, size_t word, size_t length, const char* name) {
+    return strlen(name) == length && strncasecmp(src + word, name, length) == 0;
+}
+
+// Finding the line that closes a block whose body starts at pos (nested
+// blocks of the same kind are skipped). Sets *close to the start of the
+// closing line, *after past it and *lines to the lines passed.
+static bool asm_find_block_end(const Assembler* asm_state, size_t pos, size_t end, const char* open,
+                               const char* close_name, size_t* close, size_t* after, int* lines) {
+    const char* src = asm_state->source;
+    int depth = 0;
+    *lines = 0;
+    while (pos < end) {
+        const char* newline = (const char*)memchr(src + pos, '\n', end - pos);
+        size_t line_end = newline ? (size_t)(newline - src) : end;
+        (*lines)++;
+        size_t word, label_end;
+        size_t length = asm_line_head(src, pos, line_end, &word, &label_end);
+        if (asm_head_is(src, word, length, open)) {
+            depth++;
+        } else if (asm_head_is(src, word, length, close_name) && depth-- == 0) {
+            *close = pos;
+            *after = line_end + 1;
+            return true;
         }
-        else if (strcasecmp(tokens[token_idx].value, ".WORD") == 0) {
-            if (pass == 2) {
-                for (int i = token_idx + 1; i < token_count; i++) {
-                    if (tokens[i].type != TOKEN_COMMA) {
-                        int value;
-                        if (tokens[i].type == TOKEN_IMMEDIATE) {
-                            value = tokens[i].num_value;
-                        } else {
-                            // Could be a label
-                            value = asm_find_label(asm_state, tokens[i].value);
-                            if (value == -1) value = 0;
-                        }
-                        asm_emit_word(asm_state, (uint16_t)value);
-                    }
-                }
-            } else {
-                // Counting words in pass 1
-                for (int i = token_idx + 1; i < token_count; i++) {
-                    if (tokens[i].type != TOKEN_COMMA) {
-                        asm_state->current_address++;
-                    }
-                }
-            }
+        pos = line_end + 1;
+    }
+    return false;
+}
+
+static int asm_assemble_lines(Assembler* asm_state, size_t start, size_t end);
+
+// Assembling generated text (a macro or .REPT expansion) in place of the
+// current source; line numbers stay at the invoking line
+static int asm_assemble_text(Assembler* asm_state, const char* text, size_t size) {
+    const char* saved_source = asm_state->source;
+    size_t saved_line_start = asm_state->line_start;
+    asm_state->source = text;
+    asm_state->expanding++;
+    int errors = asm_assemble_lines(asm_state, 0, size);
+    asm_state->expanding--;
+    asm_state->source = saved_source;
+    asm_state->line_start = saved_line_start;
+    return errors;
+}
+
+// Defining a macro: .MACRO name [param, ...] up to the matching .ENDM
+// (returns number of errors; *next is the line after .ENDM)
+static int asm_define_macro(Assembler* asm_state, size_t start, size_t line_end, size_t end, size_t* next) {
+    size_t close, after;
+    int lines;
+    Token* tokens = asm_state->tokens;
+    asm_state->line_start = start;
+    int token_count = asm_tokenize(asm_state, start, line_end);
+    int d = token_count > 0 && tokens[0].type == TOKEN_LABEL ? 1 : 0;
+
+    if (!asm_find_block_end(asm_state, line_end + 1, end, ".MACRO", ".ENDM", &close, &after, &lines)) {
+        asm_error(asm_state, token_count > d ? &tokens[d] : NULL, "Missing .ENDM for .MACRO");
+        *next = end;
+        return 1;
+    }
+    *next = after;
+    int line = asm_state->line;
+    if (asm_state->expanding == 0) asm_state->line += lines;
+
+    if (token_count < 0) return 1;
+    if (d + 1 >= token_count || tokens[d + 1].type != TOKEN_INSTRUCTION) {
+        asm_state->line = line;
+        asm_error(asm_state, &tokens[d], "Expected a macro name");
+        asm_state->line += asm_state->expanding == 0 ? lines : 0;
+        return 1;
+    }
+
+    const Token* name = &tokens[d + 1];
+    const char* name_text = asm_token_text(asm_state, name);
+    int errors = 0;
+    if (macro_find(&asm_state->macros, name_text, name->length)) {
+        fprintf(stderr, "Error: Duplicate macro '%.*s' (line %d)\n", (int)name->length, name_text, line);
+        return 1;
+    }
+
+    Macro* macro = macro_define(&asm_state->macros, name_text, name->length);
+    for (int i = d + 2; i < token_count; i++) {
+        if (tokens[i].type == TOKEN_COMMA) continue;
+        if (tokens[i].type != TOKEN_INSTRUCTION || macro->param_count == MACRO_MAX_PARAMS) {
+            fprintf(stderr, "Error: Invalid parameter '%.*s' for macro '%.*s' (line %d)\n",
+                    (int)tokens[i].length, asm_token_text(asm_state, &tokens[i]), (int)name->length, name_text, line);
+            errors++;
+            break;
         }
-        else if (strcasecmp(tokens[token_idx].value, ".STRING") == 0 ||
-                 strcasecmp(tokens[token_idx].value, ".ASCIIZ") == 0) {
-            if (pass == 2 && token_idx + 1 < token_count) {
-                const char* str = tokens[token_idx + 1].value;
-                // Pack two characters per word (low byte, high byte)
-                for (int i = 0; str[i]; i += 2) {
-                    uint16_t word = (str[i] & 0xFF);
-                    if (str[i + 1] != '\0') {
-                        word |= ((uint16_t)(str[i + 1] & 0xFF)) << 8;
-                    }
-                    asm_emit_word(asm_state, word);
-                }
-                asm_emit_word(asm_state, 0);  // Null terminator
-            } else {
-                const char* str = tokens[token_idx + 1].value;
-                int str_len = strlen(str);
-                // Calculate words needed: (length + 1) / 2, plus null terminator
-                asm_state->current_address += (str_len + 1) / 2 + 1;
+        size_t length = tokens[i].length;
+        macro->params[macro->param_count] = (char*)malloc(length + 1);
+        memcpy(macro->params[macro->param_count], asm_token_text(asm_state, &tokens[i]), length);
+        macro->params[macro->param_count][length] = '\0';
+        macro->param_lengths[macro->param_count++] = length;
+    }
+
+    // Copying the body: the source it came from may be a temporary expansion
+    size_t body_start = line_end + 1 < close ? line_end + 1 : close;
+    macro->body_size = close - body_start;
+    macro->body = (char*)malloc(macro->body_size + 1);
+    memcpy(macro->body, asm_state->source + body_start, macro->body_size);
+    macro->defined = errors == 0;
+    return errors;
+}
+
+// Expanding a macro call: name arg, ... (arguments are raw text split
+// at top-level commas)
+static int asm_expand_macro(Assembler* asm_state, const Macro* macro, size_t name_start, size_t name_length,
+                            size_t pos, size_t end) {
+    const char* src = asm_state->source;
+    MacroArg args[MACRO_MAX_PARAMS];
+    int arg_count = 0;
+    int depth = 0;
+    bool quoted = false;
+    size_t arg_start = pos;
+    for (; pos <= end; pos++) {
+        char c = pos < end ? src[pos] : ';';
+        if (quoted) {
+            quoted = c != '"';
+            continue;
+        }
+        if (c == '"') quoted = true;
+        if (c == '[' || c == '(') depth++;
+        if (c == ']' || c == ')') depth--;
+        if ((c == ',' && depth == 0) || c == ';') {
+            size_t a = arg_start, b = pos;
+            while (a < b && isspace((unsigned char)src[a])) a++;
+            while (b > a && isspace((unsigned char)src[b - 1])) b--;
+            if (c == ';' && arg_count == 0 && a == b) break;
+            if (arg_count == MACRO_MAX_PARAMS) {
+                arg_count++;
+                break;
             }
+            args[arg_count].text = src + a;
+            args[arg_count++].length = b - a;
+            arg_start = pos + 1;
+            if (c == ';') break;
         }
-        return true;
     }
-    
-    // Processing instruction
-    if (tokens[token_idx].type == TOKEN_INSTRUCTION) {
-        const char* mnemonic = tokens[token_idx].value;
-        Token* operands = &tokens[token_idx + 1];
-        int operand_count = token_count - token_idx - 1;
-
-        if (pass == 2) {
-            uint16_t instruction = asm_encode_instruction(mnemonic, operands, operand_count, asm_state);
-            asm_emit_word(asm_state, instruction);
-            
-            // Checking if we need to emit immediate/address
-            if (strcasecmp(mnemonic, "LDI") == 0 || strcasecmp(mnemonic, "ADDI") == 0 || 
-                strcasecmp(mnemonic, "SUBI") == 0) {
-                int value = operands[2].num_value;  // After comma
-                if (operands[2].type != TOKEN_IMMEDIATE && operands[2].type != TOKEN_REGISTER) {
-                    value = asm_find_label(asm_state, operands[2].value);
-                    if (value == -1) {
-                        fprintf(stderr, "Undefined label: %s\n", operands[2].value);
-                        value = 0;
-                    }
-                }
-                asm_emit_word(asm_state, (uint16_t)value);
-            }
-            else if (strcasecmp(mnemonic, "LD") == 0 && operands[3].type != TOKEN_REGISTER) {
-                // Token layout: LD R1, [ 0x1000 ] -> operands[3] is the address
-                int addr = asm_parse_number(operands[3].value);
-                asm_emit_word(asm_state, (uint16_t)addr);
-            }
-            else if (strcasecmp(mnemonic, "ST") == 0 && operands[1].type != TOKEN_REGISTER) {
-                int addr = asm_parse_number(operands[1].value);
-                asm_emit_word(asm_state, (uint16_t)addr);
-            }
-            else if (strcasecmp(mnemonic, "JMP") == 0 || strcasecmp(mnemonic, "CALL") == 0 ||
-                     strncasecmp(mnemonic, "B", 1) == 0) {  // Branch instructions
-                int addr;
-                if (operands[0].type == TOKEN_IMMEDIATE) {
-                    addr = operands[0].num_value;
-                } else {
-                    addr = asm_find_label(asm_state, operands[0].value);
-                    if (addr == -1) {
-                        fprintf(stderr, "Undefined label: %s\n", operands[0].value);
-                        addr = 0;
-                    }
-                }
-                asm_emit_word(asm_state, (uint16_t)addr);
-            }
+
+    const char* name = src + name_start;
+    if (arg_count != macro->param_count) {
+        fprintf(stderr, "Error: Macro '%.*s' expects %d argument(s), got %d (line %d)\n", (int)name_length, name,
+                macro->param_count, arg_count, asm_state->line);
+        return 1;
+    }
+    if (asm_state->expanding >= ASM_MAX_EXPANSION_DEPTH) {
+        fprintf(stderr, "Error: Macro '%.*s' nested more than %d deep (line %d)\n", (int)name_length, name,
+                ASM_MAX_EXPANSION_DEPTH, asm_state->line);
+        return 1;
+    }
+
+    MacroText text = { NULL, 0, 0 };
+    const char* bad;
+    size_t bad_length;
+    int errors = 0;
+    if (!macro_substitute(macro, macro->body, macro->body_size, args, asm_state->expansion_count++, &text,
+                          &bad, &bad_length)) {
+        fprintf(stderr, "Error: Unknown macro parameter '%.*s' in '%.*s' (line %d)\n", (int)bad_length, bad,
+                (int)name_length, name, asm_state->line);
+        errors = 1;
+    } else {
+        errors = asm_assemble_text(asm_state, text.data, text.size);
+        if (errors > 0) {
+            fprintf(stderr, "  in expansion of macro '%.*s' (line %d)\n", (int)name_length, name, asm_state->line);
+        }
+    }
+    free(text.data);
+    return errors;
+}
+
+// Repeating the lines up to the matching .ENDR count times. Bodies
+// without \@ are assembled in place from the source on every pass.
+static int asm_repeat(Assembler* asm_state, size_t start, size_t line_end, size_t end, size_t* next) {
+    size_t close, after;
+    int lines;
+    Token* tokens = asm_state->tokens;
+    asm_state->line_start = start;
+    int token_count = asm_tokenize(asm_state, start, line_end);
+    int d = token_count > 0 && tokens[0].type == TOKEN_LABEL ? 1 : 0;
+    int line = asm_state->line;
+
+    if (!asm_find_block_end(asm_state, line_end + 1, end, ".REPT", ".ENDR", &close, &after, &lines)) {
+        asm_error(asm_state, token_count > d ? &tokens[d] : NULL, "Missing .ENDR for .REPT");
+        *next = end;
+        return 1;
+    }
+    *next = after;
+
+    int32_t count;
+    if (token_count < 0 || !asm_eval_args(asm_state, &tokens[d], &tokens[d + 1], token_count - d - 1, &count)) {
+        if (asm_state->expanding == 0) asm_state->line += lines;
+        return 1;
+    }
+    if (count < 0) {
+        asm_error(asm_state, &tokens[d], "Negative .REPT count %d", count);
+        if (asm_state->expanding == 0) asm_state->line += lines;
+        return 1;
+    }
+
+    const char* src = asm_state->source;
+    size_t body_start = line_end + 1 < close ? line_end + 1 : close;
+    bool substitute = memchr(src + body_start, '\\', close - body_start) != NULL;
+    int errors = 0;
+    for (int32_t i = 0; i < count && errors == 0; i++) {
+        if (asm_state->expanding == 0) asm_state->line = line;
+        if (!substitute) {
+            errors += asm_assemble_lines(asm_state, body_start, close);
+            continue;
+        }
+
+        MacroText text = { NULL, 0, 0 };
+        const char* bad;
+        size_t bad_length;
+        if (!macro_substitute(NULL, src + body_start, close - body_start, NULL, asm_state->expansion_count++,
+                              &text, &bad, &bad_length)) {
+            fprintf(stderr, "Error: Unknown parameter '%.*s' in .REPT (line %d)\n", (int)bad_length, bad, line);
+            errors++;
+        } else if (asm_state->expanding >= ASM_MAX_EXPANSION_DEPTH) {
+            fprintf(stderr, "Error: .REPT nested more than %d deep (line %d)\n", ASM_MAX_EXPANSION_DEPTH, line);
+            errors++;
         } else {
-            // Pass 1: counting instruction size
-            asm_state->current_address++;
-            // Checking for multi-word instructions
-            if (strcasecmp(mnemonic, "LDI") == 0 || strcasecmp(mnemonic, "ADDI") == 0 ||
-                strcasecmp(mnemonic, "SUBI") == 0 || strcasecmp(mnemonic, "JMP") == 0 ||
-                strcasecmp(mnemonic, "CALL") == 0 || strncasecmp(mnemonic, "B", 1) == 0) {
-                asm_state->current_address++;
-            }
-            else if (strcasecmp(mnemonic, "LD") == 0 && operands[3].type != TOKEN_REGISTER) {
-                asm_state->current_address++;
-            }
-            else if (strcasecmp(mnemonic, "ST") == 0 && operands[1].type != TOKEN_REGISTER) {
-                asm_state->current_address++;
+            errors += asm_assemble_text(asm_state, text.data, text.size);
+        }
+        free(text.data);
+    }
+    if (asm_state->expanding == 0) asm_state->line = line + lines;
+    return errors;
+}
+
+// Assembling the lines of source[start, end), handling .MACRO and .REPT
+// blocks and macro calls (returns number of errors)
+static int asm_assemble_lines(Assembler* asm_state, size_t start, size_t end) {
+    const char* src = asm_state->source;
+    int errors = 0;
+    size_t pos = start;
+    while (pos < end) {
+        const char* newline = (const char*)memchr(src + pos, '\n', end - pos);
+        size_t line_end = newline ? (size_t)(newline - src) : end;
+        size_t next = line_end + 1;
+        if (asm_state->expanding == 0) asm_state->line++;
+
+        size_t word, label_end;
+        size_t length = asm_line_head(src, pos, line_end, &word, &label_end);
+        bool block = asm_head_is(src, word, length, ".MACRO") || asm_head_is(src, word, length, ".REPT");
+        const Macro* macro = NULL;
+        if (!block && length > 0 && src[word] != '.') {
+            macro = macro_find(&asm_state->macros, src + word, length);
+        }
+
+        if (!block && !macro) {
+            if (!asm_assemble_line(asm_state, pos, line_end)) errors++;
+            pos = next;
+            continue;
+        }
+
+        // A label before a block or macro call marks the current address
+        if (label_end > pos && !asm_assemble_line(asm_state, pos, label_end)) errors++;
+        if (macro) {
+            errors += asm_expand_macro(asm_state, macro, word, length, word + length, line_end);
+        } else if (asm_head_is(src, word, length, ".MACRO")) {
+            errors += asm_define_macro(asm_state, pos, line_end, end, &next);
+        } else {
+            errors += asm_repeat(asm_state, pos, line_end, end, &next);
+        }
+        pos = next;
+    }
+    return errors;
+}
+
+// Assembling a whole source buffer and patching forward references
+bool asm_assemble_source(Assembler* asm_state, const char* data, size_t size) {
+    int errors = 0;
+    asm_state->source = data;
+    asm_state->source_bytes = size;
+    asm_state->current_address = 0;
+    asm_state->line = 0;
+
+    asm_state->expanding = 0;
+    errors += asm_assemble_lines(asm_state, 0, size);
+
+    // Rewriting the buffered code, then emitting it
+    if (asm_state->optimize) {
+        peephole_optimize(asm_state);
+        errors += asm_emit_items(asm_state);
+    }
+    asm_close_run(asm_state);
+
+    errors += asm_resolve_fixups(asm_state);
+    errors += asm_resolve_entry(asm_state);
+    errors += asm_check_linkage(asm_state);
+    if (asm_state->overflowed) errors++;
+    asm_state->source = NULL;
+    if (errors > 0) {
+        fprintf(stderr, "Error: %d error(s)\n", errors);
+        return false;
+    }
+    return true;
+}
+
+// Mapping a source file read-only ("-" reads stdin into memory instead)
+bool asm_load_source(AsmSource* source, const char* input_file) {
+    memset(source, 0, sizeof(AsmSource));
+
+    if (strcmp(input_file, "-") == 0) {
+        size_t capacity = 65536;
+        char* buffer = (char*)malloc(capacity);
+        size_t n;
+        while (buffer && (n = fread(buffer + source->size, 1, capacity - source->size, stdin)) > 0) {
+            source->size += n;
+            if (source->size == capacity) {
+                capacity *= 2;
+                buffer = (char*)realloc(buffer, capacity);
             }
         }
+        if (!buffer) {
+            fprintf(stderr, "Error: Out of memory reading stdin\n");
+            return false;
+        }
+        source->data = buffer;
+        return true;
+    }
+
+    int fd = open(input_file, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "Error: Cannot open input file %s\n", input_file);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    if ((uint64_t)st.st_size > UINT32_MAX) {
+        fprintf(stderr, "Error: Input file %s is larger than 4 GB\n", input_file);
+        close(fd);
+        return false;
+    }
+
+    source->size = (size_t)st.st_size;
+    if (source->size > 0) {
+        void* data = mmap(NULL, source->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            fprintf(stderr, "Error: Cannot map input file %s\n", input_file);
+            close(fd);
+            return false;
+        }
+        posix_madvise(data, source->size, POSIX_MADV_SEQUENTIAL);
+        source->data = (const char*)data;
+        source->mapped = true;
     }
-    
+    close(fd);
     return true;
 }
 
-// Assembling file (two-pass assembler)
+void asm_close_source(AsmSource* source) {
+    if (source->mapped) {
+        munmap((void*)source->data, source->size);
+    } else {
+        free((void*)source->data);
+    }
+    memset(source, 0, sizeof(AsmSource));
+}
+
+// Writing the assembled section as a relocatable object: exported and
+// imported labels become object symbols, label references relocations
+static bool asm_write_object(Assembler* asm_state, const char* output_file) {
+    ObjectFile object;
+    memset(&object, 0, sizeof(object));
+    object.code = asm_state->output;
+    object.code_size = (uint32_t)asm_state->output_end;
+
+    // Mapping symbol ids to object symbol indices
+    uint32_t* index = (uint32_t*)malloc((asm_state->symbols.count + 1) * sizeof(uint32_t));
+    object.symbols = (ObjSymbol*)malloc((asm_state->symbols.count + 1) * sizeof(ObjSymbol));
+    for (uint32_t id = 0; id < asm_state->symbols.count; id++) {
+        const Symbol* symbol = symtab_at(&asm_state->symbols, id);
+        index[id] = OBJ_RELOC_SECTION;
+        if (!symbol->exported && !symbol->imported) continue;
+        ObjSymbol* entry = &object.symbols[object.symbol_count];
+        entry->name = (char*)symbol->name;
+        entry->value = symbol->address;
+        entry->binding = symbol->imported ? OBJ_SYM_IMPORT : OBJ_SYM_EXPORT;
+        index[id] = object.symbol_count++;
+    }
+
+    // Local labels relocate by the section base, imported ones by symbol
+    object.relocs = (ObjReloc*)malloc((asm_state->reloc_count + 1) * sizeof(ObjReloc));
+    for (int i = 0; i < asm_state->reloc_count; i++) {
+        const Fixup* ref = &asm_state->relocs[i];
+        // Constants used before their .EQU were patched with a fixed value
+        if (ref->offset >= asm_state->output_end || symtab_at(&asm_state->symbols, ref->symbol)->constant) continue;
+        ObjReloc* reloc = &object.relocs[object.reloc_count++];
+        reloc->offset = (uint32_t)ref->offset;
+        reloc->symbol = symtab_at(&asm_state->symbols, ref->symbol)->imported ? index[ref->symbol]
+                                                                               : OBJ_RELOC_SECTION;
+    }
+
+    bool ok = object_write(&object, output_file);
+    if (ok) {
+        fprintf(asm_state->info, "Object complete: %u words, %u symbols, %u relocations written to %s\n",
+                object.code_size, object.symbol_count, object.reloc_count, output_file);
+    }
+    free(index);
+    free(object.symbols);
+    free(object.relocs);
+    return ok;
+}
+
+static int asm_run_order(const void* a, const void* b) {
+    return ((const AsmRun*)a)->start - ((const AsmRun*)b)->start;
+}
+
+// Collecting the assembled program as an executable: written ranges
+// (overlapping or touching ones merged) become segments
+void asm_build_executable(const Assembler* asm_state, const char* source_name, Executable* exe) {
+    exe_init(exe);
+    exe->entry = asm_state->has_entry ? (uint16_t)asm_state->entry.value : 0;
+
+    AsmRun* runs = (AsmRun*)malloc((asm_state->run_count + 1) * sizeof(AsmRun));
+    memcpy(runs, asm_state->runs, asm_state->run_count * sizeof(AsmRun));
+    qsort(runs, asm_state->run_count, sizeof(AsmRun), asm_run_order);
+    for (int i = 0; i < asm_state->run_count;) {
+        int start = runs[i].start, end = runs[i].end;
+        for (i++; i < asm_state->run_count && runs[i].start <= end; i++) {
+            if (runs[i].end > end) end = runs[i].end;
+        }
+        exe_add_segment(exe, (uint16_t)start, &asm_state->output[start], (uint32_t)(end - start));
+    }
+    free(runs);
+
+    if (asm_state->strip) return;
+    for (uint32_t id = 0; id < asm_state->symbols.count; id++) {
+        const Symbol* symbol = symtab_at(&asm_state->symbols, id);
+        if (!symbol->defined) continue;
+        exe_add_symbol(exe, symbol->name, symbol->length, symbol->address,
+                       symbol->constant ? EXE_SYM_CONSTANT : 0);
+    }
+    if (asm_state->line_count > 0) {
+        exe->lines = (ExeLine*)malloc(asm_state->line_count * sizeof(ExeLine));
+        memcpy(exe->lines, asm_state->lines, asm_state->line_count * sizeof(ExeLine));
+        exe->line_count = (uint32_t)asm_state->line_count;
+        if (source_name && strcmp(source_name, "-") != 0) {
+            size_t length = strlen(source_name);
+            exe->source = (char*)malloc(length + 1);
+            memcpy(exe->source, source_name, length + 1);
+        }
+    }
+}
+
+// Assembling file in one pass ("-" reads stdin, so pipes work)
 bool asm_assemble_file(Assembler* asm_state, const char* input_file, const char* output_file) {
-    FILE* fp = fopen(input_file, "r");
-    if (!fp) {
-        fprintf(stderr, "Error: Cannot open input file %s\n", input_file);
+    AsmSource source;
+    if (!asm_load_source(&source, input_file)) {
         return false;
     }
-    
-    char line[MAX_LINE_LENGTH];
-    
-    // Pass 1: Collecting labels
-    printf("Pass 1: Collecting labels...\n");
-    asm_state->current_address = 0;
-    while (fgets(line, sizeof(line), fp)) {
-        asm_assemble_line(asm_state, line, 1);
-    }
-    
-    printf("Found %d labels\n", asm_state->label_count);
-    
-    // Pass 2: Generating code
-    printf("Pass 2: Generating code...\n");
-    fseek(fp, 0, SEEK_SET);
-    asm_state->current_address = 0;
-    
-    while (fgets(line, sizeof(line), fp)) {
-        asm_assemble_line(asm_state, line, 2);
-    }
-    
-    fclose(fp);
-    
-    // Writing output file
-    FILE* out = fopen(output_file, "wb");
+
+    // Emitting code and recording forward references
+    fprintf(asm_state->info, "Assembling (single pass)...\n");
+    bool ok = asm_assemble_source(asm_state, source.data, source.size);
+    asm_close_source(&source);
+
+    fprintf(asm_state->info, "Found %d labels, patched %d forward references\n",
+            asm_state->label_count, asm_state->fixup_count);
+    if (!ok) {
+        return false;
+    }
+    if (asm_state->relocatable) {
+        return asm_write_object(asm_state, output_file);
+    }
+    if (!asm_state->raw) {
+        Executable exe;
+        asm_build_executable(asm_state, input_file, &exe);
+        ok = exe_write(&exe, output_file);
+        if (ok) {
+            uint32_t words = 0;
+            for (uint32_t i = 0; i < exe.segment_count; i++) words += exe.segments[i].size;
+            fprintf(asm_state->info, "Assembly complete: %u words in %u segment(s), entry 0x%04X, "
+                    "%u symbols written to %s\n", words, exe.segment_count, exe.entry, exe.symbol_count,
+                    output_file);
+        }
+        exe_free(&exe);
+        return ok;
+    }
+
+    // Writing a flat image from address 0 ("-" writes stdout)
+    bool to_stdout = strcmp(output_file, "-") == 0;
+    FILE* out = to_stdout ? stdout : fopen(output_file, "wb");
     if (!out) {
         fprintf(stderr, "Error: Cannot open output file %s\n", output_file);
         return false;
     }
-    
-    fwrite(asm_state->output, sizeof(uint16_t), asm_state->output_size, out);
-    fclose(out);
-    
-    printf("Assembly complete: %d words written to %s\n", asm_state->output_size, output_file);
+
+    fwrite(asm_state->output, sizeof(uint16_t), asm_state->output_end, out);
+    if (to_stdout) {
+        fflush(out);
+    } else {
+        fclose(out);
+    }
+
+    fprintf(asm_state->info, "Assembly complete: %d words written to %s\n", asm_state->output_end, output_file);
     return true;
 }
@@ -1,28 +1,58 @@
 #ifndef ASSEMBLER_H
 #define ASSEMBLER_H
 
+#include "symtab.h"
+#include "macro.h"
+#include "../emulator/isa.h"
+#include "../emulator/executable.h"
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
-#define MAX_LABELS 256
-#define MAX_LINE_LENGTH 256
-#define MAX_TOKENS 10
+// Source text: a mapped file, or stdin read into memory. Not
+// NUL-terminated; tokens are slices of it.
+typedef struct {
+    const char* data;
+    size_t size;
+    bool mapped;
+} AsmSource;
 
-// Label structure
+// Label reference: a forward reference to patch once its label is
+// defined, or (relocatable mode) a word the linker must relocate
 typedef struct {
-    char name[64];
-    uint16_t address;
-} Label;
+    uint32_t symbol;            // Symbol id
+    int offset;                 // Output word to patch
+    int line;                   // Source position, for errors
+    int column;
+} Fixup;
+
+// Buffered output item (optimizing mode): code is collected per source,
+// rewritten by the peephole pass, then emitted
+typedef enum {
+    ITEM_INSN,                  // insn, rd, rs and extension value
+    ITEM_LABEL,                 // value = symbol id
+    ITEM_WORD,                  // .WORD/.STRING data word
+    ITEM_ORG,                   // value = address
+    ITEM_DELETED                // Removed by the optimizer
+} AsmItemKind;
 
-// Assembler state
 typedef struct {
-    Label labels[MAX_LABELS];
-    int label_count;
-    uint16_t current_address;
-    uint16_t* output;
-    int output_size;
-    int output_capacity;
-} Assembler;
+    const InsnInfo* insn;
+    uint32_t value;             // Extension or data word, or symbol id if symbolic
+    uint8_t kind;               // AsmItemKind
+    uint8_t rd;
+    uint8_t rs;
+    bool symbolic;
+    int line;                   // Source position, for errors and the rewrite list
+    int column;
+} AsmItem;
+
+// Address range written between two .ORG directives
+typedef struct {
+    int start;
+    int end;
+} AsmRun;
 
 // Token types
 typedef enum {
@@ -36,27 +66,98 @@ typedef enum {
     TOKEN_COMMA,
     TOKEN_LBRACKET,
     TOKEN_RBRACKET,
+    TOKEN_EXPRESSION,           // e.g. SIZE*2+1, or a run of tokens folded together
     TOKEN_UNKNOWN
 } TokenType;
 
-// Token structure
+// Token structure: (offset, length) slice of the source buffer.
+// Labels exclude the ':', strings exclude the quotes.
 typedef struct {
     TokenType type;
-    char value[128];
-    int num_value;
+    uint32_t offset;
+    uint32_t length;
+    int num_value;              // Register number or immediate value
 } Token;
 
+// Assembler state
+typedef struct {
+    SymbolTable symbols;
+    int label_count;
+    Fixup* fixups;
+    int fixup_count;
+    int fixup_capacity;
+    bool relocatable;           // Emit an object file (-c) instead of an executable
+    bool raw;                   // Emit a flat word image from address 0 (--raw)
+    bool strip;                 // Leave symbols and lines out of the executable (-s)
+    Fixup* relocs;              // Every label reference (relocatable mode only)
+    int reloc_count;
+    int reloc_capacity;
+    bool optimize;              // Buffer items and run the peephole pass (-O)
+    AsmItem* items;
+    int item_count;
+    int item_capacity;
+    const char* source;         // Buffer being assembled
+    size_t source_bytes;
+    int line;                   // Current source line
+    size_t line_start;          // Offset of current line (for columns)
+    Token* tokens;              // Tokens of the current line
+    int token_capacity;
+    MacroTable macros;
+    unsigned expansion_count;   // Numbers expansions for \@
+    int expanding;              // Nesting depth of macro/.REPT text being assembled
+    FILE* info;                 // Progress messages (stderr when output is stdout)
+    uint16_t current_address;
+    uint16_t* output;
+    int output_size;            // Output position (moved by .ORG)
+    int output_end;             // Highest output position reached
+    int output_capacity;
+    bool overflowed;            // Output ran past 0xFFFF (reported once)
+    AsmRun* runs;               // Ranges written, closed at each .ORG
+    int run_count;
+    int run_capacity;
+    int run_start;              // Start of the range being written
+    ExeLine* lines;             // Instruction address -> source line
+    int line_count;
+    int line_capacity;
+    bool has_entry;             // .ENTRY seen
+    AsmItem entry;              // .ENTRY value (symbol id until resolved)
+} Assembler;
+
+// Instruction operand (after grouping tokens)
+typedef enum {
+    OPERAND_REG,                // R1
+    OPERAND_VALUE,              // 42, 'c' or label
+    OPERAND_MEM,                // [addr] or [label]
+    OPERAND_MEM_REG,            // [R1]
+    OPERAND_MEM_OFF,            // [R1+offset] or [R1-offset]
+    OPERAND_MEM_INC,            // [R1]+
+    OPERAND_MEM_DEC             // -[R1]
+} OperandKind;
+
+typedef struct {
+    OperandKind kind;
+    Token token;                // Register, number, label or expression (the offset for MEM_OFF)
+    int base;                   // Base register of OPERAND_MEM_OFF
+} Operand;
+
+#define MAX_OPERANDS 3
+#define ASM_MAX_EXPANSION_DEPTH 64
+
 // Function prototypes
 void asm_init(Assembler* asm_state);
 void asm_free(Assembler* asm_state);
+bool asm_load_source(AsmSource* source, const char* input_file);
+void asm_close_source(AsmSource* source);
+bool asm_assemble_source(Assembler* asm_state, const char* data, size_t size);
 bool asm_assemble_file(Assembler* asm_state, const char* input_file, const char* output_file);
-bool asm_assemble_line(Assembler* asm_state, const char* line, int pass);
-void asm_add_label(Assembler* asm_state, const char* name, uint16_t address);
+void asm_build_executable(const Assembler* asm_state, const char* source_name, Executable* exe);
+bool asm_assemble_line(Assembler* asm_state, size_t start, size_t end);
+bool asm_add_label(Assembler* asm_state, const char* name, size_t length, uint16_t address);
 int asm_find_label(Assembler* asm_state, const char* name);
 void asm_emit_word(Assembler* asm_state, uint16_t word);
-int asm_tokenize(const char* line, Token tokens[], int max_tokens);
-int asm_parse_register(const char* str);
-int asm_parse_number(const char* str);
-uint16_t asm_encode_instruction(const char* mnemonic, Token operands[], int operand_count, Assembler* asm_state);
+int asm_tokenize(Assembler* asm_state, size_t start, size_t end);
+int asm_parse_register(const char* str, size_t length);
+int asm_parse_number(const char* str, size_t length);
+bool asm_assemble_instruction(Assembler* asm_state, const Token* mnemonic, Token tokens[], int token_count);
 
 #endif // ASSEMBLER_H
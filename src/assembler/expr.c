@@ -0,0 +1,220 @@
+#include "expr.h"
+#include <ctype.h>
+
+#define EXPR_MAX_DEPTH 64
+
+typedef struct {
+    const char* text;
+    size_t pos;
+    size_t length;
+    ExprLookup lookup;
+    void* context;
+    ExprError* error;
+    int depth;
+} ExprParser;
+
+static bool expr_ident_start(char c) {
+    return isalpha((unsigned char)c) || c == '_' || c == '.';
+}
+
+static bool expr_ident_char(char c) {
+    return isalnum((unsigned char)c) || c == '_' || c == '.';
+}
+
+bool expr_is_identifier(const char* text, size_t length) {
+    if (length == 0 || !expr_ident_start(text[0])) return false;
+    for (size_t i = 1; i < length; i++) {
+        if (!expr_ident_char(text[i])) return false;
+    }
+    return true;
+}
+
+static bool expr_fail(ExprParser* p, const char* message, size_t position, size_t length) {
+    if (!p->error->message) {
+        p->error->message = message;
+        p->error->position = position;
+        p->error->length = length;
+    }
+    return false;
+}
+
+static void expr_skip_space(ExprParser* p) {
+    while (p->pos < p->length && isspace((unsigned char)p->text[p->pos])) p->pos++;
+}
+
+// Matching an operator (two-character operators must be passed whole)
+static bool expr_accept(ExprParser* p, const char* op) {
+    expr_skip_space(p);
+    size_t n = op[1] ? 2 : 1;
+    if (p->pos + n > p->length || p->text[p->pos] != op[0] || (n == 2 && p->text[p->pos + 1] != op[1])) {
+        return false;
+    }
+    // '<' alone must not match the start of '<<'
+    if (n == 1 && (op[0] == '<' || op[0] == '>')) return false;
+    p->pos += n;
+    return true;
+}
+
+static bool expr_or(ExprParser* p, int32_t* value);
+
+static bool expr_number(ExprParser* p, int32_t* value) {
+    const char* s = p->text;
+    size_t start = p->pos;
+    uint32_t result = 0;
+    int base = 10;
+    if (s[p->pos] == '0' && p->pos + 1 < p->length && (s[p->pos + 1] == 'x' || s[p->pos + 1] == 'X')) {
+        base = 16;
+        p->pos += 2;
+    } else if (s[p->pos] == '0' && p->pos + 1 < p->length && (s[p->pos + 1] == 'b' || s[p->pos + 1] == 'B')) {
+        base = 2;
+        p->pos += 2;
+    }
+
+    size_t digits = p->pos;
+    while (p->pos < p->length && isxdigit((unsigned char)s[p->pos])) {
+        int c = tolower((unsigned char)s[p->pos]);
+        int digit = isdigit(c) ? c - '0' : c - 'a' + 10;
+        if (digit >= base) break;
+        result = result * base + digit;
+        p->pos++;
+    }
+    if (p->pos == digits || (p->pos < p->length && expr_ident_char(s[p->pos]))) {
+        return expr_fail(p, "Invalid number", start, p->pos - start + 1);
+    }
+    *value = (int32_t)result;
+    return true;
+}
+
+static bool expr_primary(ExprParser* p, int32_t* value) {
+    expr_skip_space(p);
+    if (p->pos >= p->length) {
+        return expr_fail(p, "Expected a value", p->pos, 0);
+    }
+
+    const char* s = p->text;
+    char c = s[p->pos];
+    if (c == '(') {
+        p->pos++;
+        if (++p->depth > EXPR_MAX_DEPTH) return expr_fail(p, "Expression nested too deeply", p->pos, 1);
+        if (!expr_or(p, value)) return false;
+        p->depth--;
+        if (!expr_accept(p, ")")) return expr_fail(p, "Expected ')'", p->pos, 1);
+        return true;
+    }
+    if (c == '\'') {
+        if (p->pos + 2 >= p->length || s[p->pos + 2] != '\'') {
+            return expr_fail(p, "Invalid character literal", p->pos, 1);
+        }
+        *value = (unsigned char)s[p->pos + 1];
+        p->pos += 3;
+        return true;
+    }
+    if (isdigit((unsigned char)c)) {
+        return expr_number(p, value);
+    }
+    if (expr_ident_start(c)) {
+        size_t start = p->pos;
+        while (p->pos < p->length && expr_ident_char(s[p->pos])) p->pos++;
+        if (!p->lookup(p->context, s + start, p->pos - start, value)) {
+            return expr_fail(p, "Undefined symbol", start, p->pos - start);
+        }
+        return true;
+    }
+    return expr_fail(p, "Unexpected character", p->pos, 1);
+}
+
+static bool expr_unary(ExprParser* p, int32_t* value) {
+    if (expr_accept(p, "-")) {
+        if (!expr_unary(p, value)) return false;
+        *value = -*value;
+        return true;
+    }
+    if (expr_accept(p, "~")) {
+        if (!expr_unary(p, value)) return false;
+        *value = ~*value;
+        return true;
+    }
+    if (expr_accept(p, "+")) {
+        return expr_unary(p, value);
+    }
+    return expr_primary(p, value);
+}
+
+static bool expr_product(ExprParser* p, int32_t* value) {
+    if (!expr_unary(p, value)) return false;
+    for (;;) {
+        char op = expr_accept(p, "*") ? '*' : expr_accept(p, "/") ? '/' : expr_accept(p, "%") ? '%' : 0;
+        if (!op) return true;
+        size_t at = p->pos;
+        int32_t rhs;
+        if (!expr_unary(p, &rhs)) return false;
+        if (op != '*' && rhs == 0) return expr_fail(p, "Division by zero", at, p->pos - at);
+        *value = op == '*' ? (int32_t)((uint32_t)*value * (uint32_t)rhs) : op == '/' ? *value / rhs : *value % rhs;
+    }
+}
+
+static bool expr_sum(ExprParser* p, int32_t* value) {
+    if (!expr_product(p, value)) return false;
+    for (;;) {
+        char op = expr_accept(p, "+") ? '+' : expr_accept(p, "-") ? '-' : 0;
+        if (!op) return true;
+        int32_t rhs;
+        if (!expr_product(p, &rhs)) return false;
+        *value = (int32_t)(op == '+' ? (uint32_t)*value + (uint32_t)rhs : (uint32_t)*value - (uint32_t)rhs);
+    }
+}
+
+static bool expr_shift(ExprParser* p, int32_t* value) {
+    if (!expr_sum(p, value)) return false;
+    for (;;) {
+        char op = expr_accept(p, "<<") ? '<' : expr_accept(p, ">>") ? '>' : 0;
+        if (!op) return true;
+        int32_t rhs;
+        if (!expr_sum(p, &rhs)) return false;
+        rhs &= 31;
+        *value = op == '<' ? (int32_t)((uint32_t)*value << rhs) : *value >> rhs;
+    }
+}
+
+static bool expr_and(ExprParser* p, int32_t* value) {
+    if (!expr_shift(p, value)) return false;
+    while (expr_accept(p, "&")) {
+        int32_t rhs;
+        if (!expr_shift(p, &rhs)) return false;
+        *value &= rhs;
+    }
+    return true;
+}
+
+static bool expr_xor(ExprParser* p, int32_t* value) {
+    if (!expr_and(p, value)) return false;
+    while (expr_accept(p, "^")) {
+        int32_t rhs;
+        if (!expr_and(p, &rhs)) return false;
+        *value ^= rhs;
+    }
+    return true;
+}
+
+static bool expr_or(ExprParser* p, int32_t* value) {
+    if (!expr_xor(p, value)) return false;
+    while (expr_accept(p, "|")) {
+        int32_t rhs;
+        if (!expr_xor(p, &rhs)) return false;
+        *value |= rhs;
+    }
+    return true;
+}
+
+// Evaluating text[0, length) (false with *error set on failure)
+bool expr_eval(const char* text, size_t length, ExprLookup lookup, void* context,
+               int32_t* value, ExprError* error) {
+    ExprParser parser = { text, 0, length, lookup, context, error, 0 };
+    error->message = NULL;
+    if (!expr_or(&parser, value)) return false;
+    expr_skip_space(&parser);
+    if (parser.pos < length) {
+        return expr_fail(&parser, "Unexpected text in expression", parser.pos, length - parser.pos);
+    }
+    return true;
+}
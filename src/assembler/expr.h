@@ -0,0 +1,26 @@
+#ifndef EXPR_H
+#define EXPR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Constant expressions (.EQU, .REPT, .ORG and operands).
+// Operators in C precedence: | ^ & << >> + - * / % and unary - + ~,
+// with parentheses. Numbers are decimal, 0x hex, 0b binary or 'c';
+// identifiers are resolved through the caller's lookup. Arithmetic is
+// 32-bit; callers truncate to 16 bits.
+
+typedef bool (*ExprLookup)(void* context, const char* name, size_t length, int32_t* value);
+
+typedef struct {
+    const char* message;
+    size_t position;            // Offset of the offending text
+    size_t length;
+} ExprError;
+
+bool expr_eval(const char* text, size_t length, ExprLookup lookup, void* context,
+               int32_t* value, ExprError* error);
+bool expr_is_identifier(const char* text, size_t length);
+
+#endif // EXPR_H
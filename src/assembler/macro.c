@@ -0,0 +1,98 @@
+#include "macro.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void macro_init(MacroTable* table) {
+    symtab_init(&table->names);
+    table->macros = NULL;
+    table->capacity = 0;
+}
+
+static void macro_clear(Macro* macro) {
+    free(macro->body);
+    for (int i = 0; i < macro->param_count; i++) {
+        free(macro->params[i]);
+    }
+    memset(macro, 0, sizeof(Macro));
+}
+
+void macro_free(MacroTable* table) {
+    for (uint32_t id = 0; id < table->names.count && table->macros; id++) {
+        macro_clear(&table->macros[id]);
+    }
+    free(table->macros);
+    table->macros = NULL;
+    table->capacity = 0;
+    symtab_free(&table->names);
+}
+
+Macro* macro_find(const MacroTable* table, const char* name, size_t length) {
+    if (table->names.count == 0) return NULL;
+    const Symbol* symbol = symtab_lookup(&table->names, name, length);
+    return symbol && table->macros[symbol->id].defined ? &table->macros[symbol->id] : NULL;
+}
+
+// Creating (or replacing) the macro called name
+Macro* macro_define(MacroTable* table, const char* name, size_t length) {
+    uint32_t id = symtab_intern(&table->names, name, length)->id;
+    if (id >= table->capacity) {
+        uint32_t capacity = table->capacity ? table->capacity * 2 : 64;
+        table->macros = (Macro*)realloc(table->macros, capacity * sizeof(Macro));
+        memset(table->macros + table->capacity, 0, (capacity - table->capacity) * sizeof(Macro));
+        table->capacity = capacity;
+    }
+    Macro* macro = &table->macros[id];
+    macro_clear(macro);
+    return macro;
+}
+
+static void macro_append(MacroText* out, const char* text, size_t length) {
+    if (out->size + length > out->capacity) {
+        size_t capacity = out->capacity ? out->capacity : 256;
+        while (capacity < out->size + length) capacity *= 2;
+        out->data = (char*)realloc(out->data, capacity);
+        out->capacity = capacity;
+    }
+    memcpy(out->data + out->size, text, length);
+    out->size += length;
+}
+
+bool macro_substitute(const Macro* macro, const char* body, size_t size, const MacroArg args[],
+                      unsigned counter, MacroText* out, const char** bad, size_t* bad_length) {
+    size_t copied = 0;
+    const char* slash;
+    while ((slash = (const char*)memchr(body + copied, '\\', size - copied)) != NULL) {
+        size_t at = (size_t)(slash - body);
+        macro_append(out, body + copied, at - copied);
+
+        if (at + 1 < size && body[at + 1] == '@') {
+            char number[16];
+            int n = snprintf(number, sizeof(number), "%u", counter);
+            macro_append(out, number, (size_t)n);
+            copied = at + 2;
+            continue;
+        }
+
+        size_t end = at + 1;
+        while (end < size && (isalnum((unsigned char)body[end]) || body[end] == '_')) end++;
+        int param = -1;
+        for (int i = 0; macro && i < macro->param_count; i++) {
+            if (macro->param_lengths[i] == end - at - 1 &&
+                memcmp(macro->params[i], body + at + 1, end - at - 1) == 0) {
+                param = i;
+                break;
+            }
+        }
+        if (param < 0) {
+            *bad = slash;
+            *bad_length = end - at;
+            return false;
+        }
+        macro_append(out, args[param].text, args[param].length);
+        copied = end;
+    }
+    macro_append(out, body + copied, size - copied);
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef MACRO_H
+#define MACRO_H
+
+#include "symtab.h"
+#include <stddef.h>
+#include <stdbool.h>
+
+// Assembler macros (.MACRO name p1, p2 ... .ENDM).
+// A body is stored as text and expanded by substitution: \name becomes
+// the argument for parameter name and \@ a number unique to the
+// expansion, so "loop\@:" gives each expansion its own local label.
+// Names are kept in a SymbolTable; macros are indexed by symbol id.
+
+#define MACRO_MAX_PARAMS 16
+
+typedef struct {
+    char* body;
+    size_t body_size;
+    int param_count;
+    char* params[MACRO_MAX_PARAMS];
+    size_t param_lengths[MACRO_MAX_PARAMS];
+    bool defined;
+} Macro;
+
+typedef struct {
+    SymbolTable names;
+    Macro* macros;              // By symbol id in names
+    uint32_t capacity;
+} MacroTable;
+
+// Argument text (a slice of the invoking line)
+typedef struct {
+    const char* text;
+    size_t length;
+} MacroArg;
+
+// Growable expansion buffer
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+} MacroText;
+
+void macro_init(MacroTable* table);
+void macro_free(MacroTable* table);
+Macro* macro_find(const MacroTable* table, const char* name, size_t length);
+Macro* macro_define(MacroTable* table, const char* name, size_t length);
+
+// Appending body with \param and \@ replaced to out. On an unknown
+// \name, returns false with *bad pointing at it in body.
+bool macro_substitute(const Macro* macro, const char* body, size_t size, const MacroArg args[],
+                      unsigned counter, MacroText* out, const char** bad, size_t* bad_length);
+
+#endif // MACRO_H
@@ -1,13 +1,27 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "assembler.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 void print_usage(const char* program_name) {
     printf("SimpleCPU16 Assembler\n");
-    printf("Usage: %s <input.asm> -o <output.bin>\n", program_name);
-    printf("  <input.asm>   Assembly source file\n");
-    printf("  -o <output>   Output binary file\n");
+    printf("Usage: %s <input.asm> -o <output.bin> [options]\n", program_name);
+    printf("  <input.asm>   Assembly source file (\"-\" for stdin)\n");
+    printf("  -o <output>   Output executable file (\"-\" for stdout)\n");
+    printf("  -c            Write a relocatable object (for the linker)\n");
+    printf("  -s, --strip   Leave the symbol and line tables out of the executable\n");
+    printf("  --raw         Write a flat word image from address 0 instead of an executable\n");
+    printf("  -O            Run the peephole optimizer and list its rewrites\n");
+    printf("  --stats       Report assembly throughput\n");
+}
+
+static double asm_now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
 }
 
 int main(int argc, char* argv[]) {
@@ -18,11 +32,26 @@ int main(int argc, char* argv[]) {
     
     const char* input_file = argv[1];
     const char* output_file = NULL;
+    bool stats = false;
+    bool relocatable = false;
+    bool optimize = false;
+    bool raw = false;
+    bool strip = false;
     
     // Parsing command-line arguments
     for (int i = 2; i < argc; i++) {
         if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
             output_file = argv[++i];
+        } else if (strcmp(argv[i], "-c") == 0) {
+            relocatable = true;
+        } else if (strcmp(argv[i], "-O") == 0) {
+            optimize = true;
+        } else if (strcmp(argv[i], "--raw") == 0) {
+            raw = true;
+        } else if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--strip") == 0) {
+            strip = true;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats = true;
         }
     }
     
@@ -32,20 +61,43 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    printf("SimpleCPU16 Assembler v1.0\n");
-    printf("===========================\n\n");
-    printf("Input:  %s\n", input_file);
-    printf("Output: %s\n\n", output_file);
+    if (relocatable && strcmp(output_file, "-") == 0) {
+        fprintf(stderr, "Error: Object files cannot be written to stdout\n");
+        return 1;
+    }
     
     Assembler asm_state;
     asm_init(&asm_state);
+    asm_state.relocatable = relocatable;
+    asm_state.optimize = optimize;
+    asm_state.raw = raw;
+    asm_state.strip = strip;
+
+    // Keeping stdout clean for the binary when writing to a pipe
+    if (strcmp(output_file, "-") == 0) {
+        asm_state.info = stderr;
+    }
+
+    fprintf(asm_state.info, "SimpleCPU16 Assembler v1.0\n");
+    fprintf(asm_state.info, "===========================\n\n");
+    fprintf(asm_state.info, "Input:  %s\n", input_file);
+    fprintf(asm_state.info, "Output: %s\n\n", output_file);
     
+    double start = asm_now_seconds();
     bool success = asm_assemble_file(&asm_state, input_file, output_file);
+    double elapsed = asm_now_seconds() - start;
+    FILE* info = asm_state.info;
+
+    if (stats && elapsed > 0) {
+        double mb = asm_state.source_bytes / (1024.0 * 1024.0);
+        fprintf(info, "Stats: %d lines, %.2f MB in %.2f ms (%.1f MB/s, %.0f lines/s)\n",
+                asm_state.line, mb, elapsed * 1e3, mb / elapsed, asm_state.line / elapsed);
+    }
     
     asm_free(&asm_state);
     
     if (success) {
-        printf("\nAssembly successful!\n");
+        fprintf(info, "\nAssembly successful!\n");
         return 0;
     } else {
         fprintf(stderr, "\nAssembly failed!\n");
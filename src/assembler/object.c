@@ -0,0 +1,169 @@
+#include "object.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char OBJ_MAGIC[8] = { 'S', 'C', '1', '6', 'O', 'B', 'J', '\0' };
+
+#define OBJ_HEADER_SIZE 24
+
+static void object_put16(uint8_t* buf, uint16_t value) {
+    buf[0] = value & 0xFF;
+    buf[1] = value >> 8;
+}
+
+static void object_put32(uint8_t* buf, uint32_t value) {
+    object_put16(buf, value & 0xFFFF);
+    object_put16(buf + 2, value >> 16);
+}
+
+static uint16_t object_get16(const uint8_t* buf) {
+    return (uint16_t)(buf[0] | (buf[1] << 8));
+}
+
+static uint32_t object_get32(const uint8_t* buf) {
+    return object_get16(buf) | ((uint32_t)object_get16(buf + 2) << 16);
+}
+
+// Writing an object file (serialized into one buffer, written at once)
+bool object_write(const ObjectFile* object, const char* filename) {
+    size_t size = OBJ_HEADER_SIZE + object->code_size * 2 + object->reloc_count * 8;
+    for (uint32_t i = 0; i < object->symbol_count; i++) {
+        size += 6 + strlen(object->symbols[i].name);
+    }
+
+    uint8_t* buf = (uint8_t*)malloc(size);
+    if (!buf) {
+        fprintf(stderr, "Error: Out of memory writing object %s\n", filename);
+        return false;
+    }
+
+    memcpy(buf, OBJ_MAGIC, sizeof(OBJ_MAGIC));
+    object_put16(buf + 8, OBJ_VERSION);
+    object_put16(buf + 10, 0);
+    object_put32(buf + 12, object->code_size);
+    object_put32(buf + 16, object->symbol_count);
+    object_put32(buf + 20, object->reloc_count);
+    uint8_t* p = buf + OBJ_HEADER_SIZE;
+
+    for (uint32_t i = 0; i < object->code_size; i++, p += 2) {
+        object_put16(p, object->code[i]);
+    }
+    for (uint32_t i = 0; i < object->symbol_count; i++) {
+        const ObjSymbol* symbol = &object->symbols[i];
+        uint16_t length = (uint16_t)strlen(symbol->name);
+        p[0] = symbol->binding;
+        p[1] = 0;
+        object_put16(p + 2, symbol->value);
+        object_put16(p + 4, length);
+        memcpy(p + 6, symbol->name, length);
+        p += 6 + length;
+    }
+    for (uint32_t i = 0; i < object->reloc_count; i++, p += 8) {
+        object_put32(p, object->relocs[i].offset);
+        object_put32(p + 4, object->relocs[i].symbol);
+    }
+
+    FILE* fp = fopen(filename, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open object file %s for writing\n", filename);
+        free(buf);
+        return false;
+    }
+    bool ok = fwrite(buf, 1, size, fp) == size;
+    ok = fclose(fp) == 0 && ok;
+    free(buf);
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to write object file %s\n", filename);
+    }
+    return ok;
+}
+
+// Parsing an object file image (false if truncated or inconsistent)
+static bool object_parse(const uint8_t* buf, size_t size, ObjectFile* object) {
+    object->code_size = object_get32(buf + 12);
+    object->symbol_count = object_get32(buf + 16);
+    object->reloc_count = object_get32(buf + 20);
+    const uint8_t* p = buf + OBJ_HEADER_SIZE;
+    const uint8_t* end = buf + size;
+
+    if (object->code_size > 0x10000 || (size_t)(end - p) / 2 < object->code_size) return false;
+    object->code = (uint16_t*)malloc((object->code_size + 1) * sizeof(uint16_t));
+    for (uint32_t i = 0; i < object->code_size; i++, p += 2) {
+        object->code[i] = object_get16(p);
+    }
+
+    if ((size_t)(end - p) / 6 < object->symbol_count) return false;
+    object->symbols = (ObjSymbol*)calloc(object->symbol_count + 1, sizeof(ObjSymbol));
+    for (uint32_t i = 0; i < object->symbol_count; i++) {
+        if (end - p < 6) return false;
+        ObjSymbol* symbol = &object->symbols[i];
+        uint16_t length = object_get16(p + 4);
+        if (p[0] > OBJ_SYM_IMPORT || end - p - 6 < length) return false;
+        symbol->binding = p[0];
+        symbol->value = object_get16(p + 2);
+        symbol->name = (char*)malloc(length + 1);
+        memcpy(symbol->name, p + 6, length);
+        symbol->name[length] = '\0';
+        p += 6 + length;
+    }
+
+    if ((size_t)(end - p) / 8 != object->reloc_count) return false;
+    object->relocs = (ObjReloc*)malloc((object->reloc_count + 1) * sizeof(ObjReloc));
+    for (uint32_t i = 0; i < object->reloc_count; i++, p += 8) {
+        ObjReloc* reloc = &object->relocs[i];
+        reloc->offset = object_get32(p);
+        reloc->symbol = object_get32(p + 4);
+        if (reloc->offset >= object->code_size ||
+            (reloc->symbol != OBJ_RELOC_SECTION && reloc->symbol >= object->symbol_count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reading an object file
+bool object_read(const char* filename, ObjectFile* object) {
+    memset(object, 0, sizeof(ObjectFile));
+    FILE* fp = fopen(filename, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open object file %s\n", filename);
+        return false;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t* buf = size > 0 ? (uint8_t*)malloc(size) : NULL;
+    bool ok = buf && fread(buf, 1, size, fp) == (size_t)size;
+    fclose(fp);
+
+    if (!ok || size < OBJ_HEADER_SIZE || memcmp(buf, OBJ_MAGIC, sizeof(OBJ_MAGIC)) != 0) {
+        fprintf(stderr, "Error: %s is not an object file\n", filename);
+        free(buf);
+        return false;
+    }
+    if (object_get16(buf + 8) != OBJ_VERSION) {
+        fprintf(stderr, "Error: Unsupported object file version %d in %s\n", object_get16(buf + 8), filename);
+        free(buf);
+        return false;
+    }
+
+    ok = object_parse(buf, (size_t)size, object);
+    free(buf);
+    if (!ok) {
+        fprintf(stderr, "Error: Object file %s is truncated or corrupt\n", filename);
+        object_free(object);
+    }
+    return ok;
+}
+
+void object_free(ObjectFile* object) {
+    for (uint32_t i = 0; object->symbols && i < object->symbol_count; i++) {
+        free(object->symbols[i].name);
+    }
+    free(object->code);
+    free(object->symbols);
+    free(object->relocs);
+    memset(object, 0, sizeof(ObjectFile));
+}
@@ -0,0 +1,52 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Relocatable object files (assembler -c, read by the linker).
+// An object holds one section of code and data assembled at address 0,
+// the symbols it exports (.global) and imports (.extern), and one
+// relocation per word that holds an address: the linker adds either the
+// section's load address or the resolved address of an imported symbol.
+//
+// File layout (little-endian):
+//   "SC16OBJ\0", u16 version, u16 reserved,
+//   u32 code words, u32 symbols, u32 relocations
+//   code:        u16 per word
+//   symbols:     u8 binding, u8 reserved, u16 value, u16 name length, name
+//   relocations: u32 offset, u32 symbol index (OBJ_RELOC_SECTION = section)
+
+#define OBJ_VERSION 1
+#define OBJ_RELOC_SECTION 0xFFFFFFFFu
+
+typedef enum {
+    OBJ_SYM_EXPORT,             // Defined here at value (section offset)
+    OBJ_SYM_IMPORT              // Defined by another object
+} ObjBinding;
+
+typedef struct {
+    char* name;
+    uint16_t value;
+    uint8_t binding;            // ObjBinding
+} ObjSymbol;
+
+typedef struct {
+    uint32_t offset;            // Code word to patch
+    uint32_t symbol;            // Index in symbols, or OBJ_RELOC_SECTION
+} ObjReloc;
+
+typedef struct {
+    uint16_t* code;
+    uint32_t code_size;
+    ObjSymbol* symbols;
+    uint32_t symbol_count;
+    ObjReloc* relocs;
+    uint32_t reloc_count;
+} ObjectFile;
+
+bool object_write(const ObjectFile* object, const char* filename);
+bool object_read(const char* filename, ObjectFile* object);
+void object_free(ObjectFile* object);
+
+#endif // OBJECT_H
@@ -0,0 +1,327 @@
+#include "peephole.h"
+#include "../emulator/cpu.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Liveness bits: R0-R7, then the flags
+#define PH_FLAG_C  (1u << 8)
+#define PH_FLAG_ZN (1u << 9)
+#define PH_REG(r)  (1u << (r))
+
+#define PH_MAX_HOPS 16
+
+static const InsnInfo* peephole_insn(const char* name) {
+    return isa_lookup(name, strlen(name));
+}
+
+static bool peephole_is(const AsmItem* item, uint8_t opcode, uint8_t sub) {
+    return item->kind == ITEM_INSN && item->insn->opcode == opcode &&
+           (sub == ISA_NOSUB || item->insn->sub == sub);
+}
+
+// Ending straight-line code: control leaves or may not come back
+static bool peephole_is_transfer(const AsmItem* item) {
+    uint8_t op = item->insn->opcode;
+    return op == OP_BRANCH || op == OP_JUMP || op == OP_CALL || op == OP_RET || op == OP_HALT;
+}
+
+// Register and flag reads and writes of a straight-line instruction
+static void peephole_effects(const AsmItem* item, uint32_t* reads, uint32_t* writes) {
+    uint32_t rd = PH_REG(item->rd), rs = PH_REG(item->rs);
+    uint8_t sub = item->insn->sub;
+    *reads = 0;
+    *writes = 0;
+    switch (item->insn->opcode) {
+        case OP_MOVE:
+            *reads = rs;
+            *writes = rd;
+            break;
+        case OP_LOAD:
+            *reads = sub == LOAD_IND || sub == LOAD_OFF ? rs : 0;
+            *writes = rd;
+            if (sub == LOAD_POSTINC || sub == LOAD_PREDEC) {
+                *reads = rs;
+                *writes |= rs;
+            }
+            break;
+        case OP_STORE:
+            *reads = sub == STORE_DIR ? rs : rd | rs;
+            if (sub == STORE_POSTINC || sub == STORE_PREDEC) *writes = rd;
+            break;
+        case OP_ARITH:
+            *reads = rd;
+            if (item->insn->shape == SHAPE_RD_RS) *reads |= rs;
+            *writes = rd | PH_FLAG_ZN;
+            if (sub != ARITH_INC && sub != ARITH_DEC && sub != ARITH_DIV) *writes |= PH_FLAG_C;
+            break;
+        case OP_LOGIC:
+        case OP_SHIFT:
+            *reads = item->insn->shape == SHAPE_RD_RS ? rd | rs : rd;
+            *writes = rd | PH_FLAG_ZN;
+            break;
+        case OP_CMP:
+            *reads = rd | rs;
+            *writes = PH_FLAG_C | PH_FLAG_ZN;
+            break;
+        case OP_SPEC:
+            *reads = sub == SPEC_BFZ ? rs : item->insn->shape == SHAPE_RD_RS ? rd | rs : rd;
+            *writes = rd | PH_FLAG_ZN;
+            if (sub == SPEC_BADDS || sub == SPEC_BSUBS || sub == SPEC_BFZ) *writes |= PH_FLAG_C;
+            break;
+        case OP_STACK:
+            *reads = PH_REG(REG_SP) | (sub == STACK_PUSH ? rs : 0);
+            *writes = PH_REG(REG_SP) | (sub == STACK_POP ? rd : 0);
+            if (sub == STACK_PUSHM) *reads |= item->value & STACK_MASK_REGS;
+            if (sub == STACK_POPM) *writes |= item->value & STACK_MASK_REGS;
+            break;
+        default:
+            break;
+    }
+}
+
+static int peephole_next(const Assembler* asm_state, int i) {
+    for (i++; i < asm_state->item_count; i++) {
+        if (asm_state->items[i].kind != ITEM_DELETED) return i;
+    }
+    return -1;
+}
+
+// Checking that everything in mask is overwritten after item i before
+// any read, within the same straight-line run (false when unsure)
+static bool peephole_dead(const Assembler* asm_state, int i, uint32_t mask) {
+    for (i = peephole_next(asm_state, i); i >= 0; i = peephole_next(asm_state, i)) {
+        const AsmItem* item = &asm_state->items[i];
+        if (item->kind != ITEM_INSN || peephole_is_transfer(item)) return false;
+        uint32_t reads, writes;
+        peephole_effects(item, &reads, &writes);
+        if (reads & mask) return false;
+        mask &= ~writes;
+        if (mask == 0) return true;
+    }
+    return false;
+}
+
+// Formatting an item as source text (labels by name)
+static void peephole_format(const Assembler* asm_state, const AsmItem* item, char* buf, size_t size) {
+    const InsnInfo* insn = item->insn;
+    char ext[48];
+    if (item->symbolic) {
+        snprintf(ext, sizeof(ext), "%.40s", symtab_at(&asm_state->symbols, item->value)->name);
+    } else {
+        snprintf(ext, sizeof(ext), "%u", item->value);
+    }
+    switch (insn->shape) {
+        case SHAPE_RD:     snprintf(buf, size, "%s R%d", insn->name, item->rd); break;
+        case SHAPE_RS:     snprintf(buf, size, "%s R%d", insn->name, item->rs); break;
+        case SHAPE_RD_RS:  snprintf(buf, size, "%s R%d, R%d", insn->name, item->rd, item->rs); break;
+        case SHAPE_RD_IMM: snprintf(buf, size, "%s R%d, %s", insn->name, item->rd, ext); break;
+        case SHAPE_RD_MEM: snprintf(buf, size, "%s R%d, [%s]", insn->name, item->rd, ext); break;
+        case SHAPE_RD_IND: snprintf(buf, size, "%s R%d, [R%d]", insn->name, item->rd, item->rs); break;
+        case SHAPE_MEM_RS: snprintf(buf, size, "%s [%s], R%d", insn->name, ext, item->rs); break;
+        case SHAPE_IND_RS: snprintf(buf, size, "%s [R%d], R%d", insn->name, item->rd, item->rs); break;
+        case SHAPE_RD_OFF: snprintf(buf, size, "%s R%d, [R%d+%s]", insn->name, item->rd, item->rs, ext); break;
+        case SHAPE_OFF_RS: snprintf(buf, size, "%s [R%d+%s], R%d", insn->name, item->rd, ext, item->rs); break;
+        case SHAPE_RD_INC: snprintf(buf, size, "%s R%d, [R%d]+", insn->name, item->rd, item->rs); break;
+        case SHAPE_RD_DEC: snprintf(buf, size, "%s R%d, -[R%d]", insn->name, item->rd, item->rs); break;
+        case SHAPE_INC_RS: snprintf(buf, size, "%s [R%d]+, R%d", insn->name, item->rd, item->rs); break;
+        case SHAPE_DEC_RS: snprintf(buf, size, "%s -[R%d], R%d", insn->name, item->rd, item->rs); break;
+        case SHAPE_TARGET: snprintf(buf, size, "%s %s", insn->name, ext); break;
+        case SHAPE_REGLIST:
+            isa_format_reglist((uint16_t)item->value, ext, sizeof(ext));
+            snprintf(buf, size, "%s %s", insn->name, ext);
+            break;
+        default:           snprintf(buf, size, "%s", insn->name); break;
+    }
+}
+
+// Listing one rewrite: before (one or two items) -> after (NULL = removed)
+static void peephole_log(const Assembler* asm_state, const AsmItem* first, const AsmItem* second,
+                         const AsmItem* after) {
+    char a[96], b[96], c[96];
+    peephole_format(asm_state, first, a, sizeof(a));
+    b[0] = '\0';
+    if (second) {
+        peephole_format(asm_state, second, b, sizeof(b));
+    }
+    if (after) {
+        peephole_format(asm_state, after, c, sizeof(c));
+    }
+    fprintf(asm_state->info, "  line %d: %s%s%s -> %s\n", first->line, a, second ? "; " : "", b,
+            after ? c : "(removed)");
+}
+
+// Finding the first instruction at a label (-1 if data, .ORG or none)
+static int peephole_label_insn(const Assembler* asm_state, const int* label_at, uint32_t symbol) {
+    if (symbol >= asm_state->symbols.count || label_at[symbol] < 0) return -1;
+    for (int i = label_at[symbol]; i >= 0; i = peephole_next(asm_state, i)) {
+        const AsmItem* item = &asm_state->items[i];
+        if (item->kind == ITEM_INSN) return i;
+        if (item->kind != ITEM_LABEL) return -1;
+    }
+    return -1;
+}
+
+// Following a chain of label: JMP label2 (-1 if it loops)
+static int peephole_thread(const Assembler* asm_state, const int* label_at, uint32_t target) {
+    uint32_t seen[PH_MAX_HOPS];
+    for (int hops = 0; hops < PH_MAX_HOPS; hops++) {
+        seen[hops] = target;
+        int j = peephole_label_insn(asm_state, label_at, target);
+        if (j < 0) return (int)target;
+        const AsmItem* next = &asm_state->items[j];
+        if (!peephole_is(next, OP_JUMP, ISA_NOSUB) || !next->symbolic) return (int)target;
+        target = next->value;
+        for (int k = 0; k <= hops; k++) {
+            if (seen[k] == target) return -1;
+        }
+    }
+    return (int)target;
+}
+
+// Checking whether target labels the code right after item i
+static bool peephole_falls_to(const Assembler* asm_state, int i, uint32_t target) {
+    for (i = peephole_next(asm_state, i); i >= 0; i = peephole_next(asm_state, i)) {
+        const AsmItem* item = &asm_state->items[i];
+        if (item->kind != ITEM_LABEL) return false;
+        if (item->value == target) return true;
+    }
+    return false;
+}
+
+// Trying every rule at item i (returns true if something changed)
+static bool peephole_rewrite(Assembler* asm_state, const int* label_at, int i) {
+    AsmItem* item = &asm_state->items[i];
+    int n = peephole_next(asm_state, i);
+    AsmItem* next = n >= 0 && asm_state->items[n].kind == ITEM_INSN ? &asm_state->items[n] : NULL;
+    AsmItem after;
+
+    // MOV Rx, Rx
+    if (peephole_is(item, OP_MOVE, ISA_NOSUB) && item->rd == item->rs) {
+        peephole_log(asm_state, item, NULL, NULL);
+        item->kind = ITEM_DELETED;
+        return true;
+    }
+
+    // MOV Ra, Rb; MOV Rb, Ra: the second copies the value back
+    if (peephole_is(item, OP_MOVE, ISA_NOSUB) && next && peephole_is(next, OP_MOVE, ISA_NOSUB) &&
+        next->rd == item->rs && next->rs == item->rd) {
+        peephole_log(asm_state, item, next, item);
+        next->kind = ITEM_DELETED;
+        return true;
+    }
+
+    // PUSH Rx; POP Ry (SP itself changes value when pushed or popped)
+    if (peephole_is(item, OP_STACK, STACK_PUSH) && next && peephole_is(next, OP_STACK, STACK_POP) &&
+        item->rs != REG_SP && next->rd != REG_SP) {
+        if (item->rs == next->rd) {
+            peephole_log(asm_state, item, next, NULL);
+            item->kind = ITEM_DELETED;
+        } else {
+            after = *item;
+            after.insn = peephole_insn("MOV");
+            after.rd = next->rd;
+            after.rs = item->rs;
+            peephole_log(asm_state, item, next, &after);
+            *item = after;
+        }
+        next->kind = ITEM_DELETED;
+        return true;
+    }
+
+    // LDI Rx, 1; ADD/SUB Ry, Rx -> INC/DEC Ry when Rx and C are not needed
+    if (peephole_is(item, OP_LOAD, LOAD_IMM) && !item->symbolic && item->value == 1 && next &&
+        (peephole_is(next, OP_ARITH, ARITH_ADD) || peephole_is(next, OP_ARITH, ARITH_SUB)) &&
+        next->rs == item->rd && next->rd != item->rd &&
+        peephole_dead(asm_state, n, PH_REG(item->rd) | PH_FLAG_C)) {
+        after = *next;
+        after.insn = peephole_insn(next->insn->sub == ARITH_ADD ? "INC" : "DEC");
+        after.rs = 0;
+        peephole_log(asm_state, item, next, &after);
+        *next = after;
+        item->kind = ITEM_DELETED;
+        return true;
+    }
+
+    // ADDI/SUBI Ry, 1 -> INC/DEC Ry when C is not needed
+    if ((peephole_is(item, OP_ARITH, ARITH_ADDI) || peephole_is(item, OP_ARITH, ARITH_SUBI)) &&
+        !item->symbolic && item->value == 1 && peephole_dead(asm_state, i, PH_FLAG_C)) {
+        after = *item;
+        after.insn = peephole_insn(item->insn->sub == ARITH_ADDI ? "INC" : "DEC");
+        after.value = 0;
+        peephole_log(asm_state, item, NULL, &after);
+        *item = after;
+        return true;
+    }
+
+    bool jump = peephole_is(item, OP_JUMP, ISA_NOSUB);
+    bool branch = peephole_is(item, OP_BRANCH, ISA_NOSUB);
+    if ((jump || branch || peephole_is(item, OP_CALL, ISA_NOSUB)) && item->symbolic) {
+        // Branching to the next instruction
+        if (!peephole_is(item, OP_CALL, ISA_NOSUB) && peephole_falls_to(asm_state, i, item->value)) {
+            peephole_log(asm_state, item, NULL, NULL);
+            item->kind = ITEM_DELETED;
+            return true;
+        }
+
+        // Branching to a JMP: go straight to its target
+        int target = peephole_thread(asm_state, label_at, item->value);
+        if (target >= 0 && (uint32_t)target != item->value) {
+            after = *item;
+            after.value = (uint32_t)target;
+            peephole_log(asm_state, item, NULL, &after);
+            *item = after;
+            return true;
+        }
+    }
+
+    // Unreachable code after HALT, JMP or RET, up to the next label or data
+    if ((jump || peephole_is(item, OP_HALT, ISA_NOSUB) || peephole_is(item, OP_RET, ISA_NOSUB)) && next) {
+        peephole_log(asm_state, next, NULL, NULL);
+        next->kind = ITEM_DELETED;
+        return true;
+    }
+    return false;
+}
+
+static int peephole_words(const Assembler* asm_state) {
+    int words = 0;
+    for (int i = 0; i < asm_state->item_count; i++) {
+        if (asm_state->items[i].kind == ITEM_INSN) words += asm_state->items[i].insn->length;
+    }
+    return words;
+}
+
+int peephole_optimize(Assembler* asm_state) {
+    // Indexing label items by symbol id
+    uint32_t symbol_count = asm_state->symbols.count;
+    int* label_at = (int*)malloc((symbol_count + 1) * sizeof(int));
+    for (uint32_t id = 0; id < symbol_count; id++) {
+        label_at[id] = -1;
+    }
+    for (int i = 0; i < asm_state->item_count; i++) {
+        const AsmItem* item = &asm_state->items[i];
+        if (item->kind == ITEM_LABEL && label_at[item->value] < 0) label_at[item->value] = i;
+    }
+
+    fprintf(asm_state->info, "Peephole pass:\n");
+    int words = peephole_words(asm_state);
+    int rewrites = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < asm_state->item_count; i++) {
+            if (asm_state->items[i].kind != ITEM_INSN) continue;
+            if (peephole_rewrite(asm_state, label_at, i)) {
+                changed = true;
+                rewrites++;
+                i--;  // Retrying the rewritten item
+            }
+        }
+    }
+    free(label_at);
+
+    fprintf(asm_state->info, "Peephole: %d rewrite(s), %d word(s) saved\n", rewrites,
+            words - peephole_words(asm_state));
+    return rewrites;
+}
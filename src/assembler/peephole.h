@@ -0,0 +1,24 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "assembler.h"
+
+// Peephole optimizer over the buffered items of one source (assembler -O).
+// Rewrites never cross a label, so every label still marks the same
+// instruction, and they only drop a flag or register write when a later
+// instruction in the same straight-line run overwrites it before any
+// read. Rewrites:
+//   LDI Rx, 1 + ADD/SUB Ry, Rx  -> INC/DEC Ry   (Rx and C dead)
+//   ADDI/SUBI Ry, 1             -> INC/DEC Ry   (C dead)
+//   MOV Rx, Rx                  -> removed
+//   MOV Ra, Rb + MOV Rb, Ra     -> MOV Ra, Rb
+//   PUSH Rx + POP Ry            -> MOV Ry, Rx, or removed when x == y
+//   branch/JMP/CALL to JMP L    -> branch/JMP/CALL to L
+//   branch/JMP to next address  -> removed
+//   code after HALT/JMP/RET up to the next label or data -> removed
+// Each rewrite is listed on asm_state->info. Numeric (non-label) code
+// addresses are not adjusted when code shrinks.
+
+int peephole_optimize(Assembler* asm_state);
+
+#endif // PEEPHOLE_H
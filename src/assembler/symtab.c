@@ -0,0 +1,120 @@
+#include "symtab.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// FNV-1a over the name bytes
+static uint32_t symtab_hash(const char* name, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void* symtab_alloc(size_t size) {
+    void* ptr = calloc(1, size);
+    if (!ptr) {
+        fprintf(stderr, "Error: Out of memory in symbol table\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+void symtab_init(SymbolTable* table) {
+    table->capacity = SYMTAB_INITIAL_CAPACITY;
+    table->count = 0;
+    table->slots = (uint32_t*)symtab_alloc(table->capacity * sizeof(uint32_t));
+    table->symbols = (Symbol*)symtab_alloc(table->capacity / 4 * 3 * sizeof(Symbol));
+    table->arena = NULL;
+}
+
+void symtab_free(SymbolTable* table) {
+    free(table->slots);
+    free(table->symbols);
+    table->slots = NULL;
+    table->symbols = NULL;
+    while (table->arena) {
+        ArenaBlock* next = table->arena->next;
+        free(table->arena);
+        table->arena = next;
+    }
+    table->capacity = 0;
+    table->count = 0;
+}
+
+// Copying a name into the arena (NUL-terminated)
+static const char* symtab_store_name(SymbolTable* table, const char* name, size_t length) {
+    ArenaBlock* block = table->arena;
+    if (!block || block->size - block->used < length + 1) {
+        size_t size = length + 1 > SYMTAB_ARENA_BLOCK ? length + 1 : SYMTAB_ARENA_BLOCK;
+        block = (ArenaBlock*)symtab_alloc(sizeof(ArenaBlock) + size);
+        block->size = size;
+        block->next = table->arena;
+        table->arena = block;
+    }
+    char* copy = block->data + block->used;
+    memcpy(copy, name, length);
+    copy[length] = '\0';
+    block->used += length + 1;
+    return copy;
+}
+
+// Finding the slot for name: holding its id, or the empty slot it would use
+static uint32_t* symtab_probe(const SymbolTable* table, const char* name, size_t length, uint32_t hash) {
+    uint32_t mask = table->capacity - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        uint32_t* slot = &table->slots[i];
+        if (*slot == 0) return slot;
+        const Symbol* symbol = &table->symbols[*slot - 1];
+        if (symbol->hash == hash && symbol->length == length && memcmp(symbol->name, name, length) == 0) {
+            return slot;
+        }
+    }
+}
+
+// Doubling capacity and rehashing (names are not copied)
+static void symtab_grow(SymbolTable* table) {
+    free(table->slots);
+    table->capacity *= 2;
+    table->slots = (uint32_t*)symtab_alloc(table->capacity * sizeof(uint32_t));
+    table->symbols = (Symbol*)realloc(table->symbols, table->capacity / 4 * 3 * sizeof(Symbol));
+    if (!table->symbols) {
+        fprintf(stderr, "Error: Out of memory in symbol table\n");
+        exit(1);
+    }
+    for (uint32_t id = 0; id < table->count; id++) {
+        const Symbol* symbol = &table->symbols[id];
+        *symtab_probe(table, symbol->name, symbol->length, symbol->hash) = id + 1;
+    }
+}
+
+// Looking up a symbol (NULL if never seen)
+Symbol* symtab_lookup(const SymbolTable* table, const char* name, size_t length) {
+    uint32_t slot = *symtab_probe(table, name, length, symtab_hash(name, length));
+    return slot ? &table->symbols[slot - 1] : NULL;
+}
+
+// Looking up a symbol, creating an undefined entry if it is new
+Symbol* symtab_intern(SymbolTable* table, const char* name, size_t length) {
+    if ((table->count + 1) * 4 > table->capacity * 3) {
+        symtab_grow(table);
+    }
+    uint32_t hash = symtab_hash(name, length);
+    uint32_t* slot = symtab_probe(table, name, length, hash);
+    if (*slot == 0) {
+        Symbol* symbol = &table->symbols[table->count];
+        symbol->name = symtab_store_name(table, name, length);
+        symbol->hash = hash;
+        symbol->length = (uint32_t)length;
+        symbol->id = table->count;
+        symbol->address = 0;
+        symbol->defined = false;
+        symbol->exported = false;
+        symbol->imported = false;
+        symbol->constant = false;
+        *slot = ++table->count;
+    }
+    return &table->symbols[*slot - 1];
+}
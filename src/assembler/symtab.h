@@ -0,0 +1,55 @@
+#ifndef SYMTAB_H
+#define SYMTAB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Assembler symbol table.
+// Symbols live in a dense array indexed by id; an open-addressing hash
+// table (linear probing, power-of-two capacity, grown at 3/4 load) maps
+// names to ids. Names are copied once into an arena of fixed-size blocks,
+// so name pointers stay valid for the life of the table and equal names
+// share one copy. Symbol pointers move when the array grows: keep the id
+// (e.g. in fixups) and use symtab_at().
+
+#define SYMTAB_INITIAL_CAPACITY 256
+#define SYMTAB_ARENA_BLOCK 65536
+
+typedef struct {
+    const char* name;           // Interned
+    uint32_t hash;
+    uint32_t length;
+    uint32_t id;                // Index in SymbolTable.symbols
+    uint16_t address;
+    bool defined;
+    bool exported;              // .global
+    bool imported;              // .extern (resolved by the linker)
+    bool constant;              // .equ value, not an address
+} Symbol;
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t used;
+    size_t size;
+    char data[];
+} ArenaBlock;
+
+typedef struct {
+    Symbol* symbols;            // Dense, in order of first appearance
+    uint32_t count;
+    uint32_t* slots;            // Hash table of id + 1 (0 = empty)
+    uint32_t capacity;          // Slots; symbols array holds 3/4 of this
+    ArenaBlock* arena;
+} SymbolTable;
+
+void symtab_init(SymbolTable* table);
+void symtab_free(SymbolTable* table);
+Symbol* symtab_lookup(const SymbolTable* table, const char* name, size_t length);
+Symbol* symtab_intern(SymbolTable* table, const char* name, size_t length);
+
+static inline Symbol* symtab_at(const SymbolTable* table, uint32_t id) {
+    return &table->symbols[id];
+}
+
+#endif // SYMTAB_H
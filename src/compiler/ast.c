@@ -0,0 +1,298 @@
+#include "ast.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_CHUNK 65536
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    ArenaChunk* chunk = arena->chunks;
+    if (!chunk || chunk->used + size > chunk->size) {
+        size_t chunk_size = size > ARENA_CHUNK ? size : ARENA_CHUNK;
+        chunk = (ArenaChunk*)malloc(sizeof(ArenaChunk) + chunk_size);
+        if (!chunk) {
+            fprintf(stderr, "Error: Out of memory\n");
+            exit(1);
+        }
+        chunk->next = arena->chunks;
+        chunk->used = 0;
+        chunk->size = chunk_size;
+        arena->chunks = chunk;
+    }
+    void* memory = chunk->data + chunk->used;
+    chunk->used += size;
+    memset(memory, 0, size);
+    return memory;
+}
+
+char* arena_strndup(Arena* arena, const char* text, size_t length) {
+    char* copy = (char*)arena_alloc(arena, length + 1);
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+void arena_free(Arena* arena) {
+    while (arena->chunks) {
+        ArenaChunk* next = arena->chunks->next;
+        free(arena->chunks);
+        arena->chunks = next;
+    }
+}
+
+CType type_scalar(BaseType base, int pointers) {
+    CType type = { (uint8_t)base, (uint8_t)pointers, -1 };
+    return type;
+}
+
+bool type_is_pointer(CType type) {
+    return type.pointers > 0 || type.length >= 0;
+}
+
+bool type_is_unsigned(CType type) {
+    return type.base == TYPE_UNSIGNED || type_is_pointer(type);
+}
+
+CType type_decay(CType type) {
+    if (type.length >= 0) {
+        type.length = -1;
+        type.pointers++;
+    }
+    return type;
+}
+
+// Truncating a folded value to the 16-bit type it has on the CPU
+static int32_t ast_truncate(int32_t value, CType type) {
+    return type_is_unsigned(type) ? (int32_t)(uint16_t)value : (int32_t)(int16_t)value;
+}
+
+static bool ast_is_num(const Node* node) {
+    return node->kind == NODE_NUM;
+}
+
+static bool ast_is_comparison(int op) {
+    return op == '<' || op == '>' || op == OP_LE || op == OP_GE || op == OP_EQ || op == OP_NE;
+}
+
+static int ast_need(int a, int b) {
+    int need = a == b ? a + 1 : a > b ? a : b;
+    return need > CC_CALL_NEED ? CC_CALL_NEED : need;
+}
+
+Node* ast_node(Arena* arena, NodeKind kind, int line, int column) {
+    Node* node = (Node*)arena_alloc(arena, sizeof(Node));
+    node->kind = (uint8_t)kind;
+    node->type = type_scalar(TYPE_INT, 0);
+    node->need = 1;
+    node->line = line;
+    node->column = column;
+    return node;
+}
+
+Node* ast_num(Arena* arena, int32_t value, CType type, int line, int column) {
+    Node* node = ast_node(arena, NODE_NUM, line, column);
+    node->type = type;
+    node->value = ast_truncate(value, type);
+    return node;
+}
+
+// Result type of an arithmetic operator: unsigned wins
+static CType ast_arith_type(CType a, CType b) {
+    return type_scalar(type_is_unsigned(a) || type_is_unsigned(b) ? TYPE_UNSIGNED : TYPE_INT, 0);
+}
+
+// Giving a node another type without changing its value
+static Node* ast_retype(Arena* arena, Node* node, CType type) {
+    if (node->type.base == type.base && node->type.pointers == type.pointers && node->type.length == type.length) {
+        return node;
+    }
+    if (ast_is_num(node)) {
+        return ast_num(arena, node->value, type, node->line, node->column);
+    }
+    Node* cast = ast_node(arena, NODE_CAST, node->line, node->column);
+    cast->type = type;
+    cast->a = node;
+    cast->need = node->need;
+    return cast;
+}
+
+static int ast_mirror(int op) {
+    switch (op) {
+        case '<': return '>';
+        case '>': return '<';
+        case OP_LE: return OP_GE;
+        case OP_GE: return OP_LE;
+        default: return op;
+    }
+}
+
+static int ast_invert(int op) {
+    switch (op) {
+        case '<': return OP_GE;
+        case '>': return OP_LE;
+        case OP_LE: return '>';
+        case OP_GE: return '<';
+        case OP_EQ: return OP_NE;
+        default: return OP_EQ;
+    }
+}
+
+// Folding a binary operator on two constants (false if it must be left
+// to run time, e.g. division by zero)
+static bool ast_fold(int op, int32_t a, int32_t b, bool is_unsigned, int32_t* result) {
+    uint16_t ua = (uint16_t)a, ub = (uint16_t)b;
+    int16_t sa = (int16_t)a, sb = (int16_t)b;
+    switch (op) {
+        case '+': *result = a + b; return true;
+        case '-': *result = a - b; return true;
+        case '*': *result = (int32_t)((uint32_t)ua * ub); return true;
+        case '/':
+        case '%':
+            if (b == 0) return false;
+            if (is_unsigned) *result = op == '/' ? ua / ub : ua % ub;
+            else *result = op == '/' ? sa / sb : sa % sb;
+            return true;
+        case '&': *result = a & b; return true;
+        case '|': *result = a | b; return true;
+        case '^': *result = a ^ b; return true;
+        case OP_SHL: *result = ua << (ub & 0xF); return true;
+        case OP_SHR: *result = is_unsigned ? ua >> (ub & 0xF) : sa >> (ub & 0xF); return true;
+        case OP_EQ: *result = ua == ub; return true;
+        case OP_NE: *result = ua != ub; return true;
+        case '<': *result = is_unsigned ? ua < ub : sa < sb; return true;
+        case '>': *result = is_unsigned ? ua > ub : sa > sb; return true;
+        case OP_LE: *result = is_unsigned ? ua <= ub : sa <= sb; return true;
+        case OP_GE: *result = is_unsigned ? ua >= ub : sa >= sb; return true;
+        case OP_ANDAND: *result = a != 0 && b != 0; return true;
+        case OP_OROR: *result = a != 0 || b != 0; return true;
+        default: return false;
+    }
+}
+
+Node* ast_binary(Arena* arena, int op, Node* a, Node* b) {
+    CType type;
+    if (ast_is_comparison(op) || op == OP_ANDAND || op == OP_OROR) {
+        type = type_scalar(TYPE_INT, 0);
+    } else if (op == '+' && type_is_pointer(a->type)) {
+        type = type_decay(a->type);
+    } else if (op == '+' && type_is_pointer(b->type)) {
+        type = type_decay(b->type);
+    } else if (op == '-' && type_is_pointer(a->type)) {
+        type = type_is_pointer(b->type) ? type_scalar(TYPE_INT, 0) : type_decay(a->type);
+    } else if (op == OP_SHL || op == OP_SHR) {
+        type = ast_arith_type(a->type, a->type);
+    } else {
+        type = ast_arith_type(a->type, b->type);
+    }
+    bool is_unsigned = type_is_unsigned(a->type) || type_is_unsigned(b->type);
+
+    // Folding constants
+    int32_t value;
+    if (ast_is_num(a) && ast_is_num(b) && ast_fold(op, a->value, b->value, is_unsigned, &value)) {
+        return ast_num(arena, value, type, a->line, a->column);
+    }
+    if ((op == OP_ANDAND || op == OP_OROR) && ast_is_num(a)) {
+        bool decided = op == OP_ANDAND ? a->value == 0 : a->value != 0;
+        if (decided) return ast_num(arena, op == OP_OROR, type, a->line, a->column);
+        return ast_binary(arena, OP_NE, b, ast_num(arena, 0, type, b->line, b->column));
+    }
+
+    // Keeping constants on the right, where they become immediates
+    if (ast_is_num(a) && !ast_is_num(b)) {
+        if (op == '+' || op == '*' || op == '&' || op == '|' || op == '^' || ast_is_comparison(op)) {
+            Node* swap = a;
+            a = b;
+            b = swap;
+            op = ast_mirror(op);
+        }
+    }
+
+    if (ast_is_num(b)) {
+        int32_t k = b->value;
+        // x - k is x + (-k), so chains of constants reassociate below
+        if (op == '-' && !(type_is_pointer(a->type) && type_is_pointer(b->type))) {
+            op = '+';
+            k = -k;
+            b = ast_num(arena, k, b->type, b->line, b->column);
+        }
+        if (op == '+' && a->kind == NODE_BINARY && a->op == '+' && ast_is_num(a->b)) {
+            Node* sum = ast_num(arena, a->b->value + k, a->b->type, b->line, b->column);
+            return ast_retype(arena, ast_binary(arena, '+', a->a, sum), type);
+        }
+        // Identities
+        bool identity = ((op == '+' || op == '|' || op == '^' || op == OP_SHL || op == OP_SHR) && (uint16_t)k == 0) ||
+                        ((op == '*' || op == '/') && k == 1);
+        if (identity) return ast_retype(arena, a, type);
+        if ((op == '*' || op == '&') && k == 0 && !ast_has_side_effects(a)) {
+            return ast_num(arena, 0, type, a->line, a->column);
+        }
+    }
+
+    Node* node = ast_node(arena, NODE_BINARY, a->line, a->column);
+    node->op = op;
+    node->type = type;
+    node->a = a;
+    node->b = b;
+    node->need = ast_need(a->need, b->need);
+    // Signed division and remainder call a runtime routine
+    if ((op == '/' && !is_unsigned) || op == '%') node->need = CC_CALL_NEED;
+    return node;
+}
+
+Node* ast_unary(Arena* arena, int op, Node* a) {
+    CType type = op == '!' ? type_scalar(TYPE_INT, 0) : ast_arith_type(a->type, a->type);
+    if (ast_is_num(a)) {
+        int32_t value = op == '-' ? -a->value : op == '~' ? ~a->value : a->value == 0;
+        return ast_num(arena, value, type, a->line, a->column);
+    }
+    if (op == '!' && a->kind == NODE_BINARY && ast_is_comparison(a->op)) {
+        return ast_binary(arena, ast_invert(a->op), a->a, a->b);
+    }
+    if (op == '!') {
+        return ast_binary(arena, OP_EQ, a, ast_num(arena, 0, a->type, a->line, a->column));
+    }
+    Node* node = ast_node(arena, NODE_UNARY, a->line, a->column);
+    node->op = op;
+    node->type = type;
+    node->a = a;
+    node->need = a->need;
+    return node;
+}
+
+Node* ast_cast(Arena* arena, CType type, Node* a) {
+    return ast_retype(arena, a, type);
+}
+
+Node* ast_cond(Arena* arena, Node* cond, Node* a, Node* b) {
+    CType type = type_is_pointer(a->type) ? type_decay(a->type) : ast_arith_type(a->type, b->type);
+    if (ast_is_num(cond)) {
+        return ast_retype(arena, cond->value ? a : b, type);
+    }
+    Node* node = ast_node(arena, NODE_COND, cond->line, cond->column);
+    node->type = type;
+    node->a = cond;
+    node->b = a;
+    node->c = b;
+    node->need = cond->need > a->need ? cond->need : a->need;
+    if (b->need > node->need) node->need = b->need;
+    return node;
+}
+
+bool ast_has_side_effects(const Node* node) {
+    if (!node) return false;
+    if (node->kind == NODE_ASSIGN || node->kind == NODE_INCDEC || node->kind == NODE_CALL) return true;
+    return ast_has_side_effects(node->a) || ast_has_side_effects(node->b) || ast_has_side_effects(node->c);
+}
+
+bool ast_uses_var(const Node* node, const Var* var) {
+    if (!node) return false;
+    if (node->kind == NODE_VAR) return node->var == var;
+    if (node->kind == NODE_CALL) {
+        for (const Node* arg = node->a; arg; arg = arg->next) {
+            if (ast_uses_var(arg, var)) return true;
+        }
+        return false;
+    }
+    return ast_uses_var(node->a, var) || ast_uses_var(node->b, var) || ast_uses_var(node->c, var);
+}
@@ -0,0 +1,141 @@
+#ifndef AST_H
+#define AST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Syntax tree for the C subset compiled by cc16.
+// Every value is one 16-bit word: int, unsigned and char are all a word,
+// pointers count in words, so pointer arithmetic never scales. Nodes are
+// allocated from an arena and freed together. Constant folding happens as
+// nodes are built (ast_binary, ast_unary, ast_cast), so code generation
+// only ever sees folded trees.
+
+#define CC_MAX_PARAMS 4         // Passed in R0-R3
+#define CC_CALL_NEED 8          // Register need of a call (evaluated first)
+
+typedef enum {
+    TYPE_VOID,
+    TYPE_INT,
+    TYPE_UNSIGNED
+} BaseType;
+
+typedef struct {
+    uint8_t base;               // BaseType
+    uint8_t pointers;           // Levels of indirection
+    int32_t length;             // Array length, or -1 for a scalar
+} CType;
+
+typedef enum {
+    VAR_GLOBAL,
+    VAR_LOCAL,
+    VAR_PARAM
+} VarKind;
+
+struct Node;
+
+typedef struct Var {
+    const char* name;
+    CType type;
+    uint8_t kind;               // VarKind
+    bool address_taken;         // & applied: must live in memory
+    uint32_t weight;            // Uses scaled by loop depth (register priority)
+    int index;                  // Parameter index
+    int reg;                    // Register home, or -1 (set by codegen)
+    int slot;                   // Frame slot (locals) or data offset (globals)
+    struct Node* init;          // Global initializer (NUM, STR or INIT_LIST)
+    struct Var* next;           // Next global, or next local of the function
+} Var;
+
+typedef struct Func {
+    const char* name;
+    CType ret;
+    Var* params[CC_MAX_PARAMS];
+    int param_count;
+    Var* locals;                // Parameters and locals, in declaration order
+    struct Node* body;          // NULL for a prototype
+    bool builtin;               // putchar/putint/putstr, expanded inline
+    int line;
+    struct Func* next;
+} Func;
+
+typedef enum {
+    // Expressions
+    NODE_NUM,                   // value
+    NODE_STR,                   // string index
+    NODE_VAR,                   // var
+    NODE_UNARY,                 // op a ('-', '~', '!')
+    NODE_BINARY,                // a op b
+    NODE_ASSIGN,                // a op= b ('=' for plain assignment)
+    NODE_INCDEC,                // ++a, a++, --a, a-- (op '+'/'-', value 1 = postfix)
+    NODE_DEREF,                 // *a
+    NODE_ADDR,                  // &a
+    NODE_CAST,                  // (type)a
+    NODE_CALL,                  // func(args in a, linked by next)
+    NODE_COND,                  // a ? b : c
+    NODE_INIT_LIST,             // { a, ... } (global initializers)
+    // Statements
+    NODE_BLOCK,                 // a: statements linked by next
+    NODE_EXPR,                  // a;
+    NODE_IF,                    // if (a) b else c
+    NODE_WHILE,                 // while (a) b
+    NODE_DO,                    // do b while (a)
+    NODE_FOR,                   // for (c; a; d) b
+    NODE_RETURN,                // return a
+    NODE_BREAK,
+    NODE_CONTINUE
+} NodeKind;
+
+// Multi-character operators (single-character ones use their ASCII code)
+enum {
+    OP_SHL = 256, OP_SHR, OP_EQ, OP_NE, OP_LE, OP_GE, OP_ANDAND, OP_OROR
+};
+
+typedef struct Node {
+    uint8_t kind;               // NodeKind
+    int op;
+    CType type;
+    int32_t value;              // NUM value (already truncated to its type), STR index
+    int need;                   // Registers needed to evaluate (Sethi-Ullman)
+    int line;
+    int column;
+    struct Node* a;
+    struct Node* b;
+    struct Node* c;
+    struct Node* d;
+    struct Node* next;
+    Var* var;
+    Func* func;
+} Node;
+
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t used;
+    size_t size;
+    char data[];
+} ArenaChunk;
+
+typedef struct {
+    ArenaChunk* chunks;
+} Arena;
+
+void* arena_alloc(Arena* arena, size_t size);
+char* arena_strndup(Arena* arena, const char* text, size_t length);
+void arena_free(Arena* arena);
+
+CType type_scalar(BaseType base, int pointers);
+bool type_is_unsigned(CType type);  // Unsigned compares, shifts and division
+bool type_is_pointer(CType type);   // Pointer or array
+CType type_decay(CType type);       // Array to pointer
+
+Node* ast_node(Arena* arena, NodeKind kind, int line, int column);
+Node* ast_num(Arena* arena, int32_t value, CType type, int line, int column);
+Node* ast_unary(Arena* arena, int op, Node* a);
+Node* ast_binary(Arena* arena, int op, Node* a, Node* b);
+Node* ast_cast(Arena* arena, CType type, Node* a);
+Node* ast_cond(Arena* arena, Node* cond, Node* a, Node* b);
+bool ast_has_side_effects(const Node* node);
+bool ast_uses_var(const Node* node, const Var* var);
+
+#endif // AST_H
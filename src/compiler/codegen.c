@@ -0,0 +1,1694 @@
+#include "codegen.h"
+#include "../emulator/cpu.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CG_REGS 7               // R0-R6 allocatable; R7 is SP
+#define CG_ALL_REGS 0x7F
+#define CG_CALLER_SAVED 0x0F    // R0-R3
+#define CG_CALLEE_SAVED 0x70    // R4-R6
+#define CG_SP 7
+#define CG_RETURN_MARK "\t@return\n"    // Placeholder, resolved per function
+
+// Runtime routines, emitted only when used
+typedef enum {
+    RT_DIVS,
+    RT_MODS,
+    RT_MODU,
+    RT_PUTSTR,
+    RT_COUNT
+} Runtime;
+
+static const char* const cg_runtime_names[RT_COUNT] = { "rt_divs", "rt_mods", "rt_modu", "rt_putstr" };
+
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+} CgBuffer;
+
+typedef struct {
+    int reg;
+    bool temp;                  // Owned temporary (free after use)
+    int offset;                 // Frame displacement for [SP+offset]
+} Operand;
+
+typedef enum {
+    ADDR_CONST,                 // [text]
+    ADDR_REG,                   // [reg+text] (a register variable)
+    ADDR_STACK,                 // SP + offset (+ pushes)
+    ADDR_EXPR                   // [value of expr+text]
+} AddrKind;
+
+typedef struct {
+    AddrKind kind;
+    char text[96];
+    int reg;
+    int offset;
+    Node* expr;
+} Address;
+
+typedef struct {
+    const Program* program;
+    CgBuffer out;               // Whole program
+    CgBuffer text;              // Current function body
+    const Func* func;
+    uint8_t held;               // Temporaries in use
+    uint8_t pending;            // Held but not yet written (dead across calls)
+    uint8_t var_regs;           // Registers holding variables
+    uint8_t used;               // Registers written (callee-saved ones are saved)
+    int push_depth;             // Words pushed since the frame was set up
+    int flags_reg;              // Register the Z/N flags currently describe, or -1
+    int frame_size;
+    int label_count;
+    int break_label;
+    int continue_label;
+    const Node* tail_return;    // Final return of the body (falls into the epilogue)
+    int* word_strings;          // Data offset of each literal as words, or -1
+    int* packed_strings;        // Data offset of each literal packed for putstr, or -1
+    uint16_t data_base;
+    uint32_t data_size;
+    uint32_t globals_size;      // Globals come first in the data area
+    bool runtime_used[RT_COUNT];
+    int errors;
+} Codegen;
+
+// ==================
+// Output
+// ==================
+
+static void cg_vappend(CgBuffer* buffer, const char* format, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+    if (buffer->size + length + 1 > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        while (capacity < buffer->size + length + 1) capacity *= 2;
+        buffer->data = (char*)realloc(buffer->data, capacity);
+        buffer->capacity = capacity;
+    }
+    vsnprintf(buffer->data + buffer->size, length + 1, format, args);
+    buffer->size += length;
+}
+
+static void cg_append(CgBuffer* buffer, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    cg_vappend(buffer, format, args);
+    va_end(args);
+}
+
+static const char* cg_reg(int reg) {
+    static const char* const names[8] = { "R0", "R1", "R2", "R3", "R4", "R5", "R6", "SP" };
+    return names[reg & 7];
+}
+
+// Recording a register write (for instructions that write two)
+static void cg_written(Codegen* g, int reg) {
+    if (reg >= 0 && reg < CG_REGS) {
+        g->used |= (uint8_t)(1 << reg);
+        g->pending &= (uint8_t)~(1 << reg);
+    }
+    if (reg == g->flags_reg) g->flags_reg = -1;
+}
+
+// Emitting an instruction that leaves the flags alone; writes is the
+// register it changes (-1 for none)
+static void cg_emit(Codegen* g, int writes, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    cg_append(&g->text, "    ");
+    cg_vappend(&g->text, format, args);
+    cg_append(&g->text, "\n");
+    va_end(args);
+    cg_written(g, writes);
+}
+
+// Emitting an instruction that sets Z/N from the register it writes
+// (rd -1: flags describe no register, e.g. CMP)
+static void cg_alu(Codegen* g, int rd, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    cg_append(&g->text, "    ");
+    cg_vappend(&g->text, format, args);
+    cg_append(&g->text, "\n");
+    va_end(args);
+    if (rd >= 0 && rd < CG_REGS) {
+        g->used |= (uint8_t)(1 << rd);
+        g->pending &= (uint8_t)~(1 << rd);
+    }
+    g->flags_reg = rd;
+}
+
+static int cg_new_label(Codegen* g) {
+    return g->label_count++;
+}
+
+static void cg_label(Codegen* g, int label) {
+    cg_append(&g->text, "L%d:\n", label);
+    g->flags_reg = -1;
+}
+
+static void cg_jump(Codegen* g, const char* mnemonic, int label) {
+    cg_emit(g, -1, "%s L%d", mnemonic, label);
+}
+
+// Formatting an immediate the way a person would write it
+static const char* cg_imm(int32_t value, char* buffer) {
+    int16_t v = (int16_t)value;
+    if (v >= -256 && v <= 255) snprintf(buffer, 16, "%d", v);
+    else snprintf(buffer, 16, "0x%04X", (uint16_t)value);
+    return buffer;
+}
+
+static void cg_load_imm(Codegen* g, int reg, int32_t value) {
+    char imm[16];
+    cg_emit(g, reg, "LDI %s, %s", cg_reg(reg), cg_imm(value, imm));
+}
+
+static void cg_move(Codegen* g, int dst, int src) {
+    if (dst != src) cg_emit(g, dst, "MOV %s, %s", cg_reg(dst), cg_reg(src));
+}
+
+static void cg_push(Codegen* g, int reg) {
+    cg_emit(g, -1, "PUSH %s", cg_reg(reg));
+    g->push_depth++;
+}
+
+static void cg_pop(Codegen* g, int reg) {
+    cg_emit(g, reg, "POP %s", cg_reg(reg));
+    g->push_depth--;
+}
+
+// ==================
+// Registers
+// ==================
+
+static int cg_free_count(const Codegen* g) {
+    int count = 0;
+    for (int r = 0; r < CG_REGS; r++) {
+        if (!((g->held | g->var_regs) & (1 << r))) count++;
+    }
+    return count;
+}
+
+static int cg_alloc(Codegen* g, int prefer) {
+    uint8_t free_regs = (uint8_t)(~(g->held | g->var_regs) & CG_ALL_REGS);
+    int reg = -1;
+    if (prefer >= 0 && (free_regs & (1 << prefer))) {
+        reg = prefer;
+    } else {
+        for (int r = 0; r < CG_REGS && reg < 0; r++) {
+            if (free_regs & (1 << r)) reg = r;
+        }
+    }
+    if (reg < 0) {
+        // The need-based evaluation order keeps this from happening
+        if (g->errors++ == 0) fprintf(stderr, "Error: Expression too complex in '%s'\n", g->func->name);
+        return 0;
+    }
+    g->held |= (uint8_t)(1 << reg);
+    g->pending |= (uint8_t)(1 << reg);
+    g->used |= (uint8_t)(1 << reg);
+    return reg;
+}
+
+static void cg_free(Codegen* g, int reg) {
+    g->held &= (uint8_t)~(1 << reg);
+    g->pending &= (uint8_t)~(1 << reg);
+}
+
+static void cg_release(Codegen* g, Operand operand) {
+    if (operand.temp) cg_free(g, operand.reg);
+}
+
+static bool cg_is_reg_var(const Node* node) {
+    return node->kind == NODE_VAR && node->var->reg >= 0 && node->var->type.length < 0;
+}
+
+// Resolving moves between registers that may overlap (cycles are
+// broken with an XOR swap)
+static void cg_parallel_move(Codegen* g, int dst[], int src[], int count) {
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        if (dst[i] != src[i]) {
+            dst[n] = dst[i];
+            src[n++] = src[i];
+        }
+    }
+    while (n > 0) {
+        int ready = -1;
+        for (int i = 0; i < n && ready < 0; i++) {
+            bool blocked = false;
+            for (int j = 0; j < n; j++) {
+                if (j != i && src[j] == dst[i]) blocked = true;
+            }
+            if (!blocked) ready = i;
+        }
+        if (ready >= 0) {
+            cg_move(g, dst[ready], src[ready]);
+        } else {
+            ready = 0;
+            int a = dst[0], b = src[0];
+            cg_alu(g, a, "XOR %s, %s", cg_reg(a), cg_reg(b));
+            cg_alu(g, b, "XOR %s, %s", cg_reg(b), cg_reg(a));
+            cg_alu(g, a, "XOR %s, %s", cg_reg(a), cg_reg(b));
+            // What was in a now lives in b
+            for (int j = 1; j < n; j++) {
+                if (src[j] == a) src[j] = b;
+            }
+        }
+        dst[ready] = dst[n - 1];
+        src[ready] = src[n - 1];
+        n--;
+    }
+}
+
+// ==================
+// Data
+// ==================
+
+static const char* cg_global_name(const Var* var, char* buffer, size_t size) {
+    snprintf(buffer, size, "_%s", var->name);
+    return buffer;
+}
+
+static uint32_t cg_data_words(const CType* type) {
+    return type->length >= 0 ? (uint32_t)type->length : 1;
+}
+
+// Words of a packed literal, laid out as .STRING does (pairs, then a zero word)
+static uint32_t cg_packed_words(size_t length) {
+    return (uint32_t)((length + 1) / 2 + 1);
+}
+
+// Placing a string literal in the data area on first use
+static int cg_string(Codegen* g, int index, bool packed) {
+    int* offsets = packed ? g->packed_strings : g->word_strings;
+    if (offsets[index] < 0) {
+        size_t length = g->program->strings[index].length;
+        offsets[index] = (int)g->data_size;
+        g->data_size += packed ? cg_packed_words(length) : (uint32_t)(length + 1);
+    }
+    return index;
+}
+
+// ==================
+// Expressions
+// ==================
+
+static void gen_value(Codegen* g, Node* node, int target);
+static void gen_cond(Codegen* g, Node* node, int label, bool when);
+static void gen_call_to(Codegen* g, const char* label, Node* args[], int arg_count, int target);
+
+static Operand gen_operand(Codegen* g, Node* node) {
+    if (cg_is_reg_var(node)) {
+        Operand operand = { node->var->reg, false, 0 };
+        return operand;
+    }
+    Operand operand = { cg_alloc(g, -1), true, 0 };
+    gen_value(g, node, operand.reg);
+    return operand;
+}
+
+static int gen_temp(Codegen* g, Node* node, int prefer) {
+    int reg = cg_alloc(g, prefer);
+    gen_value(g, node, reg);
+    return reg;
+}
+
+// Registers an operand needs while another value is held
+static int cg_operand_need(const Node* node) {
+    return cg_is_reg_var(node) ? 0 : node->need;
+}
+
+// Freeing held temporaries other than keep by pushing them, until
+// count registers are free (deep expressions in few registers)
+static uint8_t cg_borrow(Codegen* g, int count, int keep) {
+    uint8_t borrowed = 0;
+    for (int r = CG_REGS - 1; r >= 0 && cg_free_count(g) < count; r--) {
+        if (r == keep || !(g->held & (1 << r))) continue;
+        cg_push(g, r);
+        g->held &= (uint8_t)~(1 << r);
+        borrowed |= (uint8_t)(1 << r);
+    }
+    return borrowed;
+}
+
+static void cg_restore(Codegen* g, uint8_t borrowed) {
+    for (int r = 0; r < CG_REGS; r++) {
+        if (!(borrowed & (1 << r))) continue;
+        cg_pop(g, r);
+        g->held |= (uint8_t)(1 << r);
+    }
+}
+
+// Evaluating x and y so both are in registers at once. x goes into
+// target (if >= 0) or any register; y is a read-only operand. The
+// operand needing more registers goes first; if neither fits while the
+// other is held, y is parked on the stack. Returns the temporaries
+// borrowed to make room, for cg_restore once the operands are used.
+static uint8_t gen_pair(Codegen* g, Node* x, Node* y, int target, Operand* ox, Operand* oy) {
+    bool x_held = target < 0;
+    uint8_t borrowed = cg_borrow(g, x_held ? 2 : 1, target);
+    int free_regs = cg_free_count(g);
+    int nx = x_held ? cg_operand_need(x) : x->need;
+    int ny = cg_operand_need(y);
+    bool x_first = nx >= ny;
+    // A call saves what is live around it, so it only needs its result register
+    int fx = nx >= CC_CALL_NEED ? 1 : nx;
+    int fy = ny >= CC_CALL_NEED ? 1 : ny;
+    bool fits = x_first ? fy <= free_regs - (x_held ? 1 : 0)
+                        : fy <= free_regs && fx <= free_regs - (fy > 0 ? 1 : 0) + (x_held ? 0 : 1);
+
+    if (!fits) {
+        // The target is free until x is written, unless x already lives there
+        bool via_target = !x_held && !(cg_is_reg_var(x) && x->var->reg == target);
+        int parked = via_target ? target : cg_alloc(g, -1);
+        gen_value(g, y, parked);
+        cg_push(g, parked);
+        if (!via_target) cg_free(g, parked);
+    } else if (!x_first) {
+        *oy = gen_operand(g, y);
+    }
+
+    if (!x_held) {
+        gen_value(g, x, target);
+        ox->reg = target;
+        ox->temp = false;
+    } else {
+        *ox = gen_operand(g, x);
+    }
+
+    if (!fits) {
+        oy->reg = cg_alloc(g, -1);
+        oy->temp = true;
+        cg_pop(g, oy->reg);
+    } else if (x_first) {
+        *oy = gen_operand(g, y);
+    }
+    return borrowed;
+}
+
+// Writing text for an address known at assembly time
+static bool cg_const_address(Codegen* g, const Node* node, char* buffer, size_t size) {
+    char name[80];
+    switch (node->kind) {
+        case NODE_NUM:
+            snprintf(buffer, size, "0x%04X", (uint16_t)node->value);
+            return true;
+        case NODE_STR:
+            snprintf(buffer, size, "S%d", cg_string(g, node->value, false));
+            return true;
+        case NODE_ADDR:
+        case NODE_VAR:
+            if (node->var->kind != VAR_GLOBAL || (node->kind == NODE_VAR && node->var->type.length < 0)) return false;
+            snprintf(buffer, size, "%s", cg_global_name(node->var, name, sizeof(name)));
+            return true;
+        case NODE_CAST:
+            return cg_const_address(g, node->a, buffer, size);
+        case NODE_BINARY:
+            if (node->op != '+' || node->b->kind != NODE_NUM || !cg_const_address(g, node->a, buffer, size)) {
+                return false;
+            }
+            size_t length = strlen(buffer);
+            int16_t offset = (int16_t)node->b->value;
+            snprintf(buffer + length, size - length, "%s%d", offset < 0 ? "-" : "+", offset < 0 ? -offset : offset);
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Recognizing the address of a frame slot (local array or &local, plus
+// a constant)
+static bool cg_stack_address(const Node* node, int* offset) {
+    if ((node->kind == NODE_VAR && node->var->type.length >= 0) || node->kind == NODE_ADDR) {
+        if (node->var->kind == VAR_GLOBAL) return false;
+        *offset = node->var->slot;
+        return true;
+    }
+    if (node->kind == NODE_CAST) return cg_stack_address(node->a, offset);
+    if (node->kind == NODE_BINARY && node->op == '+' && node->b->kind == NODE_NUM &&
+        cg_stack_address(node->a, offset)) {
+        *offset += (int16_t)node->b->value;
+        return true;
+    }
+    return false;
+}
+
+// Classifying a memory lvalue (a variable in memory or *pointer)
+static void cg_classify(Codegen* g, Node* lvalue, Address* address) {
+    memset(address, 0, sizeof(Address));
+    if (lvalue->kind == NODE_VAR) {
+        if (lvalue->var->kind == VAR_GLOBAL) {
+            address->kind = ADDR_CONST;
+            cg_global_name(lvalue->var, address->text, sizeof(address->text));
+        } else {
+            address->kind = ADDR_STACK;
+            address->offset = lvalue->var->slot;
+        }
+        return;
+    }
+    Node* pointer = lvalue->a;
+    if (cg_const_address(g, pointer, address->text, sizeof(address->text))) {
+        address->kind = ADDR_CONST;
+    } else if (cg_is_reg_var(pointer)) {
+        address->kind = ADDR_REG;
+        address->reg = pointer->var->reg;
+    } else if (cg_stack_address(pointer, &address->offset)) {
+        address->kind = ADDR_STACK;
+    } else {
+        // Indexed forms: a known address or constant goes into the
+        // displacement, the rest into the base register
+        Node* base = pointer;
+        address->text[0] = '\0';
+        if (pointer->kind == NODE_BINARY && pointer->op == '+') {
+            char text[sizeof(address->text) - 1];
+            if (cg_const_address(g, pointer->b, text, sizeof(text))) {
+                base = pointer->a;
+            } else if (cg_const_address(g, pointer->a, text, sizeof(text))) {
+                base = pointer->b;
+            }
+            if (base != pointer) snprintf(address->text, sizeof(address->text), "+%s", text);
+        } else if (pointer->kind == NODE_BINARY && pointer->op == '-' && pointer->b->kind == NODE_NUM) {
+            base = pointer->a;
+            int offset = -(int16_t)pointer->b->value;
+            snprintf(address->text, sizeof(address->text), "%s%d", offset < 0 ? "-" : "+", offset < 0 ? -offset : offset);
+        }
+        if (cg_is_reg_var(base)) {
+            address->kind = ADDR_REG;
+            address->reg = base->var->reg;
+        } else {
+            address->kind = ADDR_EXPR;
+            address->expr = base;
+        }
+    }
+}
+
+static void cg_frame_address(Codegen* g, int reg, int offset) {
+    char imm[16];
+    cg_move(g, reg, CG_SP);
+    offset += g->push_depth;
+    if (offset != 0) cg_alu(g, reg, "ADDI %s, %s", cg_reg(reg), cg_imm(offset, imm));
+}
+
+// Getting an address into a register (or none for ADDR_CONST); into is
+// used for computed addresses when >= 0
+static Operand cg_address_operand(Codegen* g, const Address* address, int into) {
+    Operand operand = { -1, false, 0 };
+    switch (address->kind) {
+        case ADDR_CONST:
+            break;
+        case ADDR_REG:
+            operand.reg = address->reg;
+            break;
+        case ADDR_STACK:
+            operand.reg = CG_SP;
+            operand.offset = address->offset + g->push_depth;
+            break;
+        case ADDR_EXPR:
+            if (into >= 0) {
+                gen_value(g, address->expr, into);
+                operand.reg = into;
+            } else {
+                operand = gen_operand(g, address->expr);
+            }
+            break;
+    }
+    return operand;
+}
+
+static const char* cg_address_text(const Address* address, Operand operand, char* buffer, size_t size) {
+    if (address->kind == ADDR_CONST) {
+        snprintf(buffer, size, "[%s]", address->text);
+    } else if (address->kind == ADDR_STACK) {
+        if (operand.offset == 0) {
+            snprintf(buffer, size, "[SP]");
+        } else {
+            snprintf(buffer, size, "[SP+%d]", operand.offset);
+        }
+    } else {
+        snprintf(buffer, size, "[%s%s]", cg_reg(operand.reg), address->text);
+    }
+    return buffer;
+}
+
+// Recognizing *p++ and *--p on a register variable, which become [Rp]+
+// and -[Rp] (returns the step, 0 for neither)
+static int cg_auto_step(const Node* lvalue) {
+    if (lvalue->kind != NODE_DEREF || lvalue->a->kind != NODE_INCDEC || !cg_is_reg_var(lvalue->a->a)) return 0;
+    const Node* step = lvalue->a;
+    if (step->op == '+' && step->value != 0) return 1;
+    if (step->op == '-' && step->value == 0) return -1;
+    return 0;
+}
+
+static void gen_load(Codegen* g, Node* lvalue, int target) {
+    Address address;
+    char text[112];
+    int step = cg_auto_step(lvalue);
+    if (step != 0) {
+        int pointer = lvalue->a->a->var->reg;
+        cg_emit(g, target, step > 0 ? "LD %s, [%s]+" : "LD %s, -[%s]", cg_reg(target), cg_reg(pointer));
+        cg_written(g, pointer);
+        return;
+    }
+    cg_classify(g, lvalue, &address);
+    Operand operand = cg_address_operand(g, &address, target);
+    cg_emit(g, target, "LD %s, %s", cg_reg(target), cg_address_text(&address, operand, text, sizeof(text)));
+    cg_release(g, operand);
+}
+
+static const char* cg_mnemonic(int op, bool is_unsigned) {
+    switch (op) {
+        case '+': return "ADD";
+        case '-': return "SUB";
+        case '*': return "MUL";
+        case '/': return "DIV";
+        case '&': return "AND";
+        case '|': return "OR";
+        case '^': return "XOR";
+        case OP_SHL: return "SHL";
+        case OP_SHR: return is_unsigned ? "SHR" : "SAR";
+        default: return NULL;
+    }
+}
+
+static bool cg_is_comparison(int op) {
+    return op == '<' || op == '>' || op == OP_LE || op == OP_GE || op == OP_EQ || op == OP_NE ||
+           op == OP_ANDAND || op == OP_OROR;
+}
+
+// Runtime routine for an operator, or -1 if it is an instruction
+static int cg_runtime_op(int op, bool is_unsigned) {
+    if (op == '/' && !is_unsigned) return RT_DIVS;
+    if (op == '%') return is_unsigned ? RT_MODU : RT_MODS;
+    return -1;
+}
+
+// Adding a constant (INC/DEC and ADDI/SUBI forms)
+static void cg_add_const(Codegen* g, int reg, int32_t k) {
+    char imm[16];
+    int16_t v = (int16_t)k;
+    if (v == 1) cg_alu(g, reg, "INC %s", cg_reg(reg));
+    else if (v == -1) cg_alu(g, reg, "DEC %s", cg_reg(reg));
+    else if (v < 0) cg_alu(g, reg, "SUBI %s, %s", cg_reg(reg), cg_imm(-v, imm));
+    else if (v != 0) cg_alu(g, reg, "ADDI %s, %s", cg_reg(reg), cg_imm(v, imm));
+}
+
+static void gen_binary(Codegen* g, Node* node, int target) {
+    Node* a = node->a;
+    Node* b = node->b;
+    int op = node->op;
+    bool is_unsigned = type_is_unsigned(a->type) || type_is_unsigned(b->type);
+
+    int runtime = cg_runtime_op(op, is_unsigned);
+    if (runtime >= 0) {
+        Node* args[2] = { a, b };
+        g->runtime_used[runtime] = true;
+        gen_call_to(g, cg_runtime_names[runtime], args, 2, target);
+        return;
+    }
+
+    // Immediate forms
+    if (b->kind == NODE_NUM && (op == '+' || op == '-')) {
+        int offset;
+        if (op == '+' && cg_stack_address(a, &offset)) {
+            cg_frame_address(g, target, offset + (int16_t)b->value);
+            return;
+        }
+        gen_value(g, a, target);
+        cg_add_const(g, target, op == '+' ? b->value : -b->value);
+        return;
+    }
+    if (b->kind == NODE_NUM && op == '*' && (b->value == 2 || b->value == 4)) {
+        gen_value(g, a, target);
+        for (int k = b->value; k > 1; k /= 2) cg_alu(g, target, "ADD %s, %s", cg_reg(target), cg_reg(target));
+        return;
+    }
+
+    Operand ox, oy;
+    uint8_t borrowed = gen_pair(g, a, b, target, &ox, &oy);
+    if (op == OP_SHL || op == OP_SHR) is_unsigned = type_is_unsigned(a->type);
+    if (op == '/') {
+        // DIV leaves the flags alone when dividing by zero
+        cg_emit(g, target, "DIV %s, %s", cg_reg(target), cg_reg(oy.reg));
+    } else {
+        cg_alu(g, target, "%s %s, %s", cg_mnemonic(op, is_unsigned), cg_reg(target), cg_reg(oy.reg));
+    }
+    cg_release(g, oy);
+    cg_restore(g, borrowed);
+}
+
+// A variable node standing for a value already in a register
+static void cg_reg_node(Node* node, Var* var, int reg, CType type) {
+    memset(var, 0, sizeof(Var));
+    var->name = "";
+    var->kind = VAR_LOCAL;
+    var->type = type;
+    var->type.length = -1;
+    var->reg = reg;
+    memset(node, 0, sizeof(Node));
+    node->kind = NODE_VAR;
+    node->type = var->type;
+    node->var = var;
+    node->need = 1;
+}
+
+static void cg_binary_node(Node* node, int op, Node* a, Node* b, CType type) {
+    memset(node, 0, sizeof(Node));
+    node->kind = NODE_BINARY;
+    node->op = op;
+    node->type = type;
+    node->a = a;
+    node->b = b;
+    node->need = a->need > b->need ? a->need : a->need + (a->need == b->need);
+    if (b->need > node->need) node->need = b->need;
+}
+
+static void gen_assign(Codegen* g, Node* node, int target) {
+    Node* lvalue = node->a;
+    Node* value = node->b;
+    int op = node->op;
+
+    if (cg_is_reg_var(lvalue)) {
+        int reg = lvalue->var->reg;
+        if (op == '=' && !ast_uses_var(value, lvalue->var)) {
+            gen_value(g, value, reg);
+        } else if (op == '=') {
+            int temp = gen_temp(g, value, -1);
+            cg_move(g, reg, temp);
+            cg_free(g, temp);
+        } else {
+            Node binary;
+            cg_binary_node(&binary, op, lvalue, value, lvalue->type);
+            gen_value(g, &binary, reg);
+        }
+        if (target >= 0) cg_move(g, target, reg);
+        return;
+    }
+
+    Address address;
+    char text[112];
+    int step = cg_auto_step(lvalue);
+    if (op == '=' && step != 0 && !ast_uses_var(value, lvalue->a->a->var)) {
+        int pointer = lvalue->a->a->var->reg;
+        Operand stored;
+        if (target >= 0) {
+            gen_value(g, value, target);
+            stored.reg = target;
+            stored.temp = false;
+        } else {
+            stored = gen_operand(g, value);
+        }
+        cg_emit(g, pointer, step > 0 ? "ST [%s]+, %s" : "ST -[%s], %s", cg_reg(pointer), cg_reg(stored.reg));
+        cg_release(g, stored);
+        return;
+    }
+    cg_classify(g, lvalue, &address);
+    if (op == '=') {
+        Operand stored, where;
+        uint8_t borrowed = 0;
+        if (address.kind == ADDR_EXPR) {
+            if (target >= 0) {
+                borrowed = gen_pair(g, value, address.expr, target, &stored, &where);
+            } else {
+                borrowed = gen_pair(g, address.expr, value, -1, &where, &stored);
+            }
+        } else {
+            if (target >= 0) {
+                gen_value(g, value, target);
+                stored.reg = target;
+                stored.temp = false;
+            } else {
+                stored = gen_operand(g, value);
+            }
+            where = cg_address_operand(g, &address, -1);
+        }
+        cg_emit(g, -1, "ST %s, %s", cg_address_text(&address, where, text, sizeof(text)), cg_reg(stored.reg));
+        cg_release(g, where);
+        cg_release(g, stored);
+        cg_restore(g, borrowed);
+        return;
+    }
+
+    // Compound: the address is computed once, then load, operate, store
+    uint8_t borrowed = cg_borrow(g, target >= 0 ? 1 : 2, target);
+    Operand where = cg_address_operand(g, &address, -1);
+    int reg = target >= 0 ? target : cg_alloc(g, -1);
+    int depth = g->push_depth;
+    cg_address_text(&address, where, text, sizeof(text));
+    cg_emit(g, reg, "LD %s, %s", cg_reg(reg), text);
+    Var loaded_var;
+    Node loaded, binary;
+    cg_reg_node(&loaded, &loaded_var, reg, lvalue->type);
+    cg_binary_node(&binary, op, &loaded, value, lvalue->type);
+    gen_value(g, &binary, reg);
+    if (where.reg == CG_SP && g->push_depth != depth) {
+        if (g->errors++ == 0) fprintf(stderr, "Error: Internal frame error in '%s'\n", g->func->name);
+    }
+    cg_emit(g, -1, "ST %s, %s", text, cg_reg(reg));
+    cg_release(g, where);
+    if (target < 0) cg_free(g, reg);
+    cg_restore(g, borrowed);
+}
+
+static void gen_incdec(Codegen* g, Node* node, int target) {
+    Node* lvalue = node->a;
+    bool postfix = node->value != 0;
+    const char* step = node->op == '+' ? "INC" : "DEC";
+    const char* undo = node->op == '+' ? "DEC" : "INC";
+
+    if (cg_is_reg_var(lvalue)) {
+        int reg = lvalue->var->reg;
+        if (target >= 0 && postfix) cg_move(g, target, reg);
+        cg_alu(g, reg, "%s %s", step, cg_reg(reg));
+        if (target >= 0 && !postfix) cg_move(g, target, reg);
+        return;
+    }
+
+    Address address;
+    char text[112];
+    cg_classify(g, lvalue, &address);
+    uint8_t borrowed = cg_borrow(g, target >= 0 ? 1 : 2, target);
+    Operand where = cg_address_operand(g, &address, -1);
+    int reg = target >= 0 ? target : cg_alloc(g, -1);
+    cg_address_text(&address, where, text, sizeof(text));
+    cg_emit(g, reg, "LD %s, %s", cg_reg(reg), text);
+    cg_alu(g, reg, "%s %s", step, cg_reg(reg));
+    cg_emit(g, -1, "ST %s, %s", text, cg_reg(reg));
+    if (target >= 0 && postfix) cg_alu(g, reg, "%s %s", undo, cg_reg(reg));
+    cg_release(g, where);
+    if (target < 0) cg_free(g, reg);
+    cg_restore(g, borrowed);
+}
+
+// An argument that can be loaded straight into its register
+static bool cg_simple_arg(const Node* node) {
+    return node->kind == NODE_NUM || node->kind == NODE_STR || cg_is_reg_var(node) ||
+           ((node->kind == NODE_VAR || node->kind == NODE_ADDR) && node->var->kind == VAR_GLOBAL);
+}
+
+// Loading arguments into R0.. : complex ones are evaluated first (all
+// but the last parked on the stack), then register moves, then constants
+static void gen_args(Codegen* g, Node* args[], int arg_count) {
+    int last_complex = -1;
+    for (int i = 0; i < arg_count; i++) {
+        if (!cg_simple_arg(args[i])) last_complex = i;
+    }
+    for (int i = 0; i < last_complex; i++) {
+        if (cg_simple_arg(args[i])) continue;
+        int temp = gen_temp(g, args[i], -1);
+        cg_push(g, temp);
+        cg_free(g, temp);
+    }
+
+    int dst[CC_MAX_PARAMS + 1], src[CC_MAX_PARAMS + 1];
+    int moves = 0;
+    int last_temp = -1;
+    if (last_complex >= 0) {
+        last_temp = gen_temp(g, args[last_complex], last_complex);
+        dst[moves] = last_complex;
+        src[moves++] = last_temp;
+    }
+    for (int i = 0; i < arg_count; i++) {
+        if (cg_is_reg_var(args[i])) {
+            dst[moves] = i;
+            src[moves++] = args[i]->var->reg;
+        }
+    }
+    cg_parallel_move(g, dst, src, moves);
+    if (last_temp >= 0) cg_free(g, last_temp);
+
+    for (int i = last_complex - 1; i >= 0; i--) {
+        if (!cg_simple_arg(args[i])) cg_pop(g, i);
+    }
+    for (int i = 0; i < arg_count; i++) {
+        Node* arg = args[i];
+        char name[80];
+        if (!cg_simple_arg(arg) || cg_is_reg_var(arg)) continue;
+        if (arg->kind == NODE_NUM) {
+            cg_load_imm(g, i, arg->value);
+        } else if (arg->kind == NODE_STR) {
+            cg_emit(g, i, "LDI %s, S%d", cg_reg(i), cg_string(g, arg->value, false));
+        } else if (arg->kind == NODE_ADDR || (arg->kind == NODE_VAR && arg->var->type.length >= 0)) {
+            cg_emit(g, i, "LDI %s, %s", cg_reg(i), cg_global_name(arg->var, name, sizeof(name)));
+        } else if (arg->kind == NODE_VAR && arg->var->kind == VAR_GLOBAL) {
+            cg_emit(g, i, "LD %s, [%s]", cg_reg(i), cg_global_name(arg->var, name, sizeof(name)));
+        }
+    }
+}
+
+// Calling a routine: live caller-saved registers are pushed around the
+// call (and are free for evaluating arguments meanwhile); temporaries
+// not yet written are dead and not saved. The result is moved from R0
+// to target.
+static void gen_call_to(Codegen* g, const char* label, Node* args[], int arg_count, int target) {
+    uint8_t save = (uint8_t)(((g->held & ~g->pending) | g->var_regs) & CG_CALLER_SAVED);
+    if (target >= 0) save &= (uint8_t)~(1 << target);
+    for (int r = 0; r < 4; r++) {
+        if (save & (1 << r)) cg_push(g, r);
+    }
+    // Saved and not yet written registers are free for the arguments
+    uint8_t saved_held = g->held & (save | (g->pending & CG_CALLER_SAVED));
+    uint8_t saved_pending = g->pending & saved_held;
+    g->held &= (uint8_t)~saved_held;
+
+    gen_args(g, args, arg_count);
+    cg_emit(g, -1, "CALL %s", label);
+    g->flags_reg = -1;
+    g->held |= saved_held;
+    g->pending |= saved_pending;
+    if (target >= 0) {
+        cg_move(g, target, 0);
+        g->pending &= (uint8_t)~(1 << target);
+    }
+
+    for (int r = 3; r >= 0; r--) {
+        if (save & (1 << r)) cg_pop(g, r);
+    }
+}
+
+static void gen_call(Codegen* g, Node* node, int target) {
+    Node* args[CC_MAX_PARAMS];
+    int arg_count = 0;
+    for (Node* arg = node->a; arg && arg_count < CC_MAX_PARAMS; arg = arg->next) args[arg_count++] = arg;
+
+    const Func* func = node->func;
+    if (func->builtin) {
+        // Memory-mapped output, inline
+        Node* arg = args[0];
+        if (strcmp(func->name, "putstr") == 0 && arg->kind != NODE_STR) {
+            g->runtime_used[RT_PUTSTR] = true;
+            gen_call_to(g, cg_runtime_names[RT_PUTSTR], args, 1, -1);
+            return;
+        }
+        Operand operand;
+        if (arg->kind == NODE_STR) {
+            // A literal is stored packed, the form the device prints
+            operand.reg = cg_alloc(g, -1);
+            operand.temp = true;
+            cg_emit(g, operand.reg, "LDI %s, PS%d", cg_reg(operand.reg), cg_string(g, arg->value, true));
+        } else {
+            operand = gen_operand(g, arg);
+        }
+        int port = strcmp(func->name, "putchar") == 0 ? MMIO_CHAR_OUT
+                 : strcmp(func->name, "putint") == 0 ? MMIO_INT_OUT : MMIO_STR_OUT;
+        cg_emit(g, -1, "ST [0x%04X], %s", port, cg_reg(operand.reg));
+        cg_release(g, operand);
+        return;
+    }
+
+    if (!func->body) {
+        fprintf(stderr, "Error: Function '%s' is declared but never defined (line %d, column %d)\n", func->name,
+                node->line, node->column);
+        g->errors++;
+    }
+    char label[80];
+    snprintf(label, sizeof(label), "_%s", func->name);
+    gen_call_to(g, label, args, arg_count, target);
+}
+
+static void gen_value(Codegen* g, Node* node, int target) {
+    char name[80];
+    switch (node->kind) {
+        case NODE_NUM:
+            cg_load_imm(g, target, node->value);
+            break;
+        case NODE_STR:
+            cg_emit(g, target, "LDI %s, S%d", cg_reg(target), cg_string(g, node->value, false));
+            break;
+        case NODE_VAR:
+        case NODE_ADDR: {
+            Var* var = node->var;
+            bool address = node->kind == NODE_ADDR || var->type.length >= 0;
+            if (address && var->kind == VAR_GLOBAL) {
+                cg_emit(g, target, "LDI %s, %s", cg_reg(target), cg_global_name(var, name, sizeof(name)));
+            } else if (address) {
+                cg_frame_address(g, target, var->slot);
+            } else if (var->reg >= 0) {
+                cg_move(g, target, var->reg);
+            } else {
+                gen_load(g, node, target);
+            }
+            break;
+        }
+        case NODE_DEREF:
+            gen_load(g, node, target);
+            break;
+        case NODE_CAST:
+            gen_value(g, node->a, target);
+            break;
+        case NODE_UNARY:
+            gen_value(g, node->a, target);
+            cg_alu(g, target, "NOT %s", cg_reg(target));
+            if (node->op == '-') cg_alu(g, target, "INC %s", cg_reg(target));
+            break;
+        case NODE_BINARY:
+            if (cg_is_comparison(node->op)) {
+                // Materializing a truth value: 0, and 1 unless the test fails
+                int skip = cg_new_label(g);
+                cg_load_imm(g, target, 0);
+                gen_cond(g, node, skip, false);
+                cg_load_imm(g, target, 1);
+                cg_label(g, skip);
+            } else {
+                gen_binary(g, node, target);
+            }
+            break;
+        case NODE_ASSIGN:
+            gen_assign(g, node, target);
+            break;
+        case NODE_INCDEC:
+            gen_incdec(g, node, target);
+            break;
+        case NODE_CALL:
+            gen_call(g, node, target);
+            break;
+        case NODE_COND: {
+            int other = cg_new_label(g);
+            int done = cg_new_label(g);
+            gen_cond(g, node->a, other, false);
+            gen_value(g, node->b, target);
+            cg_jump(g, "JMP", done);
+            cg_label(g, other);
+            gen_value(g, node->c, target);
+            cg_label(g, done);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Evaluating for side effects only
+static void gen_effect(Codegen* g, Node* node) {
+    switch (node->kind) {
+        case NODE_ASSIGN:
+            gen_assign(g, node, -1);
+            break;
+        case NODE_INCDEC:
+            gen_incdec(g, node, -1);
+            break;
+        case NODE_CALL:
+            gen_call(g, node, -1);
+            break;
+        case NODE_CAST:
+            gen_effect(g, node->a);
+            break;
+        default:
+            if (ast_has_side_effects(node)) {
+                int temp = gen_temp(g, node, -1);
+                cg_free(g, temp);
+            }
+            break;
+    }
+}
+
+static const char* cg_branch(int op, bool is_unsigned) {
+    switch (op) {
+        case OP_EQ: return "BEQ";
+        case OP_NE: return "BNE";
+        case '<': return is_unsigned ? "BCS" : "BLT";
+        case OP_GE: return is_unsigned ? "BCC" : "BGE";
+        case '>': return "BGT";
+        case OP_LE: return "BLE";
+        default: return "JMP";
+    }
+}
+
+static int cg_invert(int op) {
+    switch (op) {
+        case '<': return OP_GE;
+        case '>': return OP_LE;
+        case OP_LE: return '>';
+        case OP_GE: return '<';
+        case OP_EQ: return OP_NE;
+        default: return OP_EQ;
+    }
+}
+
+// Branching on a signed comparison of two registers. The N flag of CMP
+// is wrong when a - b overflows, which needs operands of opposite sign;
+// then a's own sign decides. Against a constant the signs differ when
+// a's sign is not the constant's; otherwise XOR tests them and is undone.
+// Releases the operands and restores what gen_pair borrowed.
+static void gen_signed_branch(Codegen* g, int op, const Node* b, Operand oa, Operand ob,
+                              uint8_t borrowed, int label) {
+    bool a_less = op == '<' || op == OP_LE;
+    int differ = cg_new_label(g);
+    int done = cg_new_label(g);
+    const char* a_sign;             // Branch taken when the signs differ
+    bool differ_holds;              // Whether the comparison then holds
+    if (b->kind == NODE_NUM) {
+        bool b_negative = (int16_t)b->value < 0;
+        if (g->flags_reg != oa.reg) cg_alu(g, oa.reg, "OR %s, %s", cg_reg(oa.reg), cg_reg(oa.reg));
+        a_sign = b_negative ? "BGE" : "BLT";
+        differ_holds = a_less != b_negative;
+    } else {
+        cg_alu(g, oa.reg, "XOR %s, %s", cg_reg(oa.reg), cg_reg(ob.reg));
+        a_sign = "BLT";
+        differ_holds = false;       // Decided by a's sign after undoing XOR
+    }
+    // With nothing to pop, a decided comparison leaves directly
+    bool direct = !borrowed && b->kind == NODE_NUM;
+    cg_jump(g, a_sign, direct ? (differ_holds ? label : done) : differ);
+
+    if (b->kind != NODE_NUM) cg_alu(g, oa.reg, "XOR %s, %s", cg_reg(oa.reg), cg_reg(ob.reg));
+    cg_alu(g, -1, "CMP %s, %s", cg_reg(oa.reg), cg_reg(ob.reg));
+    cg_release(g, ob);
+    cg_release(g, oa);
+    cg_restore(g, borrowed);
+    cg_jump(g, cg_branch(op, false), label);
+
+    if (!direct) {
+        cg_jump(g, "JMP", done);
+        cg_label(g, differ);
+        if (b->kind != NODE_NUM) cg_alu(g, -1, "XOR %s, %s", cg_reg(oa.reg), cg_reg(ob.reg));
+        // The same pops as cg_restore above, on this path
+        for (int r = 0; r < CG_REGS; r++) {
+            if (borrowed & (1 << r)) cg_emit(g, r, "POP %s", cg_reg(r));
+        }
+        if (b->kind != NODE_NUM) {
+            cg_jump(g, a_less ? "BLT" : "BGE", label);
+        } else if (differ_holds) {
+            cg_jump(g, "JMP", label);
+        }
+    }
+    cg_label(g, done);
+}
+
+// Branching to label when node's truth equals when (falls through
+// otherwise). Comparisons branch on the flags directly.
+static void gen_cond(Codegen* g, Node* node, int label, bool when) {
+    if (node->kind == NODE_NUM) {
+        if ((node->value != 0) == when) cg_jump(g, "JMP", label);
+        return;
+    }
+    if (node->kind == NODE_BINARY && (node->op == OP_ANDAND || node->op == OP_OROR)) {
+        bool is_and = node->op == OP_ANDAND;
+        if (is_and == when) {
+            // Both must hold (&&) / both must fail (||) to branch
+            int skip = cg_new_label(g);
+            gen_cond(g, node->a, skip, !when);
+            gen_cond(g, node->b, label, when);
+            cg_label(g, skip);
+        } else {
+            gen_cond(g, node->a, label, when);
+            gen_cond(g, node->b, label, when);
+        }
+        return;
+    }
+    if (node->kind != NODE_BINARY || !cg_is_comparison(node->op)) {
+        uint8_t borrowed = cg_borrow(g, 1, -1);
+        Operand operand = gen_operand(g, node);
+        if (g->flags_reg != operand.reg) cg_alu(g, operand.reg, "OR %s, %s", cg_reg(operand.reg), cg_reg(operand.reg));
+        cg_release(g, operand);
+        cg_restore(g, borrowed);
+        cg_jump(g, when ? "BNE" : "BEQ", label);
+        return;
+    }
+
+    Node* a = node->a;
+    Node* b = node->b;
+    bool is_unsigned = type_is_unsigned(a->type) || type_is_unsigned(b->type);
+    int op = when ? node->op : cg_invert(node->op);
+
+    if (b->kind == NODE_NUM && b->value == 0) {
+        // Against zero the flags of the value itself decide
+        if (is_unsigned && (op == '<' || op == OP_GE)) {
+            if (op == OP_GE) cg_jump(g, "JMP", label);
+            if (ast_has_side_effects(a)) gen_effect(g, a);
+            return;
+        }
+        if (is_unsigned) op = op == '>' ? OP_NE : op == OP_LE ? OP_EQ : op;
+        uint8_t borrowed = cg_borrow(g, 1, -1);
+        Operand operand = gen_operand(g, a);
+        if (g->flags_reg != operand.reg) cg_alu(g, operand.reg, "OR %s, %s", cg_reg(operand.reg), cg_reg(operand.reg));
+        cg_release(g, operand);
+        cg_restore(g, borrowed);
+        cg_jump(g, cg_branch(op, false), label);
+        return;
+    }
+
+    Operand oa, ob;
+    uint8_t borrowed = gen_pair(g, a, b, -1, &oa, &ob);
+    if (is_unsigned && (op == '>' || op == OP_LE)) {
+        // Only carry is unsigned: a > b is b < a
+        cg_alu(g, -1, "CMP %s, %s", cg_reg(ob.reg), cg_reg(oa.reg));
+        op = op == '>' ? '<' : OP_GE;
+    } else if (!is_unsigned && op != OP_EQ && op != OP_NE && oa.reg != ob.reg) {
+        gen_signed_branch(g, op, b, oa, ob, borrowed, label);
+        return;
+    } else {
+        cg_alu(g, -1, "CMP %s, %s", cg_reg(oa.reg), cg_reg(ob.reg));
+    }
+    cg_release(g, ob);
+    cg_release(g, oa);
+    cg_restore(g, borrowed);
+    cg_jump(g, cg_branch(op, is_unsigned), label);
+}
+
+// ==================
+// Statements
+// ==================
+
+static bool cg_ends_in_jump(const Node* node) {
+    if (!node) return false;
+    if (node->kind == NODE_RETURN || node->kind == NODE_BREAK || node->kind == NODE_CONTINUE) return true;
+    if (node->kind != NODE_BLOCK || !node->a) return false;
+    const Node* last = node->a;
+    while (last->next) last = last->next;
+    return cg_ends_in_jump(last);
+}
+
+static void gen_statement(Codegen* g, Node* node);
+
+static void gen_statements(Codegen* g, Node* first) {
+    for (Node* node = first; node; node = node->next) {
+        gen_statement(g, node);
+        // Anything after a jump in the same block is unreachable
+        if (node->kind == NODE_RETURN || node->kind == NODE_BREAK || node->kind == NODE_CONTINUE) break;
+    }
+}
+
+// Whether a for loop's condition holds on entry: for (i = K; i < N; ...)
+static bool cg_holds_on_entry(Arena* arena, Node* init, Node* cond) {
+    Node* last = init;
+    while (last && last->next) last = last->next;
+    if (!last || last->kind != NODE_EXPR || last->a->kind != NODE_ASSIGN || last->a->op != '=') return false;
+    Node* assign = last->a;
+    if (assign->a->kind != NODE_VAR || assign->b->kind != NODE_NUM) return false;
+    if (cond->kind != NODE_BINARY || cond->a->kind != NODE_VAR || cond->a->var != assign->a->var ||
+        cond->b->kind != NODE_NUM) {
+        return false;
+    }
+    Node* start = ast_num(arena, assign->b->value, assign->a->type, cond->line, cond->column);
+    Node* folded = ast_binary(arena, cond->op, start, cond->b);
+    return folded->kind == NODE_NUM && folded->value != 0;
+}
+
+static void gen_loop(Codegen* g, Node* init, Node* cond, Node* step, Node* body, bool test_first) {
+    int saved_break = g->break_label;
+    int saved_continue = g->continue_label;
+    int top = cg_new_label(g);
+    int next = cg_new_label(g);
+    int done = cg_new_label(g);
+    g->break_label = done;
+    g->continue_label = next;
+
+    gen_statements(g, init);
+    bool forever = !cond || (cond->kind == NODE_NUM && cond->value != 0);
+    if (cond && cond->kind == NODE_NUM && cond->value == 0 && test_first) {
+        g->break_label = saved_break;
+        g->continue_label = saved_continue;
+        return;
+    }
+
+    // The test sits at the bottom; the first one is jumped to unless it
+    // is known to pass
+    int test = cg_new_label(g);
+    Arena scratch = { NULL };
+    if (test_first && !forever && !cg_holds_on_entry(&scratch, init, cond)) cg_jump(g, "JMP", test);
+    arena_free(&scratch);
+    cg_label(g, top);
+    gen_statement(g, body);
+    cg_label(g, next);
+    if (step) gen_effect(g, step);
+    cg_label(g, test);
+    if (forever) cg_jump(g, "JMP", top);
+    else gen_cond(g, cond, top, true);
+    cg_label(g, done);
+
+    g->break_label = saved_break;
+    g->continue_label = saved_continue;
+}
+
+static void gen_statement(Codegen* g, Node* node) {
+    if (!node) return;
+    switch (node->kind) {
+        case NODE_BLOCK:
+            gen_statements(g, node->a);
+            break;
+        case NODE_EXPR:
+            gen_effect(g, node->a);
+            break;
+        case NODE_IF: {
+            if (node->a->kind == NODE_NUM) {
+                gen_statement(g, node->a->value ? node->b : node->c);
+                break;
+            }
+            Node* then = node->b;
+            while (then && then->kind == NODE_BLOCK && then->a && !then->a->next) then = then->a;
+            if (!node->c && then && (then->kind == NODE_BREAK || then->kind == NODE_CONTINUE)) {
+                // if (x) break; branches straight out
+                gen_cond(g, node->a, then->kind == NODE_BREAK ? g->break_label : g->continue_label, true);
+                break;
+            }
+            int other = cg_new_label(g);
+            gen_cond(g, node->a, other, false);
+            gen_statement(g, node->b);
+            if (node->c) {
+                int done = cg_new_label(g);
+                if (!cg_ends_in_jump(node->b)) cg_jump(g, "JMP", done);
+                cg_label(g, other);
+                gen_statement(g, node->c);
+                cg_label(g, done);
+            } else {
+                cg_label(g, other);
+            }
+            break;
+        }
+        case NODE_WHILE:
+            gen_loop(g, NULL, node->a, NULL, node->b, true);
+            break;
+        case NODE_DO:
+            gen_loop(g, NULL, node->a, NULL, node->b, false);
+            break;
+        case NODE_FOR:
+            gen_loop(g, node->c, node->a, node->d, node->b, true);
+            break;
+        case NODE_RETURN:
+            if (node->a) {
+                if (g->var_regs & 1) {
+                    int temp = gen_temp(g, node->a, -1);
+                    cg_move(g, 0, temp);
+                    cg_free(g, temp);
+                } else {
+                    int reg = gen_temp(g, node->a, 0);
+                    cg_move(g, 0, reg);
+                    cg_free(g, reg);
+                }
+            }
+            if (node != g->tail_return) cg_append(&g->text, CG_RETURN_MARK);
+            break;
+        case NODE_BREAK:
+            cg_jump(g, "JMP", g->break_label);
+            break;
+        case NODE_CONTINUE:
+            cg_jump(g, "JMP", g->continue_label);
+            break;
+        default:
+            break;
+    }
+    if (g->held != 0 || g->push_depth != 0) {
+        if (g->errors++ == 0) fprintf(stderr, "Error: Internal register error in '%s'\n", g->func->name);
+        g->held = 0;
+        g->push_depth = 0;
+    }
+}
+
+// ==================
+// Functions
+// ==================
+
+// Whether a function calls anything (a leaf keeps variables in
+// caller-saved registers)
+static bool cg_makes_calls(const Node* node) {
+    if (!node) return false;
+    if (node->kind == NODE_CALL) {
+        if (!node->func->builtin || (strcmp(node->func->name, "putstr") == 0 && node->a->kind != NODE_STR)) {
+            return true;
+        }
+    }
+    if (node->kind == NODE_BINARY || node->kind == NODE_ASSIGN) {
+        bool is_unsigned = type_is_unsigned(node->a->type) || (node->b && type_is_unsigned(node->b->type));
+        if (cg_runtime_op(node->op, is_unsigned) >= 0) return true;
+    }
+    for (const Node* child = node->kind == NODE_CALL || node->kind == NODE_BLOCK ? node->a : NULL; child;
+         child = child->next) {
+        if (cg_makes_calls(child)) return true;
+    }
+    if (node->kind == NODE_CALL || node->kind == NODE_BLOCK) return false;
+    if (node->kind == NODE_FOR) {
+        for (const Node* init = node->c; init; init = init->next) {
+            if (cg_makes_calls(init)) return true;
+        }
+        return cg_makes_calls(node->a) || cg_makes_calls(node->b) || cg_makes_calls(node->d);
+    }
+    return cg_makes_calls(node->a) || cg_makes_calls(node->b) || cg_makes_calls(node->c) ||
+           cg_makes_calls(node->d);
+}
+
+// Giving the heaviest scalar variables registers; the rest get frame
+// slots. A leaf uses any of R1-R6 and leaves parameters where they
+// arrive; a function that calls uses only callee-saved R4-R6, since a
+// caller-saved home would be pushed around every call.
+static void cg_assign_homes(Codegen* g, Func* func, bool leaf) {
+    static const int leaf_order[] = { 1, 2, 3, 4, 5, 6 };
+    static const int call_order[] = { 4, 5, 6 };
+    const int* order = leaf ? leaf_order : call_order;
+    int order_count = leaf ? 6 : 3;
+
+    Var* candidates[256];
+    int count = 0;
+    for (Var* var = func->locals; var; var = var->next) {
+        var->reg = -1;
+        if (var->type.length < 0 && !var->address_taken && var->weight > 0 && count < 256) {
+            // Insertion by weight, stable for equal weights
+            int i = count++;
+            while (i > 0 && candidates[i - 1]->weight < var->weight) {
+                candidates[i] = candidates[i - 1];
+                i--;
+            }
+            candidates[i] = var;
+        }
+    }
+    if (count > CC_MAX_REG_VARS) count = CC_MAX_REG_VARS;
+    if (count > order_count) count = order_count;
+
+    // Registers where kept parameters arrive are left to them
+    uint8_t arrivals = 0;
+    for (int i = 0; i < count && leaf; i++) {
+        if (candidates[i]->kind == VAR_PARAM) arrivals |= (uint8_t)(1 << candidates[i]->index);
+    }
+    for (int i = 0; i < count; i++) {
+        Var* var = candidates[i];
+        int reg = -1;
+        if (leaf && var->kind == VAR_PARAM) reg = var->index;
+        for (int k = 0; k < order_count && reg < 0; k++) {
+            if (!((g->var_regs | arrivals) & (1 << order[k]))) reg = order[k];
+        }
+        var->reg = reg;
+        g->var_regs |= (uint8_t)(1 << reg);
+    }
+
+    g->frame_size = 0;
+    for (Var* var = func->locals; var; var = var->next) {
+        if (var->reg >= 0) continue;
+        var->slot = g->frame_size;
+        g->frame_size += (int)cg_data_words(&var->type);
+    }
+}
+
+// Moving parameters from R0-R3 to their homes
+static void gen_params(Codegen* g, Func* func) {
+    int dst[CC_MAX_PARAMS], src[CC_MAX_PARAMS];
+    int moves = 0;
+    for (int i = 0; i < func->param_count; i++) {
+        Var* param = func->params[i];
+        if (param->reg >= 0) {
+            dst[moves] = param->reg;
+            src[moves++] = i;
+        } else if (param->weight > 0 || param->address_taken) {
+            Address address = { ADDR_STACK, "", 0, param->slot, NULL };
+            char text[112];
+            int scratch = func->param_count;
+            Operand where = cg_address_operand(g, &address, scratch);
+            cg_emit(g, -1, "ST %s, %s", cg_address_text(&address, where, text, sizeof(text)), cg_reg(i));
+        }
+    }
+    cg_parallel_move(g, dst, src, moves);
+}
+
+static void cg_signature(CgBuffer* out, const Func* func) {
+    static const char* const bases[] = { "void", "int", "unsigned" };
+    cg_append(out, "; %s", bases[func->ret.base]);
+    for (int i = 0; i < func->ret.pointers; i++) cg_append(out, "*");
+    cg_append(out, " %s(", func->name);
+    for (int i = 0; i < func->param_count; i++) {
+        const Var* param = func->params[i];
+        cg_append(out, "%s%s ", i ? ", " : "", bases[param->type.base]);
+        for (int k = 0; k < param->type.pointers; k++) cg_append(out, "*");
+        cg_append(out, "%s", param->name);
+        if (param->reg >= 0) cg_append(out, " in %s", cg_reg(param->reg));
+    }
+    cg_append(out, "%s)\n", func->param_count ? "" : "void");
+}
+
+static void gen_function(Codegen* g, Func* func) {
+    g->func = func;
+    g->held = 0;
+    g->var_regs = 0;
+    g->used = 0;
+    g->push_depth = 0;
+    g->flags_reg = -1;
+    g->text.size = 0;
+    bool leaf = !cg_makes_calls(func->body);
+    cg_assign_homes(g, func, leaf);
+
+    g->tail_return = NULL;
+    for (const Node* last = func->body->a; last; last = last->next) {
+        if (!last->next && last->kind == NODE_RETURN) g->tail_return = last;
+    }
+    gen_params(g, func);
+    gen_statement(g, func->body);
+
+    // Prologue and epilogue, now that the registers used are known
+    bool is_main = strcmp(func->name, "main") == 0;
+    uint8_t saves = is_main ? 0 : (uint8_t)((g->used | g->var_regs) & CG_CALLEE_SAVED);
+    bool bare = saves == 0 && g->frame_size == 0;
+    int epilogue = cg_new_label(g);
+    char imm[16];
+
+    cg_append(&g->out, "\n");
+    cg_signature(&g->out, func);
+    cg_append(&g->out, "_%s:\n", func->name);
+    // Two or more saves go in one PUSHM/POPM
+    bool multiple = (saves & (saves - 1)) != 0;
+    char list[32] = "";
+    for (int r = 4; r < CG_REGS; r++) {
+        if (!(saves & (1 << r))) continue;
+        if (!multiple) cg_append(&g->out, "    PUSH %s\n", cg_reg(r));
+        else snprintf(list + strlen(list), sizeof(list) - strlen(list), "%s%s", list[0] ? ", " : "", cg_reg(r));
+    }
+    if (multiple) cg_append(&g->out, "    PUSHM %s\n", list);
+    if (g->frame_size > 0) cg_append(&g->out, "    SUBI SP, %s\n", cg_imm(g->frame_size, imm));
+
+    // Returns jump to the epilogue, or are a plain RET without one
+    const char* text = g->text.data ? g->text.data : "";
+    const char* mark;
+    size_t mark_length = strlen(CG_RETURN_MARK);
+    while ((mark = strstr(text, CG_RETURN_MARK)) != NULL) {
+        cg_append(&g->out, "%.*s", (int)(mark - text), text);
+        if (bare) cg_append(&g->out, "    RET\n");
+        else cg_append(&g->out, "    JMP L%d\n", epilogue);
+        text = mark + mark_length;
+    }
+    cg_append(&g->out, "%s", text);
+
+    if (!bare) cg_append(&g->out, "L%d:\n", epilogue);
+    if (g->frame_size > 0) cg_append(&g->out, "    ADDI SP, %s\n", cg_imm(g->frame_size, imm));
+    for (int r = CG_REGS - 1; r >= 4 && !multiple; r--) {
+        if (saves & (1 << r)) cg_append(&g->out, "    POP %s\n", cg_reg(r));
+    }
+    if (multiple) cg_append(&g->out, "    POPM %s\n", list);
+    cg_append(&g->out, "    RET\n");
+}
+
+// ==================
+// Program
+// ==================
+
+static void gen_runtime(Codegen* g) {
+    static const char* const bodies[RT_COUNT] = {
+        // R0 = R0 / R1, signed (DIV is unsigned: divide magnitudes, fix the sign)
+        "rt_divs:\n"
+        "    MOV R2, R0\n    XOR R2, R1\n"
+        "    OR R0, R0\n    BGE rt_divs_a\n    NOT R0\n    INC R0\n"
+        "rt_divs_a:\n    OR R1, R1\n    BGE rt_divs_b\n    NOT R1\n    INC R1\n"
+        "rt_divs_b:\n    DIV R0, R1\n    OR R2, R2\n    BGE rt_divs_c\n    NOT R0\n    INC R0\n"
+        "rt_divs_c:\n    RET\n",
+        // R0 = R0 % R1, signed (the remainder takes the dividend's sign)
+        "rt_mods:\n"
+        "    MOV R2, R0\n"
+        "    OR R0, R0\n    BGE rt_mods_a\n    NOT R0\n    INC R0\n"
+        "rt_mods_a:\n    OR R1, R1\n    BGE rt_mods_b\n    NOT R1\n    INC R1\n"
+        "rt_mods_b:\n    MOV R3, R0\n    DIV R3, R1\n    MUL R3, R1\n    SUB R0, R3\n"
+        "    OR R2, R2\n    BGE rt_mods_c\n    NOT R0\n    INC R0\n"
+        "rt_mods_c:\n    RET\n",
+        // R0 = R0 % R1, unsigned
+        "rt_modu:\n"
+        "    MOV R2, R0\n    DIV R2, R1\n    MUL R2, R1\n    SUB R0, R2\n    RET\n",
+        // Prints the one-character-per-word string at R0
+        "rt_putstr:\n"
+        "    LD R1, [R0]+\n    OR R1, R1\n    BEQ rt_putstr_done\n"
+        "    ST [0xF800], R1\n    JMP rt_putstr\n"
+        "rt_putstr_done:\n    RET\n",
+    };
+    bool any = false;
+    for (int i = 0; i < RT_COUNT; i++) {
+        if (!g->runtime_used[i]) continue;
+        if (!any) cg_append(&g->out, "\n; Runtime support\n");
+        any = true;
+        cg_append(&g->out, "\n%s", bodies[i]);
+    }
+}
+
+static bool cg_plain_text(const char* text, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c < 0x20 || c > 0x7E || c == '"' || c == '\\' || c == ';') return false;
+    }
+    return length > 0;
+}
+
+static void gen_words(CgBuffer* out, const int32_t* values, size_t count) {
+    char imm[16];
+    for (size_t i = 0; i < count; i += 8) {
+        cg_append(out, "    .WORD ");
+        for (size_t k = i; k < count && k < i + 8; k++) {
+            cg_append(out, "%s%s", k > i ? ", " : "", cg_imm(values[k], imm));
+        }
+        cg_append(out, "\n");
+    }
+}
+
+static void gen_zeros(CgBuffer* out, uint32_t count) {
+    if (count == 0) return;
+    if (count <= 8) {
+        int32_t zeros[8] = { 0 };
+        gen_words(out, zeros, count);
+        return;
+    }
+    cg_append(out, "    .REPT %u\n    .WORD 0\n    .ENDR\n", count);
+}
+
+// Writing a global's initial value (its slot is already laid out)
+static void gen_global_data(Codegen* g, const Var* var) {
+    uint32_t words = cg_data_words(&var->type);
+    int32_t* values = (int32_t*)calloc(words, sizeof(int32_t));
+    uint32_t count = 0;
+    const Node* init = var->init;
+    if (init && init->kind == NODE_INIT_LIST) {
+        for (const Node* item = init->a; item && count < words; item = item->next) {
+            values[count++] = item->kind == NODE_STR ? -1 : item->value;
+        }
+    } else if (init && init->kind == NODE_STR && var->type.length >= 0) {
+        const CcString* string = &g->program->strings[init->value];
+        for (size_t i = 0; i < string->length && count < words; i++) values[count++] = (unsigned char)string->text[i];
+    } else if (init) {
+        values[count++] = init->kind == NODE_STR ? -1 : init->value;
+    }
+
+    // Pointers to literals are written by label
+    const Node* item = init && init->kind == NODE_INIT_LIST ? init->a : init;
+    bool has_labels = false;
+    for (uint32_t i = 0; i < count && item; i++, item = init->kind == NODE_INIT_LIST ? item->next : NULL) {
+        if (item->kind == NODE_STR && !(init->kind == NODE_STR && var->type.length >= 0)) has_labels = true;
+    }
+    if (!has_labels) {
+        gen_words(&g->out, values, count);
+    } else {
+        item = init->kind == NODE_INIT_LIST ? init->a : init;
+        for (uint32_t i = 0; i < count; i++, item = init->kind == NODE_INIT_LIST ? item->next : NULL) {
+            if (item->kind == NODE_STR) cg_append(&g->out, "    .WORD S%d\n", item->value);
+            else gen_words(&g->out, &values[i], 1);
+        }
+    }
+    gen_zeros(&g->out, words - count);
+    free(values);
+}
+
+static void gen_data(Codegen* g) {
+    const Program* program = g->program;
+    cg_append(&g->out, "\n; Data\n.ORG 0x%04X\n", g->data_base);
+    char name[80];
+    for (const Var* var = program->globals; var; var = var->next) {
+        cg_append(&g->out, "; %s\n", cg_global_name(var, name, sizeof(name)));
+        gen_global_data(g, var);
+    }
+
+    // Literals in the order they were placed, after the globals
+    for (uint32_t offset = g->globals_size; offset < g->data_size;) {
+        bool found = false;
+        for (int i = 0; i < program->string_count && !found; i++) {
+            const CcString* string = &program->strings[i];
+            if (g->word_strings[i] == (int)offset) {
+                int32_t* values = (int32_t*)calloc(string->length + 1, sizeof(int32_t));
+                for (size_t k = 0; k < string->length; k++) values[k] = (unsigned char)string->text[k];
+                cg_append(&g->out, "; S%d\n", i);
+                gen_words(&g->out, values, string->length + 1);
+                free(values);
+                offset += (uint32_t)string->length + 1;
+                found = true;
+            } else if (g->packed_strings[i] == (int)offset) {
+                cg_append(&g->out, "; PS%d\n", i);
+                if (cg_plain_text(string->text, string->length)) {
+                    cg_append(&g->out, "    .STRING \"%.*s\"\n", (int)string->length, string->text);
+                } else {
+                    size_t words = cg_packed_words(string->length);
+                    int32_t* values = (int32_t*)calloc(words, sizeof(int32_t));
+                    for (size_t k = 0; k < string->length; k++) {
+                        values[k / 2] |= (unsigned char)string->text[k] << (k % 2 ? 8 : 0);
+                    }
+                    gen_words(&g->out, values, words);
+                    free(values);
+                }
+                offset += cg_packed_words(string->length);
+                found = true;
+            }
+        }
+        if (!found) break;
+    }
+}
+
+bool codegen_program(const Program* program, FILE* out, const char* source_name, uint16_t data_base) {
+    Codegen g;
+    memset(&g, 0, sizeof(g));
+    g.program = program;
+    g.data_base = data_base;
+    g.word_strings = (int*)malloc((program->string_count + 1) * sizeof(int));
+    g.packed_strings = (int*)malloc((program->string_count + 1) * sizeof(int));
+    for (int i = 0; i < program->string_count; i++) {
+        g.word_strings[i] = -1;
+        g.packed_strings[i] = -1;
+    }
+
+    // Globals come first in the data area; literals follow as they are used
+    for (Var* var = program->globals; var; var = var->next) {
+        var->slot = (int)g.data_size;
+        g.data_size += cg_data_words(&var->type);
+    }
+    g.globals_size = g.data_size;
+    for (Var* var = program->globals; var; var = var->next) {
+        if (!var->init) continue;
+        const Node* item = var->init->kind == NODE_INIT_LIST ? var->init->a : var->init;
+        for (; item; item = var->init->kind == NODE_INIT_LIST ? item->next : NULL) {
+            if (item->kind == NODE_STR && !(var->init->kind == NODE_STR && var->type.length >= 0)) {
+                cg_string(&g, item->value, false);
+            }
+        }
+    }
+
+    Func* main_func = program_find_func(program, "main");
+    if (!main_func || !main_func->body) {
+        fprintf(stderr, "Error: No main function\n");
+        g.errors++;
+    }
+    for (Func* func = program->funcs; func; func = func->next) {
+        if (func->body) gen_function(&g, func);
+    }
+    gen_runtime(&g);
+
+    if (g.errors == 0 && (uint32_t)data_base + g.data_size > STACK_START - 256 && data_base < STACK_START) {
+        fprintf(stderr, "Error: %u words of data at 0x%04X leave no room for the stack below 0x%04X\n",
+                g.data_size, data_base, STACK_START);
+        g.errors++;
+    }
+
+    if (g.errors == 0) {
+        fprintf(out, "; Generated by cc16 from %s\n", source_name);
+        fprintf(out, "; Data at 0x%04X, stack from 0x%04X down\n\n", data_base, STACK_START);
+        char name[80];
+        for (const Var* var = program->globals; var; var = var->next) {
+            fprintf(out, ".EQU %s, 0x%04X\n", cg_global_name(var, name, sizeof(name)), data_base + var->slot);
+        }
+        for (int i = 0; i < program->string_count; i++) {
+            if (g.word_strings[i] >= 0) fprintf(out, ".EQU S%d, 0x%04X\n", i, data_base + g.word_strings[i]);
+            if (g.packed_strings[i] >= 0) fprintf(out, ".EQU PS%d, 0x%04X\n", i, data_base + g.packed_strings[i]);
+        }
+        fprintf(out, "\n.ORG 0x0000\n    CALL _main\n    HALT\n");
+        gen_data(&g);
+        fwrite(g.out.data, 1, g.out.size, out);
+    }
+
+    free(g.word_strings);
+    free(g.packed_strings);
+    free(g.out.data);
+    free(g.text.data);
+    return g.errors == 0;
+}
@@ -0,0 +1,28 @@
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+#include "parser.h"
+#include <stdio.h>
+
+// Code generator: writes SimpleCPU16 assembly for a parsed program.
+//
+// Calling convention (as in programs/factorial.asm): arguments in R0-R3,
+// result in R0, R0-R3 caller-saved, R4-R6 callee-saved, R7 (SP) starts
+// at STACK_START and grows down. The stub at 0x0000 calls main and
+// halts. Globals and string literals live at a fixed data address and
+// are named with .EQU, so they can appear in operand expressions.
+//
+// Registers: up to CC_MAX_REG_VARS scalar variables per function whose
+// address is never taken get a register for their whole lifetime,
+// chosen by use count weighted by loop depth (only callee-saved R4-R6
+// in functions that call, any of R1-R6 in leaves). The remaining
+// registers are expression temporaries, allocated in Sethi-Ullman order
+// so subexpressions that need more registers are evaluated first, with a
+// push/pop fallback when they run out. Other locals live in the frame.
+
+#define CC_MAX_REG_VARS 4
+#define CC_DATA_BASE 0xD000     // Default data address (below the stack)
+
+bool codegen_program(const Program* program, FILE* out, const char* source_name, uint16_t data_base);
+
+#endif // CODEGEN_H
@@ -0,0 +1,251 @@
+#include "lexer.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char* src;
+    size_t size;
+    size_t pos;
+    int line;
+    size_t line_start;
+    int errors;
+} Lexer;
+
+static void lex_error(Lexer* lexer, size_t at, const char* message) {
+    fprintf(stderr, "Error: %s (line %d, column %d)\n", message, lexer->line, (int)(at - lexer->line_start) + 1);
+    lexer->errors++;
+}
+
+static int lex_peek(const Lexer* lexer, size_t ahead) {
+    return lexer->pos + ahead < lexer->size ? (unsigned char)lexer->src[lexer->pos + ahead] : 0;
+}
+
+// Skipping whitespace, comments and preprocessor lines
+static void lex_skip(Lexer* lexer) {
+    bool line_start = lexer->pos == lexer->line_start;
+    while (lexer->pos < lexer->size) {
+        int c = lex_peek(lexer, 0);
+        if (c == '\n') {
+            lexer->pos++;
+            lexer->line++;
+            lexer->line_start = lexer->pos;
+            line_start = true;
+        } else if (isspace(c)) {
+            lexer->pos++;
+        } else if (c == '/' && lex_peek(lexer, 1) == '/') {
+            while (lexer->pos < lexer->size && lex_peek(lexer, 0) != '\n') lexer->pos++;
+        } else if (c == '/' && lex_peek(lexer, 1) == '*') {
+            size_t start = lexer->pos;
+            lexer->pos += 2;
+            while (lexer->pos < lexer->size && !(lex_peek(lexer, 0) == '*' && lex_peek(lexer, 1) == '/')) {
+                if (lex_peek(lexer, 0) == '\n') {
+                    lexer->line++;
+                    lexer->line_start = lexer->pos + 1;
+                }
+                lexer->pos++;
+            }
+            if (lexer->pos >= lexer->size) {
+                lex_error(lexer, start, "Unterminated comment");
+                return;
+            }
+            lexer->pos += 2;
+        } else if (c == '#' && line_start) {
+            // #include and #pragma are ignored (there is no library to include)
+            size_t start = lexer->pos;
+            while (lexer->pos < lexer->size && lex_peek(lexer, 0) != '\n') lexer->pos++;
+            size_t length = lexer->pos - start;
+            if (!(length >= 8 && strncmp(lexer->src + start, "#include", 8) == 0) &&
+                !(length >= 7 && strncmp(lexer->src + start, "#pragma", 7) == 0)) {
+                lex_error(lexer, start, "Only #include and #pragma preprocessor lines are supported");
+            }
+        } else {
+            return;
+        }
+    }
+}
+
+// Reading one character of a character or string literal
+static int lex_char(Lexer* lexer) {
+    int c = lex_peek(lexer, 0);
+    lexer->pos++;
+    if (c != '\\') return c;
+
+    size_t at = lexer->pos - 1;
+    c = lex_peek(lexer, 0);
+    lexer->pos++;
+    switch (c) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+        case '0': return 0;
+        case 'a': return 7;
+        case 'b': return 8;
+        case 'f': return 12;
+        case 'v': return 11;
+        case '\\': case '\'': case '"': case '?': return c;
+        case 'x': {
+            int value = 0, digits = 0;
+            while (isxdigit(lex_peek(lexer, 0)) && digits < 4) {
+                int d = tolower(lex_peek(lexer, 0));
+                value = value * 16 + (isdigit(d) ? d - '0' : d - 'a' + 10);
+                lexer->pos++;
+                digits++;
+            }
+            if (digits == 0) lex_error(lexer, at, "Invalid \\x escape");
+            return value;
+        }
+        default:
+            lex_error(lexer, at, "Unknown escape sequence");
+            return c;
+    }
+}
+
+static bool lex_number(Lexer* lexer, Token* token) {
+    const char* s = lexer->src;
+    size_t start = lexer->pos;
+    uint32_t value = 0;
+    int base = 10;
+    if (s[lexer->pos] == '0' && (lex_peek(lexer, 1) == 'x' || lex_peek(lexer, 1) == 'X')) {
+        base = 16;
+        lexer->pos += 2;
+    } else if (s[lexer->pos] == '0' && (lex_peek(lexer, 1) == 'b' || lex_peek(lexer, 1) == 'B')) {
+        base = 2;
+        lexer->pos += 2;
+    } else if (s[lexer->pos] == '0') {
+        base = 8;
+    }
+
+    size_t digits = lexer->pos;
+    bool overflow = false;
+    while (isxdigit(lex_peek(lexer, 0))) {
+        int c = tolower(lex_peek(lexer, 0));
+        int digit = isdigit(c) ? c - '0' : c - 'a' + 10;
+        if (digit >= base) break;
+        value = value * base + digit;
+        if (value > 0xFFFF) overflow = true;
+        lexer->pos++;
+    }
+    token->is_unsigned = false;
+    while (tolower(lex_peek(lexer, 0)) == 'u' || tolower(lex_peek(lexer, 0)) == 'l') {
+        if (tolower(lex_peek(lexer, 0)) == 'u') token->is_unsigned = true;
+        lexer->pos++;
+    }
+    if (lexer->pos == digits || isalnum(lex_peek(lexer, 0)) || lex_peek(lexer, 0) == '_') {
+        lex_error(lexer, start, "Invalid number");
+        return false;
+    }
+    if (overflow) {
+        lex_error(lexer, start, "Constant does not fit in 16 bits");
+        return false;
+    }
+    // Like C, a decimal constant too big for int is not negative
+    if (value > 0x7FFF) token->is_unsigned = true;
+    token->kind = TOK_NUM;
+    token->value = (int32_t)value;
+    return true;
+}
+
+// Matching multi-character punctuators, longest first
+static bool lex_punct(Lexer* lexer, Token* token) {
+    static const struct {
+        const char* text;
+        int kind;
+        int value;
+    } puncts[] = {
+        { "<<=", TOK_ASSIGN_OP, OP_SHL }, { ">>=", TOK_ASSIGN_OP, OP_SHR },
+        { "<<", OP_SHL, 0 }, { ">>", OP_SHR, 0 }, { "==", OP_EQ, 0 }, { "!=", OP_NE, 0 },
+        { "<=", OP_LE, 0 }, { ">=", OP_GE, 0 }, { "&&", OP_ANDAND, 0 }, { "||", OP_OROR, 0 },
+        { "++", TOK_INC, 0 }, { "--", TOK_DEC, 0 },
+        { "+=", TOK_ASSIGN_OP, '+' }, { "-=", TOK_ASSIGN_OP, '-' }, { "*=", TOK_ASSIGN_OP, '*' },
+        { "/=", TOK_ASSIGN_OP, '/' }, { "%=", TOK_ASSIGN_OP, '%' }, { "&=", TOK_ASSIGN_OP, '&' },
+        { "|=", TOK_ASSIGN_OP, '|' }, { "^=", TOK_ASSIGN_OP, '^' },
+    };
+    for (size_t i = 0; i < sizeof(puncts) / sizeof(puncts[0]); i++) {
+        size_t length = strlen(puncts[i].text);
+        if (lexer->pos + length <= lexer->size && memcmp(lexer->src + lexer->pos, puncts[i].text, length) == 0) {
+            token->kind = puncts[i].kind;
+            token->value = puncts[i].value;
+            lexer->pos += length;
+            return true;
+        }
+    }
+    if (strchr("+-*/%&|^~!<>=?:;,(){}[]", lex_peek(lexer, 0))) {
+        token->kind = lex_peek(lexer, 0);
+        lexer->pos++;
+        return true;
+    }
+    return false;
+}
+
+bool lex_source(Arena* arena, const char* source, size_t size, Token** tokens, int* count) {
+    Lexer lexer = { source, size, 0, 1, 0, 0 };
+    int capacity = 1024;
+    *tokens = (Token*)malloc(capacity * sizeof(Token));
+    *count = 0;
+
+    for (;;) {
+        lex_skip(&lexer);
+        if (*count == capacity) {
+            capacity *= 2;
+            *tokens = (Token*)realloc(*tokens, capacity * sizeof(Token));
+        }
+        Token* token = &(*tokens)[*count];
+        memset(token, 0, sizeof(Token));
+        token->line = lexer.line;
+        token->column = (int)(lexer.pos - lexer.line_start) + 1;
+        token->text = source + lexer.pos;
+        if (lexer.pos >= size) {
+            token->kind = TOK_EOF;
+            (*count)++;
+            break;
+        }
+
+        int c = lex_peek(&lexer, 0);
+        size_t start = lexer.pos;
+        if (isalpha(c) || c == '_') {
+            while (isalnum(lex_peek(&lexer, 0)) || lex_peek(&lexer, 0) == '_') lexer.pos++;
+            token->kind = TOK_IDENT;
+            token->length = lexer.pos - start;
+        } else if (isdigit(c)) {
+            if (!lex_number(&lexer, token)) {
+                while (isalnum(lex_peek(&lexer, 0))) lexer.pos++;
+                continue;
+            }
+        } else if (c == '\'') {
+            lexer.pos++;
+            token->kind = TOK_NUM;
+            token->value = lex_char(&lexer);
+            if (lex_peek(&lexer, 0) != '\'') {
+                lex_error(&lexer, start, "Invalid character constant");
+                continue;
+            }
+            lexer.pos++;
+        } else if (c == '"') {
+            // Decoding into a copy (never longer than the source text)
+            lexer.pos++;
+            size_t end = lexer.pos;
+            while (end < size && source[end] != '"' && source[end] != '\n') end += source[end] == '\\' ? 2 : 1;
+            char* text = (char*)arena_alloc(arena, end - lexer.pos + 1);
+            size_t length = 0;
+            while (lexer.pos < size && lex_peek(&lexer, 0) != '"' && lex_peek(&lexer, 0) != '\n') {
+                text[length++] = (char)lex_char(&lexer);
+            }
+            if (lex_peek(&lexer, 0) != '"') {
+                lex_error(&lexer, start, "Unterminated string");
+                continue;
+            }
+            lexer.pos++;
+            token->kind = TOK_STRING;
+            token->text = text;
+            token->length = length;
+        } else if (!lex_punct(&lexer, token)) {
+            lex_error(&lexer, start, "Unexpected character");
+            lexer.pos++;
+            continue;
+        }
+        (*count)++;
+    }
+    return lexer.errors == 0;
+}
@@ -0,0 +1,35 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include "ast.h"
+
+// Tokenizer for the C subset. The whole source is tokenized up front so
+// the parser can look ahead (casts). Keywords are identifiers; the
+// parser matches them by text. Single-character punctuators use their
+// ASCII code as the kind, and the multi-character binary operators share
+// their codes with the OP_* node operators.
+
+enum {
+    TOK_EOF = 0,
+    TOK_NUM = 300,              // value, is_unsigned
+    TOK_IDENT,                  // text, length (points into the source)
+    TOK_STRING,                 // text, length (escapes decoded, in the arena)
+    TOK_INC,                    // ++
+    TOK_DEC,                    // --
+    TOK_ASSIGN_OP               // op= (value is the operator)
+};
+
+typedef struct {
+    int kind;
+    int32_t value;
+    bool is_unsigned;
+    const char* text;
+    size_t length;
+    int line;
+    int column;
+} Token;
+
+// Tokenizing source (returns false after printing errors)
+bool lex_source(Arena* arena, const char* source, size_t size, Token** tokens, int* count);
+
+#endif // LEXER_H
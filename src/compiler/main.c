@@ -0,0 +1,103 @@
+#include "parser.h"
+#include "codegen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void print_usage(const char* program_name) {
+    printf("SimpleCPU16 C Compiler\n");
+    printf("Usage: %s <input.c> -o <output.asm> [options]\n", program_name);
+    printf("  <input.c>       C source file\n");
+    printf("  -o <output>     Output assembly file (\"-\" for stdout)\n");
+    printf("  --data <addr>   Address of globals and string literals (default 0x%04X)\n", CC_DATA_BASE);
+}
+
+// Reading a whole file into memory
+static char* cc_read_file(const char* filename, size_t* size) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open input file '%s'\n", filename);
+        return NULL;
+    }
+    size_t capacity = 4096;
+    char* data = (char*)malloc(capacity);
+    *size = 0;
+    size_t count;
+    while ((count = fread(data + *size, 1, capacity - *size, file)) > 0) {
+        *size += count;
+        if (*size == capacity) {
+            capacity *= 2;
+            data = (char*)realloc(data, capacity);
+        }
+    }
+    fclose(file);
+    return data;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const char* input_file = argv[1];
+    const char* output_file = NULL;
+    uint16_t data_base = CC_DATA_BASE;
+
+    // Parsing command-line arguments
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output_file = argv[++i];
+        } else if (strcmp(argv[i], "--data") == 0 && i + 1 < argc) {
+            char* end;
+            unsigned long value = strtoul(argv[++i], &end, 0);
+            if (*end != '\0' || value > 0xFFFF) {
+                fprintf(stderr, "Error: Invalid data address '%s'\n", argv[i]);
+                return 1;
+            }
+            data_base = (uint16_t)value;
+        }
+    }
+
+    if (!output_file) {
+        fprintf(stderr, "Error: No output file specified\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // Keeping stdout clean for the assembly when writing to a pipe
+    bool to_stdout = strcmp(output_file, "-") == 0;
+    FILE* info = to_stdout ? stderr : stdout;
+    fprintf(info, "SimpleCPU16 C Compiler v1.0\n");
+    fprintf(info, "===========================\n\n");
+    fprintf(info, "Input:  %s\n", input_file);
+    fprintf(info, "Output: %s\n\n", output_file);
+
+    size_t size;
+    char* source = cc_read_file(input_file, &size);
+    if (!source) return 1;
+
+    Program program;
+    bool success = parse_program(&program, source, size);
+    if (success) {
+        FILE* out = to_stdout ? stdout : fopen(output_file, "w");
+        if (!out) {
+            fprintf(stderr, "Error: Cannot create output file '%s'\n", output_file);
+            success = false;
+        } else {
+            success = codegen_program(&program, out, input_file, data_base);
+            if (!to_stdout) fclose(out);
+            if (!success && !to_stdout) remove(output_file);
+        }
+    }
+    program_free(&program);
+    free(source);
+
+    if (success) {
+        fprintf(info, "Compilation successful!\n");
+        return 0;
+    } else {
+        fprintf(stderr, "\nCompilation failed!\n");
+        return 1;
+    }
+}
@@ -0,0 +1,915 @@
+#include "parser.h"
+#include "lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char* name;
+    size_t length;
+    Var* var;
+} ScopeEntry;
+
+typedef struct {
+    Program* program;
+    Arena* arena;
+    Token* tokens;
+    int count;
+    int pos;
+    ScopeEntry* names;          // Innermost last
+    int name_count;
+    int name_capacity;
+    int scope_start;            // First entry of the innermost scope
+    Func* func;                 // Function being parsed
+    int loop_depth;             // Loops enclosing the current point
+    int errors;
+} Parser;
+
+static const char* const parse_type_words[] = {
+    "int", "unsigned", "signed", "char", "short", "long", "void", "const", "volatile", "register",
+    "static", "extern", NULL
+};
+
+static const char* const parse_keywords[] = {
+    "if", "else", "while", "do", "for", "return", "break", "continue", "sizeof", NULL
+};
+
+static Token* parse_peek(Parser* p, int ahead) {
+    int index = p->pos + ahead;
+    return &p->tokens[index < p->count ? index : p->count - 1];
+}
+
+static Token* parse_next(Parser* p) {
+    Token* token = parse_peek(p, 0);
+    if (p->pos < p->count - 1) p->pos++;
+    return token;
+}
+
+// Reporting an error and abandoning the rest of the file: every parse
+// function stops at EOF, so the recursion unwinds without extra checks
+static void parse_error(Parser* p, const Token* token, const char* format, const char* name, size_t length) {
+    fprintf(stderr, "Error: ");
+    fprintf(stderr, format, (int)length, name);
+    fprintf(stderr, " (line %d, column %d)\n", token->line, token->column);
+    p->errors++;
+    p->pos = p->count - 1;
+}
+
+static bool parse_is(Parser* p, int kind) {
+    return parse_peek(p, 0)->kind == kind;
+}
+
+static bool parse_accept(Parser* p, int kind) {
+    if (!parse_is(p, kind)) return false;
+    parse_next(p);
+    return true;
+}
+
+static void parse_expect(Parser* p, int kind) {
+    if (parse_accept(p, kind)) return;
+    Token* token = parse_peek(p, 0);
+    char expected[2] = { (char)kind, '\0' };
+    if (token->kind == TOK_EOF && p->errors > 0) return;
+    parse_error(p, token, "Expected '%.*s'", expected, 1);
+}
+
+static bool parse_word_is(const Token* token, const char* word) {
+    return token->kind == TOK_IDENT && token->length == strlen(word) && strncmp(token->text, word, token->length) == 0;
+}
+
+static bool parse_accept_word(Parser* p, const char* word) {
+    if (!parse_word_is(parse_peek(p, 0), word)) return false;
+    parse_next(p);
+    return true;
+}
+
+static bool parse_in_list(const Token* token, const char* const words[]) {
+    for (int i = 0; words[i]; i++) {
+        if (parse_word_is(token, words[i])) return true;
+    }
+    return false;
+}
+
+static bool parse_is_type(Parser* p, int ahead) {
+    return parse_in_list(parse_peek(p, ahead), parse_type_words);
+}
+
+// Expecting a non-keyword identifier
+static Token* parse_name(Parser* p) {
+    Token* token = parse_peek(p, 0);
+    if (token->kind != TOK_IDENT || parse_in_list(token, parse_keywords) || parse_in_list(token, parse_type_words)) {
+        if (token->kind != TOK_EOF || p->errors == 0) parse_error(p, token, "Expected a name%.*s", "", 0);
+        return token;
+    }
+    return parse_next(p);
+}
+
+// ==================
+// Scopes
+// ==================
+
+static Var* parse_lookup(Parser* p, const char* name, size_t length) {
+    for (int i = p->name_count - 1; i >= 0; i--) {
+        if (p->names[i].length == length && memcmp(p->names[i].name, name, length) == 0) return p->names[i].var;
+    }
+    return NULL;
+}
+
+static Var* parse_declare(Parser* p, const Token* name, CType type, VarKind kind) {
+    for (int i = p->scope_start; i < p->name_count && name->length > 0; i++) {
+        if (p->names[i].length == name->length && memcmp(p->names[i].name, name->text, name->length) == 0) {
+            parse_error(p, name, "Redefinition of '%.*s'", name->text, name->length);
+            break;
+        }
+    }
+    if (p->name_count == p->name_capacity) {
+        p->name_capacity = p->name_capacity ? p->name_capacity * 2 : 64;
+        p->names = (ScopeEntry*)realloc(p->names, p->name_capacity * sizeof(ScopeEntry));
+    }
+    Var* var = (Var*)arena_alloc(p->arena, sizeof(Var));
+    var->name = arena_strndup(p->arena, name->text, name->length);
+    var->type = type;
+    var->kind = (uint8_t)kind;
+    var->reg = -1;
+    p->names[p->name_count].name = var->name;
+    p->names[p->name_count].length = name->length;
+    p->names[p->name_count++].var = var;
+
+    // Appending to the global or the function's variable list
+    Var** tail = kind == VAR_GLOBAL ? &p->program->globals : &p->func->locals;
+    while (*tail) tail = &(*tail)->next;
+    *tail = var;
+    return var;
+}
+
+Func* program_find_func(const Program* program, const char* name) {
+    for (Func* func = program->funcs; func; func = func->next) {
+        if (strcmp(func->name, name) == 0) return func;
+    }
+    return NULL;
+}
+
+// ==================
+// Types
+// ==================
+
+// Reading declaration specifiers (false if there were none)
+static bool parse_specifiers(Parser* p, CType* type) {
+    bool any = false;
+    bool is_unsigned = false;
+    bool is_void = false;
+    while (parse_is_type(p, 0)) {
+        Token* token = parse_next(p);
+        any = true;
+        if (parse_word_is(token, "unsigned")) is_unsigned = true;
+        if (parse_word_is(token, "void")) is_void = true;
+        if (parse_word_is(token, "long")) {
+            parse_error(p, token, "'long' is not supported (int is 16 bits)%.*s", "", 0);
+        }
+    }
+    *type = type_scalar(is_void ? TYPE_VOID : is_unsigned ? TYPE_UNSIGNED : TYPE_INT, 0);
+    return any;
+}
+
+static CType parse_pointers(Parser* p, CType type) {
+    while (parse_accept(p, '*')) {
+        type.pointers++;
+        while (parse_accept_word(p, "const") || parse_accept_word(p, "volatile")) {
+        }
+    }
+    return type;
+}
+
+// ==================
+// Expressions
+// ==================
+
+static Node* parse_expr(Parser* p);
+static Node* parse_assign(Parser* p);
+static Node* parse_unary(Parser* p);
+
+// Checking that an operand produces a value
+static Node* parse_value(Parser* p, Node* node) {
+    if (node->type.base == TYPE_VOID && node->type.pointers == 0 && node->type.length < 0) {
+        if (p->errors == 0) {
+            fprintf(stderr, "Error: Void value used in an expression (line %d, column %d)\n", node->line,
+                    node->column);
+            p->errors++;
+            p->pos = p->count - 1;
+        }
+        return ast_num(p->arena, 0, type_scalar(TYPE_INT, 0), node->line, node->column);
+    }
+    return node;
+}
+
+static bool parse_is_lvalue(const Node* node) {
+    return (node->kind == NODE_VAR && node->var->type.length < 0) || node->kind == NODE_DEREF;
+}
+
+static Node* parse_string(Parser* p) {
+    Program* program = p->program;
+    Token* first = parse_peek(p, 0);
+    size_t length = 0;
+    for (int i = 0; parse_peek(p, i)->kind == TOK_STRING; i++) length += parse_peek(p, i)->length;
+
+    // Adjacent literals are concatenated
+    char* text = (char*)arena_alloc(p->arena, length + 1);
+    length = 0;
+    while (parse_is(p, TOK_STRING)) {
+        Token* token = parse_next(p);
+        memcpy(text + length, token->text, token->length);
+        length += token->length;
+    }
+    if (program->string_count == program->string_capacity) {
+        program->string_capacity = program->string_capacity ? program->string_capacity * 2 : 32;
+        program->strings = (CcString*)realloc(program->strings, program->string_capacity * sizeof(CcString));
+    }
+    program->strings[program->string_count].text = text;
+    program->strings[program->string_count].length = length;
+
+    Node* node = ast_node(p->arena, NODE_STR, first->line, first->column);
+    node->value = program->string_count++;
+    node->type = type_scalar(TYPE_INT, 1);
+    return node;
+}
+
+static Node* parse_call(Parser* p, Token* name) {
+    char* func_name = arena_strndup(p->arena, name->text, name->length);
+    Func* func = program_find_func(p->program, func_name);
+    if (!func) {
+        parse_error(p, name, "Call to undeclared function '%.*s'", name->text, name->length);
+        return ast_num(p->arena, 0, type_scalar(TYPE_INT, 0), name->line, name->column);
+    }
+
+    Node* node = ast_node(p->arena, NODE_CALL, name->line, name->column);
+    node->func = func;
+    node->type = func->ret;
+    node->need = func->builtin ? 1 : CC_CALL_NEED;
+    Node** tail = &node->a;
+    int arg_count = 0;
+    parse_expect(p, '(');
+    if (!parse_is(p, ')')) {
+        do {
+            Node* arg = parse_value(p, parse_assign(p));
+            if (arg->need > node->need) node->need = arg->need;
+            *tail = arg;
+            tail = &arg->next;
+            arg_count++;
+        } while (parse_accept(p, ','));
+    }
+    parse_expect(p, ')');
+    if (arg_count != func->param_count && p->errors == 0) {
+        char message[96];
+        snprintf(message, sizeof(message), "Function '%%.*s' takes %d argument(s), got %d", func->param_count,
+                 arg_count);
+        parse_error(p, name, message, name->text, name->length);
+    }
+    return node;
+}
+
+static Node* parse_primary(Parser* p) {
+    Token* token = parse_peek(p, 0);
+    if (token->kind == TOK_NUM) {
+        parse_next(p);
+        return ast_num(p->arena, token->value, type_scalar(token->is_unsigned ? TYPE_UNSIGNED : TYPE_INT, 0),
+                       token->line, token->column);
+    }
+    if (token->kind == TOK_STRING) {
+        return parse_string(p);
+    }
+    if (parse_accept(p, '(')) {
+        Node* node = parse_expr(p);
+        parse_expect(p, ')');
+        return node;
+    }
+    if (token->kind == TOK_IDENT && !parse_in_list(token, parse_keywords) && !parse_is_type(p, 0)) {
+        parse_next(p);
+        if (parse_is(p, '(')) return parse_call(p, token);
+
+        Var* var = parse_lookup(p, token->text, token->length);
+        if (!var) {
+            parse_error(p, token, "Undeclared identifier '%.*s'", token->text, token->length);
+            return ast_num(p->arena, 0, type_scalar(TYPE_INT, 0), token->line, token->column);
+        }
+        // Uses inside loops count more when choosing register variables
+        int depth = p->loop_depth < 4 ? p->loop_depth : 4;
+        var->weight += 1u << (3 * depth);
+        Node* node = ast_node(p->arena, NODE_VAR, token->line, token->column);
+        node->var = var;
+        node->type = type_decay(var->type);
+        return node;
+    }
+    if (token->kind != TOK_EOF || p->errors == 0) parse_error(p, token, "Expected an expression%.*s", "", 0);
+    return ast_num(p->arena, 0, type_scalar(TYPE_INT, 0), token->line, token->column);
+}
+
+static Node* parse_deref(Parser* p, Node* pointer, const Token* at) {
+    pointer = parse_value(p, pointer);
+    if (!type_is_pointer(pointer->type)) {
+        parse_error(p, at, "Cannot dereference a non-pointer%.*s", "", 0);
+        return pointer;
+    }
+    Node* node = ast_node(p->arena, NODE_DEREF, pointer->line, pointer->column);
+    node->type = type_decay(pointer->type);
+    node->type.pointers--;
+    node->a = pointer;
+    node->need = pointer->need;
+    return node;
+}
+
+static Node* parse_incdec(Parser* p, Node* target, int op, bool postfix, const Token* at) {
+    if (!parse_is_lvalue(target)) {
+        parse_error(p, at, "Operand of ++/-- is not assignable%.*s", "", 0);
+        return target;
+    }
+    Node* node = ast_node(p->arena, NODE_INCDEC, at->line, at->column);
+    node->op = op;
+    node->value = postfix;
+    node->type = target->type;
+    node->a = target;
+    node->need = target->need + 1;
+    return node;
+}
+
+static Node* parse_postfix(Parser* p) {
+    Node* node = parse_primary(p);
+    for (;;) {
+        Token* token = parse_peek(p, 0);
+        if (parse_accept(p, '[')) {
+            Node* index = parse_value(p, parse_expr(p));
+            parse_expect(p, ']');
+            node = parse_deref(p, ast_binary(p->arena, '+', parse_value(p, node), index), token);
+        } else if (parse_accept(p, TOK_INC)) {
+            node = parse_incdec(p, node, '+', true, token);
+        } else if (parse_accept(p, TOK_DEC)) {
+            node = parse_incdec(p, node, '-', true, token);
+        } else {
+            return node;
+        }
+    }
+}
+
+static Node* parse_unary(Parser* p) {
+    Token* token = parse_peek(p, 0);
+    if (token->kind == '-' || token->kind == '~' || token->kind == '!' || token->kind == '+') {
+        parse_next(p);
+        Node* operand = parse_value(p, parse_unary(p));
+        return token->kind == '+' ? operand : ast_unary(p->arena, token->kind, operand);
+    }
+    if (parse_accept(p, '*')) {
+        return parse_deref(p, parse_unary(p), token);
+    }
+    if (parse_accept(p, '&')) {
+        Node* operand = parse_unary(p);
+        if (operand->kind == NODE_DEREF) return operand->a;
+        if (operand->kind != NODE_VAR) {
+            parse_error(p, token, "Cannot take the address of this expression%.*s", "", 0);
+            return operand;
+        }
+        operand->var->address_taken = true;
+        Node* node = ast_node(p->arena, NODE_ADDR, token->line, token->column);
+        node->var = operand->var;
+        node->type = type_decay(operand->var->type);
+        if (operand->var->type.length < 0) node->type.pointers++;
+        return node;
+    }
+    if (parse_accept(p, TOK_INC)) return parse_incdec(p, parse_unary(p), '+', false, token);
+    if (parse_accept(p, TOK_DEC)) return parse_incdec(p, parse_unary(p), '-', false, token);
+    if (parse_accept_word(p, "sizeof")) {
+        // Every scalar is one word; only arrays are bigger
+        int32_t size = 1;
+        if (parse_is(p, '(') && parse_is_type(p, 1)) {
+            CType type;
+            parse_next(p);
+            parse_specifiers(p, &type);
+            parse_pointers(p, type);
+            parse_expect(p, ')');
+        } else {
+            Node* operand = parse_unary(p);
+            if (operand->kind == NODE_VAR && operand->var->type.length >= 0) size = operand->var->type.length;
+        }
+        return ast_num(p->arena, size, type_scalar(TYPE_UNSIGNED, 0), token->line, token->column);
+    }
+    if (parse_is(p, '(') && parse_is_type(p, 1)) {
+        CType type;
+        parse_next(p);
+        parse_specifiers(p, &type);
+        type = parse_pointers(p, type);
+        parse_expect(p, ')');
+        Node* operand = parse_unary(p);
+        return type.base == TYPE_VOID && type.pointers == 0 ? operand
+                                                             : ast_cast(p->arena, type, parse_value(p, operand));
+    }
+    return parse_postfix(p);
+}
+
+static int parse_precedence(int kind) {
+    switch (kind) {
+        case OP_OROR: return 1;
+        case OP_ANDAND: return 2;
+        case '|': return 3;
+        case '^': return 4;
+        case '&': return 5;
+        case OP_EQ: case OP_NE: return 6;
+        case '<': case '>': case OP_LE: case OP_GE: return 7;
+        case OP_SHL: case OP_SHR: return 8;
+        case '+': case '-': return 9;
+        case '*': case '/': case '%': return 10;
+        default: return 0;
+    }
+}
+
+static Node* parse_binary(Parser* p, int min_precedence) {
+    Node* left = parse_unary(p);
+    for (;;) {
+        int op = parse_peek(p, 0)->kind;
+        int precedence = parse_precedence(op);
+        if (precedence == 0 || precedence < min_precedence) return left;
+        parse_next(p);
+        Node* right = parse_value(p, parse_binary(p, precedence + 1));
+        left = ast_binary(p->arena, op, parse_value(p, left), right);
+    }
+}
+
+static Node* parse_conditional(Parser* p) {
+    Node* cond = parse_binary(p, 1);
+    if (!parse_accept(p, '?')) return cond;
+    Node* a = parse_value(p, parse_expr(p));
+    parse_expect(p, ':');
+    Node* b = parse_value(p, parse_conditional(p));
+    return ast_cond(p->arena, parse_value(p, cond), a, b);
+}
+
+static Node* parse_assign(Parser* p) {
+    Node* target = parse_conditional(p);
+    Token* token = parse_peek(p, 0);
+    if (token->kind != '=' && token->kind != TOK_ASSIGN_OP) return target;
+    parse_next(p);
+    if (!parse_is_lvalue(target)) {
+        parse_error(p, token, "Left side of assignment is not assignable%.*s", "", 0);
+        return target;
+    }
+    Node* value = parse_value(p, parse_assign(p));
+    Node* node = ast_node(p->arena, NODE_ASSIGN, token->line, token->column);
+    node->op = token->kind == '=' ? '=' : token->value;
+    node->type = target->type;
+    node->a = target;
+    node->b = value;
+    node->need = (target->need > value->need ? target->need : value->need) + 1;
+    if (node->op != '=' && ((node->op == '/' && !type_is_unsigned(target->type)) || node->op == '%')) {
+        node->need = CC_CALL_NEED;
+    }
+    if (node->need > CC_CALL_NEED) node->need = CC_CALL_NEED;
+    return node;
+}
+
+static Node* parse_expr(Parser* p) {
+    return parse_assign(p);
+}
+
+// ==================
+// Statements
+// ==================
+
+static Node* parse_statement(Parser* p);
+
+static void parse_push_scope(Parser* p, int* saved_start, int* saved_count) {
+    *saved_start = p->scope_start;
+    *saved_count = p->name_count;
+    p->scope_start = p->name_count;
+}
+
+static void parse_pop_scope(Parser* p, int saved_start, int saved_count) {
+    p->scope_start = saved_start;
+    p->name_count = saved_count;
+}
+
+static Node* parse_statement_node(Parser* p, NodeKind kind, const Token* at) {
+    return ast_node(p->arena, kind, at->line, at->column);
+}
+
+// Turning "target = value" into an expression statement
+static Node* parse_init_statement(Parser* p, Node* target, Node* value) {
+    Node* assign = ast_node(p->arena, NODE_ASSIGN, value->line, value->column);
+    assign->op = '=';
+    assign->type = target->type;
+    assign->a = target;
+    assign->b = value;
+    assign->need = value->need + 1 > CC_CALL_NEED ? CC_CALL_NEED : value->need + 1;
+    Node* statement = ast_node(p->arena, NODE_EXPR, value->line, value->column);
+    statement->a = assign;
+    return statement;
+}
+
+// Declaring locals: returns their initializations as a statement list
+static Node* parse_local_declaration(Parser* p) {
+    CType base;
+    Token* start = parse_peek(p, 0);
+    if (parse_word_is(start, "static")) {
+        parse_error(p, start, "Static locals are not supported%.*s", "", 0);
+        return NULL;
+    }
+    parse_specifiers(p, &base);
+    Node* first = NULL;
+    Node** tail = &first;
+    do {
+        CType type = parse_pointers(p, base);
+        Token* name = parse_name(p);
+        if (parse_accept(p, '[')) {
+            Token* at = parse_peek(p, 0);
+            Node* length = parse_is(p, ']') ? NULL : parse_conditional(p);
+            parse_expect(p, ']');
+            if (length && (length->kind != NODE_NUM || length->value <= 0)) {
+                parse_error(p, at, "Local array size must be a positive constant%.*s", "", 0);
+                return first;
+            }
+            type.length = length ? length->value : 0;
+        }
+        if (type.base == TYPE_VOID && type.pointers == 0) {
+            parse_error(p, name, "Variable '%.*s' declared void", name->text, name->length);
+            return first;
+        }
+        Var* var = parse_declare(p, name, type, VAR_LOCAL);
+        if (!parse_accept(p, '=')) {
+            if (type.length == 0) {
+                parse_error(p, name, "Array '%.*s' needs a size", name->text, name->length);
+                return first;
+            }
+            continue;
+        }
+
+        if (type.length < 0) {
+            Node* target = ast_node(p->arena, NODE_VAR, name->line, name->column);
+            target->var = var;
+            target->type = type;
+            var->weight++;
+            *tail = parse_init_statement(p, target, parse_value(p, parse_assign(p)));
+            tail = &(*tail)->next;
+            continue;
+        }
+
+        // Array initializer: one store per element, the rest zeroed
+        Node* values[4096];
+        int value_count = 0;
+        if (parse_is(p, TOK_STRING)) {
+            Node* string = parse_string(p);
+            const CcString* text = &p->program->strings[string->value];
+            for (size_t i = 0; i <= text->length && value_count < 4096; i++) {
+                values[value_count++] = ast_num(p->arena, i < text->length ? (unsigned char)text->text[i] : 0,
+                                                type_scalar(TYPE_INT, 0), string->line, string->column);
+            }
+        } else {
+            parse_expect(p, '{');
+            while (!parse_is(p, '}') && !parse_is(p, TOK_EOF) && value_count < 4096) {
+                values[value_count++] = parse_value(p, parse_assign(p));
+                if (!parse_accept(p, ',')) break;
+            }
+            parse_expect(p, '}');
+        }
+        // char s[] = "..." takes its length from the initializer
+        if (type.length == 0) {
+            if (value_count == 0) {
+                parse_error(p, name, "Array '%.*s' needs a size", name->text, name->length);
+                return first;
+            }
+            type.length = value_count;
+            var->type.length = value_count;
+        }
+        if (value_count > type.length) {
+            parse_error(p, name, "Too many initializers for '%.*s'", name->text, name->length);
+            return first;
+        }
+        for (int i = 0; i < type.length; i++) {
+            Node* base_node = ast_node(p->arena, NODE_VAR, name->line, name->column);
+            base_node->var = var;
+            base_node->type = type_decay(type);
+            Node* element = ast_node(p->arena, NODE_DEREF, name->line, name->column);
+            element->a = ast_binary(p->arena, '+', base_node,
+                                    ast_num(p->arena, i, type_scalar(TYPE_INT, 0), name->line, name->column));
+            element->type = base;
+            element->type.pointers = type.pointers;
+            Node* value = i < value_count ? values[i]
+                                          : ast_num(p->arena, 0, type_scalar(TYPE_INT, 0), name->line, name->column);
+            *tail = parse_init_statement(p, element, value);
+            tail = &(*tail)->next;
+        }
+    } while (parse_accept(p, ','));
+    parse_expect(p, ';');
+    return first;
+}
+
+static Node* parse_block(Parser* p) {
+    Token* open = parse_peek(p, 0);
+    parse_expect(p, '{');
+    int saved_start, saved_count;
+    parse_push_scope(p, &saved_start, &saved_count);
+    Node* block = parse_statement_node(p, NODE_BLOCK, open);
+    Node** tail = &block->a;
+    while (!parse_is(p, '}') && !parse_is(p, TOK_EOF)) {
+        Node* statement = parse_is_type(p, 0) ? parse_local_declaration(p) : parse_statement(p);
+        *tail = statement;
+        while (*tail) tail = &(*tail)->next;
+    }
+    parse_expect(p, '}');
+    parse_pop_scope(p, saved_start, saved_count);
+    return block;
+}
+
+static Node* parse_condition(Parser* p) {
+    parse_expect(p, '(');
+    Node* cond = parse_value(p, parse_expr(p));
+    parse_expect(p, ')');
+    return cond;
+}
+
+static Node* parse_statement(Parser* p) {
+    Token* token = parse_peek(p, 0);
+    if (token->kind == '{') {
+        return parse_block(p);
+    }
+    if (parse_accept(p, ';')) {
+        return NULL;
+    }
+    if (parse_accept_word(p, "if")) {
+        Node* node = parse_statement_node(p, NODE_IF, token);
+        node->a = parse_condition(p);
+        node->b = parse_statement(p);
+        if (parse_accept_word(p, "else")) node->c = parse_statement(p);
+        return node;
+    }
+    if (parse_accept_word(p, "while")) {
+        Node* node = parse_statement_node(p, NODE_WHILE, token);
+        p->loop_depth++;
+        node->a = parse_condition(p);
+        node->b = parse_statement(p);
+        p->loop_depth--;
+        return node;
+    }
+    if (parse_accept_word(p, "do")) {
+        Node* node = parse_statement_node(p, NODE_DO, token);
+        p->loop_depth++;
+        node->b = parse_statement(p);
+        if (!parse_accept_word(p, "while")) parse_error(p, parse_peek(p, 0), "Expected 'while'%.*s", "", 0);
+        node->a = parse_condition(p);
+        p->loop_depth--;
+        parse_expect(p, ';');
+        return node;
+    }
+    if (parse_accept_word(p, "for")) {
+        Node* node = parse_statement_node(p, NODE_FOR, token);
+        int saved_start, saved_count;
+        parse_push_scope(p, &saved_start, &saved_count);
+        parse_expect(p, '(');
+        if (parse_is_type(p, 0)) {
+            node->c = parse_local_declaration(p);
+        } else {
+            if (!parse_is(p, ';')) {
+                node->c = parse_statement_node(p, NODE_EXPR, token);
+                node->c->a = parse_expr(p);
+            }
+            parse_expect(p, ';');
+        }
+        p->loop_depth++;
+        if (!parse_is(p, ';')) node->a = parse_value(p, parse_expr(p));
+        parse_expect(p, ';');
+        if (!parse_is(p, ')')) node->d = parse_expr(p);
+        parse_expect(p, ')');
+        node->b = parse_statement(p);
+        p->loop_depth--;
+        parse_pop_scope(p, saved_start, saved_count);
+        return node;
+    }
+    if (parse_accept_word(p, "return")) {
+        Node* node = parse_statement_node(p, NODE_RETURN, token);
+        bool is_void = p->func->ret.base == TYPE_VOID && p->func->ret.pointers == 0;
+        if (!parse_is(p, ';')) {
+            node->a = parse_value(p, parse_expr(p));
+            if (is_void) parse_error(p, token, "Void function '%.*s' returns a value", p->func->name,
+                                     strlen(p->func->name));
+        } else if (!is_void) {
+            parse_error(p, token, "Function '%.*s' must return a value", p->func->name, strlen(p->func->name));
+        }
+        parse_expect(p, ';');
+        return node;
+    }
+    if (parse_accept_word(p, "break") || parse_accept_word(p, "continue")) {
+        bool is_break = parse_word_is(token, "break");
+        if (p->loop_depth == 0) {
+            parse_error(p, token, "'%.*s' outside of a loop", token->text, token->length);
+            return NULL;
+        }
+        parse_expect(p, ';');
+        return parse_statement_node(p, is_break ? NODE_BREAK : NODE_CONTINUE, token);
+    }
+    if (parse_is_type(p, 0)) {
+        parse_error(p, token, "A declaration is not a statement here; add braces%.*s", "", 0);
+        return NULL;
+    }
+
+    Node* node = parse_statement_node(p, NODE_EXPR, token);
+    node->a = parse_expr(p);
+    parse_expect(p, ';');
+    return node;
+}
+
+// ==================
+// Top level
+// ==================
+
+static Func* parse_add_func(Parser* p, const char* name, CType ret, int line) {
+    Func* func = (Func*)arena_alloc(p->arena, sizeof(Func));
+    func->name = name;
+    func->ret = ret;
+    func->line = line;
+    Func** tail = &p->program->funcs;
+    while (*tail) tail = &(*tail)->next;
+    *tail = func;
+    return func;
+}
+
+static void parse_function(Parser* p, Token* name, CType ret) {
+    char* func_name = arena_strndup(p->arena, name->text, name->length);
+    Func* func = program_find_func(p->program, func_name);
+    if (func && func->body) {
+        parse_error(p, name, "Redefinition of function '%.*s'", name->text, name->length);
+        return;
+    }
+    // A program's own putchar etc. replaces the built-in one
+    bool declared = func && !func->builtin;
+    int declared_params = func ? func->param_count : 0;
+    if (func) func->builtin = false;
+    if (!func) func = parse_add_func(p, func_name, ret, name->line);
+
+    // Parameters are declared in a scope of their own (a definition
+    // replaces the parameters of an earlier prototype)
+    Func* saved_func = p->func;
+    func->locals = NULL;
+    func->param_count = 0;
+    func->ret = ret;
+    p->func = func;
+    int saved_start, saved_count;
+    parse_push_scope(p, &saved_start, &saved_count);
+    parse_expect(p, '(');
+    if (!(parse_word_is(parse_peek(p, 0), "void") && parse_peek(p, 1)->kind == ')') && !parse_is(p, ')')) {
+        do {
+            CType type;
+            if (!parse_specifiers(p, &type)) {
+                parse_error(p, parse_peek(p, 0), "Expected a parameter type%.*s", "", 0);
+                break;
+            }
+            type = parse_pointers(p, type);
+            Token* param = parse_peek(p, 0);
+            bool named = param->kind == TOK_IDENT;
+            if (named) parse_name(p);
+            if (parse_accept(p, '[')) {
+                while (!parse_is(p, ']') && !parse_is(p, TOK_EOF)) parse_next(p);
+                parse_expect(p, ']');
+                type.pointers++;
+            }
+            if (func->param_count == CC_MAX_PARAMS) {
+                parse_error(p, param, "Functions take at most 4 parameters%.*s", "", 0);
+                break;
+            }
+            Token unnamed = *param;
+            unnamed.text = "";
+            unnamed.length = 0;
+            Var* var = parse_declare(p, named ? param : &unnamed, type, VAR_PARAM);
+            var->index = func->param_count;
+            func->params[func->param_count++] = var;
+        } while (parse_accept(p, ','));
+    } else {
+        parse_accept_word(p, "void");
+    }
+    parse_expect(p, ')');
+
+    if (declared && declared_params != func->param_count) {
+        parse_error(p, name, "Conflicting declarations of '%.*s'", name->text, name->length);
+    }
+    if (parse_is(p, '{')) {
+        func->body = parse_block(p);
+    } else {
+        parse_expect(p, ';');
+    }
+    parse_pop_scope(p, saved_start, saved_count);
+    p->func = saved_func;
+}
+
+// Reading a global initializer (constants and string literals only)
+static Node* parse_global_init(Parser* p, CType type) {
+    if (parse_is(p, TOK_STRING) && type.length >= 0) {
+        return parse_string(p);
+    }
+    if (parse_accept(p, '{')) {
+        Node* list = ast_node(p->arena, NODE_INIT_LIST, parse_peek(p, 0)->line, parse_peek(p, 0)->column);
+        Node** tail = &list->a;
+        int count = 0;
+        while (!parse_is(p, '}') && !parse_is(p, TOK_EOF)) {
+            CType element = type;
+            element.length = -1;
+            Node* value = parse_global_init(p, element);
+            *tail = value;
+            tail = &value->next;
+            count++;
+            if (!parse_accept(p, ',')) break;
+        }
+        parse_expect(p, '}');
+        list->value = count;
+        return list;
+    }
+    Token* at = parse_peek(p, 0);
+    Node* value = parse_value(p, parse_conditional(p));
+    if (value->kind != NODE_NUM && value->kind != NODE_STR) {
+        parse_error(p, at, "Global initializer must be a constant or string literal%.*s", "", 0);
+    }
+    return value;
+}
+
+static void parse_global(Parser* p, Token* name, CType type) {
+    if (parse_accept(p, '[')) {
+        Token* at = parse_peek(p, 0);
+        Node* length = parse_is(p, ']') ? NULL : parse_conditional(p);
+        parse_expect(p, ']');
+        if (length && (length->kind != NODE_NUM || length->value <= 0)) {
+            parse_error(p, at, "Array size must be a positive constant%.*s", "", 0);
+            return;
+        }
+        type.length = length ? length->value : 0;
+    }
+    if (type.base == TYPE_VOID && type.pointers == 0) {
+        parse_error(p, name, "Variable '%.*s' declared void", name->text, name->length);
+        return;
+    }
+    Var* var = parse_declare(p, name, type, VAR_GLOBAL);
+    if (parse_accept(p, '=')) {
+        var->init = parse_global_init(p, type);
+        // int a[] = {...} takes its length from the initializer
+        int32_t count = var->init->kind == NODE_INIT_LIST ? var->init->value
+                      : var->init->kind == NODE_STR ? (int32_t)p->program->strings[var->init->value].length + 1
+                      : 1;
+        if (type.length == 0) var->type.length = count;
+        if (type.length > 0 && count > type.length) {
+            parse_error(p, name, "Too many initializers for '%.*s'", name->text, name->length);
+        }
+        if (type.length < 0 && var->init->kind == NODE_INIT_LIST) {
+            parse_error(p, name, "Braces around scalar initializer for '%.*s'", name->text, name->length);
+        }
+    }
+    if (var->type.length == 0) {
+        parse_error(p, name, "Array '%.*s' needs a size", name->text, name->length);
+    }
+}
+
+static void parse_builtins(Parser* p) {
+    static const char* const names[] = { "putchar", "putint", "putstr" };
+    for (int i = 0; i < 3; i++) {
+        Func* func = parse_add_func(p, names[i], type_scalar(TYPE_VOID, 0), 0);
+        func->builtin = true;
+        func->param_count = 1;
+    }
+}
+
+bool parse_program(Program* program, const char* source, size_t size) {
+    memset(program, 0, sizeof(Program));
+    Parser parser;
+    memset(&parser, 0, sizeof(Parser));
+    parser.program = program;
+    parser.arena = &program->arena;
+    if (!lex_source(&program->arena, source, size, &parser.tokens, &parser.count)) {
+        free(parser.tokens);
+        return false;
+    }
+
+    Parser* p = &parser;
+    parse_builtins(p);
+    while (!parse_is(p, TOK_EOF)) {
+        CType base;
+        Token* start = parse_peek(p, 0);
+        if (!parse_specifiers(p, &base)) {
+            parse_error(p, start, "Expected a declaration%.*s", "", 0);
+            break;
+        }
+        do {
+            CType type = parse_pointers(p, base);
+            Token* name = parse_name(p);
+            if (parse_is(p, '(')) {
+                parse_function(p, name, type);
+                break;
+            }
+            parse_global(p, name, type);
+            if (!parse_is(p, ',')) {
+                parse_expect(p, ';');
+                break;
+            }
+            parse_next(p);
+        } while (!parse_is(p, TOK_EOF));
+    }
+
+    free(parser.tokens);
+    free(parser.names);
+    return parser.errors == 0;
+}
+
+void program_free(Program* program) {
+    free(program->strings);
+    arena_free(&program->arena);
+}
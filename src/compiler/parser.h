@@ -0,0 +1,31 @@
+#ifndef PARSER_H
+#define PARSER_H
+
+#include "ast.h"
+
+// Recursive-descent parser for the C subset: int, unsigned, char (a
+// word), void, pointers, one-dimensional arrays, functions of up to
+// CC_MAX_PARAMS parameters, if/while/do/for/break/continue/return and
+// the C expression operators except comma and compound literals.
+// putchar(c), putint(n) and putstr(s) are built in (memory-mapped I/O).
+
+typedef struct {
+    const char* text;           // Decoded, one character per word
+    size_t length;
+} CcString;
+
+typedef struct {
+    Arena arena;
+    Var* globals;               // In declaration order
+    Func* funcs;                // In declaration order (builtins first)
+    CcString* strings;          // Literals, indexed by NODE_STR value
+    int string_count;
+    int string_capacity;
+} Program;
+
+// Parsing a whole translation unit (returns false after printing errors)
+bool parse_program(Program* program, const char* source, size_t size);
+void program_free(Program* program);
+Func* program_find_func(const Program* program, const char* name);
+
+#endif // PARSER_H
@@ -0,0 +1,98 @@
+#define _POSIX_C_SOURCE 200809L
+#include "bank.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define BANK_MAX_BANKS 65536
+
+// Mapping a host file privately: reads page in lazily, writes copy the page
+static bool bank_map_file(BankStore* store, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot open bank file '%s'\n", path);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < 2) {
+        fprintf(stderr, "Error: Bank file '%s' is empty\n", path);
+        close(fd);
+        return false;
+    }
+    size_t bytes = (size_t)info.st_size;
+    if (bytes > (size_t)BANK_MAX_BANKS * BANK_WORDS * sizeof(uint16_t)) {
+        fprintf(stderr, "Error: Bank file '%s' is larger than %d banks\n", path, BANK_MAX_BANKS);
+        close(fd);
+        return false;
+    }
+    void* data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map bank file '%s'\n", path);
+        return false;
+    }
+    store->mapped = (uint16_t*)data;
+    store->mapped_bytes = bytes;
+    store->mapped_words = bytes / sizeof(uint16_t);
+    return true;
+}
+
+bool bank_open(BankStore* store, uint32_t bank_count, const char* path) {
+    memset(store, 0, sizeof(BankStore));
+    if (path && !bank_map_file(store, path)) return false;
+    if (bank_count == 0) {
+        bank_count = (uint32_t)((store->mapped_words + BANK_WORDS - 1) / BANK_WORDS);
+    }
+    if (bank_count == 0 || bank_count > BANK_MAX_BANKS) {
+        fprintf(stderr, "Error: Bank count must be between 1 and %d\n", BANK_MAX_BANKS);
+        bank_close(store);
+        return false;
+    }
+    store->bank_count = bank_count;
+    store->pages = (uint16_t**)calloc((size_t)bank_count * BANK_PAGES, sizeof(uint16_t*));
+    if (!store->pages) {
+        fprintf(stderr, "Error: Out of memory for %u banks\n", bank_count);
+        bank_close(store);
+        return false;
+    }
+    return true;
+}
+
+void bank_close(BankStore* store) {
+    if (store->pages) {
+        for (size_t i = 0; i < (size_t)store->bank_count * BANK_PAGES; i++) {
+            free(store->pages[i]);
+        }
+        free(store->pages);
+    }
+    if (store->mapped) munmap(store->mapped, store->mapped_bytes);
+    memset(store, 0, sizeof(BankStore));
+}
+
+uint16_t* bank_page(const BankStore* store, uint16_t bank, uint16_t page) {
+    if (bank >= store->bank_count) return (uint16_t*)cpu_zero_page;
+    size_t index = (size_t)bank * BANK_PAGES + page;
+    if (store->pages[index]) return store->pages[index];
+    // A page that starts inside the file is file-backed; the host page
+    // holding the end of the file reads as zero past it
+    if (index * PAGE_WORDS < store->mapped_words) return store->mapped + index * PAGE_WORDS;
+    return (uint16_t*)cpu_zero_page;
+}
+
+uint16_t* bank_page_for_write(BankStore* store, uint16_t bank, uint16_t page) {
+    uint16_t* data = bank_page(store, bank, page);
+    if (data != cpu_zero_page) return data;
+    if (bank >= store->bank_count) return store->discard;
+    data = (uint16_t*)calloc(PAGE_WORDS, sizeof(uint16_t));
+    if (!data) {
+        fprintf(stderr, "Error: Out of memory allocating bank page\n");
+        exit(1);
+    }
+    store->pages[(size_t)bank * BANK_PAGES + page] = data;
+    store->allocated_pages++;
+    return data;
+}
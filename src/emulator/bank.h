@@ -0,0 +1,42 @@
+#ifndef BANK_H
+#define BANK_H
+
+#include "cpu.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Bank-switched memory beyond the 64K-word address space.
+//
+// A bank store holds up to 65536 banks of BANK_WORDS words. The bank
+// selected through MMIO_BANK shows through the window at BANK_WINDOW; a
+// switch only repoints the window's page-table entries, so it costs the
+// same in every engine. Banks are sparse (a page is allocated on first
+// write) or mapped copy-on-write from a host file, whose pages the host
+// reads in as the guest touches them. Guest writes never reach the file.
+//
+// Only the window is part of the CPU's memory: snapshots, checkpoints
+// and dumps see the selected bank through it, not the other banks.
+
+typedef struct BankStore {
+    uint32_t bank_count;
+    uint16_t** pages;           // bank_count * BANK_PAGES entries (NULL = all zero so far)
+    uint16_t* mapped;           // File contents, private writable mapping (NULL = none)
+    size_t mapped_words;
+    size_t mapped_bytes;
+    uint32_t allocated_pages;   // Pages allocated on write (not file-backed)
+    uint16_t discard[PAGE_WORDS];   // Sink for writes to a bank past the end
+} BankStore;
+
+// Creating a store of bank_count banks (0 = as many as the file fills),
+// backed by path when it is not NULL
+bool bank_open(BankStore* store, uint32_t bank_count, const char* path);
+void bank_close(BankStore* store);
+// Page page (0 to BANK_PAGES - 1) of bank: its data, or cpu_zero_page
+// when it was never written (also for banks past the end)
+uint16_t* bank_page(const BankStore* store, uint16_t bank, uint16_t page);
+// Same page for writing, allocated on first use; store->discard for a
+// bank past the end
+uint16_t* bank_page_for_write(BankStore* store, uint16_t bank, uint16_t page);
+
+#endif // BANK_H
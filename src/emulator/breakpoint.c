@@ -0,0 +1,320 @@
+#include "breakpoint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+static void bp_map_set(uint64_t* map, uint16_t addr) {
+    map[addr >> 6] |= 1ULL << (addr & 63);
+}
+
+// Rebuilding bitmaps after a change and publishing them to the CPU
+static void bp_rebuild(BreakpointSet* set) {
+    memset(set->pc_map, 0, sizeof(set->pc_map));
+    memset(set->read_map, 0, sizeof(set->read_map));
+    memset(set->write_map, 0, sizeof(set->write_map));
+
+    bool any_read = false, any_write = false;
+    for (int i = 0; i < set->bp_count; i++) {
+        bp_map_set(set->pc_map, set->breakpoints[i].addr);
+    }
+    for (int i = 0; i < set->wp_count; i++) {
+        Watchpoint* wp = &set->watchpoints[i];
+        for (uint32_t a = wp->start; a <= wp->end; a++) {
+            if (wp->kind & WATCH_READ) bp_map_set(set->read_map, (uint16_t)a);
+            if (wp->kind & WATCH_WRITE) bp_map_set(set->write_map, (uint16_t)a);
+        }
+        any_read |= (wp->kind & WATCH_READ) != 0;
+        any_write |= (wp->kind & WATCH_WRITE) != 0;
+    }
+
+    set->armed = set->bp_count > 0 || set->wp_count > 0;
+    set->cpu->watch_read = any_read ? set->read_map : NULL;
+    set->cpu->watch_write = any_write ? set->write_map : NULL;
+}
+
+// Initializing an empty set and attaching it to the CPU
+void bp_init(BreakpointSet* set, CPU* cpu) {
+    memset(set, 0, sizeof(BreakpointSet));
+    set->next_id = 1;
+    set->cpu = cpu;
+    cpu->breakpoints = set;
+    bp_rebuild(set);
+}
+
+// Detaching from the CPU and releasing resources
+void bp_free(BreakpointSet* set) {
+    if (set->cpu && set->cpu->breakpoints == set) {
+        set->cpu->breakpoints = NULL;
+        set->cpu->watch_read = NULL;
+        set->cpu->watch_write = NULL;
+    }
+    free(set->breakpoints);
+    free(set->watchpoints);
+    set->breakpoints = NULL;
+    set->watchpoints = NULL;
+    set->bp_count = set->wp_count = 0;
+}
+
+// Adding PC breakpoint, returning its id
+int bp_add_breakpoint(BreakpointSet* set, uint16_t addr, int cond_reg, BpCondOp op,
+                      uint16_t value, uint64_t ignore_count) {
+    if (set->bp_count >= set->bp_capacity) {
+        set->bp_capacity = set->bp_capacity ? set->bp_capacity * 2 : 8;
+        set->breakpoints = (Breakpoint*)realloc(set->breakpoints, set->bp_capacity * sizeof(Breakpoint));
+    }
+    Breakpoint* bp = &set->breakpoints[set->bp_count++];
+    bp->id = set->next_id++;
+    bp->addr = addr;
+    bp->cond_reg = op == BP_COND_NONE ? -1 : cond_reg;
+    bp->cond_op = op;
+    bp->cond_value = value;
+    bp->ignore_count = ignore_count;
+    bp->hits = 0;
+    bp_rebuild(set);
+    return bp->id;
+}
+
+// Adding watchpoint on [start, end], returning its id
+int bp_add_watchpoint(BreakpointSet* set, uint16_t start, uint16_t end, int kind) {
+    if (end < start) {
+        uint16_t tmp = start;
+        start = end;
+        end = tmp;
+    }
+    if (set->wp_count >= set->wp_capacity) {
+        set->wp_capacity = set->wp_capacity ? set->wp_capacity * 2 : 8;
+        set->watchpoints = (Watchpoint*)realloc(set->watchpoints, set->wp_capacity * sizeof(Watchpoint));
+    }
+    Watchpoint* wp = &set->watchpoints[set->wp_count++];
+    wp->id = set->next_id++;
+    wp->start = start;
+    wp->end = end;
+    wp->kind = kind;
+    wp->hits = 0;
+    bp_rebuild(set);
+    return wp->id;
+}
+
+// Removing breakpoint or watchpoint by id
+bool bp_delete(BreakpointSet* set, int id) {
+    for (int i = 0; i < set->bp_count; i++) {
+        if (set->breakpoints[i].id == id) {
+            set->breakpoints[i] = set->breakpoints[--set->bp_count];
+            bp_rebuild(set);
+            return true;
+        }
+    }
+    for (int i = 0; i < set->wp_count; i++) {
+        if (set->watchpoints[i].id == id) {
+            set->watchpoints[i] = set->watchpoints[--set->wp_count];
+            bp_rebuild(set);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool bp_condition_holds(const Breakpoint* bp, const CPU* cpu) {
+    if (bp->cond_op == BP_COND_NONE) return true;
+    uint16_t reg = cpu->registers[bp->cond_reg];
+    switch (bp->cond_op) {
+        case BP_COND_EQ: return reg == bp->cond_value;
+        case BP_COND_NE: return reg != bp->cond_value;
+        case BP_COND_LT: return reg < bp->cond_value;
+        case BP_COND_LE: return reg <= bp->cond_value;
+        case BP_COND_GT: return reg > bp->cond_value;
+        case BP_COND_GE: return reg >= bp->cond_value;
+        default: return true;
+    }
+}
+
+// Evaluating breakpoints at the current PC (called only when the PC bit is set)
+bool bp_check_pc(BreakpointSet* set, CPU* cpu, int* id) {
+    bool stop = false;
+    for (int i = 0; i < set->bp_count; i++) {
+        Breakpoint* bp = &set->breakpoints[i];
+        if (bp->addr != cpu->pc || !bp_condition_holds(bp, cpu)) continue;
+        bp->hits++;
+        if (bp->hits > bp->ignore_count && !stop) {
+            *id = bp->id;
+            stop = true;
+        }
+    }
+    return stop;
+}
+
+// Recording a watched memory access (called from the memory paths)
+void bp_note_access(CPU* cpu, uint16_t addr, uint16_t value, bool is_write) {
+    BreakpointSet* set = cpu->breakpoints;
+    if (!set || set->watch_hit) return;
+    set->watch_hit = true;
+    set->hit_addr = addr;
+    set->hit_value = value;
+    set->hit_write = is_write;
+}
+
+// Finding the watchpoint responsible for an access and counting the hit
+int bp_find_watchpoint(BreakpointSet* set, uint16_t addr, bool is_write) {
+    int kind = is_write ? WATCH_WRITE : WATCH_READ;
+    for (int i = 0; i < set->wp_count; i++) {
+        Watchpoint* wp = &set->watchpoints[i];
+        if ((wp->kind & kind) && addr >= wp->start && addr <= wp->end) {
+            wp->hits++;
+            return wp->id;
+        }
+    }
+    return -1;
+}
+
+static bool bp_parse_value(const char* str, uint16_t* value) {
+    char* end;
+    long v = strtol(str, &end, 0);
+    if (end == str || *end != '\0' || v < -32768 || v > 0xFFFF) return false;
+    *value = (uint16_t)v;
+    return true;
+}
+
+// Parsing "Rn<op>V" (spaces already removed)
+static bool bp_parse_condition(const char* text, int* reg, BpCondOp* op, uint16_t* value) {
+    static const struct { const char* str; BpCondOp op; } ops[] = {
+        { "==", BP_COND_EQ }, { "!=", BP_COND_NE }, { "<=", BP_COND_LE },
+        { ">=", BP_COND_GE }, { "<", BP_COND_LT }, { ">", BP_COND_GT }, { "=", BP_COND_EQ }
+    };
+
+    if (toupper((unsigned char)text[0]) != 'R' || text[1] < '0' || text[1] > '7') return false;
+    *reg = text[1] - '0';
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        size_t len = strlen(ops[i].str);
+        if (strncmp(text + 2, ops[i].str, len) == 0) {
+            *op = ops[i].op;
+            return bp_parse_value(text + 2 + len, value);
+        }
+    }
+    return false;
+}
+
+// Parsing "ADDR [if Rn OP V] [after N]" and adding the breakpoint
+int bp_parse_breakpoint(BreakpointSet* set, const char* spec) {
+    char buf[256];
+    char cond[64] = "";
+    strncpy(buf, spec, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    char* tok = strtok(buf, " \t");
+    uint16_t addr;
+    if (!tok || !bp_parse_value(tok, &addr)) {
+        fprintf(stderr, "Error: Bad breakpoint address in '%s'\n", spec);
+        return -1;
+    }
+
+    uint64_t ignore = 0;
+    bool in_cond = false;
+    while ((tok = strtok(NULL, " \t")) != NULL) {
+        if (strcmp(tok, "if") == 0) {
+            in_cond = true;
+        } else if (strcmp(tok, "after") == 0) {
+            in_cond = false;
+            tok = strtok(NULL, " \t");
+            ignore = tok ? strtoull(tok, NULL, 0) : 0;
+        } else if (in_cond && strlen(cond) + strlen(tok) < sizeof(cond) - 1) {
+            strcat(cond, tok);
+        }
+    }
+
+    int reg = -1;
+    BpCondOp op = BP_COND_NONE;
+    uint16_t value = 0;
+    if (cond[0] && !bp_parse_condition(cond, &reg, &op, &value)) {
+        fprintf(stderr, "Error: Bad breakpoint condition '%s' (expected Rn OP VALUE)\n", cond);
+        return -1;
+    }
+    return bp_add_breakpoint(set, addr, reg, op, value, ignore);
+}
+
+// Parsing "ADDR[-END] [r|w|rw]" or "stack [WORDS] [r|w|rw]" and adding the watchpoint
+int bp_parse_watchpoint(BreakpointSet* set, const char* spec) {
+    char buf[256];
+    strncpy(buf, spec, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    char* range = strtok(buf, " \t");
+    char* next = strtok(NULL, " \t");
+    uint16_t start, end;
+    int kind = WATCH_WRITE;
+
+    if (range && strcmp(range, "stack") == 0) {
+        // The stack grows down from STACK_START
+        uint16_t words = STACK_WATCH_DEFAULT;
+        if (next && isdigit((unsigned char)next[0])) {
+            bp_parse_value(next, &words);
+            next = strtok(NULL, " \t");
+        }
+        if (words == 0 || words > STACK_START) words = STACK_WATCH_DEFAULT;
+        start = STACK_START - words;
+        end = STACK_START - 1;
+    } else {
+        char* dash = range ? strchr(range + 1, '-') : NULL;
+        if (dash) *dash = '\0';
+        if (!range || !bp_parse_value(range, &start) || (dash && !bp_parse_value(dash + 1, &end))) {
+            fprintf(stderr, "Error: Bad watchpoint range in '%s'\n", spec);
+            return -1;
+        }
+        if (!dash) end = start;
+    }
+
+    if (next) {
+        if (strcmp(next, "r") == 0) kind = WATCH_READ;
+        else if (strcmp(next, "w") == 0) kind = WATCH_WRITE;
+        else if (strcmp(next, "rw") == 0) kind = WATCH_READ | WATCH_WRITE;
+        else {
+            fprintf(stderr, "Error: Bad watchpoint kind '%s' (expected r, w or rw)\n", next);
+            return -1;
+        }
+    }
+    return bp_add_watchpoint(set, start, end, kind);
+}
+
+// Listing breakpoints and watchpoints
+void bp_list(const BreakpointSet* set) {
+    static const char* op_names[] = { "", "==", "!=", "<", "<=", ">", ">=" };
+
+    if (set->bp_count == 0 && set->wp_count == 0) {
+        printf("No breakpoints or watchpoints\n");
+        return;
+    }
+    for (int i = 0; i < set->bp_count; i++) {
+        const Breakpoint* bp = &set->breakpoints[i];
+        printf("#%d  break 0x%04X", bp->id, bp->addr);
+        if (bp->cond_op != BP_COND_NONE) {
+            printf(" if R%d %s %u", bp->cond_reg, op_names[bp->cond_op], bp->cond_value);
+        }
+        if (bp->ignore_count) printf(" after %llu", (unsigned long long)bp->ignore_count);
+        printf("  (hits %llu)\n", (unsigned long long)bp->hits);
+    }
+    for (int i = 0; i < set->wp_count; i++) {
+        const Watchpoint* wp = &set->watchpoints[i];
+        printf("#%d  watch 0x%04X-0x%04X %s%s  (hits %llu)\n", wp->id, wp->start, wp->end,
+               (wp->kind & WATCH_READ) ? "r" : "", (wp->kind & WATCH_WRITE) ? "w" : "",
+               (unsigned long long)wp->hits);
+    }
+}
+
+// Printing why a bounded run stopped
+void bp_report_stop(const StopReason* reason) {
+    switch (reason->kind) {
+        case STOP_HALT:
+            printf("Stopped: HALT at PC=0x%04X\n", reason->pc);
+            break;
+        case STOP_CYCLE_LIMIT:
+            printf("Stopped: cycle budget exhausted at PC=0x%04X\n", reason->pc);
+            break;
+        case STOP_BREAKPOINT:
+            printf("Stopped: breakpoint #%d at PC=0x%04X\n", reason->id, reason->pc);
+            break;
+        case STOP_WATCHPOINT:
+            printf("Stopped: watchpoint #%d, %s of 0x%04X (value 0x%04X) by instruction at 0x%04X\n",
+                   reason->id, reason->write ? "write" : "read", reason->addr, reason->value, reason->pc);
+            break;
+    }
+}
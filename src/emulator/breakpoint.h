@@ -0,0 +1,93 @@
+#ifndef BREAKPOINT_H
+#define BREAKPOINT_H
+
+#include "cpu.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Breakpoints and watchpoints.
+//
+// Armed addresses are kept in bitmaps over the 64K address space, one
+// bit per word, so the per-instruction check is a single bit test. When
+// nothing is armed, cpu_run_bounded() takes a loop with no checks at all
+// and the memory paths see NULL watch maps.
+
+#define BP_MAP_WORDS (MEM_SIZE / 64)
+
+#define WATCH_READ  0x1
+#define WATCH_WRITE 0x2
+
+#define STACK_WATCH_DEFAULT 256     // Words below STACK_START for "stack"
+
+// Register comparison attached to a breakpoint
+typedef enum {
+    BP_COND_NONE,
+    BP_COND_EQ,
+    BP_COND_NE,
+    BP_COND_LT,
+    BP_COND_LE,
+    BP_COND_GT,
+    BP_COND_GE
+} BpCondOp;
+
+typedef struct {
+    int id;
+    uint16_t addr;
+    int cond_reg;               // Register compared (-1 = unconditional)
+    BpCondOp cond_op;
+    uint16_t cond_value;
+    uint64_t ignore_count;      // Qualifying hits to skip before stopping
+    uint64_t hits;              // Qualifying hits so far
+} Breakpoint;
+
+typedef struct {
+    int id;
+    uint16_t start;             // Inclusive range
+    uint16_t end;
+    int kind;                   // WATCH_READ | WATCH_WRITE
+    uint64_t hits;
+} Watchpoint;
+
+typedef struct BreakpointSet {
+    uint64_t pc_map[BP_MAP_WORDS];
+    uint64_t read_map[BP_MAP_WORDS];
+    uint64_t write_map[BP_MAP_WORDS];
+    Breakpoint* breakpoints;
+    int bp_count;
+    int bp_capacity;
+    Watchpoint* watchpoints;
+    int wp_count;
+    int wp_capacity;
+    int next_id;
+    bool armed;                 // Any breakpoint or watchpoint present
+    CPU* cpu;                   // CPU whose watch maps we maintain
+    // Pending watchpoint hit from the last memory access
+    bool watch_hit;
+    uint16_t hit_addr;
+    uint16_t hit_value;
+    bool hit_write;
+    // Last breakpoint stop: resuming from exactly there must not stop again
+    bool stopped;
+    uint16_t stop_pc;
+    uint64_t stop_cycle;
+} BreakpointSet;
+
+static inline bool bp_map_test(const uint64_t* map, uint16_t addr) {
+    return (map[addr >> 6] >> (addr & 63)) & 1;
+}
+
+void bp_init(BreakpointSet* set, CPU* cpu);
+void bp_free(BreakpointSet* set);
+int bp_add_breakpoint(BreakpointSet* set, uint16_t addr, int cond_reg, BpCondOp op,
+                      uint16_t value, uint64_t ignore_count);
+int bp_add_watchpoint(BreakpointSet* set, uint16_t start, uint16_t end, int kind);
+bool bp_delete(BreakpointSet* set, int id);
+bool bp_check_pc(BreakpointSet* set, CPU* cpu, int* id);
+void bp_note_access(CPU* cpu, uint16_t addr, uint16_t value, bool is_write);
+int bp_find_watchpoint(BreakpointSet* set, uint16_t addr, bool is_write);
+int bp_parse_breakpoint(BreakpointSet* set, const char* spec);
+int bp_parse_watchpoint(BreakpointSet* set, const char* spec);
+void bp_list(const BreakpointSet* set);
+void bp_report_stop(const StopReason* reason);
+
+#endif // BREAKPOINT_H
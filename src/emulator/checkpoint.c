@@ -0,0 +1,297 @@
+#include "checkpoint.h"
+#include "bank.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static Checkpoint* checkpoint_at(const Checkpointer* ckpt, int index) {
+    return &ckpt->ring[(ckpt->head + index) % ckpt->max_checkpoints];
+}
+
+static Checkpoint* checkpoint_newest(const Checkpointer* ckpt) {
+    return checkpoint_at(ckpt, ckpt->count - 1);
+}
+
+// Releasing saved pages of one checkpoint, buffers included: a slot
+// keeping its peak capacity would hold memory the bound no longer counts
+static void checkpoint_clear_pages(Checkpointer* ckpt, Checkpoint* cp) {
+    ckpt->total_pages -= cp->page_count;
+    ckpt->allocated_pages -= cp->page_capacity;
+    free(cp->page_ids);
+    free(cp->page_banks);
+    free(cp->page_data);
+    cp->page_ids = NULL;
+    cp->page_banks = NULL;
+    cp->page_data = NULL;
+    cp->page_count = 0;
+    cp->page_capacity = 0;
+}
+
+// Dropping the oldest checkpoint to stay within the memory bound
+static void checkpoint_drop_oldest(Checkpointer* ckpt) {
+    Checkpoint* cp = checkpoint_at(ckpt, 0);
+    checkpoint_clear_pages(ckpt, cp);
+    ckpt->head = (ckpt->head + 1) % ckpt->max_checkpoints;
+    ckpt->count--;
+    ckpt->dropped++;
+}
+
+// Recording a new checkpoint at the current cycle
+static void checkpoint_take(Checkpointer* ckpt, CPU* cpu) {
+    if (ckpt->count == ckpt->max_checkpoints) {
+        checkpoint_drop_oldest(ckpt);
+    }
+
+    Checkpoint* cp = checkpoint_at(ckpt, ckpt->count++);
+    cp->cycle = cpu->cycle_count;
+    memcpy(cp->registers, cpu->registers, sizeof(cp->registers));
+    cp->pc = cpu->pc;
+    cp->ir = cpu->ir;
+    cp->flags = cpu->flags;
+    cp->halted = cpu->halted;
+    cp->bank = cpu->bank;
+    checkpoint_clear_pages(ckpt, cp);
+
+    memset(ckpt->saved, 0, sizeof(ckpt->saved));
+    if (ckpt->bank_saved) memset(ckpt->bank_saved, 0, ckpt->bank_saved_words * sizeof(uint64_t));
+    ckpt->next_cycle = cpu->cycle_count + ckpt->interval;
+}
+
+// Setting up checkpointing and taking the initial checkpoint
+bool checkpoint_init(Checkpointer* ckpt, CPU* cpu, uint64_t interval, size_t max_pages, int max_checkpoints) {
+    memset(ckpt, 0, sizeof(Checkpointer));
+    // The newest checkpoint may need every page, so never go below that
+    size_t bank_pages = cpu->banks ? (size_t)cpu->banks->bank_count * BANK_PAGES : 0;
+    size_t floor_pages = cpu->banks ? NUM_PAGES - BANK_PAGES + bank_pages : NUM_PAGES;
+    if (max_pages < floor_pages) {
+        fprintf(stderr, "Error: Checkpoint history needs at least %zu pages%s, got %zu\n",
+                floor_pages, cpu->banks ? " (every page and bank page)" : "", max_pages);
+        return false;
+    }
+    if (bank_pages > 0) {
+        ckpt->bank_saved_words = (bank_pages + 63) / 64;
+        ckpt->bank_saved = (uint64_t*)calloc(ckpt->bank_saved_words, sizeof(uint64_t));
+        if (!ckpt->bank_saved) {
+            fprintf(stderr, "Error: Cannot allocate checkpoint bank map\n");
+            return false;
+        }
+    }
+    ckpt->interval = interval > 0 ? interval : CHECKPOINT_DEFAULT_INTERVAL;
+    ckpt->max_pages = max_pages;
+    ckpt->max_checkpoints = max_checkpoints < 2 ? 2 : max_checkpoints;
+    ckpt->ring = (Checkpoint*)calloc(ckpt->max_checkpoints, sizeof(Checkpoint));
+    if (!ckpt->ring) {
+        fprintf(stderr, "Error: Cannot allocate checkpoint ring\n");
+        free(ckpt->bank_saved);
+        return false;
+    }
+
+    // Inputs must be journaled so re-execution sees the same values
+    if (cpu->iolog) {
+        cpu->iolog->keep_events = true;
+    } else {
+        iolog_open_journal(&ckpt->journal);
+        ckpt->owns_journal = true;
+        cpu->iolog = &ckpt->journal;
+    }
+
+    cpu->ckpt = ckpt;
+    checkpoint_take(ckpt, cpu);
+    return true;
+}
+
+// Releasing checkpoint storage
+void checkpoint_free(Checkpointer* ckpt, CPU* cpu) {
+    for (int i = 0; i < ckpt->max_checkpoints; i++) {
+        free(ckpt->ring[i].page_ids);
+        free(ckpt->ring[i].page_banks);
+        free(ckpt->ring[i].page_data);
+    }
+    free(ckpt->ring);
+    ckpt->ring = NULL;
+    free(ckpt->bank_saved);
+    ckpt->bank_saved = NULL;
+
+    if (ckpt->owns_journal) {
+        if (cpu->iolog == &ckpt->journal) cpu->iolog = NULL;
+        iolog_close(&ckpt->journal);
+    }
+    if (cpu->ckpt == ckpt) cpu->ckpt = NULL;
+}
+
+// Saving a page pre-image before its first write in this interval
+void checkpoint_note_write(Checkpointer* ckpt, CPU* cpu, uint16_t address) {
+    if (ckpt->watching && address == ckpt->watch_addr) {
+        ckpt->found_write = true;
+        ckpt->write_cycle = cpu->cycle_count;
+    }
+
+    uint16_t page = address >> PAGE_SHIFT;
+    uint64_t* saved = ckpt->saved;
+    size_t index = page;
+    if (ckpt->bank_saved && page >= BANK_FIRST_PAGE && page < BANK_FIRST_PAGE + BANK_PAGES) {
+        // Writes to a bank past the end are discarded: nothing to restore
+        if (cpu->bank >= cpu->banks->bank_count) return;
+        saved = ckpt->bank_saved;
+        index = (size_t)cpu->bank * BANK_PAGES + (page - BANK_FIRST_PAGE);
+    }
+    uint64_t bit = 1ULL << (index & 63);
+    if (saved[index >> 6] & bit) return;
+    saved[index >> 6] |= bit;
+
+    while (ckpt->total_pages >= ckpt->max_pages && ckpt->count > 1) {
+        checkpoint_drop_oldest(ckpt);
+    }
+
+    Checkpoint* cp = checkpoint_newest(ckpt);
+    if (cp->page_count == cp->page_capacity) {
+        int capacity = cp->page_capacity ? cp->page_capacity * 2 : 8;
+        ckpt->allocated_pages += capacity - cp->page_capacity;
+        cp->page_capacity = capacity;
+        cp->page_ids = (uint8_t*)realloc(cp->page_ids, cp->page_capacity);
+        cp->page_banks = (uint16_t*)realloc(cp->page_banks, (size_t)cp->page_capacity * sizeof(uint16_t));
+        cp->page_data = (uint16_t*)realloc(cp->page_data,
+                                           (size_t)cp->page_capacity * PAGE_WORDS * sizeof(uint16_t));
+    }
+    cp->page_ids[cp->page_count] = (uint8_t)page;
+    cp->page_banks[cp->page_count] = cpu->bank;
+    memcpy(&cp->page_data[(size_t)cp->page_count * PAGE_WORDS],
+           cpu->pages[page], PAGE_WORDS * sizeof(uint16_t));
+    cp->page_count++;
+    ckpt->total_pages++;
+}
+
+// Getting the page a pre-image goes back to: a bank page, which need not
+// be the one in the window, or a CPU page
+static uint16_t* checkpoint_target(CPU* cpu, uint16_t page, uint16_t bank) {
+    if (cpu->banks && page >= BANK_FIRST_PAGE && page < BANK_FIRST_PAGE + BANK_PAGES) {
+        return bank_page_for_write(cpu->banks, bank, page - BANK_FIRST_PAGE);
+    }
+    return cpu_page_for_write(cpu, page);
+}
+
+// Taking a checkpoint when the interval elapses
+void checkpoint_tick(Checkpointer* ckpt, CPU* cpu) {
+    if (cpu->cycle_count >= ckpt->next_cycle) {
+        checkpoint_take(ckpt, cpu);
+    }
+}
+
+// Finding newest checkpoint at or before cycle (-1 if none)
+static int checkpoint_find(const Checkpointer* ckpt, uint64_t cycle) {
+    for (int i = ckpt->count - 1; i >= 0; i--) {
+        if (checkpoint_at(ckpt, i)->cycle <= cycle) return i;
+    }
+    return -1;
+}
+
+// Rolling machine state back to checkpoint index
+static void checkpoint_restore(Checkpointer* ckpt, CPU* cpu, int index) {
+    for (int i = ckpt->count - 1; i >= index; i--) {
+        Checkpoint* cp = checkpoint_at(ckpt, i);
+        // Newest first, so the oldest pre-image of each (bank) page is left
+        for (int p = cp->page_count - 1; p >= 0; p--) {
+            uint16_t page = cp->page_ids[p];
+            memcpy(checkpoint_target(cpu, page, cp->page_banks[p]),
+                   &cp->page_data[(size_t)p * PAGE_WORDS], PAGE_WORDS * sizeof(uint16_t));
+            cpu->dirty_pages[page >> 6] |= 1ULL << (page & 63);
+        }
+        checkpoint_clear_pages(ckpt, cp);
+    }
+    ckpt->count = index + 1;
+
+    Checkpoint* cp = checkpoint_at(ckpt, index);
+    memcpy(cpu->registers, cp->registers, sizeof(cpu->registers));
+    cpu->pc = cp->pc;
+    cpu->ir = cp->ir;
+    cpu->flags = cp->flags;
+    cpu->halted = cp->halted;
+    cpu->cycle_count = cp->cycle;
+    cpu_select_bank(cpu, cp->bank);
+
+    memset(ckpt->saved, 0, sizeof(ckpt->saved));
+    if (ckpt->bank_saved) memset(ckpt->bank_saved, 0, ckpt->bank_saved_words * sizeof(uint64_t));
+    ckpt->next_cycle = cp->cycle + ckpt->interval;
+    iolog_rewind(cpu->iolog, cp->cycle);
+}
+
+// Re-executing silently up to target cycle
+static void checkpoint_run_to(CPU* cpu, uint64_t target) {
+    bool suppress = cpu->suppress_output;
+    cpu->suppress_output = true;
+    while (!cpu->halted && cpu->cycle_count < target) {
+        cpu_step(cpu, false);
+    }
+    cpu->suppress_output = suppress;
+}
+
+// Moving to an earlier cycle: restore nearest checkpoint, re-execute forward
+bool checkpoint_restore_cycle(Checkpointer* ckpt, CPU* cpu, uint64_t cycle) {
+    int index = checkpoint_find(ckpt, cycle);
+    if (index < 0) return false;
+    checkpoint_restore(ckpt, cpu, index);
+    checkpoint_run_to(cpu, cycle);
+    return true;
+}
+
+// Stepping back count instructions (one instruction per cycle)
+bool checkpoint_step_back(Checkpointer* ckpt, CPU* cpu, uint64_t count) {
+    uint64_t target = cpu->cycle_count > count ? cpu->cycle_count - count : 0;
+    uint64_t oldest = checkpoint_at(ckpt, 0)->cycle;
+    if (target < oldest) {
+        fprintf(stderr, "Warning: history only reaches back to cycle %llu\n",
+                (unsigned long long)oldest);
+        target = oldest;
+    }
+    return checkpoint_restore_cycle(ckpt, cpu, target);
+}
+
+// Running back to just after the most recent write of address
+bool checkpoint_run_back_to_write(Checkpointer* ckpt, CPU* cpu, uint16_t address) {
+    uint64_t end = cpu->cycle_count;
+    uint64_t seg_end = end;
+
+    // Searching one checkpoint interval at a time, newest first
+    while (seg_end > 0) {
+        int index = checkpoint_find(ckpt, seg_end - 1);
+        if (index < 0) break;
+        uint64_t seg_start = checkpoint_at(ckpt, index)->cycle;
+
+        checkpoint_restore(ckpt, cpu, index);
+        ckpt->watching = true;
+        ckpt->watch_addr = address;
+        ckpt->found_write = false;
+        checkpoint_run_to(cpu, seg_end);
+        ckpt->watching = false;
+
+        if (ckpt->found_write) {
+            uint64_t write_cycle = ckpt->write_cycle;
+            checkpoint_restore_cycle(ckpt, cpu, write_cycle);
+            uint16_t write_pc = cpu->pc;
+            checkpoint_run_to(cpu, write_cycle + 1);
+            printf("Last write to 0x%04X at cycle %llu by instruction at 0x%04X\n",
+                   address, (unsigned long long)write_cycle, write_pc);
+            return true;
+        }
+        seg_end = seg_start;
+    }
+
+    // No write in recorded history: return to where we started
+    checkpoint_run_to(cpu, end);
+    printf("No write to 0x%04X in recorded history\n", address);
+    return false;
+}
+
+// Printing checkpoint statistics
+void checkpoint_print_info(const Checkpointer* ckpt) {
+    printf("Checkpoints: %d (interval %llu cycles, %llu dropped)\n",
+           ckpt->count, (unsigned long long)ckpt->interval, (unsigned long long)ckpt->dropped);
+    if (ckpt->count > 0) {
+        printf("History: cycle %llu .. %llu\n",
+               (unsigned long long)checkpoint_at(ckpt, 0)->cycle,
+               (unsigned long long)checkpoint_newest(ckpt)->cycle);
+    }
+    printf("Saved pages: %zu of %zu (%zu KB, %zu KB allocated)\n", ckpt->total_pages, ckpt->max_pages,
+           ckpt->total_pages * PAGE_WORDS * sizeof(uint16_t) / 1024,
+           ckpt->allocated_pages * PAGE_WORDS * sizeof(uint16_t) / 1024);
+}
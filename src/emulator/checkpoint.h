@@ -0,0 +1,82 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "cpu.h"
+#include "iolog.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Reverse execution via periodic incremental checkpoints.
+//
+// A checkpoint is taken every `interval` cycles. It stores the register
+// file and, lazily, the pre-image of every page written for the first
+// time during its interval. Rolling back to checkpoint k applies the
+// pre-images of all newer checkpoints (newest first) and then those of
+// k itself. Reverse commands restore the nearest checkpoint and
+// re-execute forward with output suppressed; inputs are served from an
+// in-memory journal so re-execution is deterministic.
+//
+// Memory use is bounded by max_checkpoints ring slots plus max_pages
+// saved pages (PAGE_WORDS words each). The oldest checkpoints are
+// dropped to stay within the bound, and a dropped or rolled-back
+// checkpoint frees its page buffers. The newest checkpoint is never
+// dropped, so max_pages must hold everything it can save: every page,
+// counting every bank page instead of the window when banks are attached.
+//
+// With a bank store attached, a pre-image of a bank window page records
+// the bank it came from. Window pages are tracked per bank, so each bank
+// page is saved at most once per interval however often banks switch.
+
+#define CHECKPOINT_DEFAULT_INTERVAL 10000
+#define CHECKPOINT_DEFAULT_PAGES    4096     // 2MB of page pre-images
+#define CHECKPOINT_DEFAULT_SLOTS    1024
+
+typedef struct {
+    uint64_t cycle;
+    uint16_t registers[NUM_REGISTERS];
+    uint16_t pc;
+    uint16_t ir;
+    Flags flags;
+    bool halted;
+    uint16_t bank;          // Bank selected through MMIO_BANK
+    uint8_t* page_ids;      // Pages whose pre-image is saved
+    uint16_t* page_banks;   // Bank each pre-image came from
+    uint16_t* page_data;    // page_count * PAGE_WORDS words
+    int page_count;
+    int page_capacity;
+} Checkpoint;
+
+typedef struct Checkpointer {
+    uint64_t interval;
+    size_t max_pages;
+    int max_checkpoints;
+    Checkpoint* ring;
+    int head;                           // Oldest checkpoint
+    int count;
+    size_t total_pages;
+    size_t allocated_pages;             // Page slots the checkpoints' buffers hold
+    uint64_t next_cycle;
+    uint64_t saved[NUM_PAGES / 64];     // Pages saved in newest checkpoint
+    uint64_t* bank_saved;               // Same for bank pages, bank * BANK_PAGES + page
+    size_t bank_saved_words;
+    uint64_t dropped;                   // Checkpoints evicted by the bound
+    IoLog journal;                      // Used when the CPU has no log
+    bool owns_journal;
+    // Write watch used while searching backward
+    bool watching;
+    uint16_t watch_addr;
+    bool found_write;
+    uint64_t write_cycle;
+} Checkpointer;
+
+bool checkpoint_init(Checkpointer* ckpt, CPU* cpu, uint64_t interval, size_t max_pages, int max_checkpoints);
+void checkpoint_free(Checkpointer* ckpt, CPU* cpu);
+void checkpoint_note_write(Checkpointer* ckpt, CPU* cpu, uint16_t address);
+void checkpoint_tick(Checkpointer* ckpt, CPU* cpu);
+bool checkpoint_restore_cycle(Checkpointer* ckpt, CPU* cpu, uint64_t cycle);
+bool checkpoint_step_back(Checkpointer* ckpt, CPU* cpu, uint64_t count);
+bool checkpoint_run_back_to_write(Checkpointer* ckpt, CPU* cpu, uint16_t address);
+void checkpoint_print_info(const Checkpointer* ckpt);
+
+#endif // CHECKPOINT_H
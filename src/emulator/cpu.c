@@ -1,17 +1,109 @@
 #include "cpu.h"
+#include "iolog.h"
+#include "checkpoint.h"
+#include "breakpoint.h"
+#include "engine.h"
+#include "bank.h"
+#include "timing.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// Initializing CPU state
+// Shared backing for every page that has never been written
+const uint16_t cpu_zero_page[PAGE_WORDS];
+
+// Initializing CPU state (all memory reads as zero, nothing allocated)
 void cpu_init(CPU* cpu) {
     memset(cpu, 0, sizeof(CPU));
+    for (int i = 0; i < NUM_PAGES; i++) {
+        cpu->pages[i] = (uint16_t*)cpu_zero_page;
+    }
     cpu->registers[REG_SP] = STACK_START;
     cpu->pc = 0;
     cpu->halted = false;
+    cpu->faulted = false;
     cpu->cycle_count = 0;
 }
 
+// Releasing all resident memory pages and engine state
+void cpu_free(CPU* cpu) {
+    engine_attach(cpu, NULL);
+    cpu_attach_banks(cpu, NULL);
+    for (int i = 0; i < NUM_PAGES; i++) {
+        cpu_release_page(cpu, (uint16_t)i);
+    }
+}
+
+// Window pages belong to the bank store when one is attached
+static bool cpu_banked_page(const CPU* cpu, uint16_t page) {
+    return cpu->banks && page >= BANK_FIRST_PAGE && page < BANK_FIRST_PAGE + BANK_PAGES;
+}
+
+// Getting a writable page, allocating it on first use
+uint16_t* cpu_page_for_write(CPU* cpu, uint16_t page) {
+    if (cpu->pages[page] == cpu_zero_page && cpu_banked_page(cpu, page)) {
+        // The bank store owns window pages; writes to a bank past its
+        // end land in a sink that is never mapped in
+        uint16_t* data = bank_page_for_write(cpu->banks, cpu->bank, page - BANK_FIRST_PAGE);
+        if (data == cpu->banks->discard) return data;
+        cpu->pages[page] = data;
+    } else if (cpu->pages[page] == cpu_zero_page) {
+        uint16_t* data = (uint16_t*)calloc(PAGE_WORDS, sizeof(uint16_t));
+        if (!data) {
+            fprintf(stderr, "Error: Out of memory allocating page 0x%02X\n", page);
+            exit(1);
+        }
+        cpu->pages[page] = data;
+        cpu->resident_pages++;
+    }
+    return cpu->pages[page];
+}
+
+// Returning a page to the shared zero page (clearing it, for a bank page)
+void cpu_release_page(CPU* cpu, uint16_t page) {
+    if (cpu->pages[page] != cpu_zero_page && cpu_banked_page(cpu, page)) {
+        memset(cpu->pages[page], 0, PAGE_WORDS * sizeof(uint16_t));
+    } else if (cpu->pages[page] != cpu_zero_page) {
+        free(cpu->pages[page]);
+        cpu->pages[page] = (uint16_t*)cpu_zero_page;
+        cpu->resident_pages--;
+    }
+}
+
+// Showing bank through the bank window (a bank past the end reads as zero)
+void cpu_select_bank(CPU* cpu, uint16_t bank) {
+    cpu->bank = bank;
+    if (!cpu->banks) return;
+    for (uint16_t i = 0; i < BANK_PAGES; i++) {
+        uint16_t page = BANK_FIRST_PAGE + i;
+        cpu->pages[page] = bank_page(cpu->banks, bank, i);
+        cpu->dirty_pages[page >> 6] |= 1ULL << (page & 63);
+    }
+}
+
+// Putting a bank store behind the bank window (NULL = ordinary memory again)
+void cpu_attach_banks(CPU* cpu, BankStore* banks) {
+    for (uint16_t page = BANK_FIRST_PAGE; page < BANK_FIRST_PAGE + BANK_PAGES; page++) {
+        if (cpu->banks) {
+            cpu->pages[page] = (uint16_t*)cpu_zero_page;
+        } else {
+            cpu_release_page(cpu, page);
+        }
+    }
+    cpu->banks = banks;
+    cpu_select_bank(cpu, 0);
+}
+
+// Writing a word without MMIO, watch or dirty-tracking side effects
+void cpu_poke(CPU* cpu, uint16_t address, uint16_t value) {
+    uint16_t* page = cpu->pages[address >> PAGE_SHIFT];
+    if (page == cpu_zero_page) {
+        if (value == 0) return;
+        page = cpu_page_for_write(cpu, address >> PAGE_SHIFT);
+    }
+    page[address & PAGE_MASK] = value;
+}
+
 // Resetting CPU to initial state
 void cpu_reset(CPU* cpu) {
     for (int i = 0; i < NUM_REGISTERS - 1; i++) {
@@ -25,65 +117,150 @@ void cpu_reset(CPU* cpu) {
     cpu->flags.C = false;
     cpu->flags.V = false;
     cpu->halted = false;
+    cpu->faulted = false;
     cpu->cycle_count = 0;
 }
 
 // Loading program into memory
-void cpu_load_program(CPU* cpu, const uint16_t* program, uint16_t size, uint16_t start_addr) {
-    if (start_addr + size > MEM_SIZE) {
+void cpu_load_program(CPU* cpu, const uint16_t* program, uint32_t size, uint16_t start_addr) {
+    if ((uint32_t)start_addr + size > MEM_SIZE) {
         fprintf(stderr, "Error: Program too large for memory\n");
         return;
     }
     
-    memcpy(&cpu->memory[start_addr], program, size * sizeof(uint16_t));
+    // All-zero stretches (e.g. .ORG padding) stay unallocated
+    for (uint32_t i = 0; i < size; i++) {
+        cpu_poke(cpu, (uint16_t)(start_addr + i), program[i]);
+    }
     cpu->pc = start_addr;
     
-    printf("Program loaded: %d words at address 0x%04X\n", size, start_addr);
+    printf("Program loaded: %u words at address 0x%04X\n", size, start_addr);
+}
+
+// Reading a memory-mapped device register
+static uint16_t cpu_read_device(CPU* cpu, uint16_t address) {
+    uint16_t value;
+    switch (address) {
+        case MMIO_TIMER:
+        case MMIO_CHAR_IN:
+            // Nondeterministic inputs go through the record/replay log
+            if (cpu->iolog && iolog_replaying(cpu->iolog)) {
+                return iolog_replay(cpu->iolog, address, cpu->cycle_count);
+            }
+            if (address == MMIO_TIMER) {
+                value = (uint16_t)(cpu->cycle_count & 0xFFFF);
+            } else if (cpu->input) {
+                value = cpu->input_pos < cpu->input_size ?
+                        cpu->input[cpu->input_pos++] : 0xFFFF;
+            } else {
+                value = (uint16_t)getchar();
+            }
+            if (cpu->iolog) {
+                iolog_record(cpu->iolog, address, cpu->cycle_count, value);
+            }
+            return value;
+        case MMIO_BANK:
+            return cpu->bank;
+        case MMIO_BANK_COUNT:
+            if (!cpu->banks) return 0;
+            return cpu->banks->bank_count > 0xFFFF ? 0xFFFF : (uint16_t)cpu->banks->bank_count;
+        default:
+            return 0;
+    }
 }
 
 // Reading from memory with MMIO support
 uint16_t cpu_read_memory(CPU* cpu, uint16_t address) {
-    // Handling memory-mapped I/O reads
+    bool watched = cpu->watch_read && bp_map_test(cpu->watch_read, address);
+
+    // Handling memory-mapped I/O reads; a watchpoint sees the value the guest gets
     if (address >= MMIO_START) {
-        switch (address) {
-            case MMIO_TIMER:
-                return (uint16_t)(cpu->cycle_count & 0xFFFF);
-            case MMIO_CHAR_IN:
-                return (uint16_t)getchar();
-            default:
-                return 0;
+        uint16_t value = cpu_read_device(cpu, address);
+        if (watched) {
+            bp_note_access(cpu, address, value, false);
         }
+        return value;
     }
-    
-    return cpu->memory[address];
+
+    if (watched) {
+        bp_note_access(cpu, address, cpu_peek(cpu, address), false);
+    }
+    if (cpu->timing) {
+        timing_note_access(cpu->timing, address);
+    }
+    return cpu_peek(cpu, address);
+}
+
+// Appending text to the captured output buffer
+static void cpu_output_append(OutputBuffer* out, const char* text, size_t len) {
+    if (out->size + len > out->capacity) {
+        size_t capacity = out->capacity ? out->capacity : 256;
+        while (capacity < out->size + len) capacity *= 2;
+        out->data = (char*)realloc(out->data, capacity);
+        out->capacity = capacity;
+    }
+    memcpy(out->data + out->size, text, len);
+    out->size += len;
+}
+
+// Emitting one guest output character
+static void cpu_output_char(CPU* cpu, char c) {
+    if (cpu->output) {
+        cpu_output_append(cpu->output, &c, 1);
+    } else {
+        putchar(c);
+    }
+}
+
+// Feeding MMIO_CHAR_IN from a buffer instead of stdin
+void cpu_set_input(CPU* cpu, const uint8_t* data, size_t size) {
+    cpu->input = data;
+    cpu->input_size = size;
+    cpu->input_pos = 0;
 }
 
 // Writing to memory with MMIO support
 void cpu_write_memory(CPU* cpu, uint16_t address, uint16_t value) {
+    if (cpu->watch_write && bp_map_test(cpu->watch_write, address)) {
+        bp_note_access(cpu, address, value, true);
+    }
+
     // Handling memory-mapped I/O writes
     if (address >= MMIO_START) {
+        // Switching banks is machine state, so it also happens while re-executing
+        if (address == MMIO_BANK) {
+            cpu_select_bank(cpu, value);
+            return;
+        }
+        if (cpu->suppress_output) return;
         switch (address) {
             case MMIO_CHAR_OUT:
-                putchar((char)(value & 0xFF));
-                fflush(stdout);
+                cpu_output_char(cpu, (char)(value & 0xFF));
+                if (!cpu->output) fflush(stdout);
                 break;
             case MMIO_INT_OUT:
-                printf("%d\n", value);
-                fflush(stdout);
+                if (cpu->output) {
+                    char text[8];
+                    int len = snprintf(text, sizeof(text), "%d\n", value);
+                    cpu_output_append(cpu->output, text, len);
+                } else {
+                    printf("%d\n", value);
+                    fflush(stdout);
+                }
                 break;
             case MMIO_STR_OUT: {
                 // Printing null-terminated string from memory (packed 2 chars per word)
                 uint16_t str_addr = value;
-                while (1) {
-                    uint16_t word = cpu->memory[str_addr++];
+                for (uint32_t n = 0; n < MEM_SIZE; n++) {
+                    uint16_t word = cpu_peek(cpu, str_addr++);
                     // Check low byte
                     if ((word & 0xFF) == 0) break;
-                    putchar((char)(word & 0xFF));
+                    cpu_output_char(cpu, (char)(word & 0xFF));
                     // Check high byte
                     if ((word >> 8) == 0) break;
-                    putchar((char)(word >> 8));
+                    cpu_output_char(cpu, (char)(word >> 8));
                 }
-                fflush(stdout);
+                if (!cpu->output) fflush(stdout);
                 break;
             }
             default:
@@ -92,8 +269,26 @@ void cpu_write_memory(CPU* cpu, uint16_t address, uint16_t value) {
         }
         return;
     }
+
+    uint16_t page = address >> PAGE_SHIFT;
+    cpu->dirty_pages[page >> 6] |= 1ULL << (page & 63);
+    if (cpu->ckpt) {
+        checkpoint_note_write(cpu->ckpt, cpu, address);
+    }
+    if (cpu->timing) {
+        timing_note_access(cpu->timing, address);
+    }
     
-    cpu->memory[address] = value;
+    uint16_t* data = cpu->pages[page];
+    if (data == cpu_zero_page) {
+        data = cpu_page_for_write(cpu, page);
+    }
+    data[address & PAGE_MASK] = value;
+}
+
+// Forgetting which pages have been written
+void cpu_clear_dirty(CPU* cpu) {
+    memset(cpu->dirty_pages, 0, sizeof(cpu->dirty_pages));
 }
 
 // Updating CPU flags based on result
@@ -108,12 +303,106 @@ void cpu_update_flags(CPU* cpu, uint16_t result, bool update_carry, uint32_t ful
 
 // Fetching next instruction
 uint16_t cpu_fetch(CPU* cpu) {
-    uint16_t instruction = cpu_read_memory(cpu, cpu->pc);
+    uint16_t instruction;
+
+    // Fetching is not a data access, so read watchpoints do not see it
+    if (cpu->pc >= MMIO_START) {
+        instruction = cpu_read_device(cpu, cpu->pc);
+    } else {
+        if (cpu->timing) {
+            timing_note_access(cpu->timing, cpu->pc);
+        }
+        instruction = cpu_peek(cpu, cpu->pc);
+    }
     cpu->ir = instruction;
     cpu->pc++;
     return instruction;
 }
 
+// Pushing (R6 down to R0) or popping (R0 up to R6) the registers in
+// mask, as the same sequence of PUSH or POP would. A run that stays in
+// one RAM page, with no watchpoints, checkpoints or timing model, goes
+// straight to the page instead of through the MMIO check per word.
+void cpu_stack_transfer(CPU* cpu, uint16_t mask, bool push) {
+    mask &= STACK_MASK_REGS;
+    uint16_t count = (uint16_t)__builtin_popcount(mask);
+    uint16_t sp = cpu->registers[REG_SP];
+    uint16_t low = push ? (uint16_t)(sp - count) : sp;
+    bool direct = count > 0 && low <= (uint16_t)(low + count - 1) && low + count <= MMIO_START &&
+                  (low >> PAGE_SHIFT) == ((low + count - 1) >> PAGE_SHIFT) &&
+                  !cpu->ckpt && !cpu->timing && !(push ? cpu->watch_write : cpu->watch_read);
+
+    if (direct && push) {
+        uint16_t page = low >> PAGE_SHIFT;
+        cpu->dirty_pages[page >> 6] |= 1ULL << (page & 63);
+        uint16_t* data = cpu->pages[page];
+        if (data == cpu_zero_page) {
+            data = cpu_page_for_write(cpu, page);
+        }
+        data += low & PAGE_MASK;
+        for (int r = 0; r < NUM_REGISTERS; r++) {
+            if (mask & (1 << r)) *data++ = cpu->registers[r];
+        }
+    } else if (direct) {
+        const uint16_t* data = cpu->pages[low >> PAGE_SHIFT] + (low & PAGE_MASK);
+        for (int r = 0; r < NUM_REGISTERS; r++) {
+            if (mask & (1 << r)) cpu->registers[r] = *data++;
+        }
+    } else if (push) {
+        for (int r = NUM_REGISTERS - 1; r >= 0; r--) {
+            if (!(mask & (1 << r))) continue;
+            cpu->registers[REG_SP]--;
+            cpu_write_memory(cpu, cpu->registers[REG_SP], cpu->registers[r]);
+        }
+        return;
+    } else {
+        for (int r = 0; r < NUM_REGISTERS; r++) {
+            if (!(mask & (1 << r))) continue;
+            cpu->registers[r] = cpu_read_memory(cpu, cpu->registers[REG_SP]);
+            cpu->registers[REG_SP]++;
+        }
+        return;
+    }
+    cpu->registers[REG_SP] = push ? low : (uint16_t)(sp + count);
+}
+
+// Computing a packed-byte operation on Rd (a) and Rs (b) and setting
+// the flags: Z and N from the result, C only where the mode defines it
+uint16_t cpu_packed_op(CPU* cpu, uint8_t mode, uint16_t a, uint16_t b) {
+    uint16_t result = 0;
+    bool carry = cpu->flags.C;
+    switch (mode) {
+        case SPEC_BADDS:
+        case SPEC_BSUBS:
+            carry = false;
+            for (int shift = 0; shift < 16; shift += 8) {
+                int x = (a >> shift) & 0xFF, y = (b >> shift) & 0xFF;
+                int lane = mode == SPEC_BADDS ? x + y : x - y;
+                if (lane > 0xFF || lane < 0) {
+                    lane = lane < 0 ? 0 : 0xFF;
+                    carry = true;
+                }
+                result |= (uint16_t)(lane << shift);
+            }
+            break;
+        case SPEC_BCMPEQ:
+            result = (uint16_t)((((a ^ b) & 0x00FF) ? 0 : 0x00FF) | (((a ^ b) & 0xFF00) ? 0 : 0xFF00));
+            break;
+        case SPEC_BSWAP:
+            result = (uint16_t)((a << 8) | (a >> 8));
+            break;
+        case SPEC_BFZ:
+            result = (b & 0x00FF) == 0 ? 0 : (b & 0xFF00) == 0 ? 1 : 2;
+            carry = result < 2;
+            break;
+        default:
+            return a;
+    }
+    cpu_update_flags(cpu, result, false, 0);
+    cpu->flags.C = carry;
+    return result;
+}
+
 // Decoding and executing instruction
 void cpu_decode_execute(CPU* cpu, uint16_t instruction, bool trace) {
     // Extracting opcode and operands
@@ -156,6 +445,27 @@ void cpu_decode_execute(CPU* cpu, uint16_t instruction, bool trace) {
                     cpu->registers[rd] = cpu_read_memory(cpu, addr);
                     if (trace) printf("    LD R%d, [R%d] (addr=0x%04X)\n", rd, rs, addr);
                     break;
+                case LOAD_OFF:
+                    // Loading from base register plus offset word
+                    operand = cpu_fetch(cpu);
+                    addr = (uint16_t)(cpu->registers[rs] + operand);
+                    cpu->registers[rd] = cpu_read_memory(cpu, addr);
+                    if (trace) printf("    LD R%d, [R%d+0x%04X] (addr=0x%04X)\n", rd, rs, operand, addr);
+                    break;
+                case LOAD_POSTINC:
+                case LOAD_PREDEC:
+                    // Loading indirect and stepping the address register;
+                    // the loaded value wins when Rd is the address register
+                    addr = cpu->registers[rs];
+                    if (mode == LOAD_PREDEC) addr--;
+                    operand = cpu_read_memory(cpu, addr);
+                    cpu->registers[rs] = mode == LOAD_PREDEC ? addr : (uint16_t)(addr + 1);
+                    cpu->registers[rd] = operand;
+                    if (trace) {
+                        printf(mode == LOAD_PREDEC ? "    LD R%d, -[R%d] (addr=0x%04X)\n"
+                                                   : "    LD R%d, [R%d]+ (addr=0x%04X)\n", rd, rs, addr);
+                    }
+                    break;
             }
             break;
             
@@ -173,6 +483,26 @@ void cpu_decode_execute(CPU* cpu, uint16_t instruction, bool trace) {
                     cpu_write_memory(cpu, addr, cpu->registers[rs]);
                     if (trace) printf("    ST [R%d], R%d (addr=0x%04X)\n", rd, rs, addr);
                     break;
+                case STORE_OFF:
+                    // Storing to base register plus offset word
+                    operand = cpu_fetch(cpu);
+                    addr = (uint16_t)(cpu->registers[rd] + operand);
+                    cpu_write_memory(cpu, addr, cpu->registers[rs]);
+                    if (trace) printf("    ST [R%d+0x%04X], R%d (addr=0x%04X)\n", rd, operand, rs, addr);
+                    break;
+                case STORE_POSTINC:
+                case STORE_PREDEC:
+                    // Storing indirect and stepping the address register;
+                    // Rs is read before the step when it is the same register
+                    addr = cpu->registers[rd];
+                    if (mode == STORE_PREDEC) addr--;
+                    cpu_write_memory(cpu, addr, cpu->registers[rs]);
+                    cpu->registers[rd] = mode == STORE_PREDEC ? addr : (uint16_t)(addr + 1);
+                    if (trace) {
+                        printf(mode == STORE_PREDEC ? "    ST -[R%d], R%d (addr=0x%04X)\n"
+                                                    : "    ST [R%d]+, R%d (addr=0x%04X)\n", rd, rs, addr);
+                    }
+                    break;
             }
             break;
             
@@ -359,6 +689,13 @@ void cpu_decode_execute(CPU* cpu, uint16_t instruction, bool trace) {
                     cpu->registers[REG_SP]++;
                     if (trace) printf("    POP R%d (SP=0x%04X)\n", rd, cpu->registers[REG_SP]);
                     break;
+                case STACK_PUSHM:
+                case STACK_POPM:
+                    operand = cpu_fetch(cpu);
+                    cpu_stack_transfer(cpu, operand, mode == STACK_PUSHM);
+                    if (trace) printf("    %s 0x%02X (SP=0x%04X)\n", mode == STACK_PUSHM ? "PUSHM" : "POPM",
+                                      operand & STACK_MASK_REGS, cpu->registers[REG_SP]);
+                    break;
             }
             break;
             
@@ -386,14 +723,26 @@ void cpu_decode_execute(CPU* cpu, uint16_t instruction, bool trace) {
             if (trace) printf("    CMP R%d, R%d\n", rd, rs);
             break;
             
+        case OP_SPEC: {
+            // Packed-byte operations (unassigned modes do nothing)
+            static const char* const names[] = { "BADDS", "BSUBS", "BCMPEQ", "BSWAP", "BFZ" };
+            if (mode > SPEC_BFZ) break;
+            cpu->registers[rd] = cpu_packed_op(cpu, mode, cpu->registers[rd], cpu->registers[rs]);
+            if (trace) printf("    %s R%d, R%d (result=0x%04X)\n", names[mode], rd, rs, cpu->registers[rd]);
+            break;
+        }
+
         case OP_HALT:
             cpu->halted = true;
             if (trace) printf("    HALT\n");
             break;
             
         default:
-            fprintf(stderr, "Unknown opcode: 0x%X at PC=0x%04X\n", opcode, cpu->pc - 1);
+            if (!cpu->suppress_output) {
+                fprintf(stderr, "Unknown opcode: 0x%X at PC=0x%04X\n", opcode, cpu->pc - 1);
+            }
             cpu->halted = true;
+            cpu->faulted = true;
             break;
     }
 }
@@ -406,9 +755,17 @@ void cpu_step(CPU* cpu, bool trace) {
         printf("\n[FETCH] PC=0x%04X\n", cpu->pc);
     }
     
+    uint16_t pc = cpu->pc;
     uint16_t instruction = cpu_fetch(cpu);
     cpu_decode_execute(cpu, instruction, trace);
     cpu->cycle_count++;
+
+    if (cpu->ckpt) {
+        checkpoint_tick(cpu->ckpt, cpu);
+    }
+    if (cpu->timing) {
+        timing_note_step(cpu->timing, pc, instruction, cpu->pc);
+    }
     
     if (trace) {
         printf("  [WRITE] Registers: ");
@@ -420,20 +777,79 @@ void cpu_step(CPU* cpu, bool trace) {
     }
 }
 
+// Running for at most max_cycles, stopping on HALT, breakpoints or watchpoints
+StopReason cpu_run_bounded(CPU* cpu, uint64_t max_cycles, bool trace) {
+    StopReason reason;
+    memset(&reason, 0, sizeof(reason));
+    uint64_t limit = cpu->cycle_count + max_cycles;
+    BreakpointSet* bps = cpu->breakpoints;
+
+    if (!bps || !bps->armed) {
+        // Nothing armed: plain loop, no per-instruction checks
+        if (cpu->engine && !trace) {
+            while (!cpu->halted && cpu->cycle_count < limit) {
+                cpu->engine->run(cpu, limit);
+            }
+        } else {
+            while (!cpu->halted && cpu->cycle_count < limit) {
+                cpu_step(cpu, trace);
+            }
+        }
+    } else {
+        bps->watch_hit = false;
+        // Resuming from a breakpoint stop skips that breakpoint once; any
+        // other start (entry, after a step or a budget slice) checks it
+        bool resuming = bps->stopped && bps->stop_pc == cpu->pc && bps->stop_cycle == cpu->cycle_count;
+        bps->stopped = false;
+        while (!cpu->halted && cpu->cycle_count < limit) {
+            uint16_t pc = cpu->pc;
+            if (!resuming && bp_map_test(bps->pc_map, pc) && bp_check_pc(bps, cpu, &reason.id)) {
+                bps->stopped = true;
+                bps->stop_pc = pc;
+                bps->stop_cycle = cpu->cycle_count;
+                reason.kind = STOP_BREAKPOINT;
+                reason.pc = pc;
+                return reason;
+            }
+            resuming = false;
+
+            cpu_step(cpu, trace);
+
+            if (bps->watch_hit) {
+                bps->watch_hit = false;
+                reason.kind = STOP_WATCHPOINT;
+                reason.pc = pc;
+                reason.addr = bps->hit_addr;
+                reason.value = bps->hit_value;
+                reason.write = bps->hit_write;
+                reason.id = bp_find_watchpoint(bps, bps->hit_addr, bps->hit_write);
+                return reason;
+            }
+        }
+    }
+
+    reason.kind = cpu->halted ? STOP_HALT : STOP_CYCLE_LIMIT;
+    reason.pc = cpu->pc;
+    return reason;
+}
+
 // Running CPU until halt
-void cpu_run(CPU* cpu, bool trace) {
+StopReason cpu_run(CPU* cpu, bool trace) {
     printf("\n=== Starting CPU Execution ===\n");
     
-    while (!cpu->halted && cpu->cycle_count < 1000000) {
-        cpu_step(cpu, trace);
-    }
+    StopReason reason = cpu_run_bounded(cpu, CPU_DEFAULT_CYCLE_LIMIT, trace);
     
-    if (cpu->cycle_count >= 1000000) {
+    if (reason.kind == STOP_CYCLE_LIMIT) {
         printf("\n!!! Execution limit reached (possible infinite loop) !!!\n");
     }
     
-    printf("\n=== CPU Halted ===\n");
+    printf("\n=== CPU %s ===\n", reason.kind == STOP_HALT || reason.kind == STOP_CYCLE_LIMIT ?
+                                  "Halted" : "Stopped");
+    if (reason.kind == STOP_BREAKPOINT || reason.kind == STOP_WATCHPOINT) {
+        bp_report_stop(&reason);
+    }
     printf("Total cycles: %llu\n\n", (unsigned long long)cpu->cycle_count);
+    return reason;
 }
 
 // Dumping registers to console
@@ -446,6 +862,13 @@ void cpu_dump_registers(CPU* cpu) {
     printf("Flags: Z=%d N=%d C=%d V=%d\n",
            cpu->flags.Z, cpu->flags.N, cpu->flags.C, cpu->flags.V);
     printf("Cycles: %llu\n", (unsigned long long)cpu->cycle_count);
+    printf("Resident pages: %u (%u KB)\n", cpu->resident_pages,
+           (unsigned)(cpu->resident_pages * PAGE_WORDS * sizeof(uint16_t) / 1024));
+    if (cpu->banks) {
+        printf("Bank: %u of %u (%u bank pages allocated, %zu KB file-backed)\n",
+               cpu->bank, cpu->banks->bank_count, cpu->banks->allocated_pages,
+               cpu->banks->mapped_bytes / 1024);
+    }
 }
 
 // Dumping memory to file
@@ -459,9 +882,14 @@ void cpu_dump_memory(CPU* cpu, const char* filename) {
     fprintf(fp, "Memory Dump\n");
     fprintf(fp, "===========\n\n");
     
-    for (uint32_t i = 0; i < MEM_SIZE; i++) {
-        if (cpu->memory[i] != 0) {
-            fprintf(fp, "0x%04X: 0x%04X (%d)\n", i, cpu->memory[i], cpu->memory[i]);
+    for (uint32_t page = 0; page < NUM_PAGES; page++) {
+        if (!cpu_page_resident(cpu, (uint16_t)page)) continue;
+        const uint16_t* data = cpu->pages[page];
+        for (uint32_t i = 0; i < PAGE_WORDS; i++) {
+            if (data[i] != 0) {
+                uint32_t addr = (page << PAGE_SHIFT) | i;
+                fprintf(fp, "0x%04X: 0x%04X (%d)\n", addr, data[i], data[i]);
+            }
         }
     }
     
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 // CPU Architecture Specifications
 #define WORD_SIZE 16
@@ -10,6 +11,21 @@
 #define NUM_REGISTERS 8
 #define STACK_START 0xE000      // Stack starts at 0xE000
 #define MMIO_START 0xF800       // Memory-mapped I/O region
+#define CPU_DEFAULT_CYCLE_LIMIT 1000000     // cpu_run budget (runaway guard)
+
+// Memory is allocated in 256-word pages on first write; untouched pages
+// all map to one shared read-only zero page
+#define PAGE_SHIFT 8
+#define PAGE_WORDS (1 << PAGE_SHIFT)
+#define PAGE_MASK (PAGE_WORDS - 1)
+#define NUM_PAGES (MEM_SIZE / PAGE_WORDS)
+
+// Bank window: the selected bank of an attached BankStore shows through
+// these 4K words (see bank.h); without a store it is ordinary memory
+#define BANK_WINDOW 0xC000
+#define BANK_WORDS 0x1000
+#define BANK_PAGES (BANK_WORDS / PAGE_WORDS)
+#define BANK_FIRST_PAGE (BANK_WINDOW >> PAGE_SHIFT)
 
 // Register definitions
 #define REG_R0 0
@@ -72,10 +88,16 @@ typedef enum {
 #define LOAD_IMM   0x00    // Load immediate (requires extra word)
 #define LOAD_DIR   0x01    // Load direct (requires extra word for address)
 #define LOAD_IND   0x02    // Load indirect (address in register)
+#define LOAD_OFF   0x03    // Load base register + offset (requires extra word for the offset)
+#define LOAD_POSTINC 0x04  // Load indirect, then increment the address register
+#define LOAD_PREDEC  0x05  // Decrement the address register, then load indirect
 
 // Sub-opcodes for STORE operations
 #define STORE_DIR  0x00    // Store direct (requires extra word for address)
 #define STORE_IND  0x01    // Store indirect (address in register)
+#define STORE_OFF  0x02    // Store base register + offset (requires extra word for the offset)
+#define STORE_POSTINC 0x03 // Store indirect, then increment the address register
+#define STORE_PREDEC  0x04 // Decrement the address register, then store indirect
 
 // Sub-opcodes for BRANCH operations
 #define BRANCH_EQ  0x00    // Branch if equal (Z=1)
@@ -90,6 +112,18 @@ typedef enum {
 // Sub-opcodes for STACK operations
 #define STACK_PUSH 0x00
 #define STACK_POP  0x01
+#define STACK_PUSHM 0x02   // Push the registers in a mask (extension word), R6 first
+#define STACK_POPM  0x03   // Pop the registers in a mask, R0 first
+
+#define STACK_MASK_REGS 0x7F   // Mask bits naming R0-R6 (SP and bits 7-15 are ignored)
+
+// Sub-opcodes for SPEC operations: packed 2x8-bit lanes, low byte first
+// (the order of characters in a packed string)
+#define SPEC_BADDS  0x00   // Per-byte unsigned add, saturating at 0xFF (C if any lane saturated)
+#define SPEC_BSUBS  0x01   // Per-byte unsigned subtract, saturating at 0 (C if any lane saturated)
+#define SPEC_BCMPEQ 0x02   // 0xFF in each byte where Rd and Rs are equal, 0x00 elsewhere
+#define SPEC_BSWAP  0x03   // Swap the two bytes of Rd
+#define SPEC_BFZ    0x04   // Index of the first zero byte of Rs, 2 if none (C if found)
 
 // Processor Flags
 typedef struct {
@@ -99,32 +133,105 @@ typedef struct {
     bool V;  // Overflow flag
 } Flags;
 
-// CPU State
+// Growable buffer capturing guest output instead of stdout
 typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+} OutputBuffer;
+
+struct IoLog;
+struct Checkpointer;
+struct BreakpointSet;
+struct CpuEngine;
+struct BankStore;
+struct TimingModel;
+
+// CPU State
+typedef struct CPU {
     uint16_t registers[NUM_REGISTERS];
     uint16_t pc;                    // Program Counter
     uint16_t ir;                    // Instruction Register
     Flags flags;
-    uint16_t memory[MEM_SIZE];
+    uint16_t* pages[NUM_PAGES];     // Page table (cpu_zero_page = not resident)
+    uint32_t resident_pages;        // Pages allocated for this instance
     bool halted;
+    bool faulted;                   // Halted by an unknown opcode (meaningful while halted)
     uint64_t cycle_count;
+    struct IoLog* iolog;            // Input record/replay log (NULL = live I/O)
+    struct Checkpointer* ckpt;      // Reverse-execution checkpoints (NULL = off)
+    bool suppress_output;           // Drop MMIO output (used while re-executing)
+    OutputBuffer* output;           // Capture MMIO output here (NULL = stdout)
+    const uint8_t* input;           // Buffered MMIO_CHAR_IN bytes (NULL = stdin)
+    size_t input_size;
+    size_t input_pos;
+    uint64_t dirty_pages[NUM_PAGES / 64];   // Pages written since cpu_clear_dirty
+    struct BreakpointSet* breakpoints;      // Breakpoints/watchpoints (NULL = none)
+    const uint64_t* watch_read;     // Read watch bitmap (NULL = none armed)
+    const uint64_t* watch_write;    // Write watch bitmap (NULL = none armed)
+    const struct CpuEngine* engine; // Engine for unchecked runs (NULL = cpu_step)
+    void* engine_state;             // Owned by the engine (e.g. a decode cache)
+    struct BankStore* banks;        // Memory behind the bank window (NULL = none)
+    uint16_t bank;                  // Bank selected through MMIO_BANK
+    struct TimingModel* timing;     // Detailed timing model fed every step (NULL = off)
 } CPU;
 
+// Why a bounded run stopped
+typedef enum {
+    STOP_HALT,
+    STOP_CYCLE_LIMIT,
+    STOP_BREAKPOINT,
+    STOP_WATCHPOINT
+} StopKind;
+
+typedef struct {
+    StopKind kind;
+    int id;             // Breakpoint/watchpoint number
+    uint16_t pc;        // Address of the instruction that stopped
+    uint16_t addr;      // Watched address that was accessed
+    uint16_t value;     // Value read or written
+    bool write;         // Watchpoint access was a write
+} StopReason;
+
 // Memory-Mapped I/O Addresses
 #define MMIO_CHAR_OUT    0xF800    // Write: Output character (low 8 bits)
 #define MMIO_INT_OUT     0xF801    // Write: Output integer (decimal)
 #define MMIO_STR_OUT     0xF802    // Write: Output string at address
 #define MMIO_TIMER       0xF810    // Read: Cycle counter (low 16 bits)
 #define MMIO_CHAR_IN     0xF820    // Read: Input character (blocking)
+#define MMIO_BANK        0xF830    // Read/Write: Bank shown in the bank window
+#define MMIO_BANK_COUNT  0xF831    // Read: Number of banks (0 = no bank store)
+
+extern const uint16_t cpu_zero_page[PAGE_WORDS];
+
+// Reading a word without MMIO side effects
+static inline uint16_t cpu_peek(const CPU* cpu, uint16_t address) {
+    return cpu->pages[address >> PAGE_SHIFT][address & PAGE_MASK];
+}
+
+static inline bool cpu_page_resident(const CPU* cpu, uint16_t page) {
+    return cpu->pages[page] != cpu_zero_page;
+}
 
 // Function prototypes
 void cpu_init(CPU* cpu);
+void cpu_free(CPU* cpu);
 void cpu_reset(CPU* cpu);
-void cpu_load_program(CPU* cpu, const uint16_t* program, uint16_t size, uint16_t start_addr);
-void cpu_run(CPU* cpu, bool trace);
+void cpu_load_program(CPU* cpu, const uint16_t* program, uint32_t size, uint16_t start_addr);
+StopReason cpu_run(CPU* cpu, bool trace);
+StopReason cpu_run_bounded(CPU* cpu, uint64_t max_cycles, bool trace);
 void cpu_step(CPU* cpu, bool trace);
 void cpu_dump_memory(CPU* cpu, const char* filename);
 void cpu_dump_registers(CPU* cpu);
+void cpu_clear_dirty(CPU* cpu);
+uint16_t* cpu_page_for_write(CPU* cpu, uint16_t page);
+void cpu_release_page(CPU* cpu, uint16_t page);
+void cpu_poke(CPU* cpu, uint16_t address, uint16_t value);
+void cpu_set_input(CPU* cpu, const uint8_t* data, size_t size);
+void cpu_stack_transfer(CPU* cpu, uint16_t mask, bool push);
+uint16_t cpu_packed_op(CPU* cpu, uint8_t mode, uint16_t a, uint16_t b);
+void cpu_attach_banks(CPU* cpu, struct BankStore* banks);
+void cpu_select_bank(CPU* cpu, uint16_t bank);
 
 // Helper functions
 uint16_t cpu_fetch(CPU* cpu);
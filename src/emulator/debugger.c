@@ -0,0 +1,126 @@
+#include "debugger.h"
+#include "breakpoint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEBUG_RUN_LIMIT 1000000     // Cycles per "continue" without a count
+
+static void debugger_help(void) {
+    printf("Commands:\n");
+    printf("  s, step [N]             Execute N instructions (default 1)\n");
+    printf("  c, continue [N]         Run until HALT or N cycles\n");
+    printf("  b, break ADDR [if Rn OP V] [after N]\n");
+    printf("                          Stop before executing ADDR\n");
+    printf("  w, watch ADDR[-END] [r|w|rw]\n");
+    printf("  w, watch stack [WORDS] [r|w|rw]\n");
+    printf("                          Stop after a data access to the range\n");
+    printf("  d, delete ID            Remove breakpoint or watchpoint\n");
+    printf("  bl, list                List breakpoints and watchpoints\n");
+    printf("  rs, reverse-step [N]    Step back N instructions (default 1)\n");
+    printf("  rw, reverse-write ADDR  Run back to the last write of ADDR\n");
+    printf("  r, regs                 Show registers\n");
+    printf("  x ADDR [N]              Examine N words of memory\n");
+    printf("  i, info                 Show checkpoint statistics\n");
+    printf("  q, quit                 Leave the debugger\n");
+}
+
+// Printing one-line location summary
+static void debugger_where(CPU* cpu) {
+    printf("cycle %llu  PC=0x%04X  [0x%04X]%s\n",
+           (unsigned long long)cpu->cycle_count, cpu->pc, cpu_peek(cpu, cpu->pc),
+           cpu->halted ? "  (halted)" : "");
+}
+
+// Executing forward for up to count instructions
+static void debugger_forward(CPU* cpu, uint64_t count, bool trace) {
+    StopReason reason = cpu_run_bounded(cpu, count, trace);
+    if (reason.kind != STOP_CYCLE_LIMIT) {
+        bp_report_stop(&reason);
+    }
+}
+
+static bool debugger_parse_number(const char* str, uint64_t* value) {
+    if (!str) return false;
+    char* end;
+    *value = strtoull(str, &end, 0);
+    return end != str;
+}
+
+// Running the command loop
+void debugger_run(CPU* cpu, Checkpointer* ckpt, bool trace) {
+    char line[256];
+
+    printf("\n=== SimpleCPU16 Debugger (type 'help') ===\n");
+    debugger_where(cpu);
+
+    while (1) {
+        printf("(sc16) ");
+        fflush(stdout);
+        if (!fgets(line, sizeof(line), stdin)) break;
+
+        line[strcspn(line, "\r\n")] = '\0';
+        char* cmd = strtok(line, " \t");
+        if (!cmd) continue;
+        char* rest = strtok(NULL, "");
+        char args[256] = "";
+        if (rest) strcpy(args, rest);
+        char* arg1 = rest ? strtok(rest, " \t") : NULL;
+        char* arg2 = arg1 ? strtok(NULL, " \t") : NULL;
+        uint64_t n = 1, addr;
+
+        if (strcmp(cmd, "s") == 0 || strcmp(cmd, "step") == 0) {
+            debugger_parse_number(arg1, &n);
+            debugger_forward(cpu, n, trace);
+            debugger_where(cpu);
+        } else if (strcmp(cmd, "c") == 0 || strcmp(cmd, "continue") == 0) {
+            n = DEBUG_RUN_LIMIT;
+            debugger_parse_number(arg1, &n);
+            debugger_forward(cpu, n, trace);
+            debugger_where(cpu);
+        } else if (strcmp(cmd, "rs") == 0 || strcmp(cmd, "reverse-step") == 0) {
+            debugger_parse_number(arg1, &n);
+            checkpoint_step_back(ckpt, cpu, n);
+            debugger_where(cpu);
+        } else if (strcmp(cmd, "rw") == 0 || strcmp(cmd, "reverse-write") == 0) {
+            if (!debugger_parse_number(arg1, &addr) || addr >= MMIO_START) {
+                printf("Usage: reverse-write ADDR (below 0x%04X)\n", MMIO_START);
+                continue;
+            }
+            checkpoint_run_back_to_write(ckpt, cpu, (uint16_t)addr);
+            debugger_where(cpu);
+        } else if (strcmp(cmd, "b") == 0 || strcmp(cmd, "break") == 0) {
+            int id = bp_parse_breakpoint(cpu->breakpoints, args);
+            if (id >= 0) printf("Breakpoint #%d set\n", id);
+        } else if (strcmp(cmd, "w") == 0 || strcmp(cmd, "watch") == 0) {
+            int id = bp_parse_watchpoint(cpu->breakpoints, args);
+            if (id >= 0) printf("Watchpoint #%d set\n", id);
+        } else if (strcmp(cmd, "d") == 0 || strcmp(cmd, "delete") == 0) {
+            if (!debugger_parse_number(arg1, &n) || !bp_delete(cpu->breakpoints, (int)n)) {
+                printf("No breakpoint or watchpoint %s\n", arg1 ? arg1 : "");
+            }
+        } else if (strcmp(cmd, "bl") == 0 || strcmp(cmd, "list") == 0) {
+            bp_list(cpu->breakpoints);
+        } else if (strcmp(cmd, "r") == 0 || strcmp(cmd, "regs") == 0) {
+            cpu_dump_registers(cpu);
+        } else if (strcmp(cmd, "x") == 0) {
+            if (!debugger_parse_number(arg1, &addr)) {
+                printf("Usage: x ADDR [N]\n");
+                continue;
+            }
+            debugger_parse_number(arg2, &n);
+            for (uint64_t i = 0; i < n; i++) {
+                uint16_t a = (uint16_t)(addr + i);
+                printf("0x%04X: 0x%04X (%d)\n", a, cpu_peek(cpu, a), cpu_peek(cpu, a));
+            }
+        } else if (strcmp(cmd, "i") == 0 || strcmp(cmd, "info") == 0) {
+            checkpoint_print_info(ckpt);
+        } else if (strcmp(cmd, "q") == 0 || strcmp(cmd, "quit") == 0) {
+            break;
+        } else if (strcmp(cmd, "help") == 0 || strcmp(cmd, "h") == 0) {
+            debugger_help();
+        } else {
+            printf("Unknown command '%s' (type 'help')\n", cmd);
+        }
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include "cpu.h"
+#include "checkpoint.h"
+#include <stdbool.h>
+
+// Interactive debug monitor.
+// The CPU must have a BreakpointSet attached (see breakpoint.h).
+// Commands are read from stdin; guests that read MMIO_CHAR_IN should be
+// run with --replay so their input does not mix with debugger commands.
+
+void debugger_run(CPU* cpu, Checkpointer* ckpt, bool trace);
+
+#endif // DEBUGGER_H
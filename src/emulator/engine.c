@@ -0,0 +1,513 @@
+#include "engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Reference engine: the interpreter in cpu.c, one instruction per call
+static void engine_reference_run(CPU* cpu, uint64_t limit) {
+    (void)limit;
+    cpu_step(cpu, false);
+}
+
+static const CpuEngine engine_reference = {
+    "reference", "Decode and execute each instruction (cpu_step)",
+    engine_reference_run, NULL
+};
+
+// Predecoded engine: each address caches the decoded form of the word
+// last executed there. An entry is reused only while memory still holds
+// that word, so self-modifying code and loads between runs need no
+// invalidation; extension words are always read fresh.
+
+typedef enum {
+    PD_EMPTY,                   // Nothing decoded here yet
+    PD_REFERENCE,               // Left to cpu_step (opcodes without a handler)
+    PD_NOP,                     // Also unassigned modes, which do nothing
+    PD_LDI, PD_LD, PD_LDR, PD_LDO, PD_LDP, PD_LDM, PD_ST, PD_STR, PD_STO, PD_STP, PD_STM, PD_MOV,
+    PD_ADD, PD_SUB, PD_MUL, PD_DIV, PD_INC, PD_DEC, PD_ADDI, PD_SUBI,
+    PD_AND, PD_OR, PD_XOR, PD_NOT, PD_SHL, PD_SHR, PD_SAR,
+    PD_BADDS, PD_BSUBS, PD_BCMPEQ, PD_BSWAP, PD_BFZ,
+    PD_BRANCH, PD_JMP, PD_CALL, PD_RET, PD_PUSH, PD_POP, PD_PUSHM, PD_POPM, PD_CMP, PD_HALT
+} PdOp;
+
+typedef struct {
+    uint16_t word;              // Instruction word this entry was decoded from
+    uint8_t op;                 // PdOp
+    uint8_t rd;
+    uint8_t rs;                 // Branch condition for PD_BRANCH
+    uint8_t length;             // Words including the extension word
+    uint8_t not_spin;           // A loop starting here cannot be fast-forwarded
+} PdInsn;
+
+static void pd_decode(PdInsn* d, uint16_t word) {
+    static const uint8_t load_ops[] = { PD_LDI, PD_LD, PD_LDR, PD_LDO, PD_LDP, PD_LDM };
+    static const uint8_t store_ops[] = { PD_ST, PD_STR, PD_STO, PD_STP, PD_STM };
+    static const uint8_t arith_ops[] = { PD_ADD, PD_SUB, PD_MUL, PD_DIV, PD_INC, PD_DEC, PD_ADDI, PD_SUBI };
+    static const uint8_t logic_ops[] = { PD_AND, PD_OR, PD_XOR, PD_NOT };
+    static const uint8_t shift_ops[] = { PD_SHL, PD_SHR, PD_SAR };
+    static const uint8_t stack_ops[] = { PD_PUSH, PD_POP, PD_PUSHM, PD_POPM };
+    static const uint8_t spec_ops[] = { PD_BADDS, PD_BSUBS, PD_BCMPEQ, PD_BSWAP, PD_BFZ };
+    uint8_t mode = word & 0x3F;
+
+    d->word = word;
+    d->not_spin = 0;
+    d->rd = (word >> 9) & 0x7;
+    d->rs = (word >> 6) & 0x7;
+    d->op = PD_NOP;
+    switch ((word >> 12) & 0xF) {
+        case OP_NOP:    break;
+        case OP_LOAD:   if (mode < sizeof(load_ops)) d->op = load_ops[mode]; break;
+        case OP_STORE:  if (mode < sizeof(store_ops)) d->op = store_ops[mode]; break;
+        case OP_MOVE:   d->op = PD_MOV; break;
+        case OP_ARITH:  if (mode < sizeof(arith_ops)) d->op = arith_ops[mode]; break;
+        case OP_LOGIC:  if (mode < sizeof(logic_ops)) d->op = logic_ops[mode]; break;
+        case OP_SHIFT:  if (mode < sizeof(shift_ops)) d->op = shift_ops[mode]; break;
+        case OP_BRANCH: d->op = PD_BRANCH; d->rs = mode; break;
+        case OP_JUMP:   d->op = PD_JMP; break;
+        case OP_STACK:  if (mode < sizeof(stack_ops)) d->op = stack_ops[mode]; break;
+        case OP_SPEC:   if (mode < sizeof(spec_ops)) d->op = spec_ops[mode]; break;
+        case OP_CALL:   d->op = PD_CALL; break;
+        case OP_RET:    d->op = PD_RET; break;
+        case OP_CMP:    d->op = PD_CMP; break;
+        case OP_HALT:   d->op = PD_HALT; break;
+        default:        d->op = PD_REFERENCE; break;
+    }
+    d->length = (d->op == PD_LDI || d->op == PD_LD || d->op == PD_LDO || d->op == PD_ST || d->op == PD_STO ||
+                 d->op == PD_ADDI || d->op == PD_SUBI || d->op == PD_BRANCH || d->op == PD_JMP ||
+                 d->op == PD_CALL || d->op == PD_PUSHM || d->op == PD_POPM) ? 2 : 1;
+}
+
+// Memory access: RAM directly, MMIO through cpu.c for its side effects
+static inline uint16_t pd_read(CPU* cpu, uint16_t address) {
+    return address >= MMIO_START ? cpu_read_memory(cpu, address) : cpu_peek(cpu, address);
+}
+
+static inline void pd_write(CPU* cpu, uint16_t address, uint16_t value) {
+    if (address >= MMIO_START) {
+        cpu_write_memory(cpu, address, value);
+        return;
+    }
+    uint16_t page = address >> PAGE_SHIFT;
+    cpu->dirty_pages[page >> 6] |= 1ULL << (page & 63);
+    uint16_t* data = cpu->pages[page];
+    if (data == cpu_zero_page) {
+        data = cpu_page_for_write(cpu, page);
+    }
+    data[address & PAGE_MASK] = value;
+}
+
+static inline void pd_flags(CPU* cpu, uint16_t result) {
+    cpu->flags.Z = result == 0;
+    cpu->flags.N = (result & 0x8000) != 0;
+}
+
+// Setting Z, N and C from a 32-bit result, returning its low word
+static inline uint16_t pd_carry(CPU* cpu, uint32_t full) {
+    pd_flags(cpu, (uint16_t)full);
+    cpu->flags.C = full > 0xFFFF;
+    return (uint16_t)full;
+}
+
+static inline bool pd_condition(const CPU* cpu, uint8_t cond) {
+    switch (cond) {
+        case BRANCH_EQ: return cpu->flags.Z;
+        case BRANCH_NE: return !cpu->flags.Z;
+        case BRANCH_GT: return !cpu->flags.N && !cpu->flags.Z;
+        case BRANCH_LT: return cpu->flags.N;
+        case BRANCH_GE: return !cpu->flags.N;
+        case BRANCH_LE: return cpu->flags.N || cpu->flags.Z;
+        case BRANCH_CS: return cpu->flags.C;
+        case BRANCH_CC: return !cpu->flags.C;
+        default:        return false;
+    }
+}
+
+static void engine_predecoded_run(CPU* cpu, uint64_t limit) {
+    // Watches, checkpoints and timing models hook every access: leave those runs to cpu_step
+    if (cpu->watch_read || cpu->watch_write || cpu->ckpt || cpu->timing) {
+        cpu_step(cpu, false);
+        return;
+    }
+    if (!cpu->engine_state) {
+        cpu->engine_state = calloc(MEM_SIZE, sizeof(PdInsn));
+        if (!cpu->engine_state) {
+            fprintf(stderr, "Error: Out of memory for the decode cache\n");
+            exit(1);
+        }
+    }
+    PdInsn* cache = (PdInsn*)cpu->engine_state;
+    uint16_t* r = cpu->registers;
+
+    do {
+        uint16_t pc = cpu->pc;
+        uint16_t word = cpu_peek(cpu, pc);
+        PdInsn* d = &cache[pc];
+        if (d->op == PD_EMPTY || d->word != word) {
+            pd_decode(d, word);
+        }
+        // Fetching code from MMIO has side effects the reference must perform
+        if (d->op == PD_REFERENCE || pc >= MMIO_START || (d->length == 2 && pc + 1 >= MMIO_START)) {
+            cpu_step(cpu, false);
+            return;
+        }
+
+        uint16_t ext = d->length == 2 ? cpu_peek(cpu, (uint16_t)(pc + 1)) : 0;
+        uint8_t rd = d->rd, rs = d->rs;
+        bool boundary = false;
+        cpu->ir = d->length == 2 ? ext : word;
+        cpu->pc = (uint16_t)(pc + d->length);
+
+        switch (d->op) {
+            case PD_NOP:  break;
+            case PD_LDI:  r[rd] = ext; break;
+            case PD_LD:   r[rd] = pd_read(cpu, ext); break;
+            case PD_LDR:  r[rd] = pd_read(cpu, r[rs]); break;
+            case PD_LDO:  r[rd] = pd_read(cpu, (uint16_t)(r[rs] + ext)); break;
+            case PD_LDP: {
+                uint16_t value = pd_read(cpu, r[rs]);
+                r[rs]++;
+                r[rd] = value;
+                break;
+            }
+            case PD_LDM: {
+                uint16_t value = pd_read(cpu, (uint16_t)(r[rs] - 1));
+                r[rs]--;
+                r[rd] = value;
+                break;
+            }
+            case PD_ST:   pd_write(cpu, ext, r[rs]); break;
+            case PD_STR:  pd_write(cpu, r[rd], r[rs]); break;
+            case PD_STO:  pd_write(cpu, (uint16_t)(r[rd] + ext), r[rs]); break;
+            case PD_STP:  pd_write(cpu, r[rd], r[rs]); r[rd]++; break;
+            case PD_STM:  pd_write(cpu, (uint16_t)(r[rd] - 1), r[rs]); r[rd]--; break;
+            case PD_MOV:  r[rd] = r[rs]; break;
+            case PD_ADD:  r[rd] = pd_carry(cpu, (uint32_t)r[rd] + r[rs]); break;
+            case PD_SUB:  r[rd] = pd_carry(cpu, (uint32_t)r[rd] - r[rs]); break;
+            case PD_MUL:  r[rd] = pd_carry(cpu, (uint32_t)r[rd] * r[rs]); break;
+            case PD_ADDI: r[rd] = pd_carry(cpu, (uint32_t)r[rd] + ext); break;
+            case PD_SUBI: r[rd] = pd_carry(cpu, (uint32_t)r[rd] - ext); break;
+            case PD_DIV:
+                if (r[rs] != 0) {
+                    r[rd] = r[rd] / r[rs];
+                    pd_flags(cpu, r[rd]);
+                }
+                break;
+            case PD_INC:  pd_flags(cpu, ++r[rd]); break;
+            case PD_DEC:  pd_flags(cpu, --r[rd]); break;
+            case PD_AND:  pd_flags(cpu, r[rd] &= r[rs]); break;
+            case PD_OR:   pd_flags(cpu, r[rd] |= r[rs]); break;
+            case PD_XOR:  pd_flags(cpu, r[rd] ^= r[rs]); break;
+            case PD_NOT:  pd_flags(cpu, r[rd] = (uint16_t)~r[rd]); break;
+            case PD_SHL:  pd_flags(cpu, r[rd] = (uint16_t)(r[rd] << (r[rs] & 0xF))); break;
+            case PD_SHR:  pd_flags(cpu, r[rd] = (uint16_t)(r[rd] >> (r[rs] & 0xF))); break;
+            case PD_SAR:  pd_flags(cpu, r[rd] = (uint16_t)((int16_t)r[rd] >> (r[rs] & 0xF))); break;
+            case PD_CMP:  pd_carry(cpu, (uint32_t)r[rd] - r[rs]); break;
+            case PD_BADDS: case PD_BSUBS: case PD_BCMPEQ: case PD_BSWAP: case PD_BFZ:
+                r[rd] = cpu_packed_op(cpu, (uint8_t)(d->op - PD_BADDS), r[rd], r[rs]);
+                break;
+            case PD_PUSH:
+                r[REG_SP]--;
+                pd_write(cpu, r[REG_SP], r[rs]);
+                break;
+            case PD_POP:
+                r[rd] = pd_read(cpu, r[REG_SP]);
+                r[REG_SP]++;
+                break;
+            case PD_PUSHM: cpu_stack_transfer(cpu, ext, true); break;
+            case PD_POPM:  cpu_stack_transfer(cpu, ext, false); break;
+            case PD_BRANCH:
+                if (pd_condition(cpu, rs)) cpu->pc = ext;
+                boundary = true;
+                break;
+            case PD_JMP:
+                cpu->pc = ext;
+                boundary = true;
+                break;
+            case PD_CALL:
+                r[REG_SP]--;
+                pd_write(cpu, r[REG_SP], cpu->pc);
+                cpu->pc = ext;
+                boundary = true;
+                break;
+            case PD_RET:
+                cpu->pc = pd_read(cpu, r[REG_SP]);
+                r[REG_SP]++;
+                boundary = true;
+                break;
+            case PD_HALT:
+                cpu->halted = true;
+                break;
+        }
+        cpu->cycle_count++;
+        if (boundary) return;
+    } while (!cpu->halted && cpu->cycle_count < limit);
+}
+
+// Fast-forward engine: the predecoded engine, plus skipping iterations
+// of spin loops. A spin loop is one block that branches back to its own
+// start, stores nothing, reads only RAM and the timer, and reads no
+// register before the body writes it unless the body never writes it.
+// Memory is then the same in every iteration and so is everything the
+// body computes, except values derived from the timer. Whether it
+// branches back is therefore fixed (no timer in the flags), or, when
+// the branch tests a CMP of a timer read against a fixed register, true
+// exactly for the timer values in one circular range. Iterations known
+// to branch back are skipped by advancing cycle_count; the last one
+// before the stop runs normally to recompute what the body writes.
+
+#define PD_SPIN_MAX 32              // Longest loop body analyzed (instructions)
+
+enum { PD_KIND_FIXED, PD_KIND_TIMER, PD_KIND_VARYING, PD_KIND_UNSET };
+
+typedef struct {
+    uint32_t length;                // Instructions per iteration (1 cycle each)
+    bool timed;                     // Branch depends on a timer read
+    uint32_t read_offset;           // Cycles from iteration start to that read
+    uint16_t start;                 // Taken iff (timer - start) mod 2^16 < width
+    uint32_t width;
+} PdSpin;
+
+// Timer values for which a branch on CMP timer, value (or CMP value,
+// timer when timer_first is false) is taken, as a circular range
+static void pd_spin_range(uint8_t cond, bool timer_first, uint16_t value, PdSpin* spin) {
+    // Signed conditions test r = first - second, taken for r in a range
+    static const uint16_t r_start[] = { 0, 1, 1, 0x8000, 0, 0x8000 };
+    static const uint32_t r_width[] = { 1, 0xFFFF, 0x7FFF, 0x8000, 0x8000, 0x8001 };
+
+    if (cond == BRANCH_CS || cond == BRANCH_CC) {
+        // Unsigned: C is set when first < second
+        bool cs = cond == BRANCH_CS;
+        if (timer_first) {
+            spin->start = cs ? 0 : value;                       // [0, value) or [value, 0xFFFF]
+            spin->width = cs ? value : 0x10000u - value;
+        } else {
+            spin->start = cs ? (uint16_t)(value + 1) : 0;       // (value, 0xFFFF] or [0, value]
+            spin->width = cs ? 0xFFFFu - value : (uint32_t)value + 1;
+        }
+    } else if (cond >= sizeof(r_start) / sizeof(r_start[0])) {
+        spin->start = 0;
+        spin->width = 0;
+    } else if (timer_first) {
+        spin->start = (uint16_t)(r_start[cond] + value);        // timer = r + value
+        spin->width = r_width[cond];
+    } else {
+        spin->start = (uint16_t)(value - r_start[cond] - r_width[cond] + 1);   // timer = value - r
+        spin->width = r_width[cond];
+    }
+}
+
+// Iterations that branch back before the first that does not, when
+// iteration i reads the timer at (base + i * length) mod 2^16
+// (UINT64_MAX if none ever leaves)
+static uint64_t pd_spin_iterations(uint16_t base, uint32_t length, const PdSpin* spin) {
+    if (spin->width >= 0x10000u) return UINT64_MAX;
+    uint16_t exit_start = (uint16_t)(spin->start + spin->width);
+    uint32_t exit_width = 0x10000u - spin->width;
+    uint32_t q = (uint16_t)(base - exit_start);     // Distance into the exit range
+    uint64_t taken = 0;
+    // Every wrap lands in [0, length), so after length + 1 wraps without
+    // an exit the landing points repeat
+    for (uint32_t wrap = 0; wrap <= length + 1; wrap++) {
+        if (q < exit_width) return taken;
+        uint32_t steps = (0x10000u - q + length - 1) / length;
+        taken += steps;
+        q = q + steps * length - 0x10000u;
+    }
+    return UINT64_MAX;
+}
+
+// Recognizing a spin loop at head from its decoded body
+static bool pd_spin_analyze(const CPU* cpu, PdInsn* cache, uint16_t head, PdSpin* spin) {
+    PdInsn* body[PD_SPIN_MAX];
+    uint16_t ext[PD_SPIN_MAX];
+    int count = 0;
+    uint8_t written = 0;
+
+    // Collecting the straight-line body up to the branch back to head
+    uint16_t pc = head;
+    for (;;) {
+        if (count == PD_SPIN_MAX || pc >= MMIO_START - 1) return false;
+        uint16_t word = cpu_peek(cpu, pc);
+        PdInsn* d = &cache[pc];
+        if (d->op == PD_EMPTY || d->word != word) {
+            pd_decode(d, word);
+        }
+        body[count] = d;
+        ext[count] = d->length == 2 ? cpu_peek(cpu, (uint16_t)(pc + 1)) : 0;
+        count++;
+        pc = (uint16_t)(pc + d->length);
+        if (d->op == PD_BRANCH) {
+            if (ext[count - 1] != head) return false;
+            break;
+        }
+        switch (d->op) {
+            case PD_NOP: case PD_CMP:
+                break;
+            case PD_LDI: case PD_LD: case PD_LDR: case PD_LDO: case PD_MOV:
+            case PD_ADD: case PD_SUB: case PD_MUL: case PD_INC: case PD_DEC: case PD_ADDI: case PD_SUBI:
+            case PD_AND: case PD_OR: case PD_XOR: case PD_NOT: case PD_SHL: case PD_SHR: case PD_SAR:
+                written |= (uint8_t)(1 << d->rd);
+                break;
+            default:
+                return false;   // Stores, stack, control flow, DIV, HALT, reference-only opcodes
+        }
+    }
+
+    // Following what each register holds: the same value in every
+    // iteration, the timer as read by instruction timer_at, or neither
+    uint8_t kind[NUM_REGISTERS];
+    int timer_at[NUM_REGISTERS];
+    int last_write[NUM_REGISTERS];
+    for (int r = 0; r < NUM_REGISTERS; r++) {
+        kind[r] = (written & (1 << r)) ? PD_KIND_UNSET : PD_KIND_FIXED;
+        timer_at[r] = 0;
+        last_write[r] = -1;
+    }
+    int flags_at = -1;                  // Last instruction that set flags
+    uint8_t flags_kind = PD_KIND_FIXED;
+    for (int i = 0; i < count - 1; i++) {
+        const PdInsn* d = body[i];
+        uint8_t rd = d->rd, rs = d->rs;
+        switch (d->op) {
+            case PD_NOP:
+                continue;
+            case PD_LDI:
+                kind[rd] = PD_KIND_FIXED;
+                break;
+            case PD_LD:
+            case PD_LDR:
+            case PD_LDO: {
+                uint16_t address = ext[i];
+                if (d->op != PD_LD) {
+                    // Only through a register the body leaves alone
+                    if (written & (1 << rs)) return false;
+                    address = (uint16_t)(cpu->registers[rs] + (d->op == PD_LDO ? ext[i] : 0));
+                }
+                if (address == MMIO_TIMER) {
+                    kind[rd] = PD_KIND_TIMER;
+                    timer_at[rd] = i;
+                } else if (address >= MMIO_START) {
+                    return false;
+                } else {
+                    kind[rd] = PD_KIND_FIXED;
+                }
+                break;
+            }
+            case PD_MOV:
+                if (kind[rs] == PD_KIND_UNSET) return false;
+                kind[rd] = kind[rs];
+                timer_at[rd] = timer_at[rs];
+                break;
+            case PD_CMP:
+                if (kind[rd] == PD_KIND_UNSET || kind[rs] == PD_KIND_UNSET) return false;
+                flags_at = i;
+                flags_kind = kind[rd] == PD_KIND_FIXED && kind[rs] == PD_KIND_FIXED ? PD_KIND_FIXED
+                                                                                    : PD_KIND_VARYING;
+                continue;
+            default: {
+                bool unary = d->op == PD_INC || d->op == PD_DEC || d->op == PD_NOT ||
+                             d->op == PD_ADDI || d->op == PD_SUBI;
+                if (kind[rd] == PD_KIND_UNSET || (!unary && kind[rs] == PD_KIND_UNSET)) return false;
+                bool fixed = kind[rd] == PD_KIND_FIXED && (unary || kind[rs] == PD_KIND_FIXED);
+                kind[rd] = fixed ? PD_KIND_FIXED : PD_KIND_VARYING;
+                // Carry comes only from add, subtract and multiply; the
+                // rest leave it as an earlier instruction set it
+                bool carry = d->op == PD_ADD || d->op == PD_SUB || d->op == PD_MUL ||
+                             d->op == PD_ADDI || d->op == PD_SUBI;
+                flags_at = i;
+                flags_kind = fixed && (carry || flags_kind == PD_KIND_FIXED) ? PD_KIND_FIXED
+                                                                             : PD_KIND_VARYING;
+                break;
+            }
+        }
+        last_write[rd] = i;
+    }
+
+    spin->length = (uint32_t)count;
+    spin->timed = flags_kind != PD_KIND_FIXED;
+    spin->read_offset = 0;
+    if (!spin->timed) return true;
+
+    // Otherwise the flags must come from CMP of a timer read against a
+    // fixed value that the CPU still holds (not written after the CMP)
+    const PdInsn* cmp = body[flags_at];
+    if (cmp->op != PD_CMP) return false;
+    bool timer_first = kind[cmp->rd] == PD_KIND_TIMER && kind[cmp->rs] == PD_KIND_FIXED;
+    if (!timer_first && !(kind[cmp->rd] == PD_KIND_FIXED && kind[cmp->rs] == PD_KIND_TIMER)) {
+        return false;
+    }
+    uint8_t timer = timer_first ? cmp->rd : cmp->rs;
+    uint8_t fixed = timer_first ? cmp->rs : cmp->rd;
+    if (last_write[fixed] > flags_at || last_write[timer] > flags_at) return false;
+    spin->read_offset = (uint32_t)timer_at[timer];
+    pd_spin_range(body[count - 1]->rs, timer_first, cpu->registers[fixed], spin);
+    return true;
+}
+
+static void engine_fastforward_run(CPU* cpu, uint64_t limit) {
+    uint16_t head = cpu->pc;
+    uint64_t start = cpu->cycle_count;
+    engine_predecoded_run(cpu, limit);
+    // Only a block that ran once from head back to head can be a spin
+    // loop; timer reads that are logged or watched must all happen
+    if (cpu->halted || cpu->pc != head || cpu->cycle_count >= limit || !cpu->engine_state ||
+        cpu->iolog || cpu->watch_read || cpu->watch_write || cpu->ckpt || cpu->timing) {
+        return;
+    }
+    PdInsn* cache = (PdInsn*)cpu->engine_state;
+    if (cache[head].not_spin) return;
+    PdSpin spin;
+    if (!pd_spin_analyze(cpu, cache, head, &spin)) {
+        cache[head].not_spin = 1;
+        return;
+    }
+    if (cpu->cycle_count - start != spin.length) return;
+
+    // Iteration i from now starts at now + i * length. Skipping those
+    // sure to branch back, but running the last one (the exit, or the
+    // last that fits before the limit) to recompute what the body writes
+    uint64_t now = cpu->cycle_count;
+    uint64_t taken = spin.timed ? pd_spin_iterations((uint16_t)(now + spin.read_offset), spin.length, &spin)
+                                : UINT64_MAX;
+    uint64_t room = (limit - now) / spin.length;
+    uint64_t skip = room == 0 ? 0 : (taken < room - 1 ? taken : room - 1);
+    if (skip == 0) return;
+    cpu->cycle_count += skip * spin.length;
+    engine_predecoded_run(cpu, limit);
+}
+
+static void engine_predecoded_release(CPU* cpu) {
+    free(cpu->engine_state);
+    cpu->engine_state = NULL;
+}
+
+static const CpuEngine engine_predecoded = {
+    "predecoded", "Cache decoded instructions per address, run whole basic blocks",
+    engine_predecoded_run, engine_predecoded_release
+};
+
+static const CpuEngine engine_fastforward = {
+    "fastforward", "Predecoded, skipping spin loops that poll the timer or unchanging memory",
+    engine_fastforward_run, engine_predecoded_release
+};
+
+const CpuEngine* const cpu_engines[] = {
+    &engine_reference,
+    &engine_predecoded,
+    &engine_fastforward,
+    NULL
+};
+
+const CpuEngine* engine_lookup(const char* name) {
+    for (int i = 0; cpu_engines[i]; i++) {
+        if (strcmp(cpu_engines[i]->name, name) == 0) return cpu_engines[i];
+    }
+    return NULL;
+}
+
+void engine_attach(CPU* cpu, const CpuEngine* engine) {
+    if (cpu->engine && cpu->engine->release) {
+        cpu->engine->release(cpu);
+    }
+    cpu->engine = engine;
+}
@@ -0,0 +1,37 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "cpu.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Execution engines.
+//
+// The reference engine is cpu_step(): one instruction, decoded from
+// scratch every time. Other engines must produce exactly the same
+// architectural state (registers, flags, PC, memory, output, cycle
+// count) but may execute several instructions per call, up to a block
+// boundary. The lockstep harness (lockstep.h) checks them against the
+// reference after every call.
+//
+// cpu_run_bounded() uses cpu->engine for its unchecked loop when set;
+// tracing, breakpoints and watchpoints always go through the reference.
+
+typedef struct CpuEngine {
+    const char* name;
+    const char* description;
+    // Executing at least one instruction unless halted, stopping at a
+    // block boundary, on HALT, or when cycle_count reaches limit
+    void (*run)(CPU* cpu, uint64_t limit);
+    // Releasing per-CPU engine state (NULL if there is none)
+    void (*release)(CPU* cpu);
+} CpuEngine;
+
+// Registered engines, reference first, NULL-terminated
+extern const CpuEngine* const cpu_engines[];
+
+const CpuEngine* engine_lookup(const char* name);
+// Selecting an engine for a CPU (NULL = reference), releasing the old one's state
+void engine_attach(CPU* cpu, const CpuEngine* engine);
+
+#endif // ENGINE_H
@@ -0,0 +1,324 @@
+#include "executable.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char EXE_MAGIC[8] = { 'S', 'C', '1', '6', 'E', 'X', 'E', '\0' };
+
+#define EXE_HEADER_SIZE 30      // Up to the source name
+#define EXE_CHECKSUM_OFFSET 12
+
+static void exe_put16(uint8_t* buf, uint16_t value) {
+    buf[0] = value & 0xFF;
+    buf[1] = value >> 8;
+}
+
+static void exe_put32(uint8_t* buf, uint32_t value) {
+    exe_put16(buf, value & 0xFFFF);
+    exe_put16(buf + 2, value >> 16);
+}
+
+static uint16_t exe_get16(const uint8_t* buf) {
+    return (uint16_t)(buf[0] | (buf[1] << 8));
+}
+
+static uint32_t exe_get32(const uint8_t* buf) {
+    return exe_get16(buf) | ((uint32_t)exe_get16(buf + 2) << 16);
+}
+
+// CRC-32 (IEEE, reflected), table built on first use
+static uint32_t exe_crc32(const uint8_t* data, size_t size) {
+    static uint32_t table[256];
+    static bool ready = false;
+    if (!ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320u : 0);
+            table[i] = crc;
+        }
+        ready = true;
+    }
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void exe_init(Executable* exe) {
+    memset(exe, 0, sizeof(Executable));
+}
+
+void exe_free(Executable* exe) {
+    for (uint32_t i = 0; exe->segments && i < exe->segment_count; i++) {
+        free(exe->segments[i].words);
+    }
+    for (uint32_t i = 0; exe->symbols && i < exe->symbol_count; i++) {
+        free(exe->symbols[i].name);
+    }
+    free(exe->segments);
+    free(exe->symbols);
+    free(exe->lines);
+    free(exe->source);
+    memset(exe, 0, sizeof(Executable));
+}
+
+void exe_add_segment(Executable* exe, uint16_t address, const uint16_t* words, uint32_t size) {
+    exe->segments = (ExeSegment*)realloc(exe->segments, (exe->segment_count + 1) * sizeof(ExeSegment));
+    ExeSegment* segment = &exe->segments[exe->segment_count++];
+    segment->address = address;
+    segment->size = size;
+    segment->words = (uint16_t*)malloc((size ? size : 1) * sizeof(uint16_t));
+    memcpy(segment->words, words, size * sizeof(uint16_t));
+}
+
+void exe_add_symbol(Executable* exe, const char* name, size_t length, uint16_t value, uint8_t flags) {
+    exe->symbols = (ExeSymbol*)realloc(exe->symbols, (exe->symbol_count + 1) * sizeof(ExeSymbol));
+    ExeSymbol* symbol = &exe->symbols[exe->symbol_count++];
+    symbol->name = (char*)malloc(length + 1);
+    memcpy(symbol->name, name, length);
+    symbol->name[length] = '\0';
+    symbol->value = value;
+    symbol->flags = flags;
+}
+
+static int exe_segment_order(const void* a, const void* b) {
+    return (int)((const ExeSegment*)a)->address - (int)((const ExeSegment*)b)->address;
+}
+
+static int exe_line_order(const void* a, const void* b) {
+    return (int)((const ExeLine*)a)->address - (int)((const ExeLine*)b)->address;
+}
+
+// Writing an executable (serialized into one buffer, written at once)
+bool exe_write(Executable* exe, const char* filename) {
+    qsort(exe->segments, exe->segment_count, sizeof(ExeSegment), exe_segment_order);
+    qsort(exe->lines, exe->line_count, sizeof(ExeLine), exe_line_order);
+
+    size_t source_length = exe->source ? strlen(exe->source) : 0;
+    size_t size = EXE_HEADER_SIZE + source_length + exe->line_count * 8;
+    for (uint32_t i = 0; i < exe->segment_count; i++) {
+        size += 8 + exe->segments[i].size * 2;
+    }
+    for (uint32_t i = 0; i < exe->symbol_count; i++) {
+        size += 6 + strlen(exe->symbols[i].name);
+    }
+
+    uint8_t* buf = (uint8_t*)malloc(size);
+    if (!buf) {
+        fprintf(stderr, "Error: Out of memory writing executable %s\n", filename);
+        return false;
+    }
+    memcpy(buf, EXE_MAGIC, sizeof(EXE_MAGIC));
+    exe_put16(buf + 8, EXE_VERSION);
+    exe_put16(buf + 10, exe->entry);
+    exe_put32(buf + EXE_CHECKSUM_OFFSET, 0);
+    exe_put32(buf + 16, exe->segment_count);
+    exe_put32(buf + 20, exe->symbol_count);
+    exe_put32(buf + 24, exe->line_count);
+    exe_put16(buf + 28, (uint16_t)source_length);
+    memcpy(buf + EXE_HEADER_SIZE, exe->source, source_length);
+    uint8_t* p = buf + EXE_HEADER_SIZE + source_length;
+
+    for (uint32_t i = 0; i < exe->segment_count; i++) {
+        const ExeSegment* segment = &exe->segments[i];
+        exe_put16(p, segment->address);
+        exe_put16(p + 2, 0);
+        exe_put32(p + 4, segment->size);
+        p += 8;
+        for (uint32_t w = 0; w < segment->size; w++, p += 2) {
+            exe_put16(p, segment->words[w]);
+        }
+    }
+    for (uint32_t i = 0; i < exe->symbol_count; i++) {
+        const ExeSymbol* symbol = &exe->symbols[i];
+        uint16_t length = (uint16_t)strlen(symbol->name);
+        exe_put16(p, symbol->value);
+        p[2] = symbol->flags;
+        p[3] = 0;
+        exe_put16(p + 4, length);
+        memcpy(p + 6, symbol->name, length);
+        p += 6 + length;
+    }
+    for (uint32_t i = 0; i < exe->line_count; i++, p += 8) {
+        exe_put16(p, exe->lines[i].address);
+        exe_put16(p + 2, 0);
+        exe_put32(p + 4, exe->lines[i].line);
+    }
+    exe_put32(buf + EXE_CHECKSUM_OFFSET, exe_crc32(buf, size));
+
+    bool to_stdout = strcmp(filename, "-") == 0;
+    FILE* fp = to_stdout ? stdout : fopen(filename, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open output file %s\n", filename);
+        free(buf);
+        return false;
+    }
+    bool ok = fwrite(buf, 1, size, fp) == size;
+    ok = (to_stdout ? fflush(fp) : fclose(fp)) == 0 && ok;
+    free(buf);
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to write executable %s\n", filename);
+    }
+    return ok;
+}
+
+// Parsing an executable image (false if truncated or inconsistent)
+static bool exe_parse(const uint8_t* buf, size_t size, Executable* exe) {
+    exe->entry = exe_get16(buf + 10);
+    uint32_t segment_count = exe_get32(buf + 16);
+    uint32_t symbol_count = exe_get32(buf + 20);
+    uint32_t line_count = exe_get32(buf + 24);
+    uint16_t source_length = exe_get16(buf + 28);
+    const uint8_t* p = buf + EXE_HEADER_SIZE;
+    const uint8_t* end = buf + size;
+
+    if (end - p < source_length) return false;
+    if (source_length > 0) {
+        exe->source = (char*)malloc(source_length + 1);
+        memcpy(exe->source, p, source_length);
+        exe->source[source_length] = '\0';
+        p += source_length;
+    }
+
+    if ((size_t)(end - p) / 8 < segment_count) return false;
+    exe->segments = (ExeSegment*)calloc(segment_count + 1, sizeof(ExeSegment));
+    uint32_t next_free = 0;
+    for (uint32_t i = 0; i < segment_count; i++) {
+        if (end - p < 8) return false;
+        ExeSegment* segment = &exe->segments[i];
+        segment->address = exe_get16(p);
+        segment->size = exe_get32(p + 4);
+        p += 8;
+        if (segment->address < next_free || segment->address + segment->size > 0x10000 ||
+            (size_t)(end - p) / 2 < segment->size) {
+            return false;
+        }
+        next_free = segment->address + segment->size;
+        segment->words = (uint16_t*)malloc((segment->size ? segment->size : 1) * sizeof(uint16_t));
+        for (uint32_t w = 0; w < segment->size; w++, p += 2) {
+            segment->words[w] = exe_get16(p);
+        }
+        exe->segment_count++;
+    }
+
+    if ((size_t)(end - p) / 6 < symbol_count) return false;
+    exe->symbols = (ExeSymbol*)calloc(symbol_count + 1, sizeof(ExeSymbol));
+    for (uint32_t i = 0; i < symbol_count; i++) {
+        if (end - p < 6) return false;
+        uint16_t length = exe_get16(p + 4);
+        if (end - p - 6 < length) return false;
+        ExeSymbol* symbol = &exe->symbols[i];
+        symbol->value = exe_get16(p);
+        symbol->flags = p[2];
+        symbol->name = (char*)malloc(length + 1);
+        memcpy(symbol->name, p + 6, length);
+        symbol->name[length] = '\0';
+        exe->symbol_count++;
+        p += 6 + length;
+    }
+
+    if ((size_t)(end - p) / 8 != line_count || (size_t)(end - p) % 8 != 0) return false;
+    exe->lines = (ExeLine*)malloc((line_count + 1) * sizeof(ExeLine));
+    for (uint32_t i = 0; i < line_count; i++, p += 8) {
+        exe->lines[i].address = exe_get16(p);
+        exe->lines[i].line = exe_get32(p + 4);
+    }
+    exe->line_count = line_count;
+    return true;
+}
+
+// Reading an executable, or a raw word image
+bool exe_read(const char* filename, Executable* exe) {
+    exe_init(exe);
+    FILE* fp = fopen(filename, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open binary file %s\n", filename);
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t* buf = size > 0 ? (uint8_t*)malloc(size) : NULL;
+    bool ok = buf && fread(buf, 1, size, fp) == (size_t)size;
+    fclose(fp);
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to read binary file %s\n", filename);
+        free(buf);
+        return false;
+    }
+
+    // Headerless image: native-endian words from address 0
+    if (size < EXE_HEADER_SIZE || memcmp(buf, EXE_MAGIC, sizeof(EXE_MAGIC)) != 0) {
+        uint32_t words = (uint32_t)(size / sizeof(uint16_t));
+        if (words > 0x10000) {
+            fprintf(stderr, "Error: %s is larger than memory\n", filename);
+            free(buf);
+            return false;
+        }
+        exe->raw = true;
+        exe->segments = (ExeSegment*)malloc(sizeof(ExeSegment));
+        exe->segments[0].address = 0;
+        exe->segments[0].size = words;
+        exe->segments[0].words = (uint16_t*)malloc((words ? words : 1) * sizeof(uint16_t));
+        memcpy(exe->segments[0].words, buf, words * sizeof(uint16_t));
+        exe->segment_count = 1;
+        free(buf);
+        return true;
+    }
+
+    if (exe_get16(buf + 8) != EXE_VERSION) {
+        fprintf(stderr, "Error: Unsupported executable version %d in %s\n", exe_get16(buf + 8), filename);
+        free(buf);
+        return false;
+    }
+    uint32_t checksum = exe_get32(buf + EXE_CHECKSUM_OFFSET);
+    exe_put32(buf + EXE_CHECKSUM_OFFSET, 0);
+    if (exe_crc32(buf, (size_t)size) != checksum) {
+        fprintf(stderr, "Error: Checksum mismatch in %s (file is truncated or corrupt)\n", filename);
+        free(buf);
+        return false;
+    }
+
+    ok = exe_parse(buf, (size_t)size, exe);
+    free(buf);
+    if (!ok) {
+        fprintf(stderr, "Error: Executable %s is malformed\n", filename);
+        exe_free(exe);
+    }
+    return ok;
+}
+
+uint32_t exe_extent(const Executable* exe) {
+    uint32_t extent = 0;
+    for (uint32_t i = 0; i < exe->segment_count; i++) {
+        uint32_t end = exe->segments[i].address + exe->segments[i].size;
+        if (end > extent) extent = end;
+    }
+    return extent;
+}
+
+void exe_flatten(const Executable* exe, uint16_t* memory) {
+    memset(memory, 0, exe_extent(exe) * sizeof(uint16_t));
+    for (uint32_t i = 0; i < exe->segment_count; i++) {
+        const ExeSegment* segment = &exe->segments[i];
+        memcpy(memory + segment->address, segment->words, segment->size * sizeof(uint16_t));
+    }
+}
+
+const char* exe_symbol_at(const Executable* exe, uint16_t address) {
+    for (uint32_t i = 0; i < exe->symbol_count; i++) {
+        if (exe->symbols[i].value == address && !(exe->symbols[i].flags & EXE_SYM_CONSTANT)) {
+            return exe->symbols[i].name;
+        }
+    }
+    return NULL;
+}
+
+// Binary search for the last line entry at or before address
+uint32_t exe_line_at(const Executable* exe, uint16_t address) {
+    uint32_t low = 0, high = exe->line_count;
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        if (exe->lines[mid].address <= address) low = mid + 1;
+        else high = mid;
+    }
+    return low > 0 ? exe->lines[low - 1].line : 0;
+}
@@ -0,0 +1,77 @@
+#ifndef EXECUTABLE_H
+#define EXECUTABLE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Executable files (written by the assembler and linker, loaded by the
+// emulator, server and analyzer).
+// Code and data are stored as segments at their load addresses, so .ORG
+// gaps cost nothing in the file. The header names the entry point; an
+// optional symbol table (labels and .EQU constants) and line table
+// (instruction address -> source line) follow the segments. A CRC-32 over
+// the whole file, taken with the checksum field zeroed, catches truncated
+// or corrupted files. A file without the magic is a raw word image loaded
+// at 0 with entry 0, which exe_read also accepts.
+//
+// File layout (little-endian):
+//   "SC16EXE\0", u16 version, u16 entry, u32 checksum,
+//   u32 segments, u32 symbols, u32 lines, u16 source name length, name
+//   segments: u16 address, u16 reserved, u32 words, u16 per word
+//   symbols:  u16 value, u8 flags, u8 reserved, u16 name length, name
+//   lines:    u16 address, u16 reserved, u32 source line
+
+#define EXE_VERSION 1
+#define EXE_SYM_CONSTANT 0x01   // .EQU value rather than an address
+
+typedef struct {
+    uint16_t address;           // Load address
+    uint32_t size;              // Words (address + size <= 0x10000)
+    uint16_t* words;
+} ExeSegment;
+
+typedef struct {
+    char* name;
+    uint16_t value;
+    uint8_t flags;              // EXE_SYM_*
+} ExeSymbol;
+
+typedef struct {
+    uint16_t address;           // First word of an instruction
+    uint32_t line;
+} ExeLine;
+
+typedef struct {
+    uint16_t entry;
+    bool raw;                   // Read from a headerless image
+    ExeSegment* segments;       // Sorted by address, not overlapping
+    uint32_t segment_count;
+    ExeSymbol* symbols;
+    uint32_t symbol_count;
+    ExeLine* lines;             // Sorted by address
+    uint32_t line_count;
+    char* source;               // Source file of the line table (NULL if none)
+} Executable;
+
+void exe_init(Executable* exe);
+void exe_free(Executable* exe);
+
+// Adding a copy of words as a segment (segments must not overlap)
+void exe_add_segment(Executable* exe, uint16_t address, const uint16_t* words, uint32_t size);
+void exe_add_symbol(Executable* exe, const char* name, size_t length, uint16_t value, uint8_t flags);
+
+// Writing an executable ("-" writes stdout); segments and lines are sorted first
+bool exe_write(Executable* exe, const char* filename);
+// Reading an executable, or a raw word image as one segment at 0
+bool exe_read(const char* filename, Executable* exe);
+
+// Words from 0 to the end of the highest segment
+uint32_t exe_extent(const Executable* exe);
+// Copying all segments into memory (exe_extent words, gaps zeroed)
+void exe_flatten(const Executable* exe, uint16_t* memory);
+// Label at an address (NULL if none), and source line of an instruction (0 if unknown)
+const char* exe_symbol_at(const Executable* exe, uint16_t address);
+uint32_t exe_line_at(const Executable* exe, uint16_t address);
+
+#endif // EXECUTABLE_H
@@ -0,0 +1,259 @@
+#include "iolog.h"
+#include "cpu.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char IOLOG_MAGIC[8] = { 'S', 'C', '1', '6', 'I', 'O', 'L', 'G' };
+
+// Writing unsigned LEB128 varint
+static void iolog_put_varint(FILE* fp, uint64_t value) {
+    uint8_t buf[10];
+    int len = 0;
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        if (value) byte |= 0x80;
+        buf[len++] = byte;
+    } while (value);
+    fwrite(buf, 1, len, fp);
+}
+
+// Reading unsigned LEB128 varint from buffer
+static bool iolog_get_varint(const uint8_t* data, size_t size, size_t* pos, uint64_t* value) {
+    uint64_t result = 0;
+    int shift = 0;
+    while (*pos < size && shift < 64) {
+        uint8_t byte = data[(*pos)++];
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+        shift += 7;
+    }
+    return false;
+}
+
+static uint16_t iolog_tag_to_port(uint8_t tag) {
+    return tag == IOLOG_TAG_TIMER ? MMIO_TIMER : MMIO_CHAR_IN;
+}
+
+// Opening log for recording
+bool iolog_open_record(IoLog* log, const char* filename) {
+    memset(log, 0, sizeof(IoLog));
+    log->fp = fopen(filename, "wb");
+    if (!log->fp) {
+        fprintf(stderr, "Error: Cannot open I/O log %s for writing\n", filename);
+        return false;
+    }
+
+    fwrite(IOLOG_MAGIC, 1, sizeof(IOLOG_MAGIC), log->fp);
+    fputc(IOLOG_VERSION, log->fp);
+    log->mode = IOLOG_RECORD;
+    return true;
+}
+
+// Starting an in-memory input journal (no file)
+void iolog_open_journal(IoLog* log) {
+    memset(log, 0, sizeof(IoLog));
+    log->mode = IOLOG_RECORD;
+    log->keep_events = true;
+}
+
+// Appending event to in-memory list
+static void iolog_append(IoLog* log, uint16_t port, uint64_t cycle, uint16_t value) {
+    if (log->event_count >= log->event_capacity) {
+        log->event_capacity = log->event_capacity ? log->event_capacity * 2 : 256;
+        log->events = (IoEvent*)realloc(log->events, log->event_capacity * sizeof(IoEvent));
+    }
+    IoEvent* ev = &log->events[log->event_count++];
+    ev->cycle = cycle;
+    ev->port = port;
+    ev->value = value;
+}
+
+// Loading a recorded log for replay
+bool iolog_open_replay(IoLog* log, const char* filename) {
+    memset(log, 0, sizeof(IoLog));
+    FILE* fp = fopen(filename, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open I/O log %s\n", filename);
+        return false;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    uint8_t* data = (uint8_t*)malloc(file_size > 0 ? file_size : 1);
+    if (file_size <= 0 || fread(data, 1, file_size, fp) != (size_t)file_size) {
+        fprintf(stderr, "Error: Failed to read I/O log %s\n", filename);
+        fclose(fp);
+        free(data);
+        return false;
+    }
+    fclose(fp);
+
+    size_t size = (size_t)file_size;
+    if (size < sizeof(IOLOG_MAGIC) + 1 ||
+        memcmp(data, IOLOG_MAGIC, sizeof(IOLOG_MAGIC)) != 0 ||
+        data[sizeof(IOLOG_MAGIC)] != IOLOG_VERSION) {
+        fprintf(stderr, "Error: %s is not a SimpleCPU16 I/O log\n", filename);
+        free(data);
+        return false;
+    }
+
+    size_t pos = sizeof(IOLOG_MAGIC) + 1;
+    uint64_t cycle = 0;
+    while (pos < size) {
+        uint8_t tag = data[pos++];
+        uint64_t delta, value = 0;
+        if (!iolog_get_varint(data, size, &pos, &delta)) break;
+        cycle += delta;
+
+        if (tag == IOLOG_TAG_END) {
+            log->end.present = true;
+            log->end.cycle_count = cycle;
+            bool ok = iolog_get_varint(data, size, &pos, &value);
+            log->end.pc = (uint16_t)value;
+            for (int i = 0; i < NUM_REGISTERS && ok; i++) {
+                ok = iolog_get_varint(data, size, &pos, &value);
+                log->end.registers[i] = (uint16_t)value;
+            }
+            if (!ok) log->end.present = false;
+            break;
+        }
+
+        if (!iolog_get_varint(data, size, &pos, &value)) break;
+        iolog_append(log, iolog_tag_to_port(tag), cycle, (uint16_t)value);
+    }
+
+    free(data);
+    log->mode = IOLOG_REPLAY;
+    printf("I/O log loaded: %zu events from %s\n", log->event_count, filename);
+    return true;
+}
+
+// Appending one input event to the log
+void iolog_record(IoLog* log, uint16_t port, uint64_t cycle, uint16_t value) {
+    if (log->mode != IOLOG_RECORD) return;
+
+    if (log->fp) {
+        fputc(port == MMIO_TIMER ? IOLOG_TAG_TIMER : IOLOG_TAG_CHAR_IN, log->fp);
+        iolog_put_varint(log->fp, cycle - log->last_cycle);
+        iolog_put_varint(log->fp, value);
+    }
+    if (log->keep_events) {
+        iolog_append(log, port, cycle, value);
+        log->cursor = log->event_count;
+    }
+    log->last_cycle = cycle;
+}
+
+// Checking whether the next input must come from the log
+bool iolog_replaying(IoLog* log) {
+    if (log->mode == IOLOG_REPLAY) return true;
+    if (log->rewound && log->cursor < log->event_count) return true;
+    // Journal caught up with the recorded history: back to live input
+    log->rewound = false;
+    return false;
+}
+
+// Returning the next logged value instead of performing real I/O
+uint16_t iolog_replay(IoLog* log, uint16_t port, uint64_t cycle) {
+    if (log->cursor >= log->event_count) {
+        if (!log->diverged) {
+            fprintf(stderr, "Replay: log exhausted at cycle %llu (read of 0x%04X)\n",
+                    (unsigned long long)cycle, port);
+        }
+        log->diverged = true;
+        return port == MMIO_CHAR_IN ? 0xFFFF : (uint16_t)(cycle & 0xFFFF);
+    }
+
+    IoEvent* ev = &log->events[log->cursor];
+    if (ev->port != port) {
+        if (!log->diverged) {
+            fprintf(stderr, "Replay: diverged at event %zu (expected read of 0x%04X, got 0x%04X)\n",
+                    log->cursor, ev->port, port);
+        }
+        log->diverged = true;
+    }
+
+    if (ev->cycle != cycle) {
+        if (log->timing_mismatches == 0) log->first_mismatch = log->cursor;
+        log->timing_mismatches++;
+    }
+
+    log->cursor++;
+    return ev->value;
+}
+
+// Repositioning the replay cursor to the first event at or after cycle
+void iolog_rewind(IoLog* log, uint64_t cycle) {
+    size_t lo = 0, hi = log->event_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (log->events[mid].cycle < cycle) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    log->cursor = lo;
+    if (log->mode == IOLOG_RECORD) {
+        log->rewound = true;
+    }
+}
+
+// Writing end record (record mode) or comparing against it (replay mode)
+bool iolog_finish(IoLog* log, const CPU* cpu) {
+    if (log->mode == IOLOG_RECORD) {
+        if (!log->fp) return true;
+        fputc(IOLOG_TAG_END, log->fp);
+        iolog_put_varint(log->fp, cpu->cycle_count - log->last_cycle);
+        iolog_put_varint(log->fp, cpu->pc);
+        for (int i = 0; i < NUM_REGISTERS; i++) {
+            iolog_put_varint(log->fp, cpu->registers[i]);
+        }
+        return true;
+    }
+
+    if (log->mode != IOLOG_REPLAY) return true;
+
+    bool match = !log->diverged && log->cursor == log->event_count;
+    printf("\n=== Replay Summary ===\n");
+    printf("Events replayed: %zu of %zu\n", log->cursor, log->event_count);
+    printf("Timing mismatches: %llu", (unsigned long long)log->timing_mismatches);
+    if (log->timing_mismatches) {
+        IoEvent* ev = &log->events[log->first_mismatch];
+        printf(" (first at event %llu, recorded cycle %llu)",
+               (unsigned long long)log->first_mismatch, (unsigned long long)ev->cycle);
+    }
+    printf("\n");
+
+    if (log->end.present) {
+        bool regs_match = log->end.pc == cpu->pc;
+        for (int i = 0; i < NUM_REGISTERS; i++) {
+            if (log->end.registers[i] != cpu->registers[i]) regs_match = false;
+        }
+        printf("Cycles: recorded %llu, replayed %llu\n",
+               (unsigned long long)log->end.cycle_count, (unsigned long long)cpu->cycle_count);
+        printf("Final state: %s\n", regs_match ? "match" : "MISMATCH");
+        match = match && regs_match && log->end.cycle_count == cpu->cycle_count;
+    }
+
+    printf("Replay result: %s\n", match ? "identical" : "DIVERGED");
+    return match;
+}
+
+// Closing log and releasing resources
+void iolog_close(IoLog* log) {
+    if (log->fp) {
+        fclose(log->fp);
+        log->fp = NULL;
+    }
+    free(log->events);
+    log->events = NULL;
+    log->event_count = log->event_capacity = 0;
+    log->mode = IOLOG_OFF;
+}
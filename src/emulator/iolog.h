@@ -0,0 +1,80 @@
+#ifndef IOLOG_H
+#define IOLOG_H
+
+#include "cpu.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Deterministic record/replay of nondeterministic guest inputs.
+//
+// Every read of MMIO_CHAR_IN or MMIO_TIMER is logged with the cycle at
+// which it happened. On replay the logged values are fed back without
+// touching the host, so a captured session runs at full speed and
+// produces identical results on any execution engine.
+//
+// The same structure doubles as an in-memory input journal for reverse
+// execution: events are kept in memory and iolog_rewind() serves them
+// again while the guest re-executes, before live recording resumes.
+//
+// Log file layout (all multi-byte values are LEB128 varints):
+//   "SC16IOLG"  8-byte magic
+//   version     1 byte (IOLOG_VERSION)
+//   events      tag byte, cycle delta, value
+//   end record  IOLOG_TAG_END, cycle delta, PC, R0-R7
+
+#define IOLOG_VERSION 1
+
+#define IOLOG_TAG_TIMER   0x01
+#define IOLOG_TAG_CHAR_IN 0x02
+#define IOLOG_TAG_END     0x7F
+
+typedef enum {
+    IOLOG_OFF,
+    IOLOG_RECORD,
+    IOLOG_REPLAY
+} IoLogMode;
+
+// One input event
+typedef struct {
+    uint64_t cycle;
+    uint16_t port;      // MMIO address that was read
+    uint16_t value;
+} IoEvent;
+
+// Final machine state stored in the end record
+typedef struct {
+    bool present;
+    uint64_t cycle_count;
+    uint16_t pc;
+    uint16_t registers[NUM_REGISTERS];
+} IoLogEnd;
+
+// Record/replay state
+typedef struct IoLog {
+    IoLogMode mode;
+    FILE* fp;                   // Record mode output (NULL for a journal)
+    uint64_t last_cycle;        // Cycle of previously written event
+    IoEvent* events;            // Replay events / kept record events
+    size_t event_count;
+    size_t event_capacity;
+    size_t cursor;              // Next event to replay
+    bool keep_events;           // Record mode also appends to events
+    bool rewound;               // Record mode serving events after a rewind
+    IoLogEnd end;               // Recorded end state (replay mode)
+    uint64_t timing_mismatches; // Events replayed at a different cycle
+    uint64_t first_mismatch;    // Index of first mismatched event
+    bool diverged;              // Port mismatch or log exhausted
+} IoLog;
+
+bool iolog_open_record(IoLog* log, const char* filename);
+bool iolog_open_replay(IoLog* log, const char* filename);
+void iolog_open_journal(IoLog* log);
+void iolog_record(IoLog* log, uint16_t port, uint64_t cycle, uint16_t value);
+bool iolog_replaying(IoLog* log);
+uint16_t iolog_replay(IoLog* log, uint16_t port, uint64_t cycle);
+void iolog_rewind(IoLog* log, uint64_t cycle);
+bool iolog_finish(IoLog* log, const struct CPU* cpu);
+void iolog_close(IoLog* log);
+
+#endif // IOLOG_H
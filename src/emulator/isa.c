@@ -0,0 +1,96 @@
+#include "isa.h"
+#include "isa_hash.h"
+#include <stdio.h>
+
+const InsnInfo isa_table[ISA_COUNT] = {
+#define INSN(name, opcode, sub, shape, length) { #name, opcode, sub, shape, length },
+#include "isa.def"
+};
+
+// Finding the first table row for a mnemonic (NULL if unknown)
+const InsnInfo* isa_lookup(const char* name, size_t length) {
+    int index = isa_hash_slots[isa_hash(name, length, ISA_HASH_SEED) & (ISA_HASH_SIZE - 1)];
+    if (index < 0) return NULL;
+
+    // One comparison confirms the hit
+    const char* candidate = isa_table[index].name;
+    for (size_t i = 0; i < length; i++) {
+        char c = name[i];
+        if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+        if (c != candidate[i]) return NULL;
+    }
+    return candidate[length] == '\0' ? &isa_table[index] : NULL;
+}
+
+// Finding the table row for an instruction word (NULL if not an instruction)
+const InsnInfo* isa_decode(uint16_t word) {
+    int index = isa_decode_map[word >> 12][word & 0x3F];
+    return index < 0 ? NULL : &isa_table[index];
+}
+
+// Counting words of the instruction starting with word
+int isa_length(uint16_t word) {
+    const InsnInfo* insn = isa_decode(word);
+    return insn ? insn->length : 1;
+}
+
+// Formatting an instruction as assembly (ext is the following word);
+// returns its length in words
+int isa_disassemble(uint16_t word, uint16_t ext, char* buf, size_t size) {
+    const InsnInfo* insn = isa_decode(word);
+    if (!insn) {
+        snprintf(buf, size, ".WORD 0x%04X", word);
+        return 1;
+    }
+
+    int rd = (word >> 9) & 0x7;
+    int rs = (word >> 6) & 0x7;
+    char list[40];
+    switch (insn->shape) {
+        case SHAPE_RD:     snprintf(buf, size, "%s R%d", insn->name, rd); break;
+        case SHAPE_RS:     snprintf(buf, size, "%s R%d", insn->name, rs); break;
+        case SHAPE_RD_RS:  snprintf(buf, size, "%s R%d, R%d", insn->name, rd, rs); break;
+        case SHAPE_RD_IMM: snprintf(buf, size, "%s R%d, 0x%04X", insn->name, rd, ext); break;
+        case SHAPE_RD_MEM: snprintf(buf, size, "%s R%d, [0x%04X]", insn->name, rd, ext); break;
+        case SHAPE_RD_IND: snprintf(buf, size, "%s R%d, [R%d]", insn->name, rd, rs); break;
+        case SHAPE_MEM_RS: snprintf(buf, size, "%s [0x%04X], R%d", insn->name, ext, rs); break;
+        case SHAPE_IND_RS: snprintf(buf, size, "%s [R%d], R%d", insn->name, rd, rs); break;
+        case SHAPE_RD_OFF: snprintf(buf, size, "%s R%d, [R%d+0x%04X]", insn->name, rd, rs, ext); break;
+        case SHAPE_OFF_RS: snprintf(buf, size, "%s [R%d+0x%04X], R%d", insn->name, rd, ext, rs); break;
+        case SHAPE_RD_INC: snprintf(buf, size, "%s R%d, [R%d]+", insn->name, rd, rs); break;
+        case SHAPE_RD_DEC: snprintf(buf, size, "%s R%d, -[R%d]", insn->name, rd, rs); break;
+        case SHAPE_INC_RS: snprintf(buf, size, "%s [R%d]+, R%d", insn->name, rd, rs); break;
+        case SHAPE_DEC_RS: snprintf(buf, size, "%s -[R%d], R%d", insn->name, rd, rs); break;
+        case SHAPE_TARGET: snprintf(buf, size, "%s 0x%04X", insn->name, ext); break;
+        case SHAPE_REGLIST:
+            isa_format_reglist(ext, list, sizeof(list));
+            snprintf(buf, size, "%s %s", insn->name, list);
+            break;
+        default:           snprintf(buf, size, "%s", insn->name); break;
+    }
+    return insn->length;
+}
+
+// Formatting a PUSHM/POPM mask as a register list, runs of three or
+// more as ranges ("R1, R4-R6"); an empty mask is "0"
+void isa_format_reglist(uint16_t mask, char* buf, size_t size) {
+    size_t used = 0;
+    buf[0] = '\0';
+    mask &= STACK_MASK_REGS;
+    if (mask == 0) {
+        snprintf(buf, size, "0");
+        return;
+    }
+    for (int r = 0; r < NUM_REGISTERS && used < size; r++) {
+        if (!(mask & (1 << r))) continue;
+        int last = r;
+        while (last + 1 < NUM_REGISTERS && (mask & (1 << (last + 1)))) last++;
+        const char* separator = used > 0 ? ", " : "";
+        if (last - r >= 2) {
+            used += snprintf(buf + used, size - used, "%sR%d-R%d", separator, r, last);
+            r = last;
+        } else {
+            used += snprintf(buf + used, size - used, "%sR%d", separator, r);
+        }
+    }
+}
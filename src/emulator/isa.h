@@ -0,0 +1,75 @@
+#ifndef ISA_H
+#define ISA_H
+
+#include "cpu.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Instruction table shared by the assembler, size counting and decoders.
+// Rows come from isa.def. Mnemonic lookup goes through a perfect hash and
+// decoding through an (opcode, mode) map, both generated at build time by
+// isagen into isa_hash.h.
+
+#define ISA_NOSUB 0xFF          // Mode field unused by this opcode
+
+// Operand shapes (how the operands after the mnemonic are laid out)
+typedef enum {
+    SHAPE_NONE,                 // NOP
+    SHAPE_RD,                   // INC Rd
+    SHAPE_RS,                   // PUSH Rs
+    SHAPE_RD_RS,                // ADD Rd, Rs
+    SHAPE_RD_IMM,               // LDI Rd, imm      (+1 word)
+    SHAPE_RD_MEM,               // LD Rd, [addr]    (+1 word)
+    SHAPE_RD_IND,               // LD Rd, [Rs]
+    SHAPE_MEM_RS,               // ST [addr], Rs    (+1 word)
+    SHAPE_IND_RS,               // ST [Rd], Rs
+    SHAPE_RD_OFF,               // LD Rd, [Rs+imm]  (+1 word)
+    SHAPE_OFF_RS,               // ST [Rd+imm], Rs  (+1 word)
+    SHAPE_RD_INC,               // LD Rd, [Rs]+
+    SHAPE_RD_DEC,               // LD Rd, -[Rs]
+    SHAPE_INC_RS,               // ST [Rd]+, Rs
+    SHAPE_DEC_RS,               // ST -[Rd], Rs
+    SHAPE_TARGET,               // JMP addr         (+1 word)
+    SHAPE_REGLIST               // PUSHM R1, R4-R6  (+1 word, register mask)
+} OperandShape;
+
+enum {
+    ISA_COUNT = 0
+#define INSN(name, opcode, sub, shape, length) + 1
+#include "isa.def"
+};
+
+typedef struct {
+    const char* name;
+    uint8_t opcode;
+    uint8_t sub;                // Mode field value, or ISA_NOSUB
+    uint8_t shape;              // OperandShape
+    uint8_t length;             // Words including the extension word
+} InsnInfo;
+
+extern const InsnInfo isa_table[ISA_COUNT];
+
+// Case-insensitive hash used by isagen and isa_lookup (must stay in sync)
+static inline uint32_t isa_hash(const char* name, size_t length, uint32_t seed) {
+    uint32_t hash = seed;
+    for (size_t i = 0; i < length; i++) {
+        uint8_t c = (uint8_t)name[i];
+        if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+static inline uint16_t isa_encode(const InsnInfo* insn, int rd, int rs) {
+    uint16_t sub = insn->sub == ISA_NOSUB ? 0 : insn->sub;
+    return (uint16_t)((insn->opcode << 12) | ((rd & 7) << 9) | ((rs & 7) << 6) | sub);
+}
+
+const InsnInfo* isa_lookup(const char* name, size_t length);
+const InsnInfo* isa_decode(uint16_t word);
+int isa_length(uint16_t word);
+int isa_disassemble(uint16_t word, uint16_t ext, char* buf, size_t size);
+void isa_format_reglist(uint16_t mask, char* buf, size_t size);
+
+#endif // ISA_H
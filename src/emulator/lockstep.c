@@ -0,0 +1,170 @@
+#include "lockstep.h"
+#include "isa.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Instructions the reference executed during the current step
+typedef struct {
+    uint16_t pc[LOCKSTEP_TRAIL];
+    uint16_t word[LOCKSTEP_TRAIL];
+    uint16_t ext[LOCKSTEP_TRAIL];
+    uint64_t count;
+} LockstepTrail;
+
+static void lockstep_print_trail(FILE* out, const LockstepTrail* trail) {
+    uint64_t first = trail->count > LOCKSTEP_TRAIL ? trail->count - LOCKSTEP_TRAIL : 0;
+    if (first > 0) {
+        fprintf(out, "  ... %llu earlier instruction(s) in this step\n", (unsigned long long)first);
+    }
+    for (uint64_t i = first; i < trail->count; i++) {
+        int slot = (int)(i % LOCKSTEP_TRAIL);
+        char text[48];
+        isa_disassemble(trail->word[slot], trail->ext[slot], text, sizeof(text));
+        fprintf(out, "  0x%04X: %s\n", trail->pc[slot], text);
+    }
+}
+
+// Comparing the pages either CPU wrote since the last comparison
+static uint32_t lockstep_diff_memory(const CPU* a, const CPU* b, FILE* out) {
+    uint32_t differing = 0;
+    for (int chunk = 0; chunk < NUM_PAGES / 64; chunk++) {
+        uint64_t bits = a->dirty_pages[chunk] | b->dirty_pages[chunk];
+        while (bits) {
+            int page = chunk * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            const uint16_t* pa = a->pages[page];
+            const uint16_t* pb = b->pages[page];
+            if (pa == pb || memcmp(pa, pb, PAGE_WORDS * sizeof(uint16_t)) == 0) continue;
+            for (int i = 0; i < PAGE_WORDS; i++) {
+                if (pa[i] == pb[i]) continue;
+                if (out && differing < LOCKSTEP_MAX_WORDS) {
+                    fprintf(out, "  [0x%04X]: reference 0x%04X, candidate 0x%04X\n",
+                            (page << PAGE_SHIFT) | i, pa[i], pb[i]);
+                }
+                differing++;
+            }
+        }
+    }
+    if (out && differing > LOCKSTEP_MAX_WORDS) {
+        fprintf(out, "  ... %u more differing word(s)\n", differing - LOCKSTEP_MAX_WORDS);
+    }
+    return differing;
+}
+
+// Comparing architectural state; prints each difference when out is set
+static bool lockstep_compare(const CPU* a, const CPU* b, size_t* output_seen, FILE* out) {
+    bool same = true;
+    if (a->halted != b->halted) {
+        if (out) fprintf(out, "  halted: reference %d, candidate %d\n", a->halted, b->halted);
+        same = false;
+    }
+    if (a->cycle_count != b->cycle_count) {
+        if (out) fprintf(out, "  cycles: reference %llu, candidate %llu\n",
+                         (unsigned long long)a->cycle_count, (unsigned long long)b->cycle_count);
+        same = false;
+    }
+    if (a->pc != b->pc) {
+        if (out) fprintf(out, "  PC: reference 0x%04X, candidate 0x%04X\n", a->pc, b->pc);
+        same = false;
+    }
+    for (int r = 0; r < NUM_REGISTERS; r++) {
+        if (a->registers[r] != b->registers[r]) {
+            if (out) fprintf(out, "  R%d: reference 0x%04X, candidate 0x%04X\n",
+                             r, a->registers[r], b->registers[r]);
+            same = false;
+        }
+    }
+    if (a->bank != b->bank) {
+        if (out) fprintf(out, "  bank: reference %u, candidate %u\n", a->bank, b->bank);
+        same = false;
+    }
+    const bool fa[4] = { a->flags.Z, a->flags.N, a->flags.C, a->flags.V };
+    const bool fb[4] = { b->flags.Z, b->flags.N, b->flags.C, b->flags.V };
+    for (int f = 0; f < 4; f++) {
+        if (fa[f] != fb[f]) {
+            if (out) fprintf(out, "  %c: reference %d, candidate %d\n", "ZNCV"[f], fa[f], fb[f]);
+            same = false;
+        }
+    }
+    if (lockstep_diff_memory(a, b, out) > 0) {
+        same = false;
+    }
+
+    // Output only grows, so everything before output_seen already matched
+    const OutputBuffer* oa = a->output;
+    const OutputBuffer* ob = b->output;
+    if (oa->size != ob->size || (oa->size > *output_seen &&
+        memcmp(oa->data + *output_seen, ob->data + *output_seen, oa->size - *output_seen) != 0)) {
+        size_t at = *output_seen;
+        while (at < oa->size && at < ob->size && oa->data[at] == ob->data[at]) at++;
+        if (out) fprintf(out, "  output byte %zu: reference %s%d, candidate %s%d\n", at,
+                         at < oa->size ? "" : "(end) ", at < oa->size ? (uint8_t)oa->data[at] : -1,
+                         at < ob->size ? "" : "(end) ", at < ob->size ? (uint8_t)ob->data[at] : -1);
+        same = false;
+    }
+    *output_seen = oa->size;
+    return same;
+}
+
+bool lockstep_run(CPU* reference, CPU* candidate, const CpuEngine* engine, uint64_t max_cycles,
+                  FILE* report, LockstepResult* result) {
+    memset(result, 0, sizeof(LockstepResult));
+    OutputBuffer ref_output, cand_output;
+    memset(&ref_output, 0, sizeof(ref_output));
+    memset(&cand_output, 0, sizeof(cand_output));
+    reference->output = &ref_output;
+    candidate->output = &cand_output;
+    cpu_clear_dirty(reference);
+    cpu_clear_dirty(candidate);
+
+    LockstepTrail trail;
+    size_t output_seen = 0;
+    uint64_t limit = candidate->cycle_count + max_cycles;
+    bool progress = true;
+    while (!candidate->halted && candidate->cycle_count < limit) {
+        uint64_t before = candidate->cycle_count;
+        engine->run(candidate, limit);
+        result->steps++;
+        progress = candidate->cycle_count > before || candidate->halted;
+
+        // Catching the reference up, remembering what it executed
+        trail.count = 0;
+        while (!reference->halted && reference->cycle_count < candidate->cycle_count) {
+            int slot = (int)(trail.count++ % LOCKSTEP_TRAIL);
+            trail.pc[slot] = reference->pc;
+            trail.word[slot] = cpu_peek(reference, reference->pc);
+            trail.ext[slot] = cpu_peek(reference, (uint16_t)(reference->pc + 1));
+            cpu_step(reference, false);
+        }
+
+        if (!progress || !lockstep_compare(reference, candidate, &output_seen, NULL)) {
+            result->diverged = true;
+            if (report) {
+                fprintf(report, "Divergence at step %llu (candidate '%s', cycle %llu)\n",
+                        (unsigned long long)result->steps, engine->name,
+                        (unsigned long long)candidate->cycle_count);
+                if (!progress) {
+                    fprintf(report, "  candidate made no progress at PC 0x%04X\n", candidate->pc);
+                }
+                fprintf(report, "Reference executed:\n");
+                lockstep_print_trail(report, &trail);
+                if (trail.count == 0) fprintf(report, "  (nothing)\n");
+                fprintf(report, "Differences:\n");
+                output_seen = 0;
+                lockstep_compare(reference, candidate, &output_seen, report);
+            }
+            break;
+        }
+        cpu_clear_dirty(reference);
+        cpu_clear_dirty(candidate);
+    }
+
+    result->cycles = reference->cycle_count < candidate->cycle_count ? reference->cycle_count
+                                                                     : candidate->cycle_count;
+    result->halted = reference->halted && candidate->halted;
+    reference->output = NULL;
+    candidate->output = NULL;
+    free(ref_output.data);
+    free(cand_output.data);
+    return !result->diverged;
+}
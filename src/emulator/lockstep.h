@@ -0,0 +1,36 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include "cpu.h"
+#include "engine.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Differential lockstep testing of an engine against the reference.
+//
+// Two CPUs start from the same state. After every call into the
+// candidate engine (one instruction or one block), the reference steps
+// until it has executed as many cycles, and the two are compared:
+// halted state, cycle count, PC, registers, flags, every page either
+// one wrote since the last comparison, and guest output. The run stops
+// at the first difference, which is reported together with the
+// instructions the reference executed in that step.
+
+#define LOCKSTEP_TRAIL 16           // Instructions kept for the report
+#define LOCKSTEP_MAX_WORDS 8        // Differing memory words listed
+
+typedef struct {
+    bool diverged;
+    uint64_t steps;                 // Candidate engine calls
+    uint64_t cycles;                // Cycles both executed before stopping
+    bool halted;                    // Both halted (as opposed to the cycle limit)
+} LockstepResult;
+
+// Running until both halt, max_cycles pass or they diverge. Guest output
+// is captured from both for comparison. The divergence report goes to
+// report (NULL = silent). Returns false on divergence.
+bool lockstep_run(CPU* reference, CPU* candidate, const CpuEngine* engine, uint64_t max_cycles,
+                  FILE* report, LockstepResult* result);
+
+#endif // LOCKSTEP_H
@@ -1,4 +1,13 @@
 #include "cpu.h"
+#include "iolog.h"
+#include "checkpoint.h"
+#include "debugger.h"
+#include "breakpoint.h"
+#include "memdump.h"
+#include "executable.h"
+#include "engine.h"
+#include "bank.h"
+#include "timing.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,7 +18,28 @@ void print_usage(const char* program_name) {
     printf("Usage: %s <binary_file> [options]\n", program_name);
     printf("Options:\n");
     printf("  --trace         Enable instruction trace\n");
-    printf("  --memdump FILE  Dump memory to file after execution\n");
+    printf("  --memdump FILE  Dump memory to file after execution (text)\n");
+    printf("  --dump FILE     Save final machine state as a binary dump\n");
+    printf("  --compare FILE  Diff final machine state against a binary dump\n");
+    printf("  --record FILE   Record nondeterministic inputs to an I/O log\n");
+    printf("  --replay FILE   Replay inputs from an I/O log (no real I/O)\n");
+    printf("  --break SPEC    Stop at PC: \"ADDR [if Rn OP V] [after N]\"\n");
+    printf("  --watch SPEC    Stop on access: \"ADDR[-END] [r|w|rw]\" or \"stack [WORDS]\"\n");
+    printf("  --debug         Start the interactive debugger (with reverse execution)\n");
+    printf("  --checkpoint-interval N  Cycles between debugger checkpoints (default %d)\n",
+           CHECKPOINT_DEFAULT_INTERVAL);
+    printf("  --checkpoint-pages N     Max saved 256-word pages for history (default %d; at least\n"
+           "                           %d, with banks every page outside the window and every bank page)\n",
+           CHECKPOINT_DEFAULT_PAGES, NUM_PAGES);
+    printf("  --banks N       Put N banks of %d words behind the window at 0x%04X\n",
+           BANK_WORDS, BANK_WINDOW);
+    printf("  --bank-file FILE  Back the banks with FILE (copy-on-write; as many banks as it fills)\n");
+    printf("  --timing        Run under the cache and branch timing model and print its statistics\n");
+    printf("  --engine NAME   Execution engine for untraced runs:");
+    for (int i = 0; cpu_engines[i]; i++) {
+        printf(" %s%s", cpu_engines[i]->name, i == 0 ? " (default)" : "");
+    }
+    printf("\n");
     printf("  --help          Show this help message\n");
 }
 
@@ -22,6 +52,20 @@ int main(int argc, char* argv[]) {
     const char* binary_file = NULL;
     bool trace = false;
     const char* memdump_file = NULL;
+    const char* dump_file = NULL;
+    const char* compare_file = NULL;
+    const char* record_file = NULL;
+    const char* replay_file = NULL;
+    bool debug = false;
+    const char* break_specs[64];
+    const char* watch_specs[64];
+    int break_count = 0, watch_count = 0;
+    uint64_t checkpoint_interval = CHECKPOINT_DEFAULT_INTERVAL;
+    size_t checkpoint_pages = CHECKPOINT_DEFAULT_PAGES;
+    const CpuEngine* engine = NULL;
+    uint32_t bank_count = 0;
+    const char* bank_file = NULL;
+    bool timing = false;
     
     // Parsing command-line arguments
     for (int i = 1; i < argc; i++) {
@@ -31,6 +75,56 @@ int main(int argc, char* argv[]) {
             if (i + 1 < argc) {
                 memdump_file = argv[++i];
             }
+        } else if (strcmp(argv[i], "--dump") == 0) {
+            if (i + 1 < argc) {
+                dump_file = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--compare") == 0) {
+            if (i + 1 < argc) {
+                compare_file = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--record") == 0) {
+            if (i + 1 < argc) {
+                record_file = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--replay") == 0) {
+            if (i + 1 < argc) {
+                replay_file = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--break") == 0) {
+            if (i + 1 < argc && break_count < 64) {
+                break_specs[break_count++] = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--watch") == 0) {
+            if (i + 1 < argc && watch_count < 64) {
+                watch_specs[watch_count++] = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--debug") == 0) {
+            debug = true;
+        } else if (strcmp(argv[i], "--checkpoint-interval") == 0) {
+            if (i + 1 < argc) {
+                checkpoint_interval = strtoull(argv[++i], NULL, 0);
+            }
+        } else if (strcmp(argv[i], "--checkpoint-pages") == 0) {
+            if (i + 1 < argc) {
+                checkpoint_pages = strtoull(argv[++i], NULL, 0);
+            }
+        } else if (strcmp(argv[i], "--banks") == 0) {
+            if (i + 1 < argc) {
+                bank_count = (uint32_t)strtoul(argv[++i], NULL, 0);
+            }
+        } else if (strcmp(argv[i], "--bank-file") == 0) {
+            if (i + 1 < argc) {
+                bank_file = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--timing") == 0) {
+            timing = true;
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            engine = engine_lookup(argv[++i]);
+            if (!engine) {
+                fprintf(stderr, "Error: Unknown engine '%s'\n", argv[i]);
+                return 1;
+            }
         } else if (strcmp(argv[i], "--help") == 0) {
             print_usage(argv[0]);
             return 0;
@@ -44,47 +138,128 @@ int main(int argc, char* argv[]) {
         print_usage(argv[0]);
         return 1;
     }
-    
-    // Loading binary file
-    FILE* fp = fopen(binary_file, "rb");
-    if (!fp) {
-        fprintf(stderr, "Error: Cannot open binary file %s\n", binary_file);
+
+    if (record_file && replay_file) {
+        fprintf(stderr, "Error: --record and --replay are mutually exclusive\n");
         return 1;
     }
     
-    fseek(fp, 0, SEEK_END);
-    long file_size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-
-    int word_count = file_size / sizeof(uint16_t);
-    uint16_t* program = (uint16_t*)malloc(file_size);
-
-    if (fread(program, sizeof(uint16_t), word_count, fp) != (size_t)word_count) {
-        fprintf(stderr, "Error: Failed to read binary file\n");
-        fclose(fp);
-        free(program);
+    // Loading the executable (or a raw image at 0)
+    Executable exe;
+    if (!exe_read(binary_file, &exe)) {
         return 1;
     }
     
-    fclose(fp);
-    
     // Initializing and running CPU
     printf("SimpleCPU16 Emulator v1.0\n");
     printf("==========================\n\n");
     
     CPU cpu;
     cpu_init(&cpu);
-    cpu_load_program(&cpu, program, word_count, 0x0000);
+    engine_attach(&cpu, engine);
+
+    // Attaching banks first, so segments loaded into the window land in bank 0
+    BankStore banks;
+    bool banked = bank_count > 0 || bank_file;
+    if (banked) {
+        if (!bank_open(&banks, bank_count, bank_file)) return 1;
+        cpu_attach_banks(&cpu, &banks);
+    }
+    for (uint32_t i = 0; i < exe.segment_count; i++) {
+        cpu_load_program(&cpu, exe.segments[i].words, exe.segments[i].size, exe.segments[i].address);
+    }
+    cpu.pc = exe.entry;
+    if (!exe.raw) {
+        printf("Entry point: 0x%04X\n", exe.entry);
+    }
     
-    free(program);
+    exe_free(&exe);
+
+    TimingModel model;
+    if (timing) {
+        TimingConfig config;
+        timing_default_config(&config);
+        if (!timing_init(&model, &config)) return 1;
+        cpu.timing = &model;
+    }
+
+    IoLog iolog;
+    if (record_file || replay_file) {
+        bool opened = record_file ? iolog_open_record(&iolog, record_file)
+                                  : iolog_open_replay(&iolog, replay_file);
+        if (!opened) return 1;
+        cpu.iolog = &iolog;
+    }
     
-    cpu_run(&cpu, trace);
+    BreakpointSet breakpoints;
+    bp_init(&breakpoints, &cpu);
+    for (int i = 0; i < break_count; i++) {
+        if (bp_parse_breakpoint(&breakpoints, break_specs[i]) < 0) return 1;
+    }
+    for (int i = 0; i < watch_count; i++) {
+        if (bp_parse_watchpoint(&breakpoints, watch_specs[i]) < 0) return 1;
+    }
+
+    if (debug) {
+        Checkpointer ckpt;
+        if (!checkpoint_init(&ckpt, &cpu, checkpoint_interval, checkpoint_pages,
+                             CHECKPOINT_DEFAULT_SLOTS)) {
+            return 1;
+        }
+        debugger_run(&cpu, &ckpt, trace);
+        checkpoint_free(&ckpt, &cpu);
+    } else {
+        cpu_run(&cpu, trace);
+    }
     
     cpu_dump_registers(&cpu);
+    bp_free(&breakpoints);
+
+    if (cpu.timing) {
+        printf("\n=== Timing Model ===\n");
+        timing_print_stats(stdout, &model.stats);
+        cpu.timing = NULL;
+        timing_free(&model);
+    }
+
+    int status = 0;
+    if (cpu.iolog) {
+        if (!iolog_finish(&iolog, &cpu)) status = 2;
+        iolog_close(&iolog);
+        cpu.iolog = NULL;
+    }
     
     if (memdump_file) {
         cpu_dump_memory(&cpu, memdump_file);
     }
+
+    if (dump_file && !memdump_write(&cpu, dump_file)) {
+        status = 1;
+    }
+
+    if (compare_file) {
+        MemSnapshot* expected = (MemSnapshot*)malloc(sizeof(MemSnapshot));
+        MemSnapshot* actual = (MemSnapshot*)malloc(sizeof(MemSnapshot));
+        if (expected && actual && memdump_read(compare_file, expected)) {
+            MemDiff diff;
+            memset(&diff, 0, sizeof(diff));
+            memdump_capture(&cpu, actual);
+            memdump_diff(expected, actual, &diff);
+            printf("\n=== Compare with %s ===\n", compare_file);
+            memdump_print_diff(stdout, &diff, expected, actual, false);
+            if (!memdump_diff_empty(&diff) && status == 0) status = 2;
+            memdump_diff_free(&diff);
+        } else {
+            status = 1;
+        }
+        free(expected);
+        free(actual);
+    }
+
+    cpu_free(&cpu);
+    if (banked) {
+        bank_close(&banks);
+    }
     
-    return 0;
+    return status;
 }
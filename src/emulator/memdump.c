@@ -0,0 +1,309 @@
+#include "memdump.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const char MEMDUMP_MAGIC[8] = { 'S', 'C', '1', '6', 'M', 'D', 'M', 'P' };
+
+#define MEMDUMP_HEADER_SIZE 36
+
+static void memdump_put16(uint8_t* buf, uint16_t value) {
+    buf[0] = value & 0xFF;
+    buf[1] = value >> 8;
+}
+
+static void memdump_put32(uint8_t* buf, uint32_t value) {
+    memdump_put16(buf, value & 0xFFFF);
+    memdump_put16(buf + 2, value >> 16);
+}
+
+static uint16_t memdump_get16(const uint8_t* buf) {
+    return (uint16_t)(buf[0] | (buf[1] << 8));
+}
+
+static uint32_t memdump_get32(const uint8_t* buf) {
+    return memdump_get16(buf) | ((uint32_t)memdump_get16(buf + 2) << 16);
+}
+
+// Flattening CPU state (non-resident pages become zeros)
+void memdump_capture(const CPU* cpu, MemSnapshot* snap) {
+    for (uint32_t page = 0; page < NUM_PAGES; page++) {
+        memcpy(&snap->memory[page << PAGE_SHIFT], cpu->pages[page], PAGE_WORDS * sizeof(uint16_t));
+    }
+    memcpy(snap->registers, cpu->registers, sizeof(snap->registers));
+    snap->pc = cpu->pc;
+    snap->flags = (uint8_t)(cpu->flags.Z | (cpu->flags.N << 1) | (cpu->flags.C << 2) | (cpu->flags.V << 3));
+    snap->halted = cpu->halted;
+    snap->cycles = cpu->cycle_count;
+}
+
+// Finding the end of the nonzero range starting at start
+static uint32_t memdump_range_end(const uint16_t* memory, uint32_t start) {
+    uint32_t last = start;
+    for (uint32_t i = start + 1; i < MEM_SIZE && i - last <= MEMDUMP_GAP_WORDS; i++) {
+        if (memory[i] != 0) last = i;
+    }
+    return last + 1;
+}
+
+static bool memdump_write_snapshot(const MemSnapshot* snap, FILE* fp) {
+    uint8_t header[MEMDUMP_HEADER_SIZE];
+    memcpy(header, MEMDUMP_MAGIC, sizeof(MEMDUMP_MAGIC));
+    header[8] = MEMDUMP_VERSION;
+    header[9] = (uint8_t)(snap->flags | (snap->halted << 4));
+    memdump_put16(header + 10, snap->pc);
+    for (int r = 0; r < NUM_REGISTERS; r++) {
+        memdump_put16(header + 12 + r * 2, snap->registers[r]);
+    }
+    memdump_put32(header + 28, (uint32_t)snap->cycles);
+    memdump_put32(header + 32, (uint32_t)(snap->cycles >> 32));
+    fwrite(header, 1, sizeof(header), fp);
+
+    uint8_t* buf = (uint8_t*)malloc(MEM_SIZE * sizeof(uint16_t));
+    if (!buf) return false;
+    uint32_t addr = 0;
+    while (addr < MEM_SIZE) {
+        if (snap->memory[addr] == 0) {
+            addr++;
+            continue;
+        }
+        uint32_t end = memdump_range_end(snap->memory, addr);
+        uint8_t range[8];
+        memdump_put32(range, addr);
+        memdump_put32(range + 4, end - addr);
+        fwrite(range, 1, sizeof(range), fp);
+        for (uint32_t i = addr; i < end; i++) {
+            memdump_put16(buf + (i - addr) * 2, snap->memory[i]);
+        }
+        fwrite(buf, sizeof(uint16_t), end - addr, fp);
+        addr = end;
+    }
+    free(buf);
+
+    uint8_t terminator[8] = { 0 };
+    fwrite(terminator, 1, sizeof(terminator), fp);
+    return !ferror(fp);
+}
+
+// Writing a binary dump of the current machine state
+bool memdump_write(const CPU* cpu, const char* filename) {
+    MemSnapshot* snap = (MemSnapshot*)malloc(sizeof(MemSnapshot));
+    FILE* fp = fopen(filename, "wb");
+    if (!snap || !fp) {
+        fprintf(stderr, "Error: Cannot open memory dump %s for writing\n", filename);
+        free(snap);
+        if (fp) fclose(fp);
+        return false;
+    }
+
+    memdump_capture(cpu, snap);
+    bool ok = memdump_write_snapshot(snap, fp);
+    ok = fclose(fp) == 0 && ok;
+    free(snap);
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to write memory dump %s\n", filename);
+    }
+    return ok;
+}
+
+// Reading a binary dump
+bool memdump_read(const char* filename, MemSnapshot* snap) {
+    FILE* fp = fopen(filename, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open memory dump %s\n", filename);
+        return false;
+    }
+
+    uint8_t header[MEMDUMP_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), fp) != sizeof(header) ||
+        memcmp(header, MEMDUMP_MAGIC, sizeof(MEMDUMP_MAGIC)) != 0) {
+        fprintf(stderr, "Error: %s is not a memory dump\n", filename);
+        fclose(fp);
+        return false;
+    }
+    if (header[8] != MEMDUMP_VERSION) {
+        fprintf(stderr, "Error: Unsupported memory dump version %d\n", header[8]);
+        fclose(fp);
+        return false;
+    }
+
+    memset(snap, 0, sizeof(MemSnapshot));
+    snap->flags = header[9] & 0x0F;
+    snap->halted = (header[9] >> 4) & 1;
+    snap->pc = memdump_get16(header + 10);
+    for (int r = 0; r < NUM_REGISTERS; r++) {
+        snap->registers[r] = memdump_get16(header + 12 + r * 2);
+    }
+    snap->cycles = memdump_get32(header + 28) | ((uint64_t)memdump_get32(header + 32) << 32);
+
+    uint8_t* buf = (uint8_t*)malloc(MEM_SIZE * sizeof(uint16_t));
+    bool ok = buf != NULL;
+    while (ok) {
+        uint8_t range[8];
+        if (fread(range, 1, sizeof(range), fp) != sizeof(range)) {
+            ok = false;
+            break;
+        }
+        uint32_t start = memdump_get32(range);
+        uint32_t count = memdump_get32(range + 4);
+        if (count == 0) break;
+        if (start >= MEM_SIZE || count > MEM_SIZE - start ||
+            fread(buf, sizeof(uint16_t), count, fp) != count) {
+            ok = false;
+            break;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            snap->memory[start + i] = memdump_get16(buf + i * 2);
+        }
+    }
+    free(buf);
+    fclose(fp);
+
+    if (!ok) {
+        fprintf(stderr, "Error: Memory dump %s is truncated or corrupt\n", filename);
+    }
+    return ok;
+}
+
+// Finding the first index in [start, end) where a and b differ (end if none)
+uint32_t memdump_first_diff(const uint16_t* a, const uint16_t* b, uint32_t start, uint32_t end) {
+    uint32_t i = start;
+#ifdef __SSE2__
+    // 64 bytes per iteration while everything matches
+    for (; i + 32 <= end; i += 32) {
+        __m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(a + i)),
+                                   _mm_loadu_si128((const __m128i*)(b + i)));
+        __m128i x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(a + i + 8)),
+                                   _mm_loadu_si128((const __m128i*)(b + i + 8)));
+        __m128i x2 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(a + i + 16)),
+                                   _mm_loadu_si128((const __m128i*)(b + i + 16)));
+        __m128i x3 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(a + i + 24)),
+                                   _mm_loadu_si128((const __m128i*)(b + i + 24)));
+        __m128i any = _mm_or_si128(_mm_or_si128(x0, x1), _mm_or_si128(x2, x3));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) != 0xFFFF) break;
+    }
+    for (; i + 8 <= end; i += 8) {
+        __m128i eq = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(a + i)),
+                                     _mm_loadu_si128((const __m128i*)(b + i)));
+        int mask = _mm_movemask_epi8(eq);
+        if (mask != 0xFFFF) {
+            return i + __builtin_ctz(~mask & 0xFFFF) / 2;
+        }
+    }
+#else
+    for (; i + 4 <= end; i += 4) {
+        uint64_t wa, wb;
+        memcpy(&wa, a + i, sizeof(wa));
+        memcpy(&wb, b + i, sizeof(wb));
+        if (wa != wb) break;
+    }
+#endif
+    for (; i < end; i++) {
+        if (a[i] != b[i]) return i;
+    }
+    return end;
+}
+
+// Finding the first index in [start, end) where a and b agree (end if none)
+uint32_t memdump_first_same(const uint16_t* a, const uint16_t* b, uint32_t start, uint32_t end) {
+    uint32_t i = start;
+#ifdef __SSE2__
+    for (; i + 8 <= end; i += 8) {
+        __m128i eq = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(a + i)),
+                                     _mm_loadu_si128((const __m128i*)(b + i)));
+        int mask = _mm_movemask_epi8(eq);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask) / 2;
+        }
+    }
+#endif
+    for (; i < end; i++) {
+        if (a[i] == b[i]) return i;
+    }
+    return end;
+}
+
+static void memdump_add_range(MemDiff* diff, uint32_t start, uint32_t count) {
+    if (diff->count == diff->capacity) {
+        diff->capacity = diff->capacity ? diff->capacity * 2 : 16;
+        diff->ranges = (MemRange*)realloc(diff->ranges, diff->capacity * sizeof(MemRange));
+    }
+    diff->ranges[diff->count].start = start;
+    diff->ranges[diff->count].count = count;
+    diff->count++;
+    diff->words += count;
+}
+
+// Comparing two snapshots (diff is reset first; ranges storage is reused)
+void memdump_diff(const MemSnapshot* a, const MemSnapshot* b, MemDiff* diff) {
+    diff->count = 0;
+    diff->words = 0;
+    diff->reg_mask = 0;
+    for (int r = 0; r < NUM_REGISTERS; r++) {
+        if (a->registers[r] != b->registers[r]) diff->reg_mask |= 1 << r;
+    }
+    diff->pc_differs = a->pc != b->pc;
+    diff->flags_differ = a->flags != b->flags || a->halted != b->halted;
+    diff->cycles_differ = a->cycles != b->cycles;
+
+    uint32_t addr = 0;
+    while ((addr = memdump_first_diff(a->memory, b->memory, addr, MEM_SIZE)) < MEM_SIZE) {
+        uint32_t end = memdump_first_same(a->memory, b->memory, addr + 1, MEM_SIZE);
+        memdump_add_range(diff, addr, end - addr);
+        addr = end;
+    }
+}
+
+bool memdump_diff_empty(const MemDiff* diff) {
+    return diff->count == 0 && diff->reg_mask == 0 && !diff->pc_differs &&
+           !diff->flags_differ && !diff->cycles_differ;
+}
+
+// Printing a diff report (words: list every differing word)
+void memdump_print_diff(FILE* fp, const MemDiff* diff, const MemSnapshot* a, const MemSnapshot* b,
+                        bool words) {
+    if (memdump_diff_empty(diff)) {
+        fprintf(fp, "States are identical\n");
+        return;
+    }
+
+    for (int r = 0; r < NUM_REGISTERS; r++) {
+        if (diff->reg_mask & (1 << r)) {
+            fprintf(fp, "R%d: 0x%04X -> 0x%04X\n", r, a->registers[r], b->registers[r]);
+        }
+    }
+    if (diff->pc_differs) {
+        fprintf(fp, "PC: 0x%04X -> 0x%04X\n", a->pc, b->pc);
+    }
+    if (diff->flags_differ) {
+        fprintf(fp, "Flags: Z=%d N=%d C=%d V=%d%s -> Z=%d N=%d C=%d V=%d%s\n",
+                a->flags & 1, (a->flags >> 1) & 1, (a->flags >> 2) & 1, (a->flags >> 3) & 1,
+                a->halted ? " (halted)" : "",
+                b->flags & 1, (b->flags >> 1) & 1, (b->flags >> 2) & 1, (b->flags >> 3) & 1,
+                b->halted ? " (halted)" : "");
+    }
+    if (diff->cycles_differ) {
+        fprintf(fp, "Cycles: %llu -> %llu\n", (unsigned long long)a->cycles,
+                (unsigned long long)b->cycles);
+    }
+
+    if (diff->count == 0) return;
+    fprintf(fp, "Memory: %u words differ in %d range%s\n", diff->words, diff->count,
+            diff->count == 1 ? "" : "s");
+    for (int i = 0; i < diff->count; i++) {
+        const MemRange* range = &diff->ranges[i];
+        fprintf(fp, "  0x%04X-0x%04X (%u word%s)\n", range->start, range->start + range->count - 1,
+                range->count, range->count == 1 ? "" : "s");
+        if (!words) continue;
+        for (uint32_t addr = range->start; addr < range->start + range->count; addr++) {
+            fprintf(fp, "    0x%04X: 0x%04X -> 0x%04X\n", addr, a->memory[addr], b->memory[addr]);
+        }
+    }
+}
+
+void memdump_diff_free(MemDiff* diff) {
+    free(diff->ranges);
+    memset(diff, 0, sizeof(MemDiff));
+}
@@ -0,0 +1,68 @@
+#ifndef MEMDUMP_H
+#define MEMDUMP_H
+
+#include "cpu.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Binary machine-state dumps and state diffs.
+//
+// Dump file format (little-endian):
+//   "SC16MDMP"  magic (8 bytes)
+//   u8   version (MEMDUMP_VERSION)
+//   u8   flags   Z | N<<1 | C<<2 | V<<3 | halted<<4
+//   u16  pc
+//   u16  registers[8]
+//   u64  cycles
+//   then ranges of nonzero memory, each:
+//     u32 start, u32 count, u16 words[count]
+//   terminated by a range with count 0
+//
+// Short zero gaps inside a range are kept when they are cheaper than a
+// new range header, so a dump is never larger than the words it covers
+// plus one header per range.
+
+#define MEMDUMP_VERSION 1
+#define MEMDUMP_GAP_WORDS 4     // Zero run that is worth splitting a range
+
+// Complete machine state, with memory flattened
+typedef struct {
+    uint16_t memory[MEM_SIZE];
+    uint16_t registers[NUM_REGISTERS];
+    uint16_t pc;
+    uint8_t flags;
+    bool halted;
+    uint64_t cycles;
+} MemSnapshot;
+
+typedef struct {
+    uint32_t start;
+    uint32_t count;
+} MemRange;
+
+// Result of comparing two snapshots
+typedef struct {
+    MemRange* ranges;
+    int count;
+    int capacity;
+    uint32_t words;             // Total differing words
+    uint16_t reg_mask;          // Bit n: register n differs
+    bool pc_differs;
+    bool flags_differ;
+    bool cycles_differ;
+} MemDiff;
+
+void memdump_capture(const CPU* cpu, MemSnapshot* snap);
+bool memdump_write(const CPU* cpu, const char* filename);
+bool memdump_read(const char* filename, MemSnapshot* snap);
+
+uint32_t memdump_first_diff(const uint16_t* a, const uint16_t* b, uint32_t start, uint32_t end);
+uint32_t memdump_first_same(const uint16_t* a, const uint16_t* b, uint32_t start, uint32_t end);
+void memdump_diff(const MemSnapshot* a, const MemSnapshot* b, MemDiff* diff);
+bool memdump_diff_empty(const MemDiff* diff);
+void memdump_print_diff(FILE* fp, const MemDiff* diff, const MemSnapshot* a, const MemSnapshot* b,
+                        bool words);
+void memdump_diff_free(MemDiff* diff);
+
+#endif // MEMDUMP_H
@@ -0,0 +1,89 @@
+#include "snapshot.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool snapshot_take(Snapshot* snap, const CPU* cpu) {
+    memset(snap, 0, sizeof(Snapshot));
+    memcpy(snap->registers, cpu->registers, sizeof(snap->registers));
+    snap->pc = cpu->pc;
+    snap->ir = cpu->ir;
+    snap->flags = cpu->flags;
+    snap->cycle_count = cpu->cycle_count;
+    snap->bank = cpu->bank;
+
+    for (int page = 0; page < NUM_PAGES; page++) {
+        if (!cpu_page_resident(cpu, (uint16_t)page)) continue;
+        snap->pages[page] = (uint16_t*)malloc(PAGE_WORDS * sizeof(uint16_t));
+        if (!snap->pages[page]) {
+            fprintf(stderr, "Error: Out of memory for snapshot\n");
+            snapshot_free(snap);
+            return false;
+        }
+        memcpy(snap->pages[page], cpu->pages[page], PAGE_WORDS * sizeof(uint16_t));
+        snap->page_count++;
+    }
+    return true;
+}
+
+void snapshot_free(Snapshot* snap) {
+    for (int page = 0; page < NUM_PAGES; page++) {
+        free(snap->pages[page]);
+        snap->pages[page] = NULL;
+    }
+    snap->page_count = 0;
+}
+
+// Rewriting one page from the snapshot. A page that is zero in the
+// snapshot is released, or cleared in place when keep is set (a page a
+// run dirtied once is likely to be dirtied again)
+static void snapshot_put_page(const Snapshot* snap, CPU* cpu, int page, bool keep) {
+    if (!snap->pages[page]) {
+        if (!keep) {
+            cpu_release_page(cpu, (uint16_t)page);
+        } else if (cpu_page_resident(cpu, (uint16_t)page)) {
+            memset(cpu->pages[page], 0, PAGE_WORDS * sizeof(uint16_t));
+        }
+        return;
+    }
+    uint16_t* data = cpu->pages[page];
+    if (data == cpu_zero_page) {
+        data = cpu_page_for_write(cpu, (uint16_t)page);
+    }
+    memcpy(data, snap->pages[page], PAGE_WORDS * sizeof(uint16_t));
+}
+
+static void snapshot_put_registers(const Snapshot* snap, CPU* cpu) {
+    memcpy(cpu->registers, snap->registers, sizeof(cpu->registers));
+    cpu->pc = snap->pc;
+    cpu->ir = snap->ir;
+    cpu->flags = snap->flags;
+    cpu->cycle_count = snap->cycle_count;
+    cpu->halted = false;
+    cpu->faulted = false;
+    cpu_clear_dirty(cpu);
+}
+
+void snapshot_load(const Snapshot* snap, CPU* cpu) {
+    cpu_select_bank(cpu, snap->bank);
+    for (int page = 0; page < NUM_PAGES; page++) {
+        if (snap->pages[page] || cpu_page_resident(cpu, (uint16_t)page)) {
+            snapshot_put_page(snap, cpu, page, false);
+        }
+    }
+    snapshot_put_registers(snap, cpu);
+}
+
+void snapshot_restore(const Snapshot* snap, CPU* cpu) {
+    // Switching back marks the bank window dirty, so it is rewritten too
+    cpu_select_bank(cpu, snap->bank);
+    for (int w = 0; w < NUM_PAGES / 64; w++) {
+        uint64_t bits = cpu->dirty_pages[w];
+        while (bits) {
+            int page = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            snapshot_put_page(snap, cpu, page, true);
+        }
+    }
+    snapshot_put_registers(snap, cpu);
+}
@@ -0,0 +1,38 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "cpu.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Whole-machine snapshots for running many times from one state.
+//
+// snapshot_take copies the registers and every resident page.
+// snapshot_restore rewrites only the pages the CPU dirtied since it was
+// last put into the snapshot state, so resetting after a short run
+// costs a few page copies instead of 128 KB. A snapshot is read-only
+// once taken and may be shared by CPUs on several threads.
+//
+// With a bank store attached, a snapshot holds the selected bank number
+// and the bank window as it shows that bank; other banks are not saved.
+
+typedef struct {
+    uint16_t registers[NUM_REGISTERS];
+    uint16_t pc;
+    uint16_t ir;
+    Flags flags;
+    uint64_t cycle_count;
+    uint16_t bank;                  // Bank selected through MMIO_BANK
+    uint16_t* pages[NUM_PAGES];     // Saved contents (NULL = all zero)
+    uint32_t page_count;
+} Snapshot;
+
+bool snapshot_take(Snapshot* snap, const CPU* cpu);
+void snapshot_free(Snapshot* snap);
+// Putting a CPU into the snapshot state: every page (load) or only the
+// dirty ones, which requires the CPU to have been loaded from this
+// snapshot before. Both clear the dirty bits, halted and faulted.
+void snapshot_load(const Snapshot* snap, CPU* cpu);
+void snapshot_restore(const Snapshot* snap, CPU* cpu);
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,107 @@
+#include "timing.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TIMING_EMPTY 0xFFFFFFFFu
+
+static bool timing_power_of_two(uint32_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+void timing_default_config(TimingConfig* config) {
+    config->sets = TIMING_DEFAULT_SETS;
+    config->ways = TIMING_DEFAULT_WAYS;
+    config->line_words = TIMING_DEFAULT_LINE_WORDS;
+    config->miss_penalty = TIMING_DEFAULT_MISS_PENALTY;
+    config->mispredict_penalty = TIMING_DEFAULT_MISPREDICT_PENALTY;
+}
+
+// Creating a model with an empty cache and weakly not-taken predictors
+bool timing_init(TimingModel* model, const TimingConfig* config) {
+    memset(model, 0, sizeof(TimingModel));
+    if (!timing_power_of_two(config->sets) || !timing_power_of_two(config->line_words) ||
+        config->ways == 0 || config->line_words > MEM_SIZE ||
+        (uint64_t)config->sets * config->ways > MEM_SIZE) {
+        fprintf(stderr, "Error: Cache sets and line words must be powers of two, "
+                "with at most %d lines\n", MEM_SIZE);
+        return false;
+    }
+    model->config = *config;
+    size_t lines = (size_t)config->sets * config->ways;
+    model->tags = (uint32_t*)malloc(lines * sizeof(uint32_t));
+    model->used = (uint64_t*)calloc(lines, sizeof(uint64_t));
+    if (!model->tags || !model->used) {
+        fprintf(stderr, "Error: Out of memory for the cache model\n");
+        timing_free(model);
+        return false;
+    }
+    for (size_t i = 0; i < lines; i++) model->tags[i] = TIMING_EMPTY;
+    memset(model->counters, 1, sizeof(model->counters));
+    return true;
+}
+
+void timing_free(TimingModel* model) {
+    free(model->tags);
+    free(model->used);
+    model->tags = NULL;
+    model->used = NULL;
+}
+
+// Starting a measurement: the cache and predictor keep their contents
+void timing_clear_stats(TimingModel* model) {
+    memset(&model->stats, 0, sizeof(model->stats));
+}
+
+void timing_note_access(TimingModel* model, uint16_t address) {
+    uint32_t line = address / model->config.line_words;
+    uint32_t ways = model->config.ways;
+    uint32_t* tags = &model->tags[(size_t)(line & (model->config.sets - 1)) * ways];
+    uint64_t* used = &model->used[(size_t)(line & (model->config.sets - 1)) * ways];
+    model->stats.accesses++;
+    model->clock++;
+
+    uint32_t victim = 0;
+    for (uint32_t w = 0; w < ways; w++) {
+        if (tags[w] == line) {
+            used[w] = model->clock;
+            return;
+        }
+        if (used[w] < used[victim]) victim = w;
+    }
+    // Missing: filling the least recently used way (never-used ways first)
+    tags[victim] = line;
+    used[victim] = model->clock;
+    model->stats.misses++;
+    model->stats.cycles += model->config.miss_penalty;
+}
+
+void timing_note_step(TimingModel* model, uint16_t pc, uint16_t word, uint16_t next_pc) {
+    model->stats.instructions++;
+    model->stats.cycles++;
+    if ((word >> 12) != OP_BRANCH) return;
+
+    // Conditional branches are two words; not taken falls through
+    bool taken = next_pc != (uint16_t)(pc + 2);
+    uint8_t* counter = &model->counters[pc & (TIMING_PREDICTOR_ENTRIES - 1)];
+    model->stats.branches++;
+    if ((*counter >= 2) != taken) {
+        model->stats.mispredicts++;
+        model->stats.cycles += model->config.mispredict_penalty;
+    }
+    if (taken && *counter < 3) (*counter)++;
+    if (!taken && *counter > 0) (*counter)--;
+}
+
+void timing_print_stats(FILE* out, const TimingStats* stats) {
+    double instructions = stats->instructions ? (double)stats->instructions : 1.0;
+    fprintf(out, "Instructions: %llu, cycles: %llu (CPI %.3f)\n",
+            (unsigned long long)stats->instructions, (unsigned long long)stats->cycles,
+            stats->cycles / instructions);
+    fprintf(out, "Cache: %llu accesses, %llu misses (%.2f%%, %.2f per 1000 instructions)\n",
+            (unsigned long long)stats->accesses, (unsigned long long)stats->misses,
+            stats->accesses ? 100.0 * stats->misses / stats->accesses : 0.0,
+            1000.0 * stats->misses / instructions);
+    fprintf(out, "Branches: %llu conditional, %llu mispredicted (%.2f%%)\n",
+            (unsigned long long)stats->branches, (unsigned long long)stats->mispredicts,
+            stats->branches ? 100.0 * stats->mispredicts / stats->branches : 0.0);
+}
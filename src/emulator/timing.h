@@ -0,0 +1,67 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include "cpu.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Detailed timing model.
+//
+// The functional core charges one cycle per instruction. A timing model
+// attached as cpu->timing adds what an in-order pipeline would lose to
+// a unified set-associative cache (instruction fetches and data, LRU,
+// write-allocate) and to a bimodal predictor for conditional branches:
+// miss_penalty cycles per cache miss and mispredict_penalty cycles per
+// mispredicted branch. Device accesses bypass the cache.
+//
+// The model sees every memory access and every instruction, so a CPU
+// with one attached runs through cpu_step; engines fall back to it.
+// Its contents (cache tags, predictor counters) are warm state: a
+// detailed run started from a snapshot should first run a warm-up
+// stretch and then clear the statistics with timing_clear_stats.
+
+#define TIMING_DEFAULT_SETS 64
+#define TIMING_DEFAULT_WAYS 2
+#define TIMING_DEFAULT_LINE_WORDS 8
+#define TIMING_DEFAULT_MISS_PENALTY 20
+#define TIMING_DEFAULT_MISPREDICT_PENALTY 3
+#define TIMING_PREDICTOR_ENTRIES 1024       // 2-bit counters indexed by branch address
+
+typedef struct {
+    uint32_t sets;                  // Power of two
+    uint32_t ways;
+    uint32_t line_words;            // Power of two
+    uint32_t miss_penalty;
+    uint32_t mispredict_penalty;
+} TimingConfig;
+
+typedef struct {
+    uint64_t instructions;
+    uint64_t cycles;                // Instructions plus penalties
+    uint64_t accesses;              // Cache accesses (fetches, reads, writes)
+    uint64_t misses;
+    uint64_t branches;              // Conditional branches
+    uint64_t mispredicts;
+} TimingStats;
+
+typedef struct TimingModel {
+    TimingConfig config;
+    uint32_t* tags;                 // sets * ways line numbers (TIMING_EMPTY = invalid)
+    uint64_t* used;                 // Last access time of each way (LRU)
+    uint64_t clock;
+    uint8_t counters[TIMING_PREDICTOR_ENTRIES];
+    TimingStats stats;
+} TimingModel;
+
+void timing_default_config(TimingConfig* config);
+bool timing_init(TimingModel* model, const TimingConfig* config);
+void timing_free(TimingModel* model);
+void timing_clear_stats(TimingModel* model);
+// Called by the CPU: every RAM access, and every instruction once it has
+// executed (pc and word as fetched, next_pc where execution continues)
+void timing_note_access(TimingModel* model, uint16_t address);
+void timing_note_step(TimingModel* model, uint16_t pc, uint16_t word, uint16_t next_pc);
+void timing_print_stats(FILE* out, const TimingStats* stats);
+
+#endif // TIMING_H
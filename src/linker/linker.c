@@ -0,0 +1,127 @@
+#include "linker.h"
+#include "../assembler/symtab.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Entering every export into one global table (returns number of errors)
+static int link_collect_exports(LinkInput inputs[], int count, SymbolTable* globals, int** owners) {
+    int errors = 0;
+    uint32_t owner_capacity = 0;
+    for (int i = 0; i < count; i++) {
+        const ObjectFile* object = &inputs[i].object;
+        for (uint32_t s = 0; s < object->symbol_count; s++) {
+            const ObjSymbol* export = &object->symbols[s];
+            if (export->binding != OBJ_SYM_EXPORT) continue;
+
+            Symbol* symbol = symtab_intern(globals, export->name, strlen(export->name));
+            if (symbol->id >= owner_capacity) {
+                owner_capacity = owner_capacity ? owner_capacity * 2 : 256;
+                *owners = (int*)realloc(*owners, owner_capacity * sizeof(int));
+            }
+            if (symbol->defined) {
+                fprintf(stderr, "Error: Symbol '%s' is exported by both %s and %s\n", export->name,
+                        inputs[(*owners)[symbol->id]].name, inputs[i].name);
+                errors++;
+                continue;
+            }
+            symbol->address = (uint16_t)(inputs[i].base + export->value);
+            symbol->defined = true;
+            (*owners)[symbol->id] = i;
+        }
+    }
+    return errors;
+}
+
+// Copying one section into the image and applying its relocations
+static int link_relocate(const LinkInput* input, const SymbolTable* globals, uint16_t* image) {
+    const ObjectFile* object = &input->object;
+    uint16_t* section = image + input->base;
+    memcpy(section, object->code, object->code_size * sizeof(uint16_t));
+
+    int errors = 0;
+    for (uint32_t r = 0; r < object->reloc_count; r++) {
+        const ObjReloc* reloc = &object->relocs[r];
+        if (reloc->symbol == OBJ_RELOC_SECTION) {
+            section[reloc->offset] += input->base;
+            continue;
+        }
+
+        const char* name = object->symbols[reloc->symbol].name;
+        const Symbol* symbol = symtab_lookup(globals, name, strlen(name));
+        if (!symbol || !symbol->defined) {
+            fprintf(stderr, "Error: Undefined symbol '%s' referenced by %s (offset 0x%04X)\n", name,
+                    input->name, reloc->offset);
+            errors++;
+            continue;
+        }
+        section[reloc->offset] += symbol->address;
+    }
+    return errors;
+}
+
+bool link_objects(LinkInput inputs[], int count, uint16_t** image, uint32_t* size, FILE* map) {
+    // Laying sections out back to back
+    uint32_t address = 0;
+    for (int i = 0; i < count; i++) {
+        if (address + inputs[i].object.code_size > 0x10000) {
+            fprintf(stderr, "Error: %s does not fit in memory (starts at 0x%04X, %u words)\n",
+                    inputs[i].name, address, inputs[i].object.code_size);
+            return false;
+        }
+        inputs[i].base = (uint16_t)address;
+        address += inputs[i].object.code_size;
+    }
+
+    SymbolTable globals;
+    symtab_init(&globals);
+    int* owners = NULL;
+    int errors = link_collect_exports(inputs, count, &globals, &owners);
+
+    *size = address;
+    *image = (uint16_t*)calloc(address + 1, sizeof(uint16_t));
+    for (int i = 0; i < count && *image; i++) {
+        errors += link_relocate(&inputs[i], &globals, *image);
+    }
+
+    if (map && errors == 0) {
+        fprintf(map, "Sections:\n");
+        for (int i = 0; i < count; i++) {
+            fprintf(map, "  0x%04X-0x%04X  %s\n", inputs[i].base,
+                    inputs[i].base + inputs[i].object.code_size, inputs[i].name);
+        }
+        fprintf(map, "Symbols:\n");
+        for (uint32_t id = 0; id < globals.count; id++) {
+            const Symbol* symbol = symtab_at(&globals, id);
+            fprintf(map, "  0x%04X  %-24s %s\n", symbol->address, symbol->name, inputs[owners[id]].name);
+        }
+    }
+
+    free(owners);
+    symtab_free(&globals);
+    if (errors > 0) {
+        fprintf(stderr, "Error: %d link error(s)\n", errors);
+        free(*image);
+        *image = NULL;
+        return false;
+    }
+    return *image != NULL;
+}
+
+// Writing a linked image as an executable
+bool link_write_image(const LinkInput inputs[], int count, const uint16_t* image, uint32_t size,
+                      const char* output_file) {
+    Executable exe;
+    exe_init(&exe);
+    exe_add_segment(&exe, 0, image, size);
+    for (int i = 0; i < count; i++) {
+        const ObjectFile* object = &inputs[i].object;
+        for (uint32_t s = 0; s < object->symbol_count; s++) {
+            const ObjSymbol* symbol = &object->symbols[s];
+            if (symbol->binding != OBJ_SYM_EXPORT) continue;
+            exe_add_symbol(&exe, symbol->name, strlen(symbol->name), (uint16_t)(inputs[i].base + symbol->value), 0);
+        }
+    }
+    bool ok = exe_write(&exe, output_file);
+    exe_free(&exe);
+    return ok;
+}
@@ -0,0 +1,28 @@
+#ifndef LINKER_H
+#define LINKER_H
+
+#include "../assembler/object.h"
+#include "../emulator/executable.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Linker: lays object sections out back to back in command-line order
+// (the first at address 0, so it holds the entry point), resolves
+// imported symbols against the other objects' exports and applies
+// relocations, producing a flat image written as a one-segment executable.
+
+typedef struct {
+    const char* name;           // File name, for messages
+    ObjectFile object;
+    uint16_t base;              // Load address, set by link_objects
+} LinkInput;
+
+// Linking inputs into a freshly allocated image of *size words. A layout
+// map of sections and exported symbols goes to map when non-NULL.
+bool link_objects(LinkInput inputs[], int count, uint16_t** image, uint32_t* size, FILE* map);
+// Writing the image as an executable (entry 0) listing every exported symbol
+bool link_write_image(const LinkInput inputs[], int count, const uint16_t* image, uint32_t size,
+                      const char* output_file);
+
+#endif // LINKER_H
@@ -0,0 +1,65 @@
+#include "linker.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void print_usage(const char* program_name) {
+    printf("SimpleCPU16 Linker\n");
+    printf("Usage: %s <a.o> [b.o ...] -o <output.bin> [options]\n", program_name);
+    printf("Objects are placed in order; the first starts at address 0.\n");
+    printf("Options:\n");
+    printf("  -o <output>   Output binary file\n");
+    printf("  --map         Print section addresses and exported symbols\n");
+    printf("  --help        Show this help message\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* output_file = NULL;
+    bool map = false;
+    LinkInput* inputs = (LinkInput*)calloc(argc, sizeof(LinkInput));
+    int count = 0;
+
+    // Parsing command-line arguments
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output_file = argv[++i];
+        } else if (strcmp(argv[i], "--map") == 0) {
+            map = true;
+        } else if (strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            free(inputs);
+            return 0;
+        } else {
+            inputs[count++].name = argv[i];
+        }
+    }
+
+    if (count == 0 || !output_file) {
+        fprintf(stderr, "Error: Object files and an output file are required\n");
+        print_usage(argv[0]);
+        free(inputs);
+        return 1;
+    }
+
+    bool ok = true;
+    for (int i = 0; i < count && ok; i++) {
+        ok = object_read(inputs[i].name, &inputs[i].object);
+    }
+
+    uint16_t* image = NULL;
+    uint32_t size = 0;
+    if (ok) {
+        ok = link_objects(inputs, count, &image, &size, map ? stdout : NULL) &&
+             link_write_image(inputs, count, image, size, output_file);
+    }
+    if (ok) {
+        printf("Linked %d object(s): %u words written to %s\n", count, size, output_file);
+    }
+
+    free(image);
+    for (int i = 0; i < count; i++) {
+        object_free(&inputs[i].object);
+    }
+    free(inputs);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "server.h"
+#include "../emulator/executable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+void print_usage(const char* program_name) {
+    printf("SimpleCPU16 Emulator Server\n");
+    printf("Usage: %s [options]                      Serve requests on stdin/stdout\n", program_name);
+    printf("       %s --socket PATH [options]        Serve requests on a Unix socket\n", program_name);
+    printf("       %s --connect PATH <binary_file>   Send jobs to a running server\n", program_name);
+    printf("Server options:\n");
+    printf("  --pool N        Warm CPU instances (default %d)\n", SERVER_DEFAULT_POOL);
+    printf("  --images N      Cached program images (default %d)\n", SERVER_DEFAULT_IMAGES);
+    printf("Client options:\n");
+    printf("  --input TEXT    Guest input bytes for MMIO_CHAR_IN\n");
+    printf("  --cycles N      Cycle budget per job\n");
+    printf("  --repeat N      Send the job N times and report latency\n");
+    printf("  --quit          Ask the server to shut down afterwards\n");
+    printf("  --help          Show this help message\n");
+}
+
+static double client_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static bool client_io(int fd, const void* out, size_t out_len, void* in, size_t in_len) {
+    const uint8_t* p = (const uint8_t*)out;
+    while (out_len > 0) {
+        ssize_t n = write(fd, p, out_len);
+        if (n <= 0) return false;
+        p += n;
+        out_len -= (size_t)n;
+    }
+    uint8_t* q = (uint8_t*)in;
+    while (in_len > 0) {
+        ssize_t n = read(fd, q, in_len);
+        if (n <= 0) return false;
+        q += n;
+        in_len -= (size_t)n;
+    }
+    return true;
+}
+
+// Sending one request and receiving the response (output into *output)
+static bool client_request(int fd, const ServerRequest* req, const void* payload, size_t payload_len,
+                           ServerResponse* resp, char** output) {
+    uint8_t header[SERVER_REQUEST_SIZE];
+    uint8_t reply[SERVER_RESPONSE_SIZE];
+    server_encode_request(req, header);
+    if (!client_io(fd, header, sizeof(header), NULL, 0) ||
+        !client_io(fd, payload, payload_len, reply, sizeof(reply)) ||
+        !server_decode_response(reply, resp)) {
+        return false;
+    }
+    *output = (char*)realloc(*output, resp->output_bytes + 1);
+    if (!client_io(fd, NULL, 0, *output, resp->output_bytes)) return false;
+    (*output)[resp->output_bytes] = '\0';
+    return true;
+}
+
+// Client mode: load the image once, then run it repeatedly
+static int run_client(const char* socket_path, const char* binary_file, const char* input,
+                      uint64_t cycles, int repeat, bool quit) {
+    // Flattening the executable: jobs always start at address 0
+    Executable exe;
+    if (!exe_read(binary_file, &exe)) {
+        return 1;
+    }
+    if (exe.entry != 0) {
+        fprintf(stderr, "Error: %s has entry point 0x%04X; the server starts jobs at 0x0000\n",
+                binary_file, exe.entry);
+        exe_free(&exe);
+        return 1;
+    }
+    uint32_t word_count = exe_extent(&exe);
+    uint16_t* program = (uint16_t*)malloc((word_count ? word_count : 1) * sizeof(uint16_t));
+    exe_flatten(&exe, program);
+    exe_free(&exe);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "Error: Cannot connect to %s\n", socket_path);
+        free(program);
+        return 1;
+    }
+
+    ServerRequest req;
+    ServerResponse resp;
+    char* output = NULL;
+    memset(&req, 0, sizeof(req));
+    req.magic = SERVER_MAGIC;
+    req.type = SRV_REQ_LOAD;
+    req.image_id = 1;
+    req.image_words = word_count;
+    bool ok = client_request(fd, &req, program, word_count * sizeof(uint16_t), &resp, &output) &&
+              resp.status == SRV_OK;
+
+    size_t input_len = input ? strlen(input) : 0;
+    double total_us = 0, server_us = 0;
+    for (int i = 0; ok && i < repeat; i++) {
+        req.type = SRV_REQ_RUN;
+        req.image_words = 0;
+        req.input_bytes = (uint32_t)input_len;
+        req.cycle_budget = cycles;
+        double start = client_now_us();
+        ok = client_request(fd, &req, input, input_len, &resp, &output) && resp.status == SRV_OK;
+        total_us += client_now_us() - start;
+        server_us += resp.elapsed_us;
+        if (ok && i == 0) {
+            printf("%s", output);
+            printf("\nStop: %d  PC: 0x%04X  Cycles: %llu\n", resp.stop_kind, resp.pc,
+                   (unsigned long long)resp.cycles);
+            for (int r = 0; r < NUM_REGISTERS; r++) {
+                printf("R%d: 0x%04X (%d)\n", r, resp.registers[r], resp.registers[r]);
+            }
+        }
+    }
+
+    if (!ok) {
+        fprintf(stderr, "Error: Request failed (status %d)\n", resp.status);
+    } else if (repeat > 0) {
+        printf("\n%d jobs: %.2f us/job round trip, %.2f us/job in server\n",
+               repeat, total_us / repeat, server_us / repeat);
+    }
+
+    if (quit) {
+        memset(&req, 0, sizeof(req));
+        req.magic = SERVER_MAGIC;
+        req.type = SRV_REQ_QUIT;
+        client_request(fd, &req, NULL, 0, &resp, &output);
+    }
+
+    close(fd);
+    free(output);
+    free(program);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    const char* socket_path = NULL;
+    const char* connect_path = NULL;
+    const char* binary_file = NULL;
+    const char* input = NULL;
+    uint64_t cycles = 0;
+    int repeat = 1;
+    int pool = SERVER_DEFAULT_POOL;
+    int images = SERVER_DEFAULT_IMAGES;
+    bool quit = false;
+
+    // Parsing command-line arguments
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+            connect_path = argv[++i];
+        } else if (strcmp(argv[i], "--pool") == 0 && i + 1 < argc) {
+            pool = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--images") == 0 && i + 1 < argc) {
+            images = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input = argv[++i];
+        } else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            cycles = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--quit") == 0) {
+            quit = true;
+        } else if (strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (binary_file == NULL) {
+            binary_file = argv[i];
+        }
+    }
+
+    if (connect_path) {
+        if (!binary_file) {
+            fprintf(stderr, "Error: No binary file specified\n");
+            print_usage(argv[0]);
+            return 1;
+        }
+        return run_client(connect_path, binary_file, input, cycles, repeat, quit);
+    }
+
+    Server server;
+    if (!server_init(&server, pool, images)) return 1;
+
+    bool ok = true;
+    if (socket_path) {
+        ok = server_listen(&server, socket_path);
+    } else {
+        server_serve_fd(&server, STDIN_FILENO, STDOUT_FILENO);
+    }
+
+    server_free(&server);
+    return ok ? 0 : 1;
+}
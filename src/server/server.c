@@ -0,0 +1,422 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "server.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define SERVER_MAX_INPUT (16u * 1024 * 1024)
+
+// Little-endian field helpers
+static void put_u16(uint8_t* p, uint16_t v) { p[0] = v & 0xFF; p[1] = v >> 8; }
+static void put_u32(uint8_t* p, uint32_t v) { put_u16(p, v & 0xFFFF); put_u16(p + 2, v >> 16); }
+static void put_u64(uint8_t* p, uint64_t v) { put_u32(p, (uint32_t)v); put_u32(p + 4, (uint32_t)(v >> 32)); }
+static uint16_t get_u16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t get_u32(const uint8_t* p) { return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16); }
+static uint64_t get_u64(const uint8_t* p) { return get_u32(p) | ((uint64_t)get_u32(p + 4) << 32); }
+
+static uint64_t server_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+
+// Reading exactly len bytes (false on EOF or error)
+static bool read_full(int fd, void* buf, size_t len) {
+    uint8_t* p = (uint8_t*)buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool write_full(int fd, const void* buf, size_t len) {
+    const uint8_t* p = (const uint8_t*)buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// Serializing request header
+void server_encode_request(const ServerRequest* req, uint8_t* buf) {
+    memset(buf, 0, SERVER_REQUEST_SIZE);
+    put_u32(buf, req->magic);
+    buf[4] = req->type;
+    put_u32(buf + 8, req->image_id);
+    put_u32(buf + 12, req->image_words);
+    put_u32(buf + 16, req->input_bytes);
+    put_u64(buf + 20, req->cycle_budget);
+}
+
+static void server_decode_request(const uint8_t* buf, ServerRequest* req) {
+    req->magic = get_u32(buf);
+    req->type = buf[4];
+    req->image_id = get_u32(buf + 8);
+    req->image_words = get_u32(buf + 12);
+    req->input_bytes = get_u32(buf + 16);
+    req->cycle_budget = get_u64(buf + 20);
+}
+
+static void server_encode_response(const ServerResponse* resp, uint8_t* buf) {
+    memset(buf, 0, SERVER_RESPONSE_SIZE);
+    put_u32(buf, SERVER_MAGIC);
+    buf[4] = resp->status;
+    buf[5] = resp->stop_kind;
+    buf[6] = resp->flags;
+    for (int i = 0; i < NUM_REGISTERS; i++) {
+        put_u16(buf + 8 + i * 2, resp->registers[i]);
+    }
+    put_u16(buf + 24, resp->pc);
+    put_u64(buf + 28, resp->cycles);
+    put_u32(buf + 36, resp->output_bytes);
+    put_u32(buf + 40, resp->elapsed_us);
+}
+
+// Parsing response header (false if the magic is wrong)
+bool server_decode_response(const uint8_t* buf, ServerResponse* resp) {
+    if (get_u32(buf) != SERVER_MAGIC) return false;
+    resp->status = buf[4];
+    resp->stop_kind = buf[5];
+    resp->flags = buf[6];
+    for (int i = 0; i < NUM_REGISTERS; i++) {
+        resp->registers[i] = get_u16(buf + 8 + i * 2);
+    }
+    resp->pc = get_u16(buf + 24);
+    resp->cycles = get_u64(buf + 28);
+    resp->output_bytes = get_u32(buf + 36);
+    resp->elapsed_us = get_u32(buf + 40);
+    return true;
+}
+
+// Creating the warm CPU pool and image cache
+bool server_init(Server* server, int pool_size, int max_images) {
+    memset(server, 0, sizeof(Server));
+    server->slot_count = pool_size > 0 ? pool_size : SERVER_DEFAULT_POOL;
+    server->max_images = max_images > 0 ? max_images : SERVER_DEFAULT_IMAGES;
+    server->slots = (ServerSlot*)calloc(server->slot_count, sizeof(ServerSlot));
+    server->images = (ServerImage*)calloc(server->max_images, sizeof(ServerImage));
+    if (!server->slots || !server->images) {
+        fprintf(stderr, "Error: Cannot allocate server state\n");
+        return false;
+    }
+
+    for (int i = 0; i < server->slot_count; i++) {
+        server->slots[i].cpu = (CPU*)malloc(sizeof(CPU));
+        if (!server->slots[i].cpu) {
+            fprintf(stderr, "Error: Cannot allocate CPU pool\n");
+            return false;
+        }
+        cpu_init(server->slots[i].cpu);
+        server->slots[i].cpu->output = &server->output;
+    }
+    return true;
+}
+
+// Releasing pool, images and output buffer
+void server_free(Server* server) {
+    for (int i = 0; i < server->slot_count; i++) {
+        if (server->slots[i].cpu) cpu_free(server->slots[i].cpu);
+        free(server->slots[i].cpu);
+    }
+    for (int i = 0; i < server->image_count; i++) {
+        free(server->images[i].words);
+    }
+    free(server->slots);
+    free(server->images);
+    free(server->output.data);
+    memset(server, 0, sizeof(Server));
+}
+
+static ServerImage* server_find_image(Server* server, uint32_t id) {
+    for (int i = 0; i < server->image_count; i++) {
+        if (server->images[i].id == id) return &server->images[i];
+    }
+    return NULL;
+}
+
+// Forgetting any warm slot that holds image contents about to change
+static void server_invalidate_slots(Server* server, const ServerImage* image) {
+    for (int i = 0; i < server->slot_count; i++) {
+        if (server->slots[i].image == image) server->slots[i].image = NULL;
+    }
+}
+
+// Storing image under id, replacing or evicting (LRU) as needed
+ServerImage* server_load_image(Server* server, uint32_t id, const uint16_t* words, uint32_t size) {
+    if (size > MEM_SIZE) return NULL;
+
+    ServerImage* image = server_find_image(server, id);
+    if (!image) {
+        if (server->image_count < server->max_images) {
+            image = &server->images[server->image_count++];
+        } else {
+            image = &server->images[0];
+            for (int i = 1; i < server->image_count; i++) {
+                if (server->images[i].last_used < image->last_used) image = &server->images[i];
+            }
+        }
+    }
+
+    server_invalidate_slots(server, image);
+    free(image->words);
+    image->id = id;
+    image->size = size;
+    image->words = (uint16_t*)malloc((size ? size : 1) * sizeof(uint16_t));
+    memcpy(image->words, words, size * sizeof(uint16_t));
+    memset(image->pages, 0, sizeof(image->pages));
+    for (uint32_t page = 0; page * PAGE_WORDS < size; page++) {
+        image->pages[page >> 6] |= 1ULL << (page & 63);
+    }
+    image->last_used = ++server->clock;
+    return image;
+}
+
+// Picking the slot that already holds image, else the least recently used
+static ServerSlot* server_acquire(Server* server, const ServerImage* image, bool* warm) {
+    ServerSlot* lru = &server->slots[0];
+    for (int i = 0; i < server->slot_count; i++) {
+        ServerSlot* slot = &server->slots[i];
+        if (slot->image == image) {
+            *warm = true;
+            return slot;
+        }
+        if (slot->last_used < lru->last_used) lru = slot;
+    }
+    *warm = false;
+    return lru;
+}
+
+// Restoring slot memory to the pristine image, touching only needed pages
+static void server_prepare(ServerSlot* slot, const ServerImage* image, bool warm) {
+    CPU* cpu = slot->cpu;
+    uint64_t fix[NUM_PAGES / 64];
+
+    for (int w = 0; w < NUM_PAGES / 64; w++) {
+        // Warm: only pages the last job wrote differ from the image
+        fix[w] = warm ? cpu->dirty_pages[w] : (slot->touched[w] | image->pages[w]);
+    }
+
+    for (int w = 0; w < NUM_PAGES / 64; w++) {
+        uint64_t bits = fix[w];
+        while (bits) {
+            int page = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            uint32_t start = (uint32_t)page << PAGE_SHIFT;
+            uint32_t avail = image->size > start ? image->size - start : 0;
+            if (avail > PAGE_WORDS) avail = PAGE_WORDS;
+            if (avail == 0) {
+                // Outside the image: back to the shared zero page
+                cpu_release_page(cpu, (uint16_t)page);
+                continue;
+            }
+            uint16_t* data = cpu_page_for_write(cpu, (uint16_t)page);
+            memcpy(data, &image->words[start], avail * sizeof(uint16_t));
+            memset(data + avail, 0, (PAGE_WORDS - avail) * sizeof(uint16_t));
+        }
+    }
+
+    memcpy(slot->touched, image->pages, sizeof(slot->touched));
+    slot->image = image;
+    cpu_clear_dirty(cpu);
+    cpu_reset(cpu);
+}
+
+// Running one job on a warm CPU
+void server_run(Server* server, ServerImage* image, const uint8_t* input, size_t input_size,
+                uint64_t cycle_budget, ServerResponse* response) {
+    bool warm;
+    ServerSlot* slot = server_acquire(server, image, &warm);
+    server_prepare(slot, image, warm);
+    slot->last_used = ++server->clock;
+    image->last_used = server->clock;
+
+    CPU* cpu = slot->cpu;
+    cpu_set_input(cpu, input, input_size);
+    server->output.size = 0;
+
+    StopReason reason = cpu_run_bounded(cpu, cycle_budget ? cycle_budget : CPU_DEFAULT_CYCLE_LIMIT, false);
+
+    for (int w = 0; w < NUM_PAGES / 64; w++) {
+        slot->touched[w] |= cpu->dirty_pages[w];
+    }
+    cpu_set_input(cpu, NULL, 0);
+
+    response->status = SRV_OK;
+    response->stop_kind = (uint8_t)reason.kind;
+    response->flags = (uint8_t)(cpu->flags.Z | (cpu->flags.N << 1) | (cpu->flags.C << 2) | (cpu->flags.V << 3));
+    memcpy(response->registers, cpu->registers, sizeof(response->registers));
+    response->pc = cpu->pc;
+    response->cycles = cpu->cycle_count;
+    response->output_bytes = (uint32_t)server->output.size;
+
+    server->warm_hits += warm;
+    server->total_cycles += cpu->cycle_count;
+}
+
+// Formatting statistics into the output buffer
+static void server_stats(Server* server) {
+    char text[512];
+    unsigned resident = 0;
+    for (int i = 0; i < server->slot_count; i++) {
+        resident += server->slots[i].cpu->resident_pages;
+    }
+    int len = snprintf(text, sizeof(text),
+                       "requests %llu\nwarm_hits %llu\nimages %d\npool %d\nresident_pages %u\n"
+                       "total_cycles %llu\navg_us %.2f\n",
+                       (unsigned long long)server->requests, (unsigned long long)server->warm_hits,
+                       server->image_count, server->slot_count, resident,
+                       (unsigned long long)server->total_cycles,
+                       server->requests ? (double)server->total_us / server->requests : 0.0);
+    if (server->output.capacity < (size_t)len) {
+        server->output.data = (char*)realloc(server->output.data, len);
+        server->output.capacity = len;
+    }
+    memcpy(server->output.data, text, len);
+    server->output.size = len;
+}
+
+// FNV-1a hash identifying inline images
+static uint32_t server_hash_words(const uint16_t* words, uint32_t size) {
+    uint32_t hash = 2166136261u;
+    const uint8_t* bytes = (const uint8_t*)words;
+    for (size_t i = 0; i < (size_t)size * sizeof(uint16_t); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash | 0x80000000u;
+}
+
+// Serving framed requests until EOF or QUIT (returns false on QUIT)
+bool server_serve_fd(Server* server, int in_fd, int out_fd) {
+    uint8_t header[SERVER_REQUEST_SIZE];
+    uint8_t reply[SERVER_RESPONSE_SIZE];
+    uint16_t* words = (uint16_t*)malloc(MEM_SIZE * sizeof(uint16_t));
+    uint8_t* input = NULL;
+    size_t input_capacity = 0;
+    bool keep_running = true;
+
+    while (read_full(in_fd, header, sizeof(header))) {
+        uint64_t start = server_now_us();
+        ServerRequest req;
+        ServerResponse resp;
+        memset(&resp, 0, sizeof(resp));
+        server_decode_request(header, &req);
+
+        if (req.magic != SERVER_MAGIC || req.image_words > MEM_SIZE || req.input_bytes > SERVER_MAX_INPUT) {
+            // Framing is lost; report and drop the connection
+            resp.status = req.magic != SERVER_MAGIC ? SRV_ERR_PROTOCOL : SRV_ERR_TOO_LARGE;
+            server_encode_response(&resp, reply);
+            write_full(out_fd, reply, sizeof(reply));
+            break;
+        }
+
+        if (req.image_words && !read_full(in_fd, words, req.image_words * sizeof(uint16_t))) break;
+        if (req.input_bytes > input_capacity) {
+            input_capacity = req.input_bytes;
+            input = (uint8_t*)realloc(input, input_capacity);
+        }
+        if (req.input_bytes && !read_full(in_fd, input, req.input_bytes)) break;
+
+        server->output.size = 0;
+        if (req.type == SRV_REQ_LOAD) {
+            resp.status = server_load_image(server, req.image_id, words, req.image_words) ?
+                          SRV_OK : SRV_ERR_TOO_LARGE;
+        } else if (req.type == SRV_REQ_RUN) {
+            ServerImage* image;
+            if (req.image_words) {
+                uint32_t id = req.image_id ? req.image_id : server_hash_words(words, req.image_words);
+                image = server_find_image(server, id);
+                if (!image || image->size != req.image_words ||
+                    memcmp(image->words, words, req.image_words * sizeof(uint16_t)) != 0) {
+                    image = server_load_image(server, id, words, req.image_words);
+                }
+            } else {
+                image = server_find_image(server, req.image_id);
+            }
+
+            if (image) {
+                server_run(server, image, input, req.input_bytes, req.cycle_budget, &resp);
+            } else {
+                resp.status = SRV_ERR_NO_IMAGE;
+            }
+        } else if (req.type == SRV_REQ_STATS) {
+            server_stats(server);
+        } else if (req.type == SRV_REQ_QUIT) {
+            keep_running = false;
+        } else {
+            resp.status = SRV_ERR_PROTOCOL;
+        }
+
+        uint64_t elapsed = server_now_us() - start;
+        server->requests++;
+        server->total_us += elapsed;
+        resp.elapsed_us = (uint32_t)elapsed;
+        resp.output_bytes = (uint32_t)server->output.size;
+
+        server_encode_response(&resp, reply);
+        if (!write_full(out_fd, reply, sizeof(reply)) ||
+            !write_full(out_fd, server->output.data, server->output.size)) {
+            break;
+        }
+        if (!keep_running) break;
+    }
+
+    free(words);
+    free(input);
+    return keep_running;
+}
+
+// Accepting connections on a Unix domain socket until QUIT
+bool server_listen(Server* server, const char* socket_path) {
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        fprintf(stderr, "Error: Cannot create socket: %s\n", strerror(errno));
+        return false;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: Socket path too long: %s\n", socket_path);
+        close(listen_fd);
+        return false;
+    }
+    strcpy(addr.sun_path, socket_path);
+    unlink(socket_path);
+
+    if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, 16) < 0) {
+        fprintf(stderr, "Error: Cannot listen on %s: %s\n", socket_path, strerror(errno));
+        close(listen_fd);
+        return false;
+    }
+
+    fprintf(stderr, "Listening on %s\n", socket_path);
+    bool running = true;
+    while (running) {
+        int conn = accept(listen_fd, NULL, NULL);
+        if (conn < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        running = server_serve_fd(server, conn, conn);
+        close(conn);
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+    return true;
+}
@@ -0,0 +1,126 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "../emulator/cpu.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Persistent emulator server.
+//
+// A long-lived process that runs short guest jobs without paying for
+// process creation, binary loading and cpu_init on every run. Program
+// images are cached by ID and a pool of warm CPU instances is kept;
+// resetting a CPU that last ran the same image only restores the pages
+// the previous job dirtied.
+//
+// Wire protocol (little-endian, over stdin/stdout or a Unix socket):
+//
+// Request header (32 bytes):
+//   u32 magic        SERVER_MAGIC
+//   u8  type         SRV_REQ_*
+//   u8  reserved[3]
+//   u32 image_id     Cached image to run, or ID to store a LOAD under
+//   u32 image_words  Words of inline image following the header
+//   u32 input_bytes  Guest MMIO_CHAR_IN bytes following the image
+//   u64 cycle_budget 0 = CPU_DEFAULT_CYCLE_LIMIT
+//   u32 reserved
+//
+// A RUN with image_words > 0 runs the inline image (it is also cached
+// under image_id when that is nonzero); otherwise image_id must name a
+// previously loaded image.
+//
+// Response header (44 bytes), followed by output_bytes of guest output:
+//   u32 magic        SERVER_MAGIC
+//   u8  status       SRV_OK or SRV_ERR_*
+//   u8  stop_kind    StopKind of the run
+//   u8  flags        Z | N<<1 | C<<2 | V<<3
+//   u8  reserved
+//   u16 registers[8]
+//   u16 pc
+//   u16 reserved
+//   u64 cycles
+//   u32 output_bytes
+//   u32 elapsed_us   Server-side time spent on the request
+
+#define SERVER_MAGIC 0x36314353u        // "SC16"
+#define SERVER_REQUEST_SIZE 32
+#define SERVER_RESPONSE_SIZE 44
+
+#define SRV_REQ_LOAD  1     // Cache image under image_id
+#define SRV_REQ_RUN   2     // Run cached or inline image
+#define SRV_REQ_STATS 3     // Server statistics as text output
+#define SRV_REQ_QUIT  4     // Shut the server down
+
+#define SRV_OK            0
+#define SRV_ERR_PROTOCOL  1
+#define SRV_ERR_NO_IMAGE  2
+#define SRV_ERR_TOO_LARGE 3
+
+#define SERVER_DEFAULT_POOL   8
+#define SERVER_DEFAULT_IMAGES 256
+
+typedef struct {
+    uint32_t magic;
+    uint8_t type;
+    uint32_t image_id;
+    uint32_t image_words;
+    uint32_t input_bytes;
+    uint64_t cycle_budget;
+} ServerRequest;
+
+typedef struct {
+    uint8_t status;
+    uint8_t stop_kind;
+    uint8_t flags;
+    uint16_t registers[NUM_REGISTERS];
+    uint16_t pc;
+    uint64_t cycles;
+    uint32_t output_bytes;
+    uint32_t elapsed_us;
+} ServerResponse;
+
+// Cached program image
+typedef struct {
+    uint32_t id;
+    uint16_t* words;                    // Loaded at address 0x0000
+    uint32_t size;
+    uint64_t pages[NUM_PAGES / 64];     // Pages covered by the image
+    uint64_t last_used;
+} ServerImage;
+
+// Warm CPU instance
+typedef struct {
+    CPU* cpu;
+    const ServerImage* image;           // Image currently in memory
+    uint64_t touched[NUM_PAGES / 64];   // Pages that may be nonzero
+    uint64_t last_used;
+} ServerSlot;
+
+typedef struct {
+    ServerImage* images;
+    int image_count;
+    int max_images;
+    ServerSlot* slots;
+    int slot_count;
+    uint64_t clock;                     // LRU clock
+    OutputBuffer output;
+    // Statistics
+    uint64_t requests;
+    uint64_t warm_hits;
+    uint64_t total_us;
+    uint64_t total_cycles;
+} Server;
+
+bool server_init(Server* server, int pool_size, int max_images);
+void server_free(Server* server);
+ServerImage* server_load_image(Server* server, uint32_t id, const uint16_t* words, uint32_t size);
+void server_run(Server* server, ServerImage* image, const uint8_t* input, size_t input_size,
+                uint64_t cycle_budget, ServerResponse* response);
+bool server_serve_fd(Server* server, int in_fd, int out_fd);
+bool server_listen(Server* server, const char* socket_path);
+
+void server_encode_request(const ServerRequest* req, uint8_t* buf);
+bool server_decode_response(const uint8_t* buf, ServerResponse* resp);
+
+#endif // SERVER_H
@@ -0,0 +1,228 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../assembler/assembler.h"
+#include "../linker/linker.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+// Build driver: assembles each source into a relocatable object in its
+// own process (up to -j at a time), skipping sources whose object is
+// newer than the source, then links the objects in command-line order.
+
+void print_usage(const char* program_name) {
+    printf("SimpleCPU16 Build Driver\n");
+    printf("Usage: %s <a.asm> [b.asm ...] [options]\n", program_name);
+    printf("Assembles changed sources in parallel, then links them in order.\n");
+    printf("Options:\n");
+    printf("  -o <output>   Link the objects into this binary\n");
+    printf("  -d <dir>      Directory for objects (default: next to each source)\n");
+    printf("  -j <jobs>     Parallel assembler processes (default: one per core)\n");
+    printf("  -B            Reassemble every source, even if up to date\n");
+    printf("  --map         Print the link map\n");
+    printf("  --help        Show this help message\n");
+}
+
+static double asmbuild_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// Deriving the object path: <dir>/<name>.o or the source path with .o
+static char* asmbuild_object_path(const char* source, const char* dir) {
+    const char* base = strrchr(source, '/');
+    base = base ? base + 1 : source;
+    const char* dot = strrchr(base, '.');
+    size_t stem = dot && dot != base ? (size_t)(dot - source) : strlen(source);
+    size_t skip = dir ? (size_t)(base - source) : 0;
+
+    size_t dir_len = dir ? strlen(dir) + 1 : 0;
+    char* path = (char*)malloc(dir_len + stem - skip + 3);
+    if (dir) {
+        sprintf(path, "%s/", dir);
+    }
+    memcpy(path + dir_len, source + skip, stem - skip);
+    strcpy(path + dir_len + stem - skip, ".o");
+    return path;
+}
+
+// Checking whether the object is missing or older than its source
+static bool asmbuild_is_stale(const char* source, const char* object) {
+    struct stat src, obj;
+    if (stat(object, &obj) != 0 || stat(source, &src) != 0) return true;
+    if (src.st_mtim.tv_sec != obj.st_mtim.tv_sec) return src.st_mtim.tv_sec > obj.st_mtim.tv_sec;
+    return src.st_mtim.tv_nsec > obj.st_mtim.tv_nsec;
+}
+
+// Assembling one source in a child process (returns exit status)
+static int asmbuild_assemble(const char* source, const char* object) {
+    FILE* quiet = fopen("/dev/null", "w");
+    Assembler asm_state;
+    asm_init(&asm_state);
+    asm_state.relocatable = true;
+    asm_state.info = quiet ? quiet : stderr;
+
+    bool ok = asm_assemble_file(&asm_state, source, object);
+    asm_free(&asm_state);
+    if (!ok) {
+        remove(object);
+    }
+    if (quiet) fclose(quiet);
+    fflush(stderr);
+    return ok ? 0 : 1;
+}
+
+// Running stale sources through the assembler, at most jobs at a time
+// (returns number of failures; no new jobs start after one fails)
+static int asmbuild_run(char* sources[], char* objects[], const bool stale[], int count, int jobs) {
+    pid_t* pids = (pid_t*)calloc(count, sizeof(pid_t));
+    int next = 0, running = 0, failed = 0;
+
+    while (next < count || running > 0) {
+        while (running < jobs && next < count && failed == 0) {
+            int i = next++;
+            if (!stale[i]) continue;
+            printf("  AS  %s -> %s\n", sources[i], objects[i]);
+            fflush(stdout);
+
+            pid_t pid = fork();
+            if (pid < 0) {
+                fprintf(stderr, "Error: Cannot start a process for %s\n", sources[i]);
+                failed++;
+                break;
+            }
+            if (pid == 0) {
+                _exit(asmbuild_assemble(sources[i], objects[i]));
+            }
+            pids[i] = pid;
+            running++;
+        }
+        if (running == 0) break;
+
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0) break;
+        running--;
+        for (int i = 0; i < count; i++) {
+            if (pids[i] != pid) continue;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                fprintf(stderr, "Error: Assembling %s failed\n", sources[i]);
+                failed++;
+            }
+            break;
+        }
+        if (failed > 0) next = count;
+    }
+
+    free(pids);
+    return failed;
+}
+
+// Linking the objects in order into an executable
+static bool asmbuild_link(char* objects[], int count, const char* output_file, bool map) {
+    LinkInput* inputs = (LinkInput*)calloc(count, sizeof(LinkInput));
+    bool ok = true;
+    for (int i = 0; i < count && ok; i++) {
+        inputs[i].name = objects[i];
+        ok = object_read(objects[i], &inputs[i].object);
+    }
+
+    uint16_t* image = NULL;
+    uint32_t size = 0;
+    if (ok) {
+        printf("  LD  %s\n", output_file);
+        ok = link_objects(inputs, count, &image, &size, map ? stdout : NULL) &&
+             link_write_image(inputs, count, image, size, output_file);
+    }
+    if (ok) {
+        printf("Linked %d object(s): %u words written to %s\n", count, size, output_file);
+    }
+
+    free(image);
+    for (int i = 0; i < count; i++) {
+        object_free(&inputs[i].object);
+    }
+    free(inputs);
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    const char* output_file = NULL;
+    const char* object_dir = NULL;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    bool force = false;
+    bool map = false;
+    char** sources = (char**)calloc(argc, sizeof(char*));
+    int count = 0;
+
+    // Parsing command-line arguments
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output_file = argv[++i];
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            object_dir = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-B") == 0) {
+            force = true;
+        } else if (strcmp(argv[i], "--map") == 0) {
+            map = true;
+        } else if (strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            free(sources);
+            return 0;
+        } else {
+            sources[count++] = argv[i];
+        }
+    }
+
+    if (count == 0) {
+        fprintf(stderr, "Error: No source files given\n");
+        print_usage(argv[0]);
+        free(sources);
+        return 1;
+    }
+    if (jobs < 1) jobs = 1;
+
+    char** objects = (char**)calloc(count, sizeof(char*));
+    bool* stale = (bool*)calloc(count, sizeof(bool));
+    int rebuild = 0;
+    bool ok = true;
+    for (int i = 0; i < count; i++) {
+        objects[i] = asmbuild_object_path(sources[i], object_dir);
+        for (int j = 0; j < i; j++) {
+            if (strcmp(objects[i], objects[j]) == 0) {
+                fprintf(stderr, "Error: %s and %s both build %s\n", sources[j], sources[i], objects[i]);
+                ok = false;
+            }
+        }
+        stale[i] = force || asmbuild_is_stale(sources[i], objects[i]);
+        if (stale[i]) rebuild++;
+    }
+
+    double start = asmbuild_now_ms();
+    if (ok) {
+        ok = asmbuild_run(sources, objects, stale, count, (int)jobs) == 0;
+    }
+    if (ok) {
+        printf("Assembled %d of %d source(s) (%d up to date) in %.1f ms with %ld job(s)\n",
+               rebuild, count, count - rebuild, asmbuild_now_ms() - start, jobs);
+    }
+    if (ok && output_file) {
+        ok = asmbuild_link(objects, count, output_file, map);
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(objects[i]);
+    }
+    free(objects);
+    free(stale);
+    free(sources);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,325 @@
+#include "../emulator/cpu.h"
+#include "../emulator/engine.h"
+#include "../emulator/lockstep.h"
+#include "../emulator/executable.h"
+#include "../emulator/isa.h"
+#include "../emulator/bank.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DIFFTEST_DATA_BASE 0x4000       // Data window random streams load from and store to
+#define DIFFTEST_DATA_WORDS 256
+#define DIFFTEST_RANDOM_CYCLES 10000
+
+void print_usage(const char* program_name) {
+    printf("SimpleCPU16 Differential Tester\n");
+    printf("Usage: %s [program.bin ...] [options]\n", program_name);
+    printf("Runs each program under the reference interpreter and a candidate engine in\n");
+    printf("lockstep and reports the first point where their state differs.\n");
+    printf("Exit status: 0 no divergence, 1 divergence, 2 error\n");
+    printf("Options:\n");
+    printf("  --engine NAME   Candidate engine (default predecoded):");
+    for (int i = 0; cpu_engines[i]; i++) printf(" %s", cpu_engines[i]->name);
+    printf("\n");
+    printf("  --random N      Also run N random instruction streams\n");
+    printf("  --seed S        First random seed (stream k uses S+k; default 1)\n");
+    printf("  --words N       Words per random stream (default 64)\n");
+    printf("  --cycles N      Cycle limit per run (default %d for programs, %d for streams)\n",
+           CPU_DEFAULT_CYCLE_LIMIT, DIFFTEST_RANDOM_CYCLES);
+    printf("  --input TEXT    Bytes served to MMIO_CHAR_IN\n");
+    printf("  --banks N       Give each CPU its own store of N banks behind the bank window\n");
+    printf("  --help          Show this help message\n");
+}
+
+// Test case: words loaded at address 0 and the starting registers
+typedef struct {
+    uint16_t* words;
+    uint32_t size;
+    uint16_t registers[NUM_REGISTERS];
+} RandomStream;
+
+static uint32_t difftest_next(uint64_t* state) {
+    // xorshift64*
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return (uint32_t)((*state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+// Picking an operand address: mostly the data window (or, with banks,
+// the bank window), sometimes the code itself (self-modifying code) or a
+// device register
+static uint16_t difftest_address(uint64_t* rng, uint32_t code_words, bool banked) {
+    static const uint16_t devices[] = { MMIO_TIMER, MMIO_CHAR_IN, MMIO_CHAR_OUT, MMIO_INT_OUT, MMIO_STR_OUT,
+                                        MMIO_BANK, MMIO_BANK_COUNT };
+    uint32_t pick = difftest_next(rng) % 10;
+    if (banked && pick < 3) return (uint16_t)(BANK_WINDOW + difftest_next(rng) % DIFFTEST_DATA_WORDS);
+    if (pick < 7) return (uint16_t)(DIFFTEST_DATA_BASE + difftest_next(rng) % DIFFTEST_DATA_WORDS);
+    if (pick < 8) return (uint16_t)(difftest_next(rng) % code_words);
+    return devices[difftest_next(rng) % (sizeof(devices) / sizeof(devices[0]))];
+}
+
+// Generating a stream of valid instructions (plus some words with
+// unassigned modes) ending in HALT; branch targets stay inside it
+static void difftest_generate(RandomStream* stream, uint32_t words, uint64_t seed, bool banked) {
+    uint64_t rng = seed * 0x9E3779B97F4A7C15ULL + 1;
+    stream->size = words;
+    stream->words = (uint16_t*)calloc(words, sizeof(uint16_t));
+    for (int r = 0; r < NUM_REGISTERS - 1; r++) {
+        stream->registers[r] = (difftest_next(&rng) & 1) ? (uint16_t)difftest_next(&rng)
+                                                         : difftest_address(&rng, words, banked);
+    }
+    stream->registers[REG_SP] = STACK_START;
+
+    uint32_t i = 0;
+    while (i + 1 < words) {
+        if (difftest_next(&rng) % 16 == 0) {
+            // Opcodes with a mode field, in any mode (unassigned ones do nothing)
+            static const uint8_t opcodes[] = { OP_LOAD, OP_STORE, OP_ARITH, OP_LOGIC, OP_SHIFT, OP_STACK };
+            uint8_t opcode = opcodes[difftest_next(&rng) % sizeof(opcodes)];
+            stream->words[i++] = (uint16_t)((opcode << 12) | (difftest_next(&rng) & 0xFFF));
+            continue;
+        }
+        const InsnInfo* insn;
+        do {
+            insn = &isa_table[difftest_next(&rng) % ISA_COUNT];
+        } while (insn->opcode == OP_HALT || i + insn->length >= words);
+        stream->words[i++] = isa_encode(insn, difftest_next(&rng) & 7, difftest_next(&rng) & 7);
+        if (insn->length == 1) continue;
+        switch (insn->shape) {
+            case SHAPE_TARGET:
+                stream->words[i++] = (uint16_t)(difftest_next(&rng) % words);
+                break;
+            case SHAPE_RD_MEM:
+            case SHAPE_MEM_RS:
+                stream->words[i++] = difftest_address(&rng, words, banked);
+                break;
+            case SHAPE_REGLIST:
+                stream->words[i++] = (uint16_t)(difftest_next(&rng) & 0x1FF);  // Also the ignored SP bit and above
+                break;
+            default:
+                stream->words[i++] = (difftest_next(&rng) & 1) ? difftest_address(&rng, words, banked)
+                                                               : (uint16_t)(difftest_next(&rng) % 32);
+                break;
+        }
+    }
+    stream->words[words - 1] = isa_encode(isa_lookup("HALT", 4), 0, 0);
+}
+
+// Opening a bank store for one CPU when --banks is given (before loading,
+// so code and data in the window land in bank 0)
+static bool difftest_attach_banks(CPU* cpu, BankStore* banks, uint32_t bank_count) {
+    if (bank_count == 0) return true;
+    if (!bank_open(banks, bank_count, NULL)) return false;
+    cpu_attach_banks(cpu, banks);
+    return true;
+}
+
+static void difftest_free(CPU* cpu) {
+    BankStore* banks = cpu->banks;
+    cpu_free(cpu);
+    if (banks) bank_close(banks);
+}
+
+// Setting up a CPU pair from an executable or a stream
+static void difftest_load_stream(CPU* cpu, const RandomStream* stream) {
+    for (uint32_t i = 0; i < stream->size; i++) {
+        cpu_poke(cpu, (uint16_t)i, stream->words[i]);
+    }
+    memcpy(cpu->registers, stream->registers, sizeof(cpu->registers));
+}
+
+static void difftest_load_exe(CPU* cpu, const Executable* exe) {
+    for (uint32_t s = 0; s < exe->segment_count; s++) {
+        for (uint32_t i = 0; i < exe->segments[s].size; i++) {
+            cpu_poke(cpu, (uint16_t)(exe->segments[s].address + i), exe->segments[s].words[i]);
+        }
+    }
+    cpu->pc = exe->entry;
+}
+
+static bool difftest_run_stream(const RandomStream* stream, const CpuEngine* engine, uint64_t cycles,
+                                const char* input, uint32_t bank_count, FILE* report, LockstepResult* result) {
+    CPU reference, candidate;
+    BankStore reference_banks, candidate_banks;
+    cpu_init(&reference);
+    cpu_init(&candidate);
+    if (!difftest_attach_banks(&reference, &reference_banks, bank_count) ||
+        !difftest_attach_banks(&candidate, &candidate_banks, bank_count)) {
+        exit(2);
+    }
+    difftest_load_stream(&reference, stream);
+    difftest_load_stream(&candidate, stream);
+    engine_attach(&candidate, engine);
+    size_t input_size = input ? strlen(input) : 0;
+    cpu_set_input(&reference, (const uint8_t*)input, input_size);
+    cpu_set_input(&candidate, (const uint8_t*)input, input_size);
+    bool same = lockstep_run(&reference, &candidate, engine, cycles, report, result);
+    difftest_free(&reference);
+    difftest_free(&candidate);
+    return same;
+}
+
+// Shrinking a diverging stream: every word that can become a NOP while
+// the engines still disagree does (the final HALT stays)
+static uint32_t difftest_minimize(RandomStream* stream, const CpuEngine* engine, uint64_t cycles,
+                                  const char* input, uint32_t bank_count) {
+    LockstepResult result;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t i = 0; i + 1 < stream->size; i++) {
+            uint16_t word = stream->words[i];
+            if (word == 0) continue;
+            stream->words[i] = 0;
+            if (difftest_run_stream(stream, engine, cycles, input, bank_count, NULL, &result)) {
+                stream->words[i] = word;
+            } else {
+                changed = true;
+            }
+        }
+    }
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < stream->size; i++) kept += stream->words[i] != 0;
+    return kept;
+}
+
+static void difftest_print_stream(const RandomStream* stream) {
+    printf("Registers:");
+    for (int r = 0; r < NUM_REGISTERS; r++) printf(" R%d=0x%04X", r, stream->registers[r]);
+    printf("\n");
+    for (uint32_t i = 0; i < stream->size;) {
+        char text[48];
+        uint16_t ext = i + 1 < stream->size ? stream->words[i + 1] : 0;
+        int length = isa_disassemble(stream->words[i], ext, text, sizeof(text));
+        if (stream->words[i] != 0) printf("  0x%04X: %s\n", i, text);
+        i += (uint32_t)length;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const char** programs = (const char**)calloc(argc, sizeof(char*));
+    int program_count = 0;
+    const CpuEngine* engine = engine_lookup("predecoded");
+    unsigned long random_count = 0;
+    uint64_t seed = 1;
+    uint32_t words = 64;
+    uint64_t cycles = 0;
+    const char* input = NULL;
+    uint32_t bank_count = 0;
+
+    // Parsing command-line arguments
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            engine = engine_lookup(argv[++i]);
+            if (!engine) {
+                fprintf(stderr, "Error: Unknown engine '%s'\n", argv[i]);
+                free(programs);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--random") == 0 && i + 1 < argc) {
+            random_count = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--words") == 0 && i + 1 < argc) {
+            words = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            cycles = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input = argv[++i];
+        } else if (strcmp(argv[i], "--banks") == 0 && i + 1 < argc) {
+            bank_count = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            free(programs);
+            return 0;
+        } else {
+            programs[program_count++] = argv[i];
+        }
+    }
+
+    if (program_count == 0 && random_count == 0) {
+        fprintf(stderr, "Error: No programs or random streams to run\n");
+        print_usage(argv[0]);
+        free(programs);
+        return 2;
+    }
+    if (words < 2 || words > MMIO_START) {
+        fprintf(stderr, "Error: --words must be between 2 and %d\n", MMIO_START);
+        free(programs);
+        return 2;
+    }
+
+    if (bank_count > 65536) {
+        fprintf(stderr, "Error: --banks must be at most 65536\n");
+        free(programs);
+        return 2;
+    }
+
+    int status = 0;
+    size_t input_size = input ? strlen(input) : 0;
+    LockstepResult result;
+    for (int p = 0; p < program_count && status != 2; p++) {
+        Executable exe;
+        if (!exe_read(programs[p], &exe)) {
+            status = 2;
+            break;
+        }
+        CPU reference, candidate;
+        BankStore reference_banks, candidate_banks;
+        cpu_init(&reference);
+        cpu_init(&candidate);
+        if (!difftest_attach_banks(&reference, &reference_banks, bank_count) ||
+            !difftest_attach_banks(&candidate, &candidate_banks, bank_count)) {
+            exe_free(&exe);
+            status = 2;
+            break;
+        }
+        difftest_load_exe(&reference, &exe);
+        difftest_load_exe(&candidate, &exe);
+        exe_free(&exe);
+        engine_attach(&candidate, engine);
+        cpu_set_input(&reference, (const uint8_t*)input, input_size);
+        cpu_set_input(&candidate, (const uint8_t*)input, input_size);
+
+        if (lockstep_run(&reference, &candidate, engine, cycles ? cycles : CPU_DEFAULT_CYCLE_LIMIT,
+                         stdout, &result)) {
+            printf("%s: %llu cycles in %llu steps, %s and reference agree%s\n", programs[p],
+                   (unsigned long long)result.cycles, (unsigned long long)result.steps, engine->name,
+                   result.halted ? "" : " (cycle limit)");
+        } else {
+            printf("%s: diverged\n", programs[p]);
+            status = 1;
+        }
+        difftest_free(&reference);
+        difftest_free(&candidate);
+    }
+
+    uint64_t random_cycles = 0;
+    for (unsigned long k = 0; k < random_count && status != 2; k++) {
+        RandomStream stream;
+        difftest_generate(&stream, words, seed + k, bank_count > 0);
+        uint64_t limit = cycles ? cycles : DIFFTEST_RANDOM_CYCLES;
+        if (difftest_run_stream(&stream, engine, limit, input, bank_count, NULL, &result)) {
+            random_cycles += result.cycles;
+        } else {
+            uint32_t kept = difftest_minimize(&stream, engine, limit, input, bank_count);
+            printf("Random stream %llu diverged (reproduce with --seed %llu --random 1 --words %u);\n"
+                   "minimized to %u of %u words:\n", (unsigned long long)(seed + k),
+                   (unsigned long long)(seed + k), words, kept, words);
+            difftest_print_stream(&stream);
+            difftest_run_stream(&stream, engine, limit, input, bank_count, stdout, &result);
+            status = 1;
+        }
+        free(stream.words);
+        if (status != 0) break;
+    }
+    if (random_count > 0 && status == 0) {
+        printf("Random: %lu streams of %u words, %llu cycles, %s and reference agree\n",
+               random_count, words, (unsigned long long)random_cycles, engine->name);
+    }
+
+    free(programs);
+    return status;
+}
@@ -0,0 +1,717 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../emulator/cpu.h"
+#include "../emulator/engine.h"
+#include "../emulator/snapshot.h"
+#include "../emulator/executable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+// Coverage-guided fuzzing of guest programs that read MMIO_CHAR_IN.
+//
+// The program runs once up to its first input read and the machine is
+// snapshotted there. Every execution restores the snapshot (only pages
+// the last run dirtied), feeds one input through the character device
+// and records block-to-block transitions in a hit-count map. Inputs
+// that reach a new transition or a new hit-count bucket join the
+// corpus; mutations of corpus entries are the next inputs.
+
+#define FUZZ_MAP_SIZE (1 << 14)         // Edge hit counters per execution
+#define FUZZ_DEFAULT_CYCLES 100000      // Budget per execution (exceeding it is a crash)
+#define FUZZ_DEFAULT_STACK 4096         // Stack words below STACK_START before it counts as runaway
+#define FUZZ_DEFAULT_MAX_LEN 256
+#define FUZZ_DEFAULT_SECONDS 10
+#define FUZZ_ROUND 256                  // Mutations of one entry between corpus visits
+#define FUZZ_MAX_CRASHES 256            // Distinct crash sites kept
+
+typedef enum {
+    CRASH_NONE,
+    CRASH_OPCODE,                       // Unknown opcode
+    CRASH_STACK,                        // SP left the stack window
+    CRASH_TIMEOUT                       // Cycle budget exhausted
+} CrashKind;
+
+static const char* const crash_names[] = { "none", "unknown opcode", "runaway stack", "cycle budget" };
+
+typedef struct {
+    uint8_t* data;
+    uint32_t size;
+} FuzzInput;
+
+typedef struct {
+    CrashKind kind;
+    uint16_t pc;                        // Faulting instruction, or block that moved SP / was running
+    FuzzInput input;                    // First input that crashed here
+} FuzzCrash;
+
+// State shared by all workers (corpus and coverage under lock)
+typedef struct {
+    const Snapshot* snap;
+    const CpuEngine* engine;
+    uint64_t cycles;
+    uint16_t stack_low;
+    uint32_t max_len;
+    const char* out_dir;
+    uint8_t dictionary[256];            // Byte constants the program compares against
+    int dictionary_size;
+
+    pthread_mutex_t lock;
+    FuzzInput* corpus;
+    uint32_t corpus_count;
+    uint32_t corpus_capacity;
+    uint8_t virgin[FUZZ_MAP_SIZE];      // Hit-count buckets not seen yet
+    uint32_t edges;
+    FuzzCrash crashes[FUZZ_MAX_CRASHES];
+    uint32_t crash_count;
+    bool stop;
+} Fuzzer;
+
+typedef struct {
+    Fuzzer* fuzzer;
+    pthread_t thread;
+    CPU cpu;
+    uint64_t rng;
+    uint64_t quota;                     // Executions to run (0 = until stopped)
+    uint64_t execs;
+    uint64_t crashes;
+    uint64_t crash_seen[4 * MEM_SIZE / 64];     // (kind, PC) pairs already reported
+    uint8_t trace[FUZZ_MAP_SIZE];
+    uint16_t touched[FUZZ_MAP_SIZE];    // Trace entries hit by this execution
+    uint32_t touched_count;
+    uint8_t virgin[FUZZ_MAP_SIZE];      // Buckets this worker has seen reported
+    FuzzInput base;                     // Entry being mutated
+    FuzzInput other;                    // Splice partner
+    uint8_t* buffer;
+} FuzzWorker;
+
+// Hit counts to buckets: 1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+
+static uint8_t fuzz_bucket[256];
+
+static void fuzz_init_buckets(void) {
+    for (int n = 0; n < 256; n++) {
+        fuzz_bucket[n] = n == 0 ? 0 : n == 1 ? 1 : n == 2 ? 2 : n == 3 ? 4 : n < 8 ? 8
+                       : n < 16 ? 16 : n < 32 ? 32 : n < 128 ? 64 : 128;
+    }
+}
+
+static uint32_t fuzz_next(uint64_t* state) {
+    // xorshift64*
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return (uint32_t)((*state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static uint64_t fuzz_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+void print_usage(const char* program_name) {
+    printf("SimpleCPU16 Fuzzer\n");
+    printf("Usage: %s <program.bin> [seed file or directory ...] [options]\n", program_name);
+    printf("Feeds mutated inputs to the program's MMIO_CHAR_IN and keeps those that reach new\n");
+    printf("code paths. Exit status: 0 no crashes, 1 crashes found, 2 error\n");
+    printf("Options:\n");
+    printf("  --jobs N        Worker threads (default: online cores)\n");
+    printf("  --time S        Stop after S seconds (default %d; 0 = no limit)\n", FUZZ_DEFAULT_SECONDS);
+    printf("  --runs N        Stop after N executions in total\n");
+    printf("  --seed S        Random seed (worker k uses S+k; default 1)\n");
+    printf("  --cycles N      Cycle budget per execution (default %d)\n", FUZZ_DEFAULT_CYCLES);
+    printf("  --stack N       Stack words below 0x%04X before SP is a runaway (default %d)\n",
+           STACK_START, FUZZ_DEFAULT_STACK);
+    printf("  --max-len N     Longest input generated (default %d)\n", FUZZ_DEFAULT_MAX_LEN);
+    printf("  --engine NAME   Execution engine (default predecoded):");
+    for (int i = 0; cpu_engines[i]; i++) printf(" %s", cpu_engines[i]->name);
+    printf("\n");
+    printf("  --out DIR       Write crashing inputs and the final corpus to DIR\n");
+    printf("  --help          Show this help message\n");
+}
+
+// Running one input from the snapshot; returns how it ended
+static CrashKind fuzz_execute(FuzzWorker* w, const uint8_t* data, uint32_t size, uint16_t* crash_pc) {
+    const Fuzzer* f = w->fuzzer;
+    CPU* cpu = &w->cpu;
+    static const uint8_t empty = 0;
+    snapshot_restore(f->snap, cpu);
+    cpu_set_input(cpu, data ? data : &empty, size);     // NULL would mean stdin
+    // Clearing only what the last execution hit: a run touches few edges
+    for (uint32_t i = 0; i < w->touched_count; i++) w->trace[w->touched[i]] = 0;
+    w->touched_count = 0;
+
+    uint64_t limit = cpu->cycle_count + f->cycles;
+    uint32_t prev = 0;
+    uint16_t block = cpu->pc;
+    __atomic_store_n(&w->execs, w->execs + 1, __ATOMIC_RELAXED);
+    while (!cpu->halted) {
+        if (cpu->cycle_count >= limit) {
+            // The block that was running when time ran out: a loop head
+            *crash_pc = block;
+            return CRASH_TIMEOUT;
+        }
+        block = cpu->pc;
+        f->engine->run(cpu, limit);
+
+        // Edge = (previous block, next block), hashed into the map
+        uint32_t cur = (uint32_t)cpu->pc * 0x9E3779B1u >> 18;
+        uint16_t edge = (uint16_t)((cur ^ prev) & (FUZZ_MAP_SIZE - 1));
+        uint8_t* count = &w->trace[edge];
+        if (*count == 0) w->touched[w->touched_count++] = edge;
+        if (*count != 0xFF) (*count)++;
+        prev = cur >> 1;
+
+        uint16_t sp = cpu->registers[REG_SP];
+        if (sp < f->stack_low || sp > STACK_START) {
+            *crash_pc = block;
+            return CRASH_STACK;
+        }
+    }
+    if (cpu->faulted) {
+        *crash_pc = (uint16_t)(cpu->pc - 1);
+        return CRASH_OPCODE;
+    }
+    return CRASH_NONE;
+}
+
+// Turning the hit counts of the last execution into buckets, in place
+static void fuzz_classify(FuzzWorker* w) {
+    for (uint32_t i = 0; i < w->touched_count; i++) {
+        w->trace[w->touched[i]] = fuzz_bucket[w->trace[w->touched[i]]];
+    }
+}
+
+// Whether the classified trace has a bucket still set in virgin,
+// clearing it there; counts newly seen edges when edges is set
+static bool fuzz_new_coverage(const FuzzWorker* w, uint8_t* virgin, uint32_t* edges) {
+    bool found = false;
+    for (uint32_t i = 0; i < w->touched_count; i++) {
+        uint16_t at = w->touched[i];
+        if (!(w->trace[at] & virgin[at])) continue;
+        if (edges && virgin[at] == 0xFF) (*edges)++;
+        virgin[at] &= (uint8_t)~w->trace[at];
+        found = true;
+    }
+    return found;
+}
+
+static void fuzz_copy_input(FuzzInput* to, const uint8_t* data, uint32_t size) {
+    to->data = (uint8_t*)realloc(to->data, size ? size : 1);
+    memcpy(to->data, data, size);
+    to->size = size;
+}
+
+static void fuzz_write_file(const char* path, const uint8_t* data, uint32_t size) {
+    FILE* file = fopen(path, "wb");
+    if (!file || fwrite(data, 1, size, file) != size) {
+        fprintf(stderr, "Error: Cannot write '%s'\n", path);
+    }
+    if (file) fclose(file);
+}
+
+// Printing an input as a C string literal, shortened if long
+static void fuzz_print_input(FILE* out, const uint8_t* data, uint32_t size) {
+    fprintf(out, "%u byte(s) \"", size);
+    for (uint32_t i = 0; i < size && i < 64; i++) {
+        uint8_t c = data[i];
+        if (c == '\n') fprintf(out, "\\n");
+        else if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if (c >= 0x20 && c < 0x7F) fputc(c, out);
+        else fprintf(out, "\\x%02X", c);
+    }
+    fprintf(out, size > 64 ? "\"...\n" : "\"\n");
+}
+
+// Adding an input to the shared corpus (lock held)
+static void fuzz_add_corpus(Fuzzer* f, const uint8_t* data, uint32_t size) {
+    if (f->corpus_count == f->corpus_capacity) {
+        f->corpus_capacity = f->corpus_capacity ? f->corpus_capacity * 2 : 64;
+        f->corpus = (FuzzInput*)realloc(f->corpus, f->corpus_capacity * sizeof(FuzzInput));
+    }
+    FuzzInput* entry = &f->corpus[f->corpus_count++];
+    memset(entry, 0, sizeof(FuzzInput));
+    fuzz_copy_input(entry, data, size);
+}
+
+// Recording a crash; the first input per (kind, PC) is kept
+static void fuzz_add_crash(FuzzWorker* w, CrashKind kind, uint16_t pc, const uint8_t* data, uint32_t size) {
+    Fuzzer* f = w->fuzzer;
+    uint32_t key = (uint32_t)kind * MEM_SIZE + pc;
+    __atomic_store_n(&w->crashes, w->crashes + 1, __ATOMIC_RELAXED);
+    if (w->crash_seen[key / 64] & (1ULL << (key % 64))) return;
+    w->crash_seen[key / 64] |= 1ULL << (key % 64);
+
+    pthread_mutex_lock(&f->lock);
+    bool known = false;
+    for (uint32_t i = 0; i < f->crash_count && !known; i++) {
+        known = f->crashes[i].kind == kind && f->crashes[i].pc == pc;
+    }
+    if (!known && f->crash_count < FUZZ_MAX_CRASHES) {
+        FuzzCrash* crash = &f->crashes[f->crash_count++];
+        crash->kind = kind;
+        crash->pc = pc;
+        memset(&crash->input, 0, sizeof(FuzzInput));
+        fuzz_copy_input(&crash->input, data, size);
+        printf("Crash: %s at 0x%04X, input ", crash_names[kind], pc);
+        fuzz_print_input(stdout, data, size);
+        fflush(stdout);
+        if (f->out_dir) {
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/crash-%d-%04X", f->out_dir, (int)kind, pc);
+            fuzz_write_file(path, data, size);
+        }
+    }
+    pthread_mutex_unlock(&f->lock);
+}
+
+// Running an input and keeping it if it found something; returns true
+// when it joined the corpus
+static bool fuzz_try(FuzzWorker* w, const uint8_t* data, uint32_t size) {
+    Fuzzer* f = w->fuzzer;
+    uint16_t pc = 0;
+    CrashKind kind = fuzz_execute(w, data, size, &pc);
+    if (kind != CRASH_NONE) {
+        fuzz_add_crash(w, kind, pc, data, size);
+        return false;
+    }
+    // Checking the worker's own map first keeps the lock off the hot path
+    fuzz_classify(w);
+    if (!fuzz_new_coverage(w, w->virgin, NULL)) return false;
+
+    bool added = false;
+    pthread_mutex_lock(&f->lock);
+    if (fuzz_new_coverage(w, f->virgin, &f->edges)) {
+        fuzz_add_corpus(f, data, size);
+        added = true;
+    }
+    pthread_mutex_unlock(&f->lock);
+    return added;
+}
+
+static const uint8_t fuzz_interesting[] = { 0x00, 0x01, 0x7F, 0x80, 0xFF, '0', '1', '9', ' ', '\n', '-', ',' };
+
+// Stacking 2-16 random edits of the base entry into the buffer
+static uint32_t fuzz_mutate(FuzzWorker* w) {
+    const Fuzzer* f = w->fuzzer;
+    uint8_t* out = w->buffer;
+    uint32_t size = w->base.size;
+    memcpy(out, w->base.data, size);
+
+    int edits = 2 << (fuzz_next(&w->rng) % 4);
+    for (int e = 0; e < edits; e++) {
+        uint32_t choice = fuzz_next(&w->rng) % 10;
+        uint32_t at = size ? fuzz_next(&w->rng) % size : 0;
+        // Edits that need a byte to change become insertions on empty input
+        if (size == 0 && choice < 4) choice = 4;
+        switch (choice) {
+            case 0:     // Flipping a bit
+                out[at] ^= (uint8_t)(1 << (fuzz_next(&w->rng) % 8));
+                break;
+            case 1:     // Random byte
+                out[at] = (uint8_t)fuzz_next(&w->rng);
+                break;
+            case 2:     // Boundary or separator byte
+                out[at] = fuzz_interesting[fuzz_next(&w->rng) % sizeof(fuzz_interesting)];
+                break;
+            case 3:     // Small increment or decrement
+                out[at] = (uint8_t)(out[at] + (fuzz_next(&w->rng) % 33) - 16);
+                break;
+            case 4:     // Inserting a byte (a dictionary byte half the time)
+            case 5: {
+                if (size >= f->max_len) break;
+                at = fuzz_next(&w->rng) % (size + 1);
+                memmove(out + at + 1, out + at, size - at);
+                out[at] = (choice == 5 && f->dictionary_size)
+                        ? f->dictionary[fuzz_next(&w->rng) % f->dictionary_size]
+                        : (uint8_t)fuzz_next(&w->rng);
+                size++;
+                break;
+            }
+            case 6: {   // Deleting a run
+                if (size == 0) break;
+                uint32_t length = 1 + fuzz_next(&w->rng) % (size - at < 8 ? size - at : 8);
+                memmove(out + at, out + at + length, size - at - length);
+                size -= length;
+                break;
+            }
+            case 7: {   // Duplicating a run somewhere else
+                if (size == 0) break;
+                uint8_t run[16];
+                uint32_t length = 1 + fuzz_next(&w->rng) % (size - at < 16 ? size - at : 16);
+                if (size + length > f->max_len) break;
+                memcpy(run, out + at, length);
+                uint32_t to = fuzz_next(&w->rng) % (size + 1);
+                memmove(out + to + length, out + to, size - to);
+                memcpy(out + to, run, length);
+                size += length;
+                break;
+            }
+            case 8:     // Overwriting with a dictionary byte
+                if (size && f->dictionary_size) {
+                    out[at] = f->dictionary[fuzz_next(&w->rng) % f->dictionary_size];
+                }
+                break;
+            case 9: {   // Splicing: a prefix of this entry, the tail of another
+                const FuzzInput* other = &w->other;
+                if (other->size == 0) break;
+                uint32_t from = fuzz_next(&w->rng) % other->size;
+                uint32_t length = other->size - from;
+                if (at + length > f->max_len) length = f->max_len - at;
+                memcpy(out + at, other->data + from, length);
+                size = at + length;
+                break;
+            }
+        }
+    }
+    return size;
+}
+
+// Copying two random corpus entries to mutate
+static bool fuzz_pick(FuzzWorker* w) {
+    Fuzzer* f = w->fuzzer;
+    pthread_mutex_lock(&f->lock);
+    bool stop = f->stop;
+    if (!stop) {
+        // Newer entries are picked more often
+        uint32_t n = f->corpus_count;
+        uint32_t pick = fuzz_next(&w->rng) % n;
+        if (fuzz_next(&w->rng) & 1) pick = n - 1 - pick / 2;
+        fuzz_copy_input(&w->base, f->corpus[pick].data, f->corpus[pick].size);
+        const FuzzInput* other = &f->corpus[fuzz_next(&w->rng) % n];
+        fuzz_copy_input(&w->other, other->data, other->size);
+    }
+    pthread_mutex_unlock(&f->lock);
+    return !stop;
+}
+
+static void* fuzz_worker_main(void* arg) {
+    FuzzWorker* w = (FuzzWorker*)arg;
+    while ((w->quota == 0 || w->execs < w->quota) && fuzz_pick(w)) {
+        for (int i = 0; i < FUZZ_ROUND && (w->quota == 0 || w->execs < w->quota); i++) {
+            uint32_t size = fuzz_mutate(w);
+            // A find becomes the base for the rest of the round
+            if (fuzz_try(w, w->buffer, size)) {
+                fuzz_copy_input(&w->base, w->buffer, size);
+            }
+        }
+    }
+    return NULL;
+}
+
+// Running the program up to the instruction that first reads
+// MMIO_CHAR_IN. Reading a device never writes memory, so undoing that
+// instruction only needs the registers.
+static bool fuzz_initialize(CPU* cpu) {
+    static const uint8_t probe = 0;
+    cpu_set_input(cpu, &probe, 1);
+    while (!cpu->halted && cpu->cycle_count < CPU_DEFAULT_CYCLE_LIMIT) {
+        uint16_t registers[NUM_REGISTERS];
+        memcpy(registers, cpu->registers, sizeof(registers));
+        uint16_t pc = cpu->pc, ir = cpu->ir;
+        Flags flags = cpu->flags;
+        uint64_t cycles = cpu->cycle_count;
+        cpu_step(cpu, false);
+        if (cpu->input_pos > 0) {
+            memcpy(cpu->registers, registers, sizeof(registers));
+            cpu->pc = pc;
+            cpu->ir = ir;
+            cpu->flags = flags;
+            cpu->cycle_count = cycles;
+            cpu->halted = false;
+            cpu_set_input(cpu, NULL, 0);
+            return true;
+        }
+    }
+    fprintf(stderr, "Error: Program %s before reading MMIO_CHAR_IN (0x%04X); nothing to fuzz\n",
+            cpu->halted ? "halted" : "ran out of cycles", MMIO_CHAR_IN);
+    return false;
+}
+
+// Collecting byte immediates of LDI: the characters the program compares input with
+static void fuzz_collect_dictionary(Fuzzer* f, const Snapshot* snap) {
+    bool seen[256] = { false };
+    for (int page = 0; page < NUM_PAGES; page++) {
+        const uint16_t* data = snap->pages[page];
+        if (!data) continue;
+        for (int i = 0; i + 1 < PAGE_WORDS; i++) {
+            uint16_t word = data[i];
+            if ((word >> 12) != OP_LOAD || (word & 0x3F) != LOAD_IMM || data[i + 1] > 0xFF) continue;
+            uint8_t value = (uint8_t)data[i + 1];
+            if (!seen[value]) {
+                seen[value] = true;
+                f->dictionary[f->dictionary_size++] = value;
+            }
+        }
+    }
+}
+
+// Reading seed inputs from a file or every regular file in a directory
+static bool fuzz_load_seeds(const char* path, FuzzInput** seeds, int* count, uint32_t max_len) {
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        fprintf(stderr, "Error: Cannot open seed '%s'\n", path);
+        return false;
+    }
+    if (S_ISDIR(info.st_mode)) {
+        DIR* dir = opendir(path);
+        if (!dir) {
+            fprintf(stderr, "Error: Cannot open seed directory '%s'\n", path);
+            return false;
+        }
+        struct dirent* entry;
+        bool ok = true;
+        while (ok && (entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.') continue;
+            char child[1024];
+            snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+            if (stat(child, &info) == 0 && S_ISREG(info.st_mode)) {
+                ok = fuzz_load_seeds(child, seeds, count, max_len);
+            }
+        }
+        closedir(dir);
+        return ok;
+    }
+
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open seed '%s'\n", path);
+        return false;
+    }
+    uint8_t* data = (uint8_t*)malloc(max_len ? max_len : 1);
+    uint32_t size = (uint32_t)fread(data, 1, max_len, file);
+    fclose(file);
+    *seeds = (FuzzInput*)realloc(*seeds, (*count + 1) * sizeof(FuzzInput));
+    (*seeds)[*count].data = data;
+    (*seeds)[*count].size = size;
+    (*count)++;
+    return true;
+}
+
+static void fuzz_print_status(Fuzzer* f, FuzzWorker* workers, int jobs, uint64_t elapsed_ms) {
+    uint64_t execs = 0, crashes = 0;
+    for (int i = 0; i < jobs; i++) {
+        execs += __atomic_load_n(&workers[i].execs, __ATOMIC_RELAXED);
+        crashes += __atomic_load_n(&workers[i].crashes, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_lock(&f->lock);
+    printf("[%5.1fs] execs %llu (%.0f/s), corpus %u, edges %u, crashes %llu (%u distinct)\n",
+           elapsed_ms / 1000.0, (unsigned long long)execs,
+           elapsed_ms ? execs * 1000.0 / elapsed_ms : 0.0, f->corpus_count, f->edges,
+           (unsigned long long)crashes, f->crash_count);
+    pthread_mutex_unlock(&f->lock);
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+    const char* program = NULL;
+    const char** seed_paths = (const char**)calloc(argc, sizeof(char*));
+    int seed_path_count = 0;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    double seconds = FUZZ_DEFAULT_SECONDS;
+    uint64_t runs = 0;
+    uint64_t seed = 1;
+    uint64_t cycles = FUZZ_DEFAULT_CYCLES;
+    uint32_t stack_words = FUZZ_DEFAULT_STACK;
+    uint32_t max_len = FUZZ_DEFAULT_MAX_LEN;
+    const CpuEngine* engine = engine_lookup("predecoded");
+    const char* out_dir = NULL;
+
+    // Parsing command-line arguments
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = strtol(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+            seconds = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            cycles = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--stack") == 0 && i + 1 < argc) {
+            stack_words = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--max-len") == 0 && i + 1 < argc) {
+            max_len = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            engine = engine_lookup(argv[++i]);
+            if (!engine) {
+                fprintf(stderr, "Error: Unknown engine '%s'\n", argv[i]);
+                free(seed_paths);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_dir = argv[++i];
+        } else if (strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            free(seed_paths);
+            return 0;
+        } else if (!program) {
+            program = argv[i];
+        } else {
+            seed_paths[seed_path_count++] = argv[i];
+        }
+    }
+
+    if (!program) {
+        fprintf(stderr, "Error: No program specified\n");
+        print_usage(argv[0]);
+        free(seed_paths);
+        return 2;
+    }
+    if (jobs < 1 || jobs > 256 || cycles == 0 || max_len == 0 || stack_words >= STACK_START) {
+        fprintf(stderr, "Error: --jobs must be 1-256, --cycles and --max-len positive, --stack below %d\n",
+                STACK_START);
+        free(seed_paths);
+        return 2;
+    }
+    if (out_dir && mkdir(out_dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error: Cannot create '%s'\n", out_dir);
+        free(seed_paths);
+        return 2;
+    }
+
+    // Initializing the program and snapshotting it at its first input read
+    Executable exe;
+    if (!exe_read(program, &exe)) {
+        free(seed_paths);
+        return 2;
+    }
+    CPU init;
+    cpu_init(&init);
+    init.suppress_output = true;
+    for (uint32_t s = 0; s < exe.segment_count; s++) {
+        for (uint32_t i = 0; i < exe.segments[s].size; i++) {
+            cpu_poke(&init, (uint16_t)(exe.segments[s].address + i), exe.segments[s].words[i]);
+        }
+    }
+    init.pc = exe.entry;
+    exe_free(&exe);
+    Snapshot snap;
+    bool ready = fuzz_initialize(&init) && snapshot_take(&snap, &init);
+    uint64_t init_cycles = init.cycle_count;
+    uint16_t init_pc = init.pc;
+    cpu_free(&init);
+    if (!ready) {
+        free(seed_paths);
+        return 2;
+    }
+
+    FuzzInput* seeds = NULL;
+    int seed_count = 0;
+    bool ok = true;
+    for (int i = 0; i < seed_path_count && ok; i++) {
+        ok = fuzz_load_seeds(seed_paths[i], &seeds, &seed_count, max_len);
+    }
+    free(seed_paths);
+
+    Fuzzer* f = (Fuzzer*)calloc(1, sizeof(Fuzzer));
+    f->snap = &snap;
+    f->engine = engine;
+    f->cycles = cycles;
+    f->stack_low = (uint16_t)(STACK_START - stack_words);
+    f->max_len = max_len;
+    f->out_dir = out_dir;
+    memset(f->virgin, 0xFF, sizeof(f->virgin));
+    pthread_mutex_init(&f->lock, NULL);
+    fuzz_init_buckets();
+    fuzz_collect_dictionary(f, &snap);
+
+    FuzzWorker* workers = (FuzzWorker*)calloc(jobs, sizeof(FuzzWorker));
+    for (int i = 0; i < jobs; i++) {
+        FuzzWorker* w = &workers[i];
+        w->fuzzer = f;
+        w->rng = (seed + i) * 0x9E3779B97F4A7C15ULL + 1;
+        w->quota = runs ? runs / jobs + (i < (long)(runs % jobs)) : 0;
+        w->buffer = (uint8_t*)malloc(max_len);
+        memset(w->virgin, 0xFF, sizeof(w->virgin));
+        cpu_init(&w->cpu);
+        w->cpu.suppress_output = true;
+        snapshot_load(&snap, &w->cpu);
+        engine_attach(&w->cpu, engine);
+    }
+
+    printf("Fuzzing %s: snapshot at 0x%04X after %llu cycles (%u pages), %ld worker(s), "
+           "%d dictionary byte(s)\n", program, init_pc, (unsigned long long)init_cycles,
+           snap.page_count, jobs, f->dictionary_size);
+
+    // Seeds (or one empty input) form the initial corpus, whatever they cover
+    uint64_t start = fuzz_now_ms();
+    for (int i = 0; i < seed_count && ok; i++) {
+        if (!fuzz_try(&workers[0], seeds[i].data, seeds[i].size)) {
+            fuzz_add_corpus(f, seeds[i].data, seeds[i].size);
+        }
+    }
+    if (f->corpus_count == 0 && !fuzz_try(&workers[0], NULL, 0)) {
+        fuzz_add_corpus(f, NULL, 0);
+    }
+    for (int i = 0; i < seed_count; i++) free(seeds[i].data);
+    free(seeds);
+
+    int started = 0;
+    for (int i = 0; i < jobs && ok; i++, started++) {
+        if (pthread_create(&workers[i].thread, NULL, fuzz_worker_main, &workers[i]) != 0) {
+            fprintf(stderr, "Error: Cannot start worker thread\n");
+            ok = false;
+            break;
+        }
+    }
+
+    // Reporting once a second until the time or run limit
+    uint64_t last_report = start;
+    while (ok) {
+        struct timespec tick = { 0, 50 * 1000000L };
+        nanosleep(&tick, NULL);
+        uint64_t now = fuzz_now_ms();
+        bool done = seconds > 0 && now - start >= (uint64_t)(seconds * 1000);
+        if (runs) {
+            uint64_t execs = 0;
+            for (int i = 0; i < jobs; i++) execs += __atomic_load_n(&workers[i].execs, __ATOMIC_RELAXED);
+            done = done || execs >= runs;
+        }
+        if (done) break;
+        if (now - last_report >= 1000) {
+            fuzz_print_status(f, workers, jobs, now - start);
+            last_report = now;
+        }
+    }
+    pthread_mutex_lock(&f->lock);
+    f->stop = true;
+    pthread_mutex_unlock(&f->lock);
+    for (int i = 0; i < started; i++) pthread_join(workers[i].thread, NULL);
+    fuzz_print_status(f, workers, jobs, fuzz_now_ms() - start);
+
+    for (uint32_t i = 0; i < f->crash_count; i++) {
+        const FuzzCrash* crash = &f->crashes[i];
+        printf("  %-15s at 0x%04X: ", crash_names[crash->kind], crash->pc);
+        fuzz_print_input(stdout, crash->input.data, crash->input.size);
+    }
+    if (out_dir) {
+        for (uint32_t i = 0; i < f->corpus_count; i++) {
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/corpus-%06u", out_dir, i);
+            fuzz_write_file(path, f->corpus[i].data, f->corpus[i].size);
+        }
+    }
+
+    int status = !ok ? 2 : f->crash_count > 0 ? 1 : 0;
+    for (int i = 0; i < jobs; i++) {
+        cpu_free(&workers[i].cpu);
+        free(workers[i].base.data);
+        free(workers[i].other.data);
+        free(workers[i].buffer);
+    }
+    for (uint32_t i = 0; i < f->corpus_count; i++) free(f->corpus[i].data);
+    for (uint32_t i = 0; i < f->crash_count; i++) free(f->crashes[i].input.data);
+    free(f->corpus);
+    pthread_mutex_destroy(&f->lock);
+    free(f);
+    free(workers);
+    snapshot_free(&snap);
+    return status;
+}
@@ -0,0 +1,112 @@
+#include "../emulator/isa.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Build-time generator for isa_hash.h: finds a collision-free seed for
+// the mnemonic hash and writes the hash slots and the decode map.
+
+static const InsnInfo rows[] = {
+#define INSN(name, opcode, sub, shape, length) { #name, opcode, sub, shape, length },
+#include "../emulator/isa.def"
+};
+
+#define ROW_COUNT ((int)(sizeof(rows) / sizeof(rows[0])))
+#define MAX_SEEDS 1000000
+
+// Filling slots for one seed; false on collision
+static bool isagen_try(uint32_t seed, int size, int* slots) {
+    for (int i = 0; i < size; i++) slots[i] = -1;
+    for (int i = 0; i < ROW_COUNT; i++) {
+        // Rows of one mnemonic are adjacent: only the first gets a slot
+        if (i > 0 && strcmp(rows[i].name, rows[i - 1].name) == 0) continue;
+        uint32_t slot = isa_hash(rows[i].name, strlen(rows[i].name), seed) & (size - 1);
+        if (slots[slot] >= 0) return false;
+        slots[slot] = i;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <isa_hash.h>\n", argv[0]);
+        return 1;
+    }
+
+    // Rejecting non-adjacent duplicate mnemonics (lookup returns the first row)
+    for (int i = 0; i < ROW_COUNT; i++) {
+        for (int j = i + 2; j < ROW_COUNT; j++) {
+            if (strcmp(rows[i].name, rows[j].name) == 0 && strcmp(rows[j - 1].name, rows[j].name) != 0) {
+                fprintf(stderr, "Error: Rows for %s in isa.def must be adjacent\n", rows[i].name);
+                return 1;
+            }
+        }
+    }
+
+    int size = 16;
+    while (size < ROW_COUNT) size *= 2;
+    int* slots = NULL;
+    uint32_t seed = 0;
+    bool found = false;
+    while (!found && size <= 4096) {
+        slots = (int*)realloc(slots, size * sizeof(int));
+        for (seed = 1; seed < MAX_SEEDS && !found; seed++) {
+            found = isagen_try(seed * 0x9E3779B1u, size, slots);
+        }
+        if (!found) size *= 2;
+    }
+    if (!found) {
+        fprintf(stderr, "Error: No perfect hash found for the instruction table\n");
+        free(slots);
+        return 1;
+    }
+    seed = (seed - 1) * 0x9E3779B1u;
+
+    // Decode map: exact (opcode, mode) rows first, then opcodes ignoring mode
+    int decode[16][64];
+    memset(decode, 0xFF, sizeof(decode));
+    for (int i = 0; i < ROW_COUNT; i++) {
+        if (rows[i].sub == ISA_NOSUB) continue;
+        if (decode[rows[i].opcode][rows[i].sub] >= 0) {
+            fprintf(stderr, "Error: %s duplicates the encoding of %s\n", rows[i].name,
+                    rows[decode[rows[i].opcode][rows[i].sub]].name);
+            free(slots);
+            return 1;
+        }
+        decode[rows[i].opcode][rows[i].sub] = i;
+    }
+    for (int i = 0; i < ROW_COUNT; i++) {
+        if (rows[i].sub != ISA_NOSUB) continue;
+        for (int mode = 0; mode < 64; mode++) {
+            if (decode[rows[i].opcode][mode] < 0) decode[rows[i].opcode][mode] = i;
+        }
+    }
+
+    FILE* out = fopen(argv[1], "w");
+    if (!out) {
+        fprintf(stderr, "Error: Cannot open %s for writing\n", argv[1]);
+        free(slots);
+        return 1;
+    }
+    fprintf(out, "// Generated by isagen from src/emulator/isa.def - do not edit\n");
+    fprintf(out, "#ifndef ISA_HASH_H\n#define ISA_HASH_H\n\n");
+    fprintf(out, "#define ISA_HASH_SEED 0x%08Xu\n", seed);
+    fprintf(out, "#define ISA_HASH_SIZE %d\n\n", size);
+    fprintf(out, "static const int8_t isa_hash_slots[ISA_HASH_SIZE] = {");
+    for (int i = 0; i < size; i++) {
+        fprintf(out, "%s%d,", i % 16 == 0 ? "\n    " : " ", slots[i]);
+    }
+    fprintf(out, "\n};\n\n");
+    fprintf(out, "static const int8_t isa_decode_map[16][64] = {\n");
+    for (int op = 0; op < 16; op++) {
+        fprintf(out, "    {");
+        for (int mode = 0; mode < 64; mode++) {
+            fprintf(out, "%s%d", mode ? "," : "", decode[op][mode]);
+        }
+        fprintf(out, "},\n");
+    }
+    fprintf(out, "};\n\n#endif // ISA_HASH_H\n");
+    fclose(out);
+    free(slots);
+    return 0;
+}
@@ -0,0 +1,80 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "../emulator/memdump.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+void print_usage(const char* program_name) {
+    printf("SimpleCPU16 State Diff\n");
+    printf("Usage: %s <dump_a> <dump_b> [options]\n", program_name);
+    printf("Compares two binary dumps written by emulator --dump.\n");
+    printf("Exit status: 0 identical, 1 different, 2 error\n");
+    printf("Options:\n");
+    printf("  --words         List every differing word\n");
+    printf("  --bench N       Time N full-state comparisons\n");
+    printf("  --help          Show this help message\n");
+}
+
+static double memdiff_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+int main(int argc, char* argv[]) {
+    const char* files[2] = { NULL, NULL };
+    int file_count = 0;
+    bool words = false;
+    int bench = 0;
+
+    // Parsing command-line arguments
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--words") == 0) {
+            words = true;
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            bench = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (file_count < 2) {
+            files[file_count++] = argv[i];
+        }
+    }
+
+    if (file_count < 2) {
+        fprintf(stderr, "Error: Two dump files required\n");
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    MemSnapshot* a = (MemSnapshot*)malloc(sizeof(MemSnapshot));
+    MemSnapshot* b = (MemSnapshot*)malloc(sizeof(MemSnapshot));
+    if (!a || !b || !memdump_read(files[0], a) || !memdump_read(files[1], b)) {
+        free(a);
+        free(b);
+        return 2;
+    }
+
+    MemDiff diff;
+    memset(&diff, 0, sizeof(diff));
+    memdump_diff(a, b, &diff);
+    memdump_print_diff(stdout, &diff, a, b, words);
+
+    if (bench > 0) {
+        double start = memdiff_now_us();
+        for (int i = 0; i < bench; i++) {
+            memdump_diff(a, b, &diff);
+        }
+        double elapsed = memdiff_now_us() - start;
+        printf("\n%d comparisons: %.2f us each (%u KB of state)\n", bench, elapsed / bench,
+               (unsigned)(sizeof(a->memory) / 1024));
+    }
+
+    int status = memdump_diff_empty(&diff) ? 0 : 1;
+    memdump_diff_free(&diff);
+    free(a);
+    free(b);
+    return status;
+}
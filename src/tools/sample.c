@@ -0,0 +1,588 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../emulator/cpu.h"
+#include "../emulator/engine.h"
+#include "../emulator/snapshot.h"
+#include "../emulator/executable.h"
+#include "../emulator/timing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// Sampled simulation: estimating what the detailed timing model would
+// report for a whole run from a few intervals run in detail.
+//
+// 1. Profiling: the predecoded engine runs the program in intervals of
+//    a fixed number of instructions. Each call runs one basic block, so
+//    the PC before it names the block; instructions per block, hashed
+//    into SAMPLE_BBV_DIMS counters and normalized, are the interval's
+//    basic-block vector.
+// 2. Clustering: k-means groups intervals with similar vectors. They
+//    run the same code in the same proportions, so they behave alike.
+// 3. Choosing: a few intervals at random from each cluster (all of a
+//    small one). Clusters are the strata of a stratified sample.
+// 4. Checkpointing: a second functional run snapshots the machine a
+//    warm-up stretch before each chosen interval.
+// 5. Detailed runs: worker threads restore the snapshots and run the
+//    warm-up, then the interval, under the timing model.
+// 6. Estimating: stratified ratio estimates of CPI, cache miss rate and
+//    branch misprediction rate, with 95% confidence intervals from the
+//    spread within each cluster.
+//
+// Guest output is dropped and MMIO_CHAR_IN reads --input (then end of
+// input), so every run of the program sees the same inputs.
+
+#define SAMPLE_BBV_BITS 5
+#define SAMPLE_BBV_DIMS (1 << SAMPLE_BBV_BITS)
+#define SAMPLE_DEFAULT_INTERVAL 10000
+#define SAMPLE_DEFAULT_WARMUP 2000
+#define SAMPLE_DEFAULT_CLUSTERS 6
+#define SAMPLE_DEFAULT_PER_CLUSTER 3
+#define SAMPLE_DEFAULT_CYCLES 100000000ULL     // Functional budget for the whole run
+#define SAMPLE_KMEANS_ROUNDS 100
+#define SAMPLE_Z95 1.96
+
+typedef struct {
+    uint64_t start;                     // Cycle the interval starts at
+    uint64_t length;                    // Instructions (the last may be short)
+    float bbv[SAMPLE_BBV_DIMS];         // Fraction of instructions per block hash
+    int cluster;
+    bool chosen;
+    // Chosen intervals only
+    Snapshot* snap;                     // Taken warm-up instructions before start
+    size_t input_pos;                   // MMIO_CHAR_IN bytes consumed at the snapshot
+    TimingStats stats;                  // Detailed statistics of the interval itself
+} SampleInterval;
+
+// State shared by the detailed-run workers
+typedef struct {
+    SampleInterval* intervals;
+    uint32_t* chosen;                   // Indexes of chosen intervals
+    uint32_t chosen_count;
+    uint32_t next;                      // Next chosen interval to run (atomic)
+    const TimingConfig* config;
+    const uint8_t* input;
+    size_t input_size;
+    bool failed;
+} SampleJobs;
+
+typedef struct {
+    double value;
+    double half_width;                  // 95% confidence (NAN = unknown)
+} SampleEstimate;
+
+void print_usage(const char* program_name) {
+    printf("SimpleCPU16 Sampled Simulator\n");
+    printf("Usage: %s <program.bin> [options]\n", program_name);
+    printf("Profiles the program with the fast engine, clusters its intervals by basic-block\n");
+    printf("vector, runs a few intervals per cluster under the timing model in parallel and\n");
+    printf("estimates whole-run CPI, cache miss rate and branch misprediction rate.\n");
+    printf("Exit status: 0 estimated, 2 error\n");
+    printf("Options:\n");
+    printf("  --interval N    Instructions per interval (default %d)\n", SAMPLE_DEFAULT_INTERVAL);
+    printf("  --warmup N      Detailed instructions before each interval, not measured (default %d)\n",
+           SAMPLE_DEFAULT_WARMUP);
+    printf("  --clusters K    Clusters of similar intervals (default %d)\n", SAMPLE_DEFAULT_CLUSTERS);
+    printf("  --per-cluster M Intervals simulated per cluster (default %d; 2+ for error bounds)\n",
+           SAMPLE_DEFAULT_PER_CLUSTER);
+    printf("  --jobs N        Detailed-run threads (default: online cores)\n");
+    printf("  --seed S        Random seed for clustering and choosing (default 1)\n");
+    printf("  --cycles N      Functional cycle budget (default %llu)\n", SAMPLE_DEFAULT_CYCLES);
+    printf("  --input TEXT    Bytes served to MMIO_CHAR_IN\n");
+    printf("  --full          Also run the whole program in detail and compare\n");
+    printf("  --sets N / --ways N / --line N   Cache shape (default %d x %d x %d words)\n",
+           TIMING_DEFAULT_SETS, TIMING_DEFAULT_WAYS, TIMING_DEFAULT_LINE_WORDS);
+    printf("  --miss-penalty N / --mispredict-penalty N   Penalty cycles (default %d / %d)\n",
+           TIMING_DEFAULT_MISS_PENALTY, TIMING_DEFAULT_MISPREDICT_PENALTY);
+    printf("  --help          Show this help message\n");
+}
+
+static uint32_t sample_next(uint64_t* state) {
+    // xorshift64*
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return (uint32_t)((*state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static double sample_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Setting up a CPU at the program's entry with buffered input and no output
+static void sample_load(CPU* cpu, const Executable* exe, const uint8_t* input, size_t input_size) {
+    cpu_init(cpu);
+    cpu->suppress_output = true;
+    for (uint32_t s = 0; s < exe->segment_count; s++) {
+        for (uint32_t i = 0; i < exe->segments[s].size; i++) {
+            cpu_poke(cpu, (uint16_t)(exe->segments[s].address + i), exe->segments[s].words[i]);
+        }
+    }
+    cpu->pc = exe->entry;
+    cpu_set_input(cpu, input, input_size);
+}
+
+// Profiling: running to the end (or budget) in intervals, one basic-block vector each
+static SampleInterval* sample_profile(CPU* cpu, uint64_t interval, uint64_t budget, uint32_t* count) {
+    uint32_t capacity = 64;
+    SampleInterval* intervals = (SampleInterval*)calloc(capacity, sizeof(SampleInterval));
+    *count = 0;
+    while (intervals && !cpu->halted && cpu->cycle_count < budget) {
+        if (*count == capacity) {
+            capacity *= 2;
+            SampleInterval* grown = (SampleInterval*)realloc(intervals, capacity * sizeof(SampleInterval));
+            if (!grown) break;
+            intervals = grown;
+        }
+        SampleInterval* iv = &intervals[*count];
+        memset(iv, 0, sizeof(SampleInterval));
+        iv->start = cpu->cycle_count;
+        uint64_t end = iv->start + interval < budget ? iv->start + interval : budget;
+        uint64_t counts[SAMPLE_BBV_DIMS] = { 0 };
+        while (!cpu->halted && cpu->cycle_count < end) {
+            uint32_t block = (uint32_t)(cpu->pc * 2654435761u) >> (32 - SAMPLE_BBV_BITS);
+            uint64_t before = cpu->cycle_count;
+            cpu->engine->run(cpu, end);
+            counts[block] += cpu->cycle_count - before;
+        }
+        iv->length = cpu->cycle_count - iv->start;
+        if (iv->length == 0) break;
+        for (int d = 0; d < SAMPLE_BBV_DIMS; d++) {
+            iv->bbv[d] = (float)((double)counts[d] / iv->length);
+        }
+        (*count)++;
+    }
+    if (!intervals) fprintf(stderr, "Error: Out of memory for interval profiles\n");
+    return intervals;
+}
+
+static double sample_distance(const float* a, const float* b) {
+    double sum = 0;
+    for (int d = 0; d < SAMPLE_BBV_DIMS; d++) {
+        double diff = (double)a[d] - b[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// k-means with k-means++ seeding; sets every interval's cluster
+static void sample_cluster(SampleInterval* intervals, uint32_t count, uint32_t k, uint64_t* rng) {
+    float (*centers)[SAMPLE_BBV_DIMS] = calloc(k, sizeof(*centers));
+    double* nearest = (double*)malloc(count * sizeof(double));
+
+    // Seeding: each next center is an interval picked with probability
+    // proportional to its squared distance from the centers so far
+    memcpy(centers[0], intervals[sample_next(rng) % count].bbv, sizeof(centers[0]));
+    for (uint32_t c = 1; c < k; c++) {
+        double total = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            double best = INFINITY;
+            for (uint32_t j = 0; j < c; j++) {
+                double dist = sample_distance(intervals[i].bbv, centers[j]);
+                if (dist < best) best = dist;
+            }
+            nearest[i] = best;
+            total += best;
+        }
+        uint32_t pick = 0;
+        double target = total * (sample_next(rng) / 4294967296.0);
+        for (uint32_t i = 0; i < count; i++) {
+            pick = i;
+            if (target < nearest[i]) break;
+            target -= nearest[i];
+        }
+        memcpy(centers[c], intervals[pick].bbv, sizeof(centers[c]));
+    }
+
+    for (uint32_t i = 0; i < count; i++) intervals[i].cluster = -1;
+    for (int round = 0; round < SAMPLE_KMEANS_ROUNDS; round++) {
+        bool moved = false;
+        for (uint32_t i = 0; i < count; i++) {
+            int best = 0;
+            double best_dist = INFINITY;
+            for (uint32_t c = 0; c < k; c++) {
+                double dist = sample_distance(intervals[i].bbv, centers[c]);
+                if (dist < best_dist) {
+                    best_dist = dist;
+                    best = (int)c;
+                }
+            }
+            moved = moved || intervals[i].cluster != best;
+            intervals[i].cluster = best;
+        }
+        if (!moved) break;
+        // An emptied cluster keeps its center
+        for (uint32_t c = 0; c < k; c++) {
+            double sum[SAMPLE_BBV_DIMS] = { 0 };
+            uint32_t members = 0;
+            for (uint32_t i = 0; i < count; i++) {
+                if (intervals[i].cluster != (int)c) continue;
+                for (int d = 0; d < SAMPLE_BBV_DIMS; d++) sum[d] += intervals[i].bbv[d];
+                members++;
+            }
+            if (members == 0) continue;
+            for (int d = 0; d < SAMPLE_BBV_DIMS; d++) centers[c][d] = (float)(sum[d] / members);
+        }
+    }
+    free(centers);
+    free(nearest);
+}
+
+// Choosing up to per_cluster intervals of each cluster uniformly at random
+static uint32_t* sample_choose(SampleInterval* intervals, uint32_t count, uint32_t k, uint32_t per_cluster,
+                               uint64_t* rng, uint32_t* chosen_count) {
+    uint32_t* chosen = (uint32_t*)malloc(count * sizeof(uint32_t));
+    uint32_t* members = (uint32_t*)malloc(count * sizeof(uint32_t));
+    *chosen_count = 0;
+    for (uint32_t c = 0; c < k; c++) {
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            if (intervals[i].cluster == (int)c) members[n++] = i;
+        }
+        for (uint32_t j = 0; j < n && j < per_cluster; j++) {
+            uint32_t swap = j + sample_next(rng) % (n - j);
+            uint32_t pick = members[swap];
+            members[swap] = members[j];
+            members[j] = pick;
+            intervals[pick].chosen = true;
+        }
+    }
+    // In program order, for the checkpointing run
+    for (uint32_t i = 0; i < count; i++) {
+        if (intervals[i].chosen) chosen[(*chosen_count)++] = i;
+    }
+    free(members);
+    return chosen;
+}
+
+// Checkpointing: re-running functionally, snapshotting before each chosen interval
+static bool sample_checkpoint(CPU* cpu, SampleInterval* intervals, const uint32_t* chosen,
+                              uint32_t chosen_count, uint64_t warmup) {
+    for (uint32_t j = 0; j < chosen_count; j++) {
+        SampleInterval* iv = &intervals[chosen[j]];
+        uint64_t at = iv->start > warmup ? iv->start - warmup : 0;
+        if (at > cpu->cycle_count) {
+            cpu_run_bounded(cpu, at - cpu->cycle_count, false);
+        }
+        iv->snap = (Snapshot*)malloc(sizeof(Snapshot));
+        if (!iv->snap || !snapshot_take(iv->snap, cpu)) {
+            if (!iv->snap) fprintf(stderr, "Error: Out of memory for snapshot\n");
+            free(iv->snap);
+            iv->snap = NULL;
+            return false;
+        }
+        iv->input_pos = cpu->input_pos;
+    }
+    return true;
+}
+
+static void* sample_worker_main(void* arg) {
+    SampleJobs* jobs = (SampleJobs*)arg;
+    CPU cpu;
+    cpu_init(&cpu);
+    cpu.suppress_output = true;
+    TimingModel model;
+    for (;;) {
+        uint32_t j = __atomic_fetch_add(&jobs->next, 1, __ATOMIC_RELAXED);
+        if (j >= jobs->chosen_count) break;
+        SampleInterval* iv = &jobs->intervals[jobs->chosen[j]];
+        snapshot_load(iv->snap, &cpu);
+        cpu_set_input(&cpu, jobs->input, jobs->input_size);
+        cpu.input_pos = iv->input_pos;
+        if (!timing_init(&model, jobs->config)) {
+            jobs->failed = true;
+            break;
+        }
+        cpu.timing = &model;
+        while (!cpu.halted && cpu.cycle_count < iv->start) {
+            cpu_step(&cpu, false);
+        }
+        timing_clear_stats(&model);
+        while (!cpu.halted && cpu.cycle_count < iv->start + iv->length) {
+            cpu_step(&cpu, false);
+        }
+        iv->stats = model.stats;
+        cpu.timing = NULL;
+        timing_free(&model);
+    }
+    cpu_free(&cpu);
+    return NULL;
+}
+
+static uint64_t sample_field(const TimingStats* stats, size_t offset) {
+    return *(const uint64_t*)((const char*)stats + offset);
+}
+
+// Stratified ratio estimate of the whole-run sum(y) / sum(x): each
+// cluster's total is its size times its sample mean. The variance of
+// the ratio comes from the residuals y - R x within each cluster, with
+// the finite-population correction (a fully sampled cluster adds none)
+static SampleEstimate sample_estimate(const SampleInterval* intervals, uint32_t count, uint32_t k,
+                                      size_t y_field, size_t x_field) {
+    SampleEstimate estimate = { 0.0, 0.0 };
+    double* total_y = (double*)calloc(k, sizeof(double));
+    double* total_x = (double*)calloc(k, sizeof(double));
+    uint32_t* size = (uint32_t*)calloc(k, sizeof(uint32_t));
+    uint32_t* sampled = (uint32_t*)calloc(k, sizeof(uint32_t));
+    for (uint32_t i = 0; i < count; i++) {
+        int c = intervals[i].cluster;
+        size[c]++;
+        if (!intervals[i].chosen) continue;
+        sampled[c]++;
+        total_y[c] += (double)sample_field(&intervals[i].stats, y_field);
+        total_x[c] += (double)sample_field(&intervals[i].stats, x_field);
+    }
+    double y = 0, x = 0;
+    for (uint32_t c = 0; c < k; c++) {
+        if (sampled[c] == 0) continue;
+        y += size[c] * total_y[c] / sampled[c];
+        x += size[c] * total_x[c] / sampled[c];
+    }
+    if (x > 0) {
+        double ratio = y / x;
+        double variance = 0;
+        for (uint32_t c = 0; c < k && !isnan(variance); c++) {
+            if (sampled[c] == size[c]) continue;
+            if (sampled[c] < 2) {
+                variance = NAN;
+                break;
+            }
+            double mean = (total_y[c] - ratio * total_x[c]) / sampled[c];
+            double spread = 0;
+            for (uint32_t i = 0; i < count; i++) {
+                if (intervals[i].cluster != (int)c || !intervals[i].chosen) continue;
+                double d = sample_field(&intervals[i].stats, y_field) -
+                           ratio * sample_field(&intervals[i].stats, x_field) - mean;
+                spread += d * d;
+            }
+            spread /= sampled[c] - 1;
+            variance += (double)size[c] * size[c] * (1.0 - (double)sampled[c] / size[c]) * spread / sampled[c];
+        }
+        estimate.value = ratio;
+        estimate.half_width = SAMPLE_Z95 * sqrt(variance) / x;
+    }
+    free(total_y);
+    free(total_x);
+    free(size);
+    free(sampled);
+    return estimate;
+}
+
+static void sample_print_estimate(const char* name, SampleEstimate estimate, double scale, const char* unit) {
+    if (isnan(estimate.half_width)) {
+        printf("  %-24s %.3f%s (no error bound: a cluster has one sample)\n", name,
+               estimate.value * scale, unit);
+    } else {
+        printf("  %-24s %.3f%s +/- %.3f%s (95%%)\n", name, estimate.value * scale, unit,
+               estimate.half_width * scale, unit);
+    }
+}
+
+// Comparing an estimate with the value from the full detailed run
+static void sample_print_actual(const char* name, SampleEstimate estimate, double actual, double scale,
+                                const char* unit) {
+    double error = estimate.value - actual;
+    printf("  %-24s %.3f%s (estimate off by %.3f%s, %s the bound)\n", name, actual * scale, unit,
+           fabs(error) * scale, unit,
+           isnan(estimate.half_width) ? "no" : fabs(error) <= estimate.half_width ? "within" : "outside");
+}
+
+int main(int argc, char* argv[]) {
+    const char* program = NULL;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t interval = SAMPLE_DEFAULT_INTERVAL;
+    uint64_t warmup = SAMPLE_DEFAULT_WARMUP;
+    uint32_t clusters = SAMPLE_DEFAULT_CLUSTERS;
+    uint32_t per_cluster = SAMPLE_DEFAULT_PER_CLUSTER;
+    uint64_t seed = 1;
+    uint64_t cycles = SAMPLE_DEFAULT_CYCLES;
+    const char* input = NULL;
+    bool full = false;
+    TimingConfig config;
+    timing_default_config(&config);
+
+    // Parsing command-line arguments
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--clusters") == 0 && i + 1 < argc) {
+            clusters = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--per-cluster") == 0 && i + 1 < argc) {
+            per_cluster = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = strtol(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            cycles = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input = argv[++i];
+        } else if (strcmp(argv[i], "--full") == 0) {
+            full = true;
+        } else if (strcmp(argv[i], "--sets") == 0 && i + 1 < argc) {
+            config.sets = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--ways") == 0 && i + 1 < argc) {
+            config.ways = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--line") == 0 && i + 1 < argc) {
+            config.line_words = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--miss-penalty") == 0 && i + 1 < argc) {
+            config.miss_penalty = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--mispredict-penalty") == 0 && i + 1 < argc) {
+            config.mispredict_penalty = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (!program) {
+            program = argv[i];
+        }
+    }
+
+    if (!program) {
+        fprintf(stderr, "Error: No program specified\n");
+        print_usage(argv[0]);
+        return 2;
+    }
+    if (jobs < 1 || jobs > 256 || interval == 0 || clusters == 0 || per_cluster == 0 || cycles == 0) {
+        fprintf(stderr, "Error: --jobs must be 1-256; --interval, --clusters, --per-cluster "
+                "and --cycles positive\n");
+        return 2;
+    }
+    TimingModel probe;
+    if (!timing_init(&probe, &config)) return 2;
+    timing_free(&probe);
+
+    Executable exe;
+    if (!exe_read(program, &exe)) return 2;
+    static const uint8_t empty = 0;     // NULL input would mean stdin
+    const uint8_t* input_bytes = input ? (const uint8_t*)input : &empty;
+    size_t input_size = input ? strlen(input) : 0;
+
+    // Profiling with the fast engine
+    double started = sample_now();
+    CPU cpu;
+    sample_load(&cpu, &exe, input_bytes, input_size);
+    engine_attach(&cpu, engine_lookup("predecoded"));
+    uint32_t count;
+    SampleInterval* intervals = sample_profile(&cpu, interval, cycles, &count);
+    uint64_t total = cpu.cycle_count;
+    bool halted = cpu.halted;
+    cpu_free(&cpu);
+    if (!intervals || count == 0) {
+        if (intervals) fprintf(stderr, "Error: Program ran no instructions\n");
+        free(intervals);
+        exe_free(&exe);
+        return 2;
+    }
+    printf("Profiled %s: %llu instructions%s in %u interval(s) of %llu (%.3f s)\n", program,
+           (unsigned long long)total, halted ? "" : " (cycle budget)", count,
+           (unsigned long long)interval, sample_now() - started);
+
+    // Clustering and choosing
+    uint64_t rng = seed * 0x9E3779B97F4A7C15ULL + 1;
+    if (clusters > count) clusters = count;
+    sample_cluster(intervals, count, clusters, &rng);
+    uint32_t chosen_count;
+    uint32_t* chosen = sample_choose(intervals, count, clusters, per_cluster, &rng, &chosen_count);
+    for (uint32_t c = 0; c < clusters; c++) {
+        uint32_t size = 0;
+        for (uint32_t i = 0; i < count; i++) size += intervals[i].cluster == (int)c;
+        if (size == 0) continue;
+        printf("  Cluster %u: %u interval(s) (%.1f%%), simulating", c, size, 100.0 * size / count);
+        for (uint32_t j = 0; j < chosen_count; j++) {
+            if (intervals[chosen[j]].cluster == (int)c) printf(" #%u", chosen[j]);
+        }
+        printf("\n");
+    }
+
+    // Checkpointing, then the detailed runs in parallel
+    started = sample_now();
+    sample_load(&cpu, &exe, input_bytes, input_size);
+    engine_attach(&cpu, engine_lookup("predecoded"));
+    bool ok = sample_checkpoint(&cpu, intervals, chosen, chosen_count, warmup);
+    cpu_free(&cpu);
+
+    SampleJobs shared;
+    memset(&shared, 0, sizeof(shared));
+    shared.intervals = intervals;
+    shared.chosen = chosen;
+    shared.chosen_count = chosen_count;
+    shared.config = &config;
+    shared.input = input_bytes;
+    shared.input_size = input_size;
+    if (jobs > (long)chosen_count) jobs = (long)chosen_count;
+    pthread_t* threads = (pthread_t*)calloc(jobs, sizeof(pthread_t));
+    int running = 0;
+    for (int i = 0; i < jobs && ok; i++, running++) {
+        if (pthread_create(&threads[i], NULL, sample_worker_main, &shared) != 0) {
+            fprintf(stderr, "Error: Cannot start worker thread\n");
+            ok = false;
+            break;
+        }
+    }
+    for (int i = 0; i < running; i++) pthread_join(threads[i], NULL);
+    free(threads);
+    ok = ok && !shared.failed;
+
+    if (ok) {
+        uint64_t detailed = 0;
+        for (uint32_t j = 0; j < chosen_count; j++) {
+            const SampleInterval* iv = &intervals[chosen[j]];
+            detailed += iv->length + (iv->start > warmup ? warmup : iv->start);
+        }
+        printf("Simulated %u of %u interval(s) in detail on %ld thread(s): %llu instructions "
+               "with warm-up (%.1f%% of the run, %.3f s)\n", chosen_count, count, jobs,
+               (unsigned long long)detailed, 100.0 * detailed / total, sample_now() - started);
+
+        SampleEstimate cpi = sample_estimate(intervals, count, clusters, offsetof(TimingStats, cycles),
+                                             offsetof(TimingStats, instructions));
+        SampleEstimate miss = sample_estimate(intervals, count, clusters, offsetof(TimingStats, misses),
+                                              offsetof(TimingStats, accesses));
+        SampleEstimate mispredict = sample_estimate(intervals, count, clusters,
+                                                    offsetof(TimingStats, mispredicts),
+                                                    offsetof(TimingStats, branches));
+        printf("Estimate:\n");
+        sample_print_estimate("CPI:", cpi, 1.0, "");
+        sample_print_estimate("Cache miss rate:", miss, 100.0, "%");
+        sample_print_estimate("Branch mispredict rate:", mispredict, 100.0, "%");
+
+        if (full) {
+            started = sample_now();
+            TimingModel model;
+            sample_load(&cpu, &exe, input_bytes, input_size);
+            ok = timing_init(&model, &config);
+            if (ok) {
+                cpu.timing = &model;
+                while (!cpu.halted && cpu.cycle_count < total) {
+                    cpu_step(&cpu, false);
+                }
+                const TimingStats* s = &model.stats;
+                printf("Full detailed run (%.3f s):\n", sample_now() - started);
+                sample_print_actual("CPI:", cpi, (double)s->cycles / s->instructions, 1.0, "");
+                sample_print_actual("Cache miss rate:", miss,
+                                    s->accesses ? (double)s->misses / s->accesses : 0.0, 100.0, "%");
+                sample_print_actual("Branch mispredict rate:", mispredict,
+                                    s->branches ? (double)s->mispredicts / s->branches : 0.0, 100.0, "%");
+                cpu.timing = NULL;
+                timing_free(&model);
+            }
+            cpu_free(&cpu);
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (intervals[i].snap) snapshot_free(intervals[i].snap);
+        free(intervals[i].snap);
+    }
+    free(intervals);
+    free(chosen);
+    exe_free(&exe);
+    return ok ? 0 : 2;
+}